@@ -79,6 +79,7 @@ typedef enum
 typedef struct
 {
     nl_eventqueue_t mSdkQueue;    /* queue used by the sdk to receive events. */
+    nl_eventqueue_t mLogQueue;    /* queue of a low priority task that logs the NCP debug stream, or NULL. */
 } thci_init_params_t;
 
 /**
@@ -173,11 +174,17 @@ typedef struct
  * It is up to the THCI module to initialize underlying layers, including
  * OpenThread and any platform specific code.
  *
+ * With THCI_CONFIG_ARENA, the buffers are carved from a static region
+ * for the default profile, and this is only built with
+ * THCI_CONFIG_ARENA_DEFAULT_REGION.  See thciSDKInitWithArena().
+ *
  * @param[in] A pointer to thci_init_params_t struct.
  *
  * @retval 0  If initialization succeeded, error code otherwise.
  */
+#if !THCI_CONFIG_ARENA || THCI_CONFIG_ARENA_DEFAULT_REGION
 int thciSDKInit(thci_init_params_t *aInitParams);
+#endif
 
 /**
  * Check if Thci was initialized.
@@ -186,6 +193,44 @@ int thciSDKInit(thci_init_params_t *aInitParams);
  */
 int thciInitialized(void);
 
+/**
+ * A THCI instance: one NCP with its own context, UART, event queue, netifs
+ * and message queue.  Instance 0 is the default instance.
+ */
+typedef struct thci_instance_s thci_instance_t;
+
+/**
+ * Get a THCI instance.
+ *
+ * @param[in] aIndex   The instance index, below THCI_CONFIG_MAX_INSTANCES.
+ *
+ * @return The instance, or NULL if aIndex is out of range.
+ */
+thci_instance_t *thciGetInstance(uint8_t aIndex);
+
+/**
+ * Bind the calling task to a THCI instance.  The THCI API called from this
+ * task then acts on that instance.  Each instance's THCI task, the task
+ * that services its mSdkQueue, must be bound to it before thciSDKInit() is
+ * called for it.  Tasks that are not bound act on the default instance.
+ *
+ * @param[in] aInstance   The instance, or NULL to unbind the task.
+ *
+ * @return The instance the task was bound to before, NULL if none, so that
+ *         a task may bind temporarily and restore its binding after.
+ */
+thci_instance_t *thciSetCurrentInstance(thci_instance_t *aInstance);
+
+/**
+ * Get the THCI instance the THCI API acts on from the calling task.
+ */
+thci_instance_t *thciGetCurrentInstance(void);
+
+/**
+ * Get the index of a THCI instance.
+ */
+uint8_t thciGetInstanceIndex(const thci_instance_t *aInstance);
+
 /**
  * Initialize / Enable the Thread Module.
  *
@@ -1188,6 +1233,70 @@ otError thciGetChildTable(otChildInfo *aChildTableHead, uint32_t aInSize, uint32
  */
 otError thciGetNeighborTable(otNeighborInfo *aNeighborTableHead, uint32_t aInSize, uint32_t *aOutSize);
 
+/**
+ * This function pointer is called by thciVisitChildTable() for each entry
+ * of the child table.
+ *
+ * It runs in the middle of the response of the NCP: it must not call
+ * THCI, whose next request would overwrite the response being decoded,
+ * nor the safe API, which would wait for the THCI task it runs on.
+ *
+ * @param[in]  aChild    The entry, valid only during the call.
+ * @param[in]  aContext  A pointer to application-specific context.
+ *
+ * @return  true to visit the next entry, false to stop.
+ */
+typedef bool (*thciChildVisitor)(const otChildInfo *aChild, void *aContext);
+
+/**
+ * This function pointer is called by thciVisitNeighborTable() for each
+ * entry of the neighbour table.
+ *
+ * It runs in the middle of the response of the NCP: it must not call
+ * THCI, whose next request would overwrite the response being decoded,
+ * nor the safe API, which would wait for the THCI task it runs on.
+ *
+ * @param[in]  aNeighbor  The entry, valid only during the call.
+ * @param[in]  aContext   A pointer to application-specific context.
+ *
+ * @return  true to visit the next entry, false to stop.
+ */
+typedef bool (*thciNeighborVisitor)(const otNeighborInfo *aNeighbor, void *aContext);
+
+/**
+ * Visit the thread child table, without a caller sized array.  The
+ * entries are decoded one at a time from the response of the NCP.
+ *
+ * @param[in]  aVisitor  Called for each entry, until it returns false.
+ *                       It must not call THCI, see thciChildVisitor.
+ * @param[in]  aContext  A pointer to application-specific context.
+ *
+ * @retval  OT_ERROR_NONE               Visited the table, or stopped by aVisitor.
+ * @retval  OT_ERROR_INVALID_ARGS       aVisitor is NULL.
+ * @retval  OT_ERROR_INVALID_STATE      The NCP module is not initialized.
+ * @retval  OT_ERROR_PARSE              A page or an entry of the response could not be parsed.
+ * @retval  OT_ERROR_NO_FRAME_RECEIVED  The NCP did not respond in time.
+ * @retval  OT_ERROR_FAILED             Failed to read the table.
+ */
+otError thciVisitChildTable(thciChildVisitor aVisitor, void *aContext);
+
+/**
+ * Visit the thread neighbour table, without a caller sized array.  The
+ * entries are decoded one at a time from the response of the NCP.
+ *
+ * @param[in]  aVisitor  Called for each entry, until it returns false.
+ *                       It must not call THCI, see thciNeighborVisitor.
+ * @param[in]  aContext  A pointer to application-specific context.
+ *
+ * @retval  OT_ERROR_NONE               Visited the table, or stopped by aVisitor.
+ * @retval  OT_ERROR_INVALID_ARGS       aVisitor is NULL.
+ * @retval  OT_ERROR_INVALID_STATE      The NCP module is not initialized.
+ * @retval  OT_ERROR_PARSE              A page or an entry of the response could not be parsed.
+ * @retval  OT_ERROR_NO_FRAME_RECEIVED  The NCP did not respond in time.
+ * @retval  OT_ERROR_FAILED             Failed to read the table.
+ */
+otError thciVisitNeighborTable(thciNeighborVisitor aVisitor, void *aContext);
+
 /**
  * Get the instantaneous RSSI
  *
@@ -1212,6 +1321,18 @@ void thciInitiateNCPRecovery(void);
  */
 void thciStallOutgoingDataPackets(bool aEnable);
 
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_SPINEL_IID_MUX
+/**
+ * This function stalls or restarts the outgoing IP packets of one netif,
+ * leaving the other netifs flowing.  Packets are held in the netif's queue
+ * while stalled.
+ *
+ * @param[in]   aTag     The netif.
+ * @param[in]   aEnable  Set true to stall the netif's outgoing IP packets, false otherwise.
+ */
+void thciStallNetifDataPackets(thci_netif_tags_t aTag, bool aEnable);
+#endif
+
 /**
  * This function extracts the checksum from the IP packet
  *
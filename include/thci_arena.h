@@ -0,0 +1,175 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the memory arena of a THCI instance.
+ *
+ *      With THCI_CONFIG_ARENA the largest buffers of an instance are not
+ *      static arrays sized at build time, but are carved by
+ *      thciSDKInitWithArena() from a region of the application, sized by a
+ *      profile.  A product can then trade RAM against throughput without a
+ *      rebuild: thciGetArenaUsage() reports the high water mark of each
+ *      buffer, to size the profile from measured data.  thciSDKInit()
+ *      carves the default profile from a static region instead, unless
+ *      THCI_CONFIG_ARENA_DEFAULT_REGION is 0.
+ *
+ *      The buffers are carved once, and stay in use until reboot: the
+ *      region must not be reused, and the arena of an instance cannot be
+ *      changed.  The other buffers of THCI, of a few hundred bytes, stay
+ *      static.
+ *
+ */
+
+#ifndef __THCI_ARENA_H_INCLUDED__
+#define __THCI_ARENA_H_INCLUDED__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <thci.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if THCI_CONFIG_ARENA
+
+/**
+ * Size of the buffer of an HDLC encoded frame, every byte escaped, for
+ * Spinel frames of up to _size bytes.
+ */
+#define THCI_ARENA_ENCODED_FRAME_SIZE(_size)    (2 * (_size) + 8)
+
+/**
+ * Size of the UART TX buffers, for Spinel frames of up to _size bytes:
+ * whole encoded frames for the tty, a fifo of encoded bytes for the UART.
+ */
+#if THCI_CONFIG_POSIX_TTY
+#define THCI_ARENA_UART_TX_SIZE(_size)          (THCI_CONFIG_UART_TX_FRAMES * THCI_ARENA_ENCODED_FRAME_SIZE(_size))
+#else
+#define THCI_ARENA_UART_TX_SIZE(_size)          (THCI_CONFIG_UART_TX_FIFO_SIZE)
+#endif
+
+/**
+ * Sizes of the buffers of an instance.  The UART ones are not carved when
+ * the NCP is on SPI or shared memory.
+ */
+typedef struct
+{
+    uint32_t    mTxRingSize;            // bytes of the NCP TX message ring.
+    uint16_t    mMessageQueueSize;      // entries of each outgoing message queue.
+    uint16_t    mTxFrameSize;           // bytes of the largest Spinel frame sent.
+    uint16_t    mRxFrameSize;           // bytes of the largest Spinel frame received over the UART.
+    uint16_t    mRxFifoSize;            // bytes of the UART RX fifo.
+} thci_arena_profile_t;
+
+/**
+ * Use of the arena of an instance.
+ */
+typedef struct
+{
+    uint32_t                mSize;                  // of the region.
+    uint32_t                mUsed;                  // bytes carved for the profile.
+    thci_arena_profile_t    mProfile;
+    uint32_t                mTxRingHighWater;       // highest number of bytes in use in the TX message ring.
+    uint16_t                mMessageQueueHighWater; // most entries in an outgoing message queue.
+    uint16_t                mTxFrameHighWater;      // longest Spinel frame sent.
+    uint16_t                mRxFrameHighWater;      // longest Spinel frame received.
+    uint16_t                mRxFifoHighWater;       // highest number of bytes in the UART RX fifo.
+} thci_arena_usage_t;
+
+/**
+ * Get the profile of the sizes THCI is built with when THCI_CONFIG_ARENA
+ * is 0, to start from.
+ */
+void thciArenaGetDefaultProfile(thci_arena_profile_t *aProfile);
+
+/**
+ * @return The number of bytes of a region for aProfile.
+ */
+size_t thciArenaGetSize(const thci_arena_profile_t *aProfile);
+
+/**
+ * Same as thciSDKInit(), carving the buffers of the current instance from
+ * aArena, as sized by aProfile.
+ *
+ * @param[in] aInitParams   A pointer to thci_init_params_t struct.
+ * @param[in] aArena        The region, used by THCI from then on.
+ * @param[in] aArenaSize    Its size, at least thciArenaGetSize(aProfile).
+ * @param[in] aProfile      The sizes of the buffers, NULL for the defaults.
+ *
+ * @retval 0  If initialization succeeded, -EINVAL for an invalid profile,
+ *            -ENOMEM if aArenaSize is too small, error code otherwise.
+ */
+int thciSDKInitWithArena(thci_init_params_t *aInitParams, void *aArena, size_t aArenaSize, const thci_arena_profile_t *aProfile);
+
+/**
+ * Get the use of the arena of the current instance, since its
+ * initialization or the last reset of the datapath and UART counters.
+ */
+void thciGetArenaUsage(thci_arena_usage_t *aUsage);
+
+/**
+ * The buffers carved from the arena of an instance.  For the modules.
+ */
+typedef struct
+{
+    uint8_t         *mTxRing;           // mTxRingSize bytes.
+    otMessage       **mMessageQueues;   // THCI_MESSAGE_QUEUE_COUNT queues of mMessageQueueSize entries.
+    uint8_t         *mTxFrame;          // mTxFrameSize bytes.
+    uint8_t         *mTxFrames;         // THCI_ARENA_UART_TX_SIZE(mTxFrameSize) bytes.
+    uint8_t         *mRxFrame;          // mRxFrameSize bytes.
+    uint8_t         *mRxFifo;           // mRxFifoSize bytes.
+} thci_arena_buffers_t;
+
+/**
+ * Carve the buffers of the current instance.  Called from
+ * thciSDKInitWithArena().
+ *
+ * @retval 0 on success, a negative errno otherwise.
+ */
+int thciArenaInit(void *aArena, size_t aArenaSize, const thci_arena_profile_t *aProfile);
+
+#if THCI_CONFIG_ARENA_DEFAULT_REGION
+/**
+ * Carve the buffers of the current instance from its static region, for
+ * the default profile.  Called from thciSDKInit().
+ *
+ * @retval 0 on success, a negative errno otherwise.
+ */
+int thciArenaInitDefault(void);
+#endif
+
+/**
+ * @return The profile of the current instance.
+ */
+const thci_arena_profile_t *thciArenaGetProfile(void);
+
+/**
+ * @return The buffers of the current instance, NULL before thciArenaInit().
+ */
+const thci_arena_buffers_t *thciArenaGetBuffers(void);
+
+#endif // THCI_CONFIG_ARENA
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_ARENA_H_INCLUDED__ */
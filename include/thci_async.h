@@ -0,0 +1,117 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the non-blocking Spinel request path.
+ *
+ *      thciAsyncRequest() sends a property request to the NCP and returns
+ *      at once; the response is delivered to a callback by an event on
+ *      the THCI task.  Up to THCI_CONFIG_ASYNC_MAX_REQUESTS requests are
+ *      outstanding, each with its own Spinel transaction id, alongside the
+ *      blocking THCI API.  Responses are copied, truncated to
+ *      THCI_CONFIG_ASYNC_VALUE_SIZE bytes.
+ *
+ *      THCI has no timers: a request that is not answered is only expired
+ *      by the next THCI event, so the application calls thciAsyncTick()
+ *      periodically while requests may be outstanding.  As with the
+ *      blocking API, an expired request starts NCP recovery, which fails
+ *      the other outstanding requests with OT_ERROR_ABORT.
+ *
+ *      thciAsyncPost() runs a function on the THCI task, which is where
+ *      requests must be made; thci_coroutine.h builds on both.
+ *
+ */
+
+#ifndef __THCI_ASYNC_H_INCLUDED__
+#define __THCI_ASYNC_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#include <openthread/types.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#include <openthread/spinel.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_ASYNC_REQUESTS
+
+/**
+ * Receives the response to a request on the THCI task.
+ *
+ * @param[in]  aError       OT_ERROR_NONE on success, OT_ERROR_FAILED when the
+ *                          NCP answered with another key, usually
+ *                          LAST_STATUS, OT_ERROR_RESPONSE_TIMEOUT or
+ *                          OT_ERROR_ABORT when there is no response.
+ * @param[in]  aCommand     The command of the response.
+ * @param[in]  aKey         The key of the response.
+ * @param[in]  aValue       The value of the response, valid during the call.
+ * @param[in]  aLength      The length of aValue.
+ * @param[in]  aContext     The context given to thciAsyncRequest().
+ */
+typedef void (*thciAsyncCallback)(otError aError, uint32_t aCommand, spinel_prop_key_t aKey,
+                                  const uint8_t *aValue, uint16_t aLength, void *aContext);
+
+typedef void (*thciAsyncFunction)(void *aContext);
+
+/**
+ * Send a property get, set, insert or remove request, plain or Nest
+ * vendor, without waiting for its response.  Call from the THCI task.
+ *
+ * @param[in]  aValue       The packed value of the request.  May be NULL
+ *                          when aValueLength is 0.
+ * @param[in]  aValueLength At most THCI_CONFIG_ASYNC_VALUE_SIZE bytes.
+ *
+ * @retval OT_ERROR_NONE            The request was sent; aCallback will be called.
+ * @retval OT_ERROR_INVALID_ARGS    aCallback is NULL, or the value is missing or too long.
+ * @retval OT_ERROR_INVALID_STATE   THCI is not initialized.
+ * @retval OT_ERROR_NOT_IMPLEMENTED aCommand is not supported.
+ * @retval OT_ERROR_NO_BUFS         THCI_CONFIG_ASYNC_MAX_REQUESTS requests are outstanding.
+ */
+otError thciAsyncRequest(uint32_t aCommand, spinel_prop_key_t aKey, const uint8_t *aValue, uint16_t aValueLength,
+                         thciAsyncCallback aCallback, void *aContext);
+
+/**
+ * Run aFunction on the THCI task.  May be called from any task.
+ *
+ * @retval OT_ERROR_NONE            aFunction will be called.
+ * @retval OT_ERROR_INVALID_STATE   THCI is not initialized.
+ * @retval OT_ERROR_NO_BUFS         THCI_CONFIG_ASYNC_MAX_CALLS calls are queued.
+ */
+otError thciAsyncPost(thciAsyncFunction aFunction, void *aContext);
+
+/**
+ * Expire the requests that were not answered in time.  Call periodically,
+ * e.g. every second, from any task.
+ */
+void thciAsyncTick(void);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_ASYNC_REQUESTS
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_ASYNC_H_INCLUDED__ */
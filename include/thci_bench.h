@@ -0,0 +1,104 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the THCI traffic generator.
+ *
+ *      The generator sends UDP datagrams to an echo service, or ICMPv6
+ *      echo requests, through LwIP so that the traffic takes the same path
+ *      as production traffic (LwIPOutputIP6 on NCP platforms).  Each
+ *      packet carries a sequence number and its send time, so loss and
+ *      round trip times are measured from the echoed packets alone.
+ *
+ *      To measure the host/NCP link without a peer, target an address
+ *      answered by the NCP itself, e.g. its RLOC with ICMPv6 echo offload
+ *      enabled (thciSetIcmpEchoEnabled).
+ *
+ */
+
+#ifndef __THCI_BENCH_H_INCLUDED__
+#define __THCI_BENCH_H_INCLUDED__
+
+#include <stdint.h>
+
+#include <thci_config.h>
+#include <thci_stats.h>
+
+#include <lwip/ip6_addr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Default UDP port of the echo service (RFC 862).
+ */
+#define THCI_BENCH_DEFAULT_PORT     7
+
+typedef enum
+{
+    kThciBenchProtoUdp = 0,
+    kThciBenchProtoIcmp
+} thci_bench_proto_t;
+
+typedef struct
+{
+    thci_bench_proto_t  mProto;
+    ip6_addr_t          mPeer;          // echo peer.
+    uint16_t            mPort;          // UDP echo port, ignored for ICMPv6.
+    uint16_t            mSize;          // payload size in bytes, including the 12 byte bench header.
+    uint16_t            mRate;          // packets per second.
+    uint32_t            mDuration;      // send duration, in msec.
+    uint32_t            mLinger;        // time to wait for late replies after the last send, in msec.
+} thci_bench_config_t;
+
+typedef struct
+{
+    uint32_t            mSent;          // packets accepted by LwIP.
+    uint32_t            mSendErrors;    // packets LwIP failed to send.
+    uint32_t            mReceived;      // valid replies, once per packet.
+    uint32_t            mDuplicates;    // further replies to packets already received.
+    uint32_t            mInvalid;       // replies that were not ours or were malformed.
+    uint32_t            mElapsed;       // from the first send to the last reply or end of linger, in msec.
+    uint32_t            mTxBitsPerSec;  // offered payload rate.
+    uint32_t            mRxBitsPerSec;  // delivered payload rate.
+    thci_histogram_t    mRtt;           // round trip, in msec.
+} thci_bench_result_t;
+
+#if THCI_CONFIG_BENCH
+
+/**
+ * Run a benchmark.  Blocks the calling task for the duration of the run;
+ * must not be called from the THCI or LwIP tasks.
+ *
+ * @param[in]  aConfig  The benchmark configuration.
+ * @param[out] aResult  The results.
+ *
+ * @retval 0 on success, -EINVAL if the run has more than
+ *         THCI_CONFIG_BENCH_MAX_PACKETS packets, a negative errno otherwise.
+ */
+int thciBenchRun(const thci_bench_config_t *aConfig, thci_bench_result_t *aResult);
+
+#endif // THCI_CONFIG_BENCH
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_BENCH_H_INCLUDED__ */
@@ -25,12 +25,9 @@
 #ifndef __THCI_CERT_H__
 #define __THCI_CERT_H__
 
-#include <lwip/pbuf.h>
+#include <stddef.h>
 
 void thci_cert_set_tx_corrupt_bits(size_t corrupted_bits);
 void thci_cert_set_rx_corrupt_bits(size_t corrupted_bits);
 
-void thci_cert_tx_corrupt(struct pbuf *buff);
-void thci_cert_rx_corrupt(struct pbuf *buff);
-
 #endif // __THCI_CERT_H__
@@ -0,0 +1,181 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the correlation between the host and the NCP clocks.
+ *
+ *      Each sample is a request/response exchange: the host time when the
+ *      request was sent, the NCP time carried in the response and the host
+ *      time when the response was received.  As in NTP, the sample with the
+ *      smallest round trip in the window gives the best offset estimate and
+ *      half of its round trip bounds the error.  Drift is estimated from the
+ *      best samples of the older and newer halves of the window.
+ *
+ *      Each frame received from the NCP ticks a periodic resync, posted to
+ *      the THCI task every THCI_CONFIG_NCP_CLOCK_SYNC_INTERVAL, and can be
+ *      stamped with the host and NCP times by a frame timestamp observer.
+ *
+ *      Each THCI instance correlates the clock of its own NCP; the functions
+ *      below act on the instance bound to the calling task.
+ *
+ */
+
+#ifndef __THCI_CLOCK_H_INCLUDED__
+#define __THCI_CLOCK_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#include <openthread/types.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The current host/NCP clock estimate.
+ */
+typedef struct
+{
+    uint32_t    mHostTime;      // host time of the reference sample, in msec.
+    int32_t     mOffset;        // NCP time minus host time at mHostTime, in msec.
+    uint32_t    mError;         // error bound of mOffset at mHostTime, in msec.
+    int32_t     mDriftPpm;      // NCP clock rate relative to the host clock, in ppm.
+    uint32_t    mDriftErrorPpm; // error bound of mDriftPpm, in ppm.
+    uint8_t     mSamples;       // samples in the window.
+} thci_ncp_clock_t;
+
+/**
+ * The times of a frame received from the NCP.
+ */
+typedef struct
+{
+    uint32_t    mHostTime;      // host time at which the frame was processed, in msec.
+    uint32_t    mNcpTime;       // mHostTime on the NCP clock, in msec.
+    uint32_t    mNcpTimeError;  // error bound of mNcpTime, in msec.
+    bool        mNcpTimeValid;  // false until a clock sample is available.
+} thci_frame_timestamp_t;
+
+/**
+ * Called on the THCI task for every Spinel frame received from the NCP,
+ * before it is parsed.  aFrame is only valid during the call, and THCI
+ * APIs must not be called from it.
+ */
+typedef void (*thciFrameTimestampObserver)(const uint8_t *aFrame, uint16_t aLength, const thci_frame_timestamp_t *aTimestamp, void *aContext);
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_CLOCK_SYNC
+
+/**
+ * Initialize the clock correlation.
+ *
+ * @retval 0 on success, a negative errno otherwise.
+ */
+int thciNcpClockInit(void);
+
+/**
+ * Discard all samples.  Called when the NCP resets, since its clock restarts.
+ */
+void thciNcpClockReset(void);
+
+/**
+ * Add a sample to the window, evicting the oldest one if it is full.
+ *
+ * @param[in]  aHostSend      Host time at which the request was sent, in msec.
+ * @param[in]  aNcpTime       NCP time carried in the response, in msec.
+ * @param[in]  aHostReceive   Host time at which the response was received, in msec.
+ */
+void thciNcpClockAddSample(uint32_t aHostSend, uint32_t aNcpTime, uint32_t aHostReceive);
+
+/**
+ * Retrieve the current estimate.
+ *
+ * @param[out] aClock   The estimate.
+ *
+ * @retval true if at least one sample is available, false otherwise.
+ */
+bool thciNcpClockGet(thci_ncp_clock_t *aClock);
+
+/**
+ * Convert an NCP time to host time.
+ *
+ * @param[in]  aNcpTime     The NCP time, in msec.
+ * @param[out] aHostTime    The corresponding host time, in msec.
+ * @param[out] aError       Error bound of aHostTime, in msec. May be NULL.
+ *
+ * @retval true if the conversion was done, false if no sample is available.
+ */
+bool thciNcpTimeToHost(uint32_t aNcpTime, uint32_t *aHostTime, uint32_t *aError);
+
+/**
+ * Convert a host time to NCP time.
+ *
+ * @param[in]  aHostTime    The host time, in msec.
+ * @param[out] aNcpTime     The corresponding NCP time, in msec.
+ * @param[out] aError       Error bound of aNcpTime, in msec. May be NULL.
+ *
+ * @retval true if the conversion was done, false if no sample is available.
+ */
+bool thciHostTimeToNcp(uint32_t aHostTime, uint32_t *aNcpTime, uint32_t *aError);
+
+/**
+ * Take one clock sample from the NCP (SPINEL_PROP_VENDOR_NEST_NCP_TIMESTAMP).
+ * Call from the THCI task.  THCI calls it every
+ * THCI_CONFIG_NCP_CLOCK_SYNC_INTERVAL; the window of
+ * THCI_CONFIG_NCP_CLOCK_SAMPLES samples should span a few minutes for the
+ * drift estimate to be useful.
+ *
+ * @retval  OT_ERROR_NONE           Successfully added a sample.
+ * @retval  OT_ERROR_INVALID_STATE  THCI is not initialized.
+ * @retval  OT_ERROR_NOT_CAPABLE    The NCP does not list
+ *                                  SPINEL_CAP_VENDOR_NEST_NCP_TIMESTAMP.
+ * @retval  OT_ERROR_FAILED         The NCP answered with a malformed time.
+ */
+otError thciSyncNcpClock(void);
+
+/**
+ * Post a clock sample to the THCI task if the last one is
+ * THCI_CONFIG_NCP_CLOCK_SYNC_INTERVAL old.  May be called from any task.
+ * THCI calls this on every frame from the NCP; an application that also
+ * calls it periodically keeps the clock of an idle NCP in sync.
+ */
+void thciNcpClockTick(void);
+
+/**
+ * Stamp a frame received from the NCP and tick the resync.  Called by the
+ * Spinel layer for every frame.
+ */
+void thciNcpClockFrameReceived(const uint8_t *aFrame, uint16_t aLength);
+
+/**
+ * Set the observer of the timestamps of received frames, NULL for none.
+ * The observer must tolerate being called with the context it replaced.
+ */
+void thciNcpSetFrameTimestampObserver(thciFrameTimestampObserver aObserver, void *aContext);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_CLOCK_SYNC
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_CLOCK_H_INCLUDED__ */
@@ -0,0 +1,636 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines C++20 coroutines over the non-blocking Spinel request path,
+ *      thci_async.h.
+ *
+ *      A thci::Task runs on the THCI task, where it is started by
+ *      thci::Spawn(), and awaits NCP requests without blocking the task:
+ *
+ *          thci::Task<> Report(void)
+ *          {
+ *              thci::Result<uint16_t> rloc16 = co_await thci::GetRloc16();
+ *
+ *              auto partitionId = thci::GetPartitionId();
+ *              auto role = thci::GetProperty<uint8_t>(SPINEL_PROP_NET_ROLE, SPINEL_DATATYPE_UINT8_S);
+ *
+ *              co_await thci::All(partitionId, role);
+ *              ...
+ *          }
+ *
+ *          thci::Spawn(Report());
+ *
+ *      All() sends its requests together.  Requests beyond
+ *      THCI_CONFIG_ASYNC_MAX_REQUESTS wait for a free slot, in order, so
+ *      any number of tasks may have requests outstanding.  A request is
+ *      registered by address: it cannot be copied or moved, and it must be
+ *      awaited until it completes.  The application calls thciAsyncTick()
+ *      periodically to expire unanswered requests.
+ *
+ *      Only available to C++20 code; THCI itself does not use it.
+ *
+ */
+
+#ifndef __THCI_COROUTINE_H_INCLUDED__
+#define __THCI_COROUTINE_H_INCLUDED__
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_ASYNC_REQUESTS && (__cplusplus >= 202002L)
+
+#include <coroutine>
+#include <exception>
+#include <stdint.h>
+#include <string.h>
+#include <tuple>
+#include <utility>
+
+#include <thci.h>
+#include <thci_async.h>
+
+namespace thci {
+
+/**
+ * The response to a request.
+ */
+struct Response
+{
+    otError             mError;
+    uint32_t            mCommand;
+    spinel_prop_key_t   mKey;
+    uint16_t            mLength;
+    uint8_t             mValue[THCI_CONFIG_ASYNC_VALUE_SIZE];
+};
+
+/**
+ * The outcome of a typed request.
+ */
+template <typename T>
+struct Result
+{
+    otError     mError;
+    T           mValue;
+};
+
+namespace detail {
+
+// The coroutine resumed once a number of requests complete.
+struct Waiter
+{
+    uint16_t                    mRemaining;
+    std::coroutine_handle<>     mHandle;
+
+    void Done(void)
+    {
+        if (--mRemaining == 0)
+        {
+            mHandle.resume();
+        }
+    }
+};
+
+inline uint8_t CurrentInstanceIndex(void)
+{
+    return thciGetInstanceIndex(thciGetCurrentInstance());
+}
+
+inline void Resume(void *aContext)
+{
+    std::coroutine_handle<>::from_address(aContext).resume();
+}
+
+} // namespace detail
+
+/**
+ * An NCP request awaited by a coroutine.  The value is copied; one longer
+ * than THCI_CONFIG_ASYNC_VALUE_SIZE bytes fails the request with
+ * OT_ERROR_NO_BUFS, without sending it.
+ */
+class Request
+{
+public:
+    Request(uint32_t aCommand, spinel_prop_key_t aKey, const uint8_t *aValue = nullptr, uint16_t aValueLength = 0)
+        : mValueError((aValueLength <= sizeof(mValue)) ? OT_ERROR_NONE : OT_ERROR_NO_BUFS)
+        , mCommand(aCommand)
+        , mKey(aKey)
+        , mValueLength((mValueError == OT_ERROR_NONE) ? aValueLength : 0)
+        , mStarted(false)
+        , mDone(false)
+        , mWaiter(nullptr)
+        , mNext(nullptr)
+    {
+        if (mValueLength > 0)
+        {
+            memcpy(mValue, aValue, mValueLength);
+        }
+
+        memset(&mResponse, 0, sizeof(mResponse));
+    }
+
+    Request(const Request &) = delete;
+    Request &operator=(const Request &) = delete;
+
+    bool await_ready(void) const noexcept { return mDone; }
+
+    bool await_suspend(std::coroutine_handle<> aHandle)
+    {
+        // Counts the caller, so that a request failing at once does not
+        // resume the coroutine before it is suspended.
+        mOwnWaiter.mRemaining = 2;
+        mOwnWaiter.mHandle = aHandle;
+
+        Start(&mOwnWaiter);
+
+        return (--mOwnWaiter.mRemaining != 0);
+    }
+
+    const Response &await_resume(void) const noexcept { return mResponse; }
+
+    bool IsDone(void) const { return mDone; }
+    const Response &GetResponse(void) const { return mResponse; }
+
+    /**
+     * Send the request, or queue it until a request slot is free.  aWaiter
+     * is told when it completes.  Call on the THCI task.
+     */
+    void Start(detail::Waiter *aWaiter)
+    {
+        mWaiter = aWaiter;
+
+        if (mStarted)
+        {
+            if (mDone)
+            {
+                Complete();
+            }
+        }
+        else if (mValueError != OT_ERROR_NONE)
+        {
+            mStarted = true;
+            Fail(mValueError);
+        }
+        else if (sWaiting[detail::CurrentInstanceIndex()].mHead != nullptr)
+        {
+            // Behind the requests already waiting for a slot.
+            Enqueue();
+        }
+        else
+        {
+            Send();
+        }
+    }
+
+protected:
+    Response mResponse;
+    otError  mValueError;       // the value cannot be sent; fails the request.
+
+private:
+    struct Queue
+    {
+        Request *mHead;
+        Request *mTail;
+    };
+
+    // Returns OT_ERROR_NO_BUFS, without sending, when no slot is free.
+    otError Transmit(void)
+    {
+        const otError error = thciAsyncRequest(mCommand, mKey, mValue, mValueLength, &Request::HandleResponse, this);
+
+        mStarted = (error != OT_ERROR_NO_BUFS);
+
+        return error;
+    }
+
+    void Send(void)
+    {
+        const otError error = Transmit();
+
+        if (error == OT_ERROR_NO_BUFS)
+        {
+            Enqueue();
+        }
+        else if (error != OT_ERROR_NONE)
+        {
+            Fail(error);
+        }
+    }
+
+    void Fail(otError aError)
+    {
+        mResponse.mError = aError;
+        mResponse.mKey = mKey;
+        mDone = true;
+
+        Complete();
+    }
+
+    void Enqueue(void)
+    {
+        Queue &queue = sWaiting[detail::CurrentInstanceIndex()];
+
+        mNext = nullptr;
+
+        if (queue.mTail != nullptr)
+        {
+            queue.mTail->mNext = this;
+        }
+        else
+        {
+            queue.mHead = this;
+        }
+
+        queue.mTail = this;
+    }
+
+    void Complete(void)
+    {
+        detail::Waiter *waiter = mWaiter;
+
+        mWaiter = nullptr;
+
+        if (waiter != nullptr)
+        {
+            waiter->Done();
+        }
+    }
+
+    // A slot was released: send the waiting requests while slots are free.
+    static void SendWaiting(void)
+    {
+        Queue &queue = sWaiting[detail::CurrentInstanceIndex()];
+
+        while (queue.mHead != nullptr)
+        {
+            Request *request = queue.mHead;
+            const otError error = request->Transmit();
+
+            if (error == OT_ERROR_NO_BUFS)
+            {
+                break;
+            }
+
+            queue.mHead = request->mNext;
+
+            if (queue.mHead == nullptr)
+            {
+                queue.mTail = nullptr;
+            }
+
+            if (error != OT_ERROR_NONE)
+            {
+                request->Fail(error);
+            }
+        }
+    }
+
+    static void HandleResponse(otError aError, uint32_t aCommand, spinel_prop_key_t aKey,
+                               const uint8_t *aValue, uint16_t aLength, void *aContext)
+    {
+        Request *request = static_cast<Request *>(aContext);
+
+        request->mResponse.mError = aError;
+        request->mResponse.mCommand = aCommand;
+        request->mResponse.mKey = aKey;
+        request->mResponse.mLength = aLength;
+        memcpy(request->mResponse.mValue, aValue, aLength);
+        request->mDone = true;
+
+        SendWaiting();
+
+        request->Complete();
+    }
+
+    uint32_t                mCommand;
+    spinel_prop_key_t       mKey;
+    uint8_t                 mValue[THCI_CONFIG_ASYNC_VALUE_SIZE];
+    uint16_t                mValueLength;
+    bool                    mStarted;
+    bool                    mDone;
+    detail::Waiter          *mWaiter;
+    detail::Waiter          mOwnWaiter;
+    Request                 *mNext;         // next request waiting for a slot.
+
+    static inline Queue     sWaiting[THCI_CONFIG_MAX_INSTANCES];
+};
+
+/**
+ * Get a property and unpack it with a Spinel format, e.g.
+ * SPINEL_DATATYPE_UINT16_S for a uint16_t.
+ */
+template <typename T>
+class GetProperty : public Request
+{
+public:
+    GetProperty(spinel_prop_key_t aKey, const char *aFormat)
+        : Request(SPINEL_CMD_PROP_VALUE_GET, aKey)
+        , mFormat(aFormat)
+    {
+    }
+
+    Result<T> await_resume(void) const { return GetResult(); }
+
+    Result<T> GetResult(void) const
+    {
+        Result<T> result = { mResponse.mError, T() };
+
+        if (result.mError == OT_ERROR_NONE &&
+            spinel_datatype_unpack(mResponse.mValue, mResponse.mLength, mFormat, &result.mValue) <= 0)
+        {
+            result.mError = OT_ERROR_PARSE;
+        }
+
+        return result;
+    }
+
+private:
+    const char *mFormat;
+};
+
+/**
+ * Set a property to a value packed with a Spinel format.  The request fails
+ * with OT_ERROR_INVALID_ARGS if the value cannot be packed, or
+ * OT_ERROR_NO_BUFS if it is longer than THCI_CONFIG_ASYNC_VALUE_SIZE bytes.
+ */
+class SetProperty : public Request
+{
+    struct Packed
+    {
+        uint8_t     mBuffer[THCI_CONFIG_ASYNC_VALUE_SIZE];
+        uint16_t    mLength;
+        otError     mError;
+    };
+
+public:
+    template <typename T>
+    SetProperty(spinel_prop_key_t aKey, const char *aFormat, T aValue)
+        : SetProperty(aKey, Pack(aFormat, aValue))
+    {
+    }
+
+    otError await_resume(void) const { return mResponse.mError; }
+
+private:
+    SetProperty(spinel_prop_key_t aKey, const Packed &aPacked)
+        : Request(SPINEL_CMD_PROP_VALUE_SET, aKey, aPacked.mBuffer, aPacked.mLength)
+    {
+        if (aPacked.mError != OT_ERROR_NONE)
+        {
+            mValueError = aPacked.mError;
+        }
+    }
+
+    template <typename T>
+    static Packed Pack(const char *aFormat, T aValue)
+    {
+        Packed packed;
+        const spinel_ssize_t length = spinel_datatype_pack(packed.mBuffer, sizeof(packed.mBuffer), aFormat, aValue);
+
+        packed.mLength = 0;
+        packed.mError = OT_ERROR_NONE;
+
+        if (length <= 0)
+        {
+            packed.mError = OT_ERROR_INVALID_ARGS;
+        }
+        else if ((size_t)length > sizeof(packed.mBuffer))
+        {
+            packed.mError = OT_ERROR_NO_BUFS;
+        }
+        else
+        {
+            packed.mLength = (uint16_t)length;
+        }
+
+        return packed;
+    }
+};
+
+inline GetProperty<uint16_t> GetRloc16(void)
+{
+    return GetProperty<uint16_t>(SPINEL_PROP_THREAD_RLOC16, SPINEL_DATATYPE_UINT16_S);
+}
+
+inline GetProperty<uint32_t> GetPartitionId(void)
+{
+    return GetProperty<uint32_t>(SPINEL_PROP_NET_PARTITION_ID, SPINEL_DATATYPE_UINT32_S);
+}
+
+inline GetProperty<uint8_t> GetLeaderWeight(void)
+{
+    return GetProperty<uint8_t>(SPINEL_PROP_THREAD_LEADER_WEIGHT, SPINEL_DATATYPE_UINT8_S);
+}
+
+/**
+ * Awaits several requests sent together.  Their outcomes are read from the
+ * requests afterwards, with GetResponse() or GetResult().
+ */
+template <typename... Requests>
+class AllRequests
+{
+public:
+    explicit AllRequests(Requests &... aRequests)
+        : mRequests(aRequests...)
+    {
+    }
+
+    bool await_ready(void) const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> aHandle)
+    {
+        // Counts the caller too; see Request::await_suspend().
+        mWaiter.mRemaining = sizeof...(Requests) + 1;
+        mWaiter.mHandle = aHandle;
+
+        std::apply([this](Requests &... aRequests) { (aRequests.Start(&mWaiter), ...); }, mRequests);
+
+        return (--mWaiter.mRemaining != 0);
+    }
+
+    void await_resume(void) const noexcept {}
+
+private:
+    std::tuple<Requests &...>   mRequests;
+    detail::Waiter              mWaiter;
+};
+
+template <typename... Requests>
+AllRequests<Requests...> All(Requests &... aRequests)
+{
+    return AllRequests<Requests...>(aRequests...);
+}
+
+/**
+ * A coroutine run on the THCI task.  It starts when awaited, or when
+ * passed to Spawn().
+ */
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct PromiseBase
+{
+    std::coroutine_handle<> mContinuation;
+
+    struct FinalAwaiter
+    {
+        bool await_ready(void) const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> aHandle) noexcept
+        {
+            std::coroutine_handle<> continuation = aHandle.promise().mContinuation;
+
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume(void) const noexcept {}
+    };
+
+    std::suspend_always initial_suspend(void) const noexcept { return {}; }
+    FinalAwaiter final_suspend(void) const noexcept { return {}; }
+
+    // THCI is built without exceptions.
+    void unhandled_exception(void) const noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase
+{
+    T mValue;
+
+    Task<T> get_return_object(void);
+    void return_value(T aValue) { mValue = std::move(aValue); }
+    T Take(void) { return std::move(mValue); }
+};
+
+template <>
+struct Promise<void> : PromiseBase
+{
+    Task<void> get_return_object(void);
+    void return_void(void) const noexcept {}
+    void Take(void) const noexcept {}
+};
+
+} // namespace detail
+
+template <typename T>
+class Task
+{
+public:
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> aHandle)
+        : mHandle(aHandle)
+    {
+    }
+
+    Task(Task &&aOther) noexcept
+        : mHandle(std::exchange(aOther.mHandle, nullptr))
+    {
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task(void)
+    {
+        if (mHandle)
+        {
+            mHandle.destroy();
+        }
+    }
+
+    bool await_ready(void) const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> aHandle) noexcept
+    {
+        mHandle.promise().mContinuation = aHandle;
+
+        return mHandle;
+    }
+
+    T await_resume(void) { return mHandle.promise().Take(); }
+
+private:
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object(void)
+{
+    return Task<T>(std::coroutine_handle<Promise<T> >::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object(void)
+{
+    return Task<void>(std::coroutine_handle<Promise<void> >::from_promise(*this));
+}
+
+// Owns a spawned task and frees itself when the task ends.
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object(void) { return Detached{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend(void) const noexcept { return {}; }
+        std::suspend_never final_suspend(void) const noexcept { return {}; }
+        void return_void(void) const noexcept {}
+        void unhandled_exception(void) const noexcept { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+inline Detached RunDetached(Task<void> aTask)
+{
+    co_await aTask;
+}
+
+} // namespace detail
+
+/**
+ * Run a task on the THCI task of the calling task's instance.  May be
+ * called from any task.
+ *
+ * @retval OT_ERROR_NONE            The task will run.
+ * @retval OT_ERROR_INVALID_STATE   THCI is not initialized.
+ * @retval OT_ERROR_NO_BUFS         THCI_CONFIG_ASYNC_MAX_CALLS calls are queued.
+ */
+inline otError Spawn(Task<void> aTask)
+{
+    const std::coroutine_handle<> handle = detail::RunDetached(std::move(aTask)).mHandle;
+    const otError error = thciAsyncPost(&detail::Resume, handle.address());
+
+    if (error != OT_ERROR_NONE)
+    {
+        handle.destroy();
+    }
+
+    return error;
+}
+
+} // namespace thci
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_ASYNC_REQUESTS && (__cplusplus >= 202002L)
+
+#endif /* __THCI_COROUTINE_H_INCLUDED__ */
@@ -0,0 +1,176 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the THCI daemon: a UNIX domain socket front end that shares
+ *      the NCP between several host processes.
+ *
+ *      Clients connect to a SOCK_SEQPACKET socket; every message is one
+ *      datagram made of a message type byte followed by its payload:
+ *
+ *        request       client -> daemon    a Spinel frame for the NCP
+ *        response      daemon -> client    the NCP's answer, with the TID of the request
+ *        notify        daemon -> client    an unsolicited NCP frame of a subscribed key
+ *        subscribe     client -> daemon    a packed Spinel property key
+ *        unsubscribe   client -> daemon    a packed Spinel property key
+ *
+ *      Requests use Spinel framing (header, command, key, value).  The
+ *      daemon forwards them with its own transaction ids, so clients pick
+ *      their TIDs independently, and answers every request, with a
+ *      LAST_STATUS when the NCP did not.  Only the property get, set,
+ *      insert and remove commands, plain or Nest vendor, are forwarded;
+ *      others are answered with SPINEL_STATUS_INVALID_COMMAND.  Subscribing
+ *      to SPINEL_PROP_STREAM_NET or SPINEL_PROP_STREAM_NET_INSECURE
+ *      delivers a copy of the received IPv6 datagrams, which still go to
+ *      LwIP.
+ *
+ *      Each client has a queue of THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH
+ *      requests; a client with a full queue is not read until it drains, so
+ *      it throttles itself.  The THCI task takes one request per client in
+ *      turn, and keeps up to THCI_CONFIG_DAEMON_PIPELINE_DEPTH requests in
+ *      flight to the NCP.  Responses and notifications are sent without
+ *      blocking; those the socket has no room for are queued, up to
+ *      THCI_CONFIG_DAEMON_CLIENT_OUTPUT_DEPTH per client, and sent by
+ *      thciDaemonPoll() once it has.  A client that lets its queue overflow
+ *      is disconnected, so that it never misses a response silently.
+ *
+ *      The socket side runs in thciDaemonPoll(), which the application
+ *      calls in a loop from its own task.  The daemon serves the THCI
+ *      instance bound to the task that starts it.  POSIX hosts only.
+ *
+ */
+
+#ifndef __THCI_DAEMON_H_INCLUDED__
+#define __THCI_DAEMON_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#include <openthread/types.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#include <openthread/spinel.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    kThciDaemonMsgRequest       = 1,
+    kThciDaemonMsgResponse      = 2,
+    kThciDaemonMsgNotify        = 3,
+    kThciDaemonMsgSubscribe     = 4,
+    kThciDaemonMsgUnsubscribe   = 5,
+} thci_daemon_msg_type_t;
+
+typedef struct
+{
+    uint32_t    mClients;           // clients connected.
+    uint32_t    mAccepted;          // connections accepted.
+    uint32_t    mRejected;          // connections refused, all client slots in use.
+    uint32_t    mRequests;          // requests forwarded to the NCP.
+    uint32_t    mInvalid;           // malformed or refused messages.
+    uint32_t    mNotifications;     // notifications sent.
+    uint32_t    mSendDeferred;      // responses and notifications queued for a socket without room.
+    uint32_t    mSendDrops;         // responses and notifications lost with a client disconnected for not taking them.
+} thci_daemon_stats_t;
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DAEMON
+
+/**
+ * A Spinel request passed through to the NCP by thciNcpRawTransact().
+ */
+typedef struct
+{
+    uint32_t            mCommand;
+    spinel_prop_key_t   mKey;
+    const uint8_t      *mValue;
+    uint16_t            mValueLength;
+
+    // Set by thciNcpRawTransact().
+    otError             mError;             // OT_ERROR_FAILED when the NCP answered with another key, e.g. LAST_STATUS;
+                                            // OT_ERROR_NO_BUFS when the response outgrew its pipelined response slot.
+    uint32_t            mResponseCommand;
+    spinel_prop_key_t   mResponseKey;
+    uint8_t            *mResponse;          // provided by the caller.
+    uint16_t            mResponseSize;      // size of mResponse.
+    uint16_t            mResponseLength;    // truncated to mResponseSize.
+} thci_raw_request_t;
+
+/**
+ * Called on the THCI task for every frame the NCP sends on its own,
+ * including received IPv6 datagrams.
+ */
+typedef void (*thciRawFrameObserver)(uint32_t aCommand, spinel_prop_key_t aKey, const uint8_t *aValue, uint16_t aLength, void *aContext);
+
+/**
+ * Start the daemon on the UNIX socket aPath, replacing any stale socket
+ * file.  Call once THCI is initialized, and not concurrently with
+ * thciDaemonPoll() or thciDaemonStop().
+ *
+ * @retval 0 on success, or a negative errno.
+ */
+int thciDaemonStart(const char *aPath);
+
+/**
+ * Stop the daemon, disconnect its clients and remove the socket file.
+ */
+void thciDaemonStop(void);
+
+/**
+ * Accept clients and read their messages.  Waits up to aTimeoutMsec, -1
+ * for ever, for socket activity.  Call in a loop from a task other than
+ * the THCI task.
+ *
+ * @retval 0 on success, -ENOTCONN if the daemon is not started or was
+ *         stopped during the wait, or a negative errno from poll().
+ */
+int thciDaemonPoll(int aTimeoutMsec);
+
+void thciDaemonGetStats(thci_daemon_stats_t *aStats);
+
+/**
+ * Send requests to the NCP, up to THCI_CONFIG_DAEMON_PIPELINE_DEPTH of
+ * them before the first response, and collect the responses in order.
+ * Call from the THCI task.  Provided by the NCP module.
+ *
+ * @retval OT_ERROR_NONE            All requests were sent; see mError.
+ * @retval OT_ERROR_INVALID_STATE   THCI is not initialized.
+ * @retval OT_ERROR_INVALID_ARGS    More requests than the pipeline depth.
+ */
+otError thciNcpRawTransact(thci_raw_request_t *aRequests, uint8_t aCount);
+
+/**
+ * Set the observer of the frames the NCP sends on its own, NULL for none.
+ * The observer must tolerate being called with the context it replaced.
+ * Provided by the NCP module.
+ */
+void thciNcpSetRawFrameObserver(thciRawFrameObserver aObserver, void *aContext);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DAEMON
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_DAEMON_H_INCLUDED__ */
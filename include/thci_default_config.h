@@ -42,11 +42,29 @@
 
 /**
  * Define this if you want to log NCP log messages on the host's logging feature.
+ * The NCP debug stream is captured into a ring buffer and written to the host
+ * log by thciNcpLogFlush(), from the task serving the mLogQueue init parameter.
  */
 #ifndef THCI_CONFIG_LOG_NCP_LOGS
 #define THCI_CONFIG_LOG_NCP_LOGS 1
 #endif /* THCI_CONFIG_LOG_NCP_LOGS */
 
+/**
+ * Size in bytes of the ring buffer that captures the NCP debug stream.
+ */
+#ifndef THCI_CONFIG_NCP_LOG_RING_SIZE
+#define THCI_CONFIG_NCP_LOG_RING_SIZE 2048
+#endif /* THCI_CONFIG_NCP_LOG_RING_SIZE */
+
+/**
+ * Maximum number of NCP debug stream bytes captured per second. Bytes beyond
+ * this budget, including the tail of a frame that exceeds it, are dropped and
+ * counted. Define to 0 to disable rate limiting.
+ */
+#ifndef THCI_CONFIG_NCP_LOG_RATE_LIMIT
+#define THCI_CONFIG_NCP_LOG_RATE_LIMIT 1024
+#endif /* THCI_CONFIG_NCP_LOG_RATE_LIMIT */
+
 /**
  * Define as 1 to enable OpenThread border router feature and its APIs.
  */
@@ -118,5 +136,610 @@
 #define THCI_CONFIG_INITIALIZE_WITHOUT_NCP_RESET 0
 #endif
 
+/**
+ * Define as 1 to record THCI's hot-path log sites (per-datagram TX/RX logs)
+ * as binary records in a ring buffer instead of formatting them in place.
+ * Records are rendered later by thciDeferredLogFlush() or exported raw.
+ */
+#ifndef THCI_CONFIG_DEFERRED_LOG
+#define THCI_CONFIG_DEFERRED_LOG 0
+#endif
+
+/**
+ * Size in bytes of the deferred log ring buffer.  An IP datagram record
+ * takes 48 bytes.
+ */
+#ifndef THCI_CONFIG_DEFERRED_LOG_RING_SIZE
+#define THCI_CONFIG_DEFERRED_LOG_RING_SIZE 1536
+#endif
+
+/**
+ * Define as 0 for the application to drain the deferred log ring: it calls
+ * thciDeferredLogFlush() or thciDeferredLogRead() from a low priority task,
+ * so that rendering never delays the THCI task.  Define as 1 for THCI to
+ * render the records itself, a batch per event on the sdk queue, at the
+ * cost of that formatting work on the THCI task.
+ */
+#ifndef THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH
+#define THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH 0
+#endif
+
+/**
+ * Define as 1 to keep per event type statistics for the events THCI posts:
+ * post and dedupe counts, queue depth and post-to-dispatch latency.
+ */
+#ifndef THCI_CONFIG_EVENT_STATS
+#define THCI_CONFIG_EVENT_STATS 0
+#endif
+
+/**
+ * Define as 1 to correlate the NCP clock with the host clock, using the
+ * SPINEL_PROP_VENDOR_NEST_NCP_TIMESTAMP vendor property.
+ */
+#ifndef THCI_CONFIG_NCP_CLOCK_SYNC
+#define THCI_CONFIG_NCP_CLOCK_SYNC 0
+#endif
+
+/**
+ * Number of clock samples kept for the NCP clock offset and drift estimate.
+ */
+#ifndef THCI_CONFIG_NCP_CLOCK_SAMPLES
+#define THCI_CONFIG_NCP_CLOCK_SAMPLES 8
+#endif
+
+/**
+ * Worst case rate difference, in ppm, between the host and NCP clocks.
+ * Used to bound the conversion error until drift has been measured.
+ */
+#ifndef THCI_CONFIG_NCP_CLOCK_MAX_DRIFT_PPM
+#define THCI_CONFIG_NCP_CLOCK_MAX_DRIFT_PPM 100
+#endif
+
+/**
+ * Period, in msec, at which THCI takes an NCP clock sample.  The resync is
+ * ticked by the frames received from the NCP and by thciNcpClockTick().
+ */
+#ifndef THCI_CONFIG_NCP_CLOCK_SYNC_INTERVAL
+#define THCI_CONFIG_NCP_CLOCK_SYNC_INTERVAL 60000
+#endif
+
+/**
+ * Define as 1 to record attach and role transition timing: time to attach,
+ * to the first routable address and to the first datagram after
+ * thciThreadStart, detach durations and role flaps.
+ */
+#ifndef THCI_CONFIG_ATTACH_STATS
+#define THCI_CONFIG_ATTACH_STATS 0
+#endif
+
+/**
+ * A role transition within this many msec of the previous one is counted
+ * as a flap.
+ */
+#ifndef THCI_CONFIG_ROLE_FLAP_WINDOW_MSEC
+#define THCI_CONFIG_ROLE_FLAP_WINDOW_MSEC 30000
+#endif
+
+/**
+ * Define as 1 to build the traffic generator (thciBenchRun) and the shell
+ * bench command.  Requires the LwIP netconn API; ICMPv6 echo also requires
+ * LWIP_RAW.
+ */
+#ifndef THCI_CONFIG_BENCH
+#define THCI_CONFIG_BENCH 0
+#endif
+
+/**
+ * Largest bench payload, in bytes.  The generator keeps one transmit and
+ * one receive buffer of about this size.
+ */
+#ifndef THCI_CONFIG_BENCH_MAX_SIZE
+#define THCI_CONFIG_BENCH_MAX_SIZE 1232
+#endif
+
+/**
+ * Largest number of packets of a bench run, i.e. mRate times mDuration.
+ * The generator keeps one bit per packet to tell duplicated replies.
+ */
+#ifndef THCI_CONFIG_BENCH_MAX_PACKETS
+#define THCI_CONFIG_BENCH_MAX_PACKETS 4096
+#endif
+
+/**
+ * Define as 1 to build the manufacturing diagnostics sequencer
+ * (thciDiagnosticsRunScript), which pipelines diag commands to the NCP.
+ */
+#ifndef THCI_CONFIG_DIAG_SEQUENCER
+#define THCI_CONFIG_DIAG_SEQUENCER 0
+#endif
+
+/**
+ * Maximum number of diag commands outstanding on the NCP.  Each one holds
+ * one of the THCI_CONFIG_PIPELINED_RESPONSES slots of the UART driver.
+ * Must be less than the number of Spinel transaction ids (13).
+ */
+#ifndef THCI_CONFIG_DIAG_PIPELINE_DEPTH
+#define THCI_CONFIG_DIAG_PIPELINE_DEPTH 4
+#endif
+
+/**
+ * Diag command output kept per step, in bytes.  Longer output is truncated.
+ */
+#ifndef THCI_CONFIG_DIAG_OUTPUT_SIZE
+#define THCI_CONFIG_DIAG_OUTPUT_SIZE 96
+#endif
+
+/**
+ * Define as 1 to build the RF packet error rate test API (thciRfTestStart),
+ * which requires SPINEL_PROP_VENDOR_NEST_RF_TEST support in the NCP.
+ */
+#ifndef THCI_CONFIG_RF_TEST
+#define THCI_CONFIG_RF_TEST 0
+#endif
+
+/**
+ * Maximum number of steps in one RF test sequence.
+ */
+#ifndef THCI_CONFIG_RF_TEST_MAX_STEPS
+#define THCI_CONFIG_RF_TEST_MAX_STEPS 32
+#endif
+
+/**
+ * Define as 1 to build the fault injection engine (thci_fault.h) and its
+ * hooks on the IP, Spinel frame and UART byte streams.  Required by, and
+ * enabled by default with, BUILD_FEATURE_THCI_CERT.
+ */
+#ifndef THCI_CONFIG_FAULT_INJECTION
+#ifdef BUILD_FEATURE_THCI_CERT
+#define THCI_CONFIG_FAULT_INJECTION 1
+#else
+#define THCI_CONFIG_FAULT_INJECTION 0
+#endif
+#endif
+
+/**
+ * Define as 1 to build the NCP health monitor (thci_health.h).
+ */
+#ifndef THCI_CONFIG_NCP_HEALTH
+#define THCI_CONFIG_NCP_HEALTH 0
+#endif
+
+/**
+ * Number of most recent probes over which the health SLOs are evaluated.
+ */
+#ifndef THCI_CONFIG_NCP_HEALTH_WINDOW
+#define THCI_CONFIG_NCP_HEALTH_WINDOW 32
+#endif
+
+/**
+ * Number of THCI instances, one per NCP.  With more than one, each task
+ * binds to an instance with thciSetCurrentInstance() and the THCI API acts
+ * on the instance bound to the calling task, or on instance 0 when the
+ * task is unbound.  NCP only.
+ */
+#ifndef THCI_CONFIG_MAX_INSTANCES
+#define THCI_CONFIG_MAX_INSTANCES 1
+#endif
+
+/**
+ * Number of tasks that may be bound to a THCI instance at the same time,
+ * counting the THCI task of every instance.
+ */
+#ifndef THCI_CONFIG_MAX_INSTANCE_TASKS
+#define THCI_CONFIG_MAX_INSTANCE_TASKS 8
+#endif
+
+#if (THCI_CONFIG_MAX_INSTANCES < 1) || (THCI_CONFIG_MAX_INSTANCES > 4)
+#error THCI_CONFIG_MAX_INSTANCES must be between 1 and 4.
+#endif
+
+#if (THCI_CONFIG_MAX_INSTANCES > 1) && !THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#error THCI_CONFIG_MAX_INSTANCES > 1 requires THCI_CONFIG_USE_OPENTHREAD_ON_NCP.
+#endif
+
+/**
+ * Define as 1 to carry each THCI netif on its own Spinel interface id
+ * (IID), instead of telling the legacy netif apart with vendor commands.
+ * Each netif then has its own outgoing queue, served round robin, and can
+ * be stalled on its own.  The NCP must use the same IIDs, and list
+ * SPINEL_CAP_VENDOR_NEST_IID_MUX; legacy packets are rejected otherwise.
+ * NCP only.
+ */
+#ifndef THCI_CONFIG_SPINEL_IID_MUX
+#define THCI_CONFIG_SPINEL_IID_MUX 0
+#endif
+
+/**
+ * Spinel IID of the legacy netif when THCI_CONFIG_SPINEL_IID_MUX is set.
+ * The Thread netif is always IID 0.
+ */
+#ifndef THCI_CONFIG_SPINEL_IID_LEGACY
+#define THCI_CONFIG_SPINEL_IID_LEGACY 1
+#endif
+
+#if THCI_CONFIG_SPINEL_IID_MUX && ((THCI_CONFIG_SPINEL_IID_LEGACY < 1) || (THCI_CONFIG_SPINEL_IID_LEGACY > 3))
+#error THCI_CONFIG_SPINEL_IID_LEGACY must be between 1 and 3.
+#endif
+
+/**
+ * Define as 1 to build the THCI daemon, which shares the NCP with other
+ * host processes over a UNIX domain socket.  POSIX hosts with an NCP only.
+ */
+#ifndef THCI_CONFIG_DAEMON
+#define THCI_CONFIG_DAEMON 0
+#endif
+
+/**
+ * Number of daemon clients connected at the same time.
+ */
+#ifndef THCI_CONFIG_DAEMON_MAX_CLIENTS
+#define THCI_CONFIG_DAEMON_MAX_CLIENTS 4
+#endif
+
+/**
+ * Number of requests queued per daemon client.  A client with a full queue
+ * is not read until the NCP has answered its oldest request.
+ */
+#ifndef THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH
+#define THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH 4
+#endif
+
+/**
+ * Number of responses and notifications queued per daemon client while its
+ * socket has no room.  A client that lets the queue overflow is closed.
+ */
+#ifndef THCI_CONFIG_DAEMON_CLIENT_OUTPUT_DEPTH
+#define THCI_CONFIG_DAEMON_CLIENT_OUTPUT_DEPTH 4
+#endif
+
+/**
+ * Number of property subscriptions per daemon client.
+ */
+#ifndef THCI_CONFIG_DAEMON_MAX_SUBSCRIPTIONS
+#define THCI_CONFIG_DAEMON_MAX_SUBSCRIPTIONS 8
+#endif
+
+/**
+ * Size of the largest daemon message, which must hold an IPv6 datagram of
+ * NL_THCI_PAYLOAD_MTU bytes with its Spinel framing.
+ */
+#ifndef THCI_CONFIG_DAEMON_MAX_MESSAGE
+#define THCI_CONFIG_DAEMON_MAX_MESSAGE 1300
+#endif
+
+/**
+ * Number of daemon requests outstanding on the NCP at the same time.  When
+ * more than one, each holds one of the THCI_CONFIG_PIPELINED_RESPONSES
+ * slots of the UART driver.
+ */
+#ifndef THCI_CONFIG_DAEMON_PIPELINE_DEPTH
+#if THCI_CONFIG_DIAG_SEQUENCER
+#define THCI_CONFIG_DAEMON_PIPELINE_DEPTH THCI_CONFIG_DIAG_PIPELINE_DEPTH
+#else
+#define THCI_CONFIG_DAEMON_PIPELINE_DEPTH 1
+#endif
+#endif
+
+#if THCI_CONFIG_DAEMON && !THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#error THCI_CONFIG_DAEMON requires THCI_CONFIG_USE_OPENTHREAD_ON_NCP.
+#endif
+
+/**
+ * Number of UART driver slots that hold the response to a pipelined request
+ * when it arrives before a task waits for it (thciUartExpectResponse).  The
+ * diag sequencer and the daemon need one per request they keep outstanding;
+ * 0 leaves the slots out.
+ */
+#ifndef THCI_CONFIG_PIPELINED_RESPONSES
+#if THCI_CONFIG_DAEMON && (THCI_CONFIG_DAEMON_PIPELINE_DEPTH > 1) && \
+    (!THCI_CONFIG_DIAG_SEQUENCER || (THCI_CONFIG_DAEMON_PIPELINE_DEPTH > THCI_CONFIG_DIAG_PIPELINE_DEPTH))
+#define THCI_CONFIG_PIPELINED_RESPONSES THCI_CONFIG_DAEMON_PIPELINE_DEPTH
+#elif THCI_CONFIG_DIAG_SEQUENCER
+#define THCI_CONFIG_PIPELINED_RESPONSES THCI_CONFIG_DIAG_PIPELINE_DEPTH
+#else
+#define THCI_CONFIG_PIPELINED_RESPONSES 0
+#endif
+#endif
+
+/**
+ * Largest response payload a pipelined response slot holds, in bytes.  The
+ * wait for a longer response fails with OT_ERROR_NO_BUFS.
+ */
+#ifndef THCI_CONFIG_PIPELINED_RESPONSE_SIZE
+#define THCI_CONFIG_PIPELINED_RESPONSE_SIZE 128
+#endif
+
+#if THCI_CONFIG_DIAG_SEQUENCER && (THCI_CONFIG_PIPELINED_RESPONSES < THCI_CONFIG_DIAG_PIPELINE_DEPTH)
+#error THCI_CONFIG_DIAG_SEQUENCER requires THCI_CONFIG_PIPELINED_RESPONSES of at least THCI_CONFIG_DIAG_PIPELINE_DEPTH.
+#endif
+
+#if THCI_CONFIG_DAEMON && (THCI_CONFIG_DAEMON_PIPELINE_DEPTH > 1) && \
+    (THCI_CONFIG_PIPELINED_RESPONSES < THCI_CONFIG_DAEMON_PIPELINE_DEPTH)
+#error THCI_CONFIG_DAEMON_PIPELINE_DEPTH > 1 requires THCI_CONFIG_PIPELINED_RESPONSES of at least as many.
+#endif
+
+/**
+ * Define as 1 to build the non-blocking Spinel request path, thci_async.h,
+ * and the C++20 coroutine API built on it, thci_coroutine.h.  NCP only.
+ */
+#ifndef THCI_CONFIG_ASYNC_REQUESTS
+#define THCI_CONFIG_ASYNC_REQUESTS 0
+#endif
+
+/**
+ * Number of non-blocking requests outstanding on the NCP at the same time.
+ * Each holds a Spinel transaction id, of which there are 14.
+ */
+#ifndef THCI_CONFIG_ASYNC_MAX_REQUESTS
+#define THCI_CONFIG_ASYNC_MAX_REQUESTS 8
+#endif
+
+/**
+ * Number of functions queued by thciAsyncPost() at the same time.
+ */
+#ifndef THCI_CONFIG_ASYNC_MAX_CALLS
+#define THCI_CONFIG_ASYNC_MAX_CALLS 8
+#endif
+
+/**
+ * Size of the value of a non-blocking request, and of the response value
+ * kept for it.  Longer requests are rejected; longer responses are
+ * truncated.
+ */
+#ifndef THCI_CONFIG_ASYNC_VALUE_SIZE
+#define THCI_CONFIG_ASYNC_VALUE_SIZE 64
+#endif
+
+/**
+ * Time after which a non-blocking request that was not answered expires.
+ */
+#ifndef THCI_CONFIG_ASYNC_TIMEOUT_MSEC
+#define THCI_CONFIG_ASYNC_TIMEOUT_MSEC 3000
+#endif
+
+#if THCI_CONFIG_ASYNC_REQUESTS && !THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#error THCI_CONFIG_ASYNC_REQUESTS requires THCI_CONFIG_USE_OPENTHREAD_ON_NCP.
+#endif
+
+// Leaves transaction ids for the blocking and pipelined requests.
+#if THCI_CONFIG_ASYNC_REQUESTS && ((THCI_CONFIG_ASYNC_MAX_REQUESTS < 1) || (THCI_CONFIG_ASYNC_MAX_REQUESTS > 8))
+#error THCI_CONFIG_ASYNC_MAX_REQUESTS must be between 1 and 8.
+#endif
+
+/**
+ * Define as 1 to run the NCP UART on a POSIX tty, e.g. a USB serial
+ * adapter or one end of a socat pty pair, instead of the product UART.
+ * A thread per instance reads the tty in place of the RX ISR.  Linux
+ * hosts only.
+ */
+#ifndef THCI_CONFIG_POSIX_TTY
+#define THCI_CONFIG_POSIX_TTY 0
+#endif
+
+/**
+ * The tty of the NCP.  Hosts with more than one NCP define
+ * THCI_INSTANCE_TTY_PATH(aIndex) instead.
+ */
+#ifndef THCI_CONFIG_POSIX_TTY_PATH
+#define THCI_CONFIG_POSIX_TTY_PATH "/dev/ttyACM0"
+#endif
+
+/**
+ * Define as 1 to use RTS/CTS flow control on the tty.  Ptys ignore it.
+ */
+#ifndef THCI_CONFIG_POSIX_TTY_FLOW_CONTROL
+#define THCI_CONFIG_POSIX_TTY_FLOW_CONTROL 1
+#endif
+
+#if THCI_CONFIG_POSIX_TTY && !THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#error THCI_CONFIG_POSIX_TTY requires THCI_CONFIG_USE_OPENTHREAD_ON_NCP.
+#endif
+
+/**
+ * Define as 1 to reach the NCP over Spinel SPI instead of the HDLC-lite
+ * UART.  The platform provides the SPI bus and the NCP's interrupt line,
+ * see thci_spi.h.
+ */
+#ifndef THCI_CONFIG_NCP_SPI
+#define THCI_CONFIG_NCP_SPI 0
+#endif
+
+/**
+ * Size of the largest Spinel frame carried over SPI.
+ */
+#ifndef THCI_CONFIG_SPI_FRAME_SIZE
+#define THCI_CONFIG_SPI_FRAME_SIZE 1500
+#endif
+
+/**
+ * Number of payload bytes clocked when the length of the NCP's next frame
+ * is not known.  A longer frame takes a second transfer.
+ */
+#ifndef THCI_CONFIG_SPI_SMALL_PACKET_SIZE
+#define THCI_CONFIG_SPI_SMALL_PACKET_SIZE 32
+#endif
+
+/**
+ * Number of frames received over SPI and held until the THCI task
+ * processes them.  The NCP keeps its frames while none is free.
+ */
+#ifndef THCI_CONFIG_SPI_RX_FRAMES
+#define THCI_CONFIG_SPI_RX_FRAMES 4
+#endif
+
+/**
+ * Number of SPI transfers made back to back while the NCP has frames to
+ * send, before the THCI task handles other events.
+ */
+#ifndef THCI_CONFIG_SPI_BURST
+#define THCI_CONFIG_SPI_BURST 8
+#endif
+
+/**
+ * Define as 1 to build a simulated SPI NCP that provides the SPI platform
+ * functions, for testing without hardware.  It answers property requests
+ * by echoing them, see thci_spi.h.
+ */
+#ifndef THCI_CONFIG_SPI_SIMULATED_PEER
+#define THCI_CONFIG_SPI_SIMULATED_PEER 0
+#endif
+
+#if THCI_CONFIG_NCP_SPI && !THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#error THCI_CONFIG_NCP_SPI requires THCI_CONFIG_USE_OPENTHREAD_ON_NCP.
+#endif
+
+#if THCI_CONFIG_NCP_SPI && THCI_CONFIG_POSIX_TTY
+#error THCI_CONFIG_NCP_SPI and THCI_CONFIG_POSIX_TTY are exclusive.
+#endif
+
+// One frame is held for the Spinel layer while the others are received.
+#if THCI_CONFIG_NCP_SPI && (THCI_CONFIG_SPI_RX_FRAMES < 2)
+#error THCI_CONFIG_SPI_RX_FRAMES must be at least 2.
+#endif
+
+#if THCI_CONFIG_SPI_SIMULATED_PEER && !THCI_CONFIG_NCP_SPI
+#error THCI_CONFIG_SPI_SIMULATED_PEER requires THCI_CONFIG_NCP_SPI.
+#endif
+
+/**
+ * Define as 1 to reach an NCP on another core of the same SoC through
+ * shared memory instead of the HDLC-lite UART.  Spinel frames are passed
+ * in descriptor rings, without HDLC escaping or FCS; see thci_shm.h.
+ */
+#ifndef THCI_CONFIG_NCP_SHM
+#define THCI_CONFIG_NCP_SHM 0
+#endif
+
+/**
+ * Size of the buffer of each descriptor of the shared memory rings, the
+ * largest Spinel frame they carry.  A multiple of the cache line size.
+ */
+#ifndef THCI_CONFIG_SHM_FRAME_SIZE
+#define THCI_CONFIG_SHM_FRAME_SIZE 1536
+#endif
+
+/**
+ * Number of descriptors of each shared memory ring, a power of 2 of at
+ * least 8, so that the descriptors fill whole cache lines.
+ */
+#ifndef THCI_CONFIG_SHM_RING_SIZE
+#define THCI_CONFIG_SHM_RING_SIZE 8
+#endif
+
+/**
+ * Define as 1 to build the Linux platform of the shared memory transport,
+ * which maps a POSIX shared memory object and rings doorbells with
+ * futexes, so that the NCP can run in another thread or process.
+ */
+#ifndef THCI_CONFIG_SHM_POSIX
+#define THCI_CONFIG_SHM_POSIX 0
+#endif
+
+/**
+ * Name of the POSIX shared memory object of the first THCI instance;
+ * later instances append their index.
+ */
+#ifndef THCI_CONFIG_SHM_POSIX_NAME
+#define THCI_CONFIG_SHM_POSIX_NAME "/thci-shm"
+#endif
+
+#if THCI_CONFIG_NCP_SHM && !THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#error THCI_CONFIG_NCP_SHM requires THCI_CONFIG_USE_OPENTHREAD_ON_NCP.
+#endif
+
+#if THCI_CONFIG_NCP_SHM && (THCI_CONFIG_NCP_SPI || THCI_CONFIG_POSIX_TTY)
+#error THCI_CONFIG_NCP_SHM, THCI_CONFIG_NCP_SPI and THCI_CONFIG_POSIX_TTY are exclusive.
+#endif
+
+#if THCI_CONFIG_NCP_SHM && ((THCI_CONFIG_SHM_RING_SIZE & (THCI_CONFIG_SHM_RING_SIZE - 1)) || (THCI_CONFIG_SHM_RING_SIZE < 8))
+#error THCI_CONFIG_SHM_RING_SIZE must be a power of 2, at least 8.
+#endif
+
+#if THCI_CONFIG_NCP_SHM && ((THCI_CONFIG_SHM_FRAME_SIZE % 64) != 0)
+#error THCI_CONFIG_SHM_FRAME_SIZE must be a multiple of the 64 byte cache line.
+#endif
+
+#if THCI_CONFIG_SHM_POSIX && !THCI_CONFIG_NCP_SHM
+#error THCI_CONFIG_SHM_POSIX requires THCI_CONFIG_NCP_SHM.
+#endif
+
+/**
+ * Time in milliseconds without a byte from the tty after which the bytes
+ * of a frame that did not end are passed to the THCI task anyway.
+ * Otherwise the task is woken only at the end of a frame, or once the RX
+ * fifo is half full.
+ */
+#ifndef THCI_CONFIG_POSIX_TTY_RX_IDLE_MSEC
+#define THCI_CONFIG_POSIX_TTY_RX_IDLE_MSEC 5
+#endif
+
+/**
+ * Number of HDLC encoded frames queued for the tty, with
+ * THCI_CONFIG_POSIX_TTY.  A frame is sent while the THCI task packs and
+ * encodes the next one.  Each takes a buffer of twice the largest Spinel
+ * frame, as every byte may be escaped: about 3 KB.
+ */
+#ifndef THCI_CONFIG_UART_TX_FRAMES
+#define THCI_CONFIG_UART_TX_FRAMES 2
+#endif
+
+#if (THCI_CONFIG_UART_TX_FRAMES < 1) || (THCI_CONFIG_UART_TX_FRAMES > 16) || (THCI_CONFIG_UART_TX_FRAMES & (THCI_CONFIG_UART_TX_FRAMES - 1))
+#error THCI_CONFIG_UART_TX_FRAMES must be a power of 2, from 1 to 16.
+#endif
+
+/**
+ * Bytes of the HDLC encoded TX fifo of the UART, without
+ * THCI_CONFIG_POSIX_TTY.  The THCI task encodes frames into it in chunks
+ * and refills the UART driver from it, so that the end of a frame is sent
+ * while the next one is packed.
+ */
+#ifndef THCI_CONFIG_UART_TX_FIFO_SIZE
+#define THCI_CONFIG_UART_TX_FIFO_SIZE 256
+#endif
+
+#if (THCI_CONFIG_UART_TX_FIFO_SIZE < 64) || (THCI_CONFIG_UART_TX_FIFO_SIZE > 32768) || (THCI_CONFIG_UART_TX_FIFO_SIZE & (THCI_CONFIG_UART_TX_FIFO_SIZE - 1))
+#error THCI_CONFIG_UART_TX_FIFO_SIZE must be a power of 2, from 64 to 32768.
+#endif
+
+/**
+ * Size in bytes of the buffer each UART instance decodes a received frame
+ * into, which bounds the longest Spinel frame THCI receives over the
+ * UART.  Tables that do not fit in a frame are read a page at a time from
+ * an NCP that supports SPINEL_PROP_VENDOR_NEST_TABLE_PAGE, so a smaller
+ * buffer saves RAM at the cost of more requests.
+ */
+#ifndef THCI_CONFIG_UART_RX_BUFFER_SIZE
+#define THCI_CONFIG_UART_RX_BUFFER_SIZE 1500
+#endif
+
+#if THCI_CONFIG_UART_RX_BUFFER_SIZE < 256
+#error THCI_CONFIG_UART_RX_BUFFER_SIZE must be at least 256.
+#endif
+
+/**
+ * Define as 1 for the largest buffers of each instance to be carved from
+ * a region passed to thciSDKInitWithArena(), and sized by the profile
+ * passed with it, rather than sized at build time: the NCP TX message
+ * ring, the outgoing message queues, the Spinel TX frame and, with the
+ * UART, its encoded TX frames, RX frame and RX fifo.  See thci_arena.h.
+ */
+#ifndef THCI_CONFIG_ARENA
+#define THCI_CONFIG_ARENA 0
+#endif
+
+/**
+ * With THCI_CONFIG_ARENA, define as 1 for thciSDKInit() to carve the
+ * default profile of each instance from a static region.  Define as 0 to
+ * save that RAM when only thciSDKInitWithArena() is used: thciSDKInit()
+ * is then not built.
+ */
+#ifndef THCI_CONFIG_ARENA_DEFAULT_REGION
+#define THCI_CONFIG_ARENA_DEFAULT_REGION 1
+#endif
+
+#if THCI_CONFIG_ARENA && !THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#error THCI_CONFIG_ARENA requires THCI_CONFIG_USE_OPENTHREAD_ON_NCP.
+#endif
+
 #endif /* __THCI_CONFIG_H_INCLUDED__ */
 
@@ -0,0 +1,165 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the deferred, binary encoded logging used by THCI's own
+ *      hot-path log sites.
+ *
+ *      A log site records a format identifier plus its raw arguments into
+ *      a ring buffer.  No string formatting or address conversion is done
+ *      at the log site; records are rendered later by thciDeferredLogFlush(),
+ *      from a low priority task of the application, or from an event of the
+ *      THCI task with THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH, or exported raw
+ *      with thciDeferredLogRead() and rendered off-device using the format
+ *      identifiers below.
+ *
+ *      Each THCI instance has its own ring; the functions below act on the
+ *      instance bound to the calling task.
+ *
+ */
+
+#ifndef __THCI_DEFERRED_LOG_H_INCLUDED__
+#define __THCI_DEFERRED_LOG_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum number of 32-bit arguments carried by a single record.
+ */
+#define THCI_DEFERRED_LOG_MAX_ARGS  11
+
+/**
+ * Deferred log format identifiers.
+ *
+ * The identifiers are part of the export format and must not be renumbered.
+ * New identifiers are added at the end.
+ */
+typedef enum
+{
+    kThciLogIdNone          = 0,
+    kThciLogIdIpTx          = 1, // flags/len, cksum, src[4], dst[4]
+    kThciLogIdIpRx          = 2, // flags/len, cksum, src[4], dst[4]
+    kThciLogIdOpenPort      = 3, // port
+    kThciLogIdCount
+} thci_log_id_t;
+
+/**
+ * Flags packed into the upper half of the first argument of the IP records.
+ */
+#define THCI_DEFERRED_LOG_IP_FLAG_SECURE    0x00010000
+
+/**
+ * A decoded deferred log record.
+ */
+typedef struct
+{
+    uint32_t    mTimestamp;                             // Host time, in milliseconds, at the log site.
+    uint16_t    mId;                                    // One of thci_log_id_t.
+    uint8_t     mArgCount;                              // Number of valid entries in mArgs.
+    uint32_t    mArgs[THCI_DEFERRED_LOG_MAX_ARGS];      // Raw arguments.
+} thci_log_record_t;
+
+/**
+ * Deferred log ring buffer counters.
+ */
+typedef struct
+{
+    uint32_t    mRecorded;      // Records written to the ring.
+    uint32_t    mDropped;       // Records dropped because the ring was full.
+    uint32_t    mHighWater;     // Highest number of bytes in use in the ring.
+} thci_log_stats_t;
+
+#if THCI_CONFIG_DEFERRED_LOG
+
+struct ip6_hdr;
+
+/**
+ * Initialize the deferred log ring.  Called from thciSDKInit().
+ *
+ * @retval 0 on success, a negative errno otherwise.
+ */
+int thciDeferredLogInit(void);
+
+/**
+ * Append a record to the deferred log ring.  The record is dropped and
+ * counted if the ring does not have room for it.
+ *
+ * @param[in]  aId        The format identifier.
+ * @param[in]  aArgs      The raw arguments.
+ * @param[in]  aArgCount  The number of arguments, at most THCI_DEFERRED_LOG_MAX_ARGS.
+ */
+void thciDeferredLog(thci_log_id_t aId, const uint32_t *aArgs, uint8_t aArgCount);
+
+/**
+ * Append an IPv6 datagram record (kThciLogIdIpTx or kThciLogIdIpRx).
+ *
+ * @param[in]  aId        kThciLogIdIpTx or kThciLogIdIpRx.
+ * @param[in]  aHeader    The IPv6 header of the datagram.
+ * @param[in]  aLength    The datagram length.
+ * @param[in]  aSecure    Whether the datagram is sent/received with link security.
+ * @param[in]  aChecksum  The datagram checksum as reported by thciGetChecksum().
+ */
+void thciDeferredLogIp6(thci_log_id_t aId, const struct ip6_hdr *aHeader, uint16_t aLength, bool aSecure, uint16_t aChecksum);
+
+/**
+ * Remove the oldest record from the ring.
+ *
+ * @param[out] aRecord    The record.
+ *
+ * @retval true if a record was returned, false if the ring is empty.
+ */
+bool thciDeferredLogRead(thci_log_record_t *aRecord);
+
+/**
+ * Render up to aMaxRecords records from the ring to the log.
+ * This is intended to be called from a low priority task.  Without
+ * THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH, nothing else renders the records:
+ * the application must call this or thciDeferredLogRead(), e.g. every few
+ * hundred milliseconds from its idle task, before the ring fills and
+ * records are dropped.  With several THCI instances, the task binds to each
+ * instance with thciSetCurrentInstance() in turn to drain its ring.
+ *
+ * @param[in]  aMaxRecords  The maximum number of records to render, 0 for all.
+ *
+ * @return The number of records rendered.
+ */
+size_t thciDeferredLogFlush(size_t aMaxRecords);
+
+/**
+ * Retrieve the deferred log counters.
+ *
+ * @param[out] aStats     The counters.
+ */
+void thciDeferredLogGetStats(thci_log_stats_t *aStats);
+
+#endif // THCI_CONFIG_DEFERRED_LOG
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_DEFERRED_LOG_H_INCLUDED__ */
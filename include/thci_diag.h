@@ -0,0 +1,107 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the manufacturing diagnostics sequencer.
+ *
+ *      A diag script is a list of OpenThread diag commands separated by
+ *      new lines or ';', e.g.
+ *
+ *          start; channel 11; power 8; gpio set 3 1; gpio get 4 = 1
+ *
+ *      The "diag" prefix is optional.  A step may end with "= <value>", in
+ *      which case the step only passes if the numeric output of the command
+ *      equals <value>.  Empty steps and steps starting with '#' are ignored.
+ *
+ *      Up to THCI_CONFIG_DIAG_PIPELINE_DEPTH steps are outstanding on the
+ *      NCP at any time, so a script costs about one NCP round trip plus the
+ *      NCP processing time of each step rather than one round trip per
+ *      step.
+ *
+ */
+
+#ifndef __THCI_DIAG_H_INCLUDED__
+#define __THCI_DIAG_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#include <openthread/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Stop issuing steps after the first failed step.  Steps already sent to
+ * the NCP still complete and are reported.
+ */
+#define THCI_DIAG_FLAG_ABORT_ON_FAILURE     0x01
+
+typedef enum
+{
+    kThciDiagResultNotRun = 0,      // not run because the script was aborted.
+    kThciDiagResultPass,
+    kThciDiagResultFail,            // the command failed or the output did not match the expected value.
+    kThciDiagResultError,           // the NCP did not respond, or its response could not be held.
+} thci_diag_result_t;
+
+typedef struct
+{
+    uint16_t            mStep;          // script step, from 1; blank and comment lines are not steps.
+    thci_diag_result_t  mResult;
+    otError             mError;         // result of the Spinel exchange.
+    uint8_t             mStatus;        // "status 0x.." reported by the command, 0 if none.
+    bool                mHasValue;      // the output contains a line that is a plain number.
+    int32_t             mValue;         // that number, e.g. a gpio level.
+    bool                mHasExpected;
+    int32_t             mExpected;      // the expected mValue.
+    uint32_t            mLatency;       // from send to response, in msec.
+    char                mOutput[THCI_CONFIG_DIAG_OUTPUT_SIZE + 1];
+} thci_diag_record_t;
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+
+/**
+ * Run a diag script on the NCP.
+ *
+ * @param[in]  aScript      The script.
+ * @param[in]  aFlags       THCI_DIAG_FLAG_* flags.
+ * @param[out] aRecords     One record per step, in script order.
+ * @param[in]  aMaxRecords  Size of aRecords.  Steps beyond it are not run.
+ * @param[out] aNumRecords  Number of records written.
+ *
+ * @retval  OT_ERROR_NONE           All steps passed.
+ * @retval  OT_ERROR_FAILED         At least one step did not pass.
+ * @retval  OT_ERROR_NO_BUFS        The script has more than aMaxRecords steps.
+ * @retval  OT_ERROR_INVALID_ARGS   The script could not be parsed.
+ * @retval  OT_ERROR_INVALID_STATE  THCI is not initialized.
+ */
+otError thciDiagnosticsRunScript(const char *aScript, uint8_t aFlags, thci_diag_record_t *aRecords,
+                                 uint16_t aMaxRecords, uint16_t *aNumRecords);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_DIAG_H_INCLUDED__ */
@@ -0,0 +1,216 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the THCI fault injection engine.
+ *
+ *      Faults are injected on streams: IPv6 packets between LwIP and THCI,
+ *      decoded Spinel frames and raw UART bytes (NCP only), each in the tx
+ *      and rx directions.  Every stream has its own probabilities and its
+ *      own xorshift generator derived from a common seed, so a given seed
+ *      reproduces the same faults on a stream for the same traffic,
+ *      whatever happens on the other streams.
+ *
+ *      Actions supported per stream:
+ *
+ *        ip_tx, ip_rx          drop, duplicate, delay, reorder, truncate, bitflip
+ *        frame_tx, frame_rx    drop, duplicate, delay, truncate, bitflip
+ *        byte_tx, byte_rx      drop, duplicate, bitflip
+ *
+ *      IP delay and reorder hold one packet per stream.  A delayed packet
+ *      is released by the first packet of its stream that passes after the
+ *      delay expired, so under light traffic the delay is a lower bound.  A
+ *      reordered packet is released right after the next packet.  Frame
+ *      delays block the THCI task, like a stalled link would.
+ *
+ *      When THCI_CONFIG_FAULT_INJECTION is 0 the hooks compile out; when it
+ *      is 1 and no stream is enabled each hook costs one load and test.
+ *      Frame and byte streams are not locked: reconfiguring one while
+ *      traffic flows may apply a mix of the old and new settings to the
+ *      frame or byte in flight.
+ *
+ */
+
+#ifndef __THCI_FAULT_H_INCLUDED__
+#define __THCI_FAULT_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#include <lwip/err.h>
+#include <lwip/init.h>
+#include <lwip/ip6_addr.h>
+#include <lwip/netif.h>
+#include <lwip/pbuf.h>
+#include <lwip/tcpip.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    kThciFaultStreamIpTx = 0,
+    kThciFaultStreamIpRx,
+    kThciFaultStreamFrameTx,
+    kThciFaultStreamFrameRx,
+    kThciFaultStreamByteTx,
+    kThciFaultStreamByteRx,
+    kThciFaultStreamCount
+} thci_fault_stream_t;
+
+typedef enum
+{
+    kThciFaultActionDrop = 0,
+    kThciFaultActionDuplicate,
+    kThciFaultActionDelay,
+    kThciFaultActionReorder,
+    kThciFaultActionTruncate,
+    kThciFaultActionBitFlip,
+    kThciFaultActionCount
+} thci_fault_action_t;
+
+/**
+ * Verdicts returned by the frame and byte hooks.  Truncation and bit flips
+ * are applied in place and are not reported.
+ */
+#define THCI_FAULT_VERDICT_PASS         0x00
+#define THCI_FAULT_VERDICT_DROP         0x01
+#define THCI_FAULT_VERDICT_DUPLICATE    0x02
+#define THCI_FAULT_VERDICT_DELAY        0x04
+
+#define THCI_FAULT_PROBABILITY_MAX      1000000     // probabilities are in parts per million.
+#define THCI_FAULT_MAX_BIT_FLIPS        8
+
+#if LWIP_VERSION_MAJOR < 2
+typedef struct ip6_addr *thci_fault_ip6_addr_t;
+#else
+typedef const struct ip6_addr *thci_fault_ip6_addr_t;
+#endif
+
+typedef struct
+{
+    uint32_t    mProbability[kThciFaultActionCount];    // per packet, frame or byte, in ppm.
+    uint16_t    mDelay;         // delay in msec.
+    uint16_t    mSkipBytes;     // leading bytes never truncated or corrupted, e.g. 40 for the IPv6 header; ignored by byte streams.
+    uint8_t     mBitFlips;      // bits flipped by a bitflip action, 1 if 0, up to THCI_FAULT_MAX_BIT_FLIPS; 1 for byte streams.
+} thci_fault_config_t;
+
+typedef struct
+{
+    uint32_t    mUnits;                             // packets, frames or bytes seen.
+    uint32_t    mInjected[kThciFaultActionCount];   // faults injected.
+} thci_fault_stats_t;
+
+#if THCI_CONFIG_FAULT_INJECTION
+
+extern volatile uint8_t gThciFaultActiveStreams;
+
+#define THCI_FAULT_ACTIVE(aStream)  ((gThciFaultActiveStreams & (1 << (aStream))) != 0)
+
+#define THCI_FAULT_TCPIP_INPUT(aPbuf, aNetif) \
+    (THCI_FAULT_ACTIVE(kThciFaultStreamIpRx) ? thciFaultInput((aPbuf), (aNetif)) : tcpip_input((aPbuf), (aNetif)))
+
+/**
+ * Seed all stream generators and reset the statistics.  Streams keep
+ * their configuration.
+ */
+void thciFaultSeed(uint32_t aSeed);
+
+/**
+ * Configure and enable a stream, or disable it when aConfig is NULL or has
+ * only zero probabilities.
+ *
+ * @retval 0 on success, -EINVAL when an action is not supported on the
+ *         stream or a probability is above THCI_FAULT_PROBABILITY_MAX.
+ */
+int thciFaultConfigure(thci_fault_stream_t aStream, const thci_fault_config_t *aConfig);
+
+/**
+ * Disable all streams and release any held packet.
+ */
+void thciFaultDisableAll(void);
+
+void thciFaultGetConfig(thci_fault_stream_t aStream, thci_fault_config_t *aConfig);
+
+void thciFaultGetStats(thci_fault_stream_t aStream, thci_fault_stats_t *aStats);
+
+void thciFaultResetStats(void);
+
+const char *thciFaultStreamName(thci_fault_stream_t aStream);
+
+const char *thciFaultActionName(thci_fault_action_t aAction);
+
+/**
+ * Apply the ip_rx faults to a received packet and pass the resulting
+ * packets to tcpip_input().  Takes ownership of aPbuf, like tcpip_input()
+ * does on success.  A packet held for a delay or reorder is released to
+ * the netif it was received on.
+ *
+ * @retval ERR_OK.
+ */
+err_t thciFaultInput(struct pbuf *aPbuf, struct netif *aNetif);
+
+/**
+ * Apply the ip_tx faults to a packet sent by LwIP.  The packet is copied and
+ * the resulting packets are sent through aNetif->output_ip6, during which
+ * the hook is bypassed.  The THCI output functions ignore the next hop
+ * address, so a released packet is sent with the address of the packet
+ * that released it.
+ *
+ * @retval true if the packet was handled, with aResult the result to return
+ *         to LwIP; false if the call is a bypassed one and the caller must
+ *         send the packet itself.
+ */
+bool thciFaultOutput(struct netif *aNetif, struct pbuf *aPbuf, thci_fault_ip6_addr_t aAddress, err_t *aResult);
+
+/**
+ * Apply the faults of a frame stream to a frame, in place.
+ *
+ * @param[in]     aStream   kThciFaultStreamFrameTx or kThciFaultStreamFrameRx.
+ * @param[inout]  aFrame    The frame.
+ * @param[inout]  aLength   The frame length, reduced by a truncation.
+ * @param[out]    aDelay    The delay to apply, in msec, for THCI_FAULT_VERDICT_DELAY.
+ *
+ * @retval THCI_FAULT_VERDICT_* flags.
+ */
+uint8_t thciFaultFrame(thci_fault_stream_t aStream, uint8_t *aFrame, uint16_t *aLength, uint16_t *aDelay);
+
+/**
+ * Apply the faults of a byte stream to a byte, in place.
+ *
+ * @retval THCI_FAULT_VERDICT_PASS, _DROP or _DUPLICATE.
+ */
+uint8_t thciFaultByte(thci_fault_stream_t aStream, uint8_t *aByte);
+
+#else
+
+#define THCI_FAULT_ACTIVE(aStream)  (0)
+
+#define THCI_FAULT_TCPIP_INPUT(aPbuf, aNetif)   tcpip_input((aPbuf), (aNetif))
+
+#endif // THCI_CONFIG_FAULT_INJECTION
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_FAULT_H_INCLUDED__ */
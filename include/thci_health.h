@@ -0,0 +1,181 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the NCP health monitor.
+ *
+ *      The monitor probes the NCP with a GET of SPINEL_PROP_LAST_STATUS on
+ *      the THCI task and keeps the round trip and outcome of the last
+ *      THCI_CONFIG_NCP_HEALTH_WINDOW probes.  The NCP is:
+ *
+ *        - degraded when the p99 round trip or the failure rate of the
+ *          window exceeds its SLO,
+ *        - failed after mFailureThreshold consecutive failed probes, at
+ *          which point NCP recovery is started if mAutoRecover is set.
+ *
+ *      Probes are sent every mMaxInterval while the NCP is healthy and
+ *      every mMinInterval otherwise, until the window is healthy again.
+ *
+ *      THCI has no timers: the monitor is ticked on the THCI task by every
+ *      frame from the NCP and every outgoing datagram, and the application
+ *      may call thciHealthTick() periodically as well so that an idle NCP
+ *      is probed too.  A tick posts a probe to the THCI task when one is
+ *      due; thciHealthStart() posts the first one, and a failed probe is
+ *      retried at once until the NCP is declared failed.  With T the
+ *      longest gap between ticks, R the response timeout
+ *      (MAX_NCP_APP_RESPONSE_TIME_MSEC, 3 s) and N mFailureThreshold, an
+ *      NCP that stops responding is declared failed within
+ *
+ *          mMaxInterval + T + N * R
+ *
+ *      e.g. 10 s + 1 s + 3 * 3 s = 20 s with the defaults and a 1 s tick,
+ *      against an unbounded time when only API timeouts detect it.  A
+ *      failure rate SLO of E% over a window of W probes is breached within
+ *      mMaxInterval + T + k * R when the failures are consecutive, where
+ *      k = floor(W * E / 100) + 1.  The p99 of a window smaller than 100
+ *      probes is its largest sample, so one probe slower than the RTT SLO
+ *      reports degraded until it leaves the window.
+ *
+ *      Each THCI instance monitors its own NCP; the functions below act on
+ *      the instance bound to the calling task.
+ *
+ */
+
+#ifndef __THCI_HEALTH_H_INCLUDED__
+#define __THCI_HEALTH_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+#include <thci_stats.h>
+
+#include <openthread/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define THCI_HEALTH_DEFAULT_MIN_INTERVAL_MSEC       1000
+#define THCI_HEALTH_DEFAULT_MAX_INTERVAL_MSEC       10000
+#define THCI_HEALTH_DEFAULT_RTT_SLO_MSEC            100
+#define THCI_HEALTH_DEFAULT_FAILURE_SLO_PERCENT     10
+#define THCI_HEALTH_DEFAULT_FAILURE_THRESHOLD       3
+
+typedef enum
+{
+    kThciHealthStopped = 0,
+    kThciHealthOk,
+    kThciHealthDegraded,            // an SLO is breached.
+    kThciHealthFailed,              // the NCP does not respond.
+} thci_health_state_t;
+
+typedef struct
+{
+    uint32_t    mMinInterval;       // probe interval while degraded or failed, in msec.
+    uint32_t    mMaxInterval;       // probe interval while healthy, in msec.
+    uint32_t    mRttSlo;            // p99 round trip SLO, in msec.
+    uint8_t     mFailureSlo;        // failed probes SLO, in percent of the window.
+    uint8_t     mFailureThreshold;  // consecutive failed probes that mean failed.
+    bool        mAutoRecover;       // start NCP recovery when failed.
+} thci_health_config_t;
+
+typedef struct
+{
+    thci_health_state_t mState;
+    uint32_t            mInterval;          // current probe interval, in msec.
+    uint32_t            mProbes;            // probes sent.
+    uint32_t            mFailures;          // probes that failed.
+    uint32_t            mConsecutiveFailures;
+    uint32_t            mLastProbeTime;     // host time of the last probe.
+    uint32_t            mWindowProbes;      // probes in the window.
+    uint32_t            mWindowRttP99;      // p99 round trip of the window, in msec.
+    uint8_t             mWindowFailures;    // failed probes in the window, in percent.
+    uint32_t            mDegradations;      // transitions from ok to degraded or failed.
+    uint32_t            mRecoveries;        // NCP recoveries started by the monitor.
+    thci_histogram_t    mRtt;               // round trip of all successful probes, in msec.
+} thci_health_status_t;
+
+/**
+ * Called on the THCI task when the health state changes.
+ */
+typedef void (*thciHealthCallback)(thci_health_state_t aState, const thci_health_status_t *aStatus, void *aContext);
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_HEALTH
+
+/**
+ * Create the monitor lock.  Called once by THCI initialization, before
+ * any other task can start the monitor.
+ *
+ * @retval 0 on success, a negative errno otherwise.
+ */
+int thciHealthInit(void);
+
+/**
+ * Start the health monitor.  May be called from any task.
+ *
+ * @param[in]  aConfig      The configuration, or NULL for the defaults.
+ * @param[in]  aCallback    Receives state changes.  May be NULL.
+ * @param[in]  aContext     Passed to aCallback.
+ *
+ * @retval  OT_ERROR_NONE           The monitor was started.
+ * @retval  OT_ERROR_INVALID_ARGS   Invalid configuration.
+ * @retval  OT_ERROR_INVALID_STATE  THCI is not initialized.
+ */
+otError thciHealthStart(const thci_health_config_t *aConfig, thciHealthCallback aCallback, void *aContext);
+
+/**
+ * Stop the health monitor.  May be called from any task.
+ */
+void thciHealthStop(void);
+
+/**
+ * Drive the health monitor.  May be called from any task.  Posts a probe
+ * to the THCI task when one is due.  THCI calls
+ * this on the frames it exchanges with the NCP; an application that
+ * also calls it periodically, e.g. every second, bounds T for an idle NCP.
+ */
+void thciHealthTick(void);
+
+/**
+ * Retrieve the health status.  May be called from any task.
+ */
+void thciGetHealthStatus(thci_health_status_t *aStatus);
+
+/**
+ * Send a keep-alive request to the NCP and measure its round trip.  Call
+ * from the THCI task.  Unlike the other requests, a timeout does not start
+ * NCP recovery.
+ *
+ * @param[out] aRtt     The round trip, in msec.
+ *
+ * @retval  OT_ERROR_NONE           The NCP responded.
+ * @retval  OT_ERROR_INVALID_STATE  THCI is not initialized.
+ */
+otError thciPingNcp(uint32_t *aRtt);
+
+const char *thciHealthStateName(thci_health_state_t aState);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_HEALTH
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_HEALTH_H_INCLUDED__ */
@@ -55,7 +55,13 @@ typedef struct
 {
     uint16_t mHead;
     uint16_t mTail;
+    uint16_t mSize;         // entries of mQueue.
+    uint16_t mHighWater;    // most entries queued.
+#if THCI_CONFIG_ARENA
+    otMessage **mQueue;     // carved from the arena.
+#else
     otMessage *mQueue[THCI_CONFIG_MESSAGE_QUEUE_SIZE];
+#endif
 } thci_message_queue_t;
 
 /**
@@ -89,6 +95,18 @@ typedef enum
  */
 #define THCI_RECEIVED_SECURE_MESSAGE_ON_INSECURE_PORT(_flags) (((_flags) & THCI_SECURITY_FLAG_SECURE_MSG_RXD_ON_INSECURE_PORT) ? true : false)
 
+/**
+ * THCI_MESSAGE_QUEUE_COUNT - Number of outgoing message queues: one per netif
+ * when each netif has its own Spinel interface id, one shared otherwise.
+ */
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_SPINEL_IID_MUX
+#define THCI_MESSAGE_QUEUE_COUNT        THCI_NETIF_TAG_COUNT
+#define THCI_MESSAGE_QUEUE_OF(_tag)     (_tag)
+#else
+#define THCI_MESSAGE_QUEUE_COUNT        1
+#define THCI_MESSAGE_QUEUE_OF(_tag)     0
+#endif
+
 /**
  * THCI context storage
  */
@@ -96,17 +114,48 @@ typedef struct
 {
     thci_init_params_t      mInitParams;                    // send and receive event queues.
     struct netif            *mNetif[THCI_NETIF_TAG_COUNT];  // The associated LwIP network Interface.
-    thci_message_queue_t    mMessageQueue;                  // The outgoing message queue.
+    thci_message_queue_t    mMessageQueue[THCI_MESSAGE_QUEUE_COUNT]; // The outgoing message queues.
     thci_state_t            mState;                         // THCI state.
     uint16_t                mInsecureSourcePort;            // A second insecure port opened by THCI or the port opened by the client.
     uint8_t                 mSecurityFlags;                 // OpenThread Security State flags.
     otDeviceRole            mDeviceRole;                    // OpenThread device role
     bool                    mStallOutgoingDataPackets;      // Allows the flow of outgoing data packets to be stalled.
+    uint8_t                 mStalledMessageQueues;          // Bit per message queue stalled on its own.
 } thci_sdk_context_t;
 
-otMessage* DequeueMessage(void);
-int EnqueueMessage(otMessage *aMessage);
-bool IsMessageQueueEmpty(void);
+extern thci_sdk_context_t gTHCISDKContexts[THCI_CONFIG_MAX_INSTANCES];
+
+#if THCI_CONFIG_MAX_INSTANCES > 1
+/**
+ * Index of the instance bound to the calling task, 0 if none.  This scans
+ * THCI_CONFIG_MAX_INSTANCE_TASKS entries, so the data path resolves it once
+ * per entry point and passes the index or context down.
+ */
+uint8_t thciGetCurrentInstanceIndex(void);
+
+#define THCI_INSTANCE_INDEX()   thciGetCurrentInstanceIndex()
+#else
+#define THCI_INSTANCE_INDEX()   0
+#endif
+
+/**
+ * The context of the current instance.  Code that is not running on behalf
+ * of a task, e.g. an ISR, must use gTHCISDKContexts with an explicit index.
+ */
+#define gTHCISDKContext         (gTHCISDKContexts[THCI_INSTANCE_INDEX()])
+
+/**
+ * Find the instance a netif was registered with, NULL if none.
+ */
+thci_instance_t *thciGetNetifInstance(const struct netif *aNetif);
+
+/**
+ * The outgoing message queues of an instance.  The data path resolves its
+ * instance once and passes its context.
+ */
+otMessage* DequeueMessage(thci_sdk_context_t *aContext, uint8_t aQueue);
+int EnqueueMessage(thci_sdk_context_t *aContext, uint8_t aQueue, otMessage *aMessage);
+bool IsMessageQueueEmpty(const thci_sdk_context_t *aContext, uint8_t aQueue);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -46,6 +46,17 @@ extern "C" {
 // OPENTHREAD_CONFIG_MAX_EXT_MULTICAST_IP_ADDRS
 #define THCI_CACHED_MULTICAST_ADDRESS_SIZE 2
 
+// The largest Spinel frame THCI assumes the NCP takes, until the NCP reports
+// its own limit.
+#define THCI_NCP_DEFAULT_MAX_FRAME_SIZE     1500
+
+// The number of capabilities and UART baud rates kept from the lists of the NCP.
+#define THCI_NCP_MAX_CAPS                   32
+#define THCI_NCP_MAX_BAUD_RATES             8
+
+#define THCI_NCP_CAPS_FLAG_CAPS             0x01    // the NCP answered SPINEL_PROP_CAPS.
+#define THCI_NCP_CAPS_FLAG_LIMITS           0x02    // the NCP answered SPINEL_PROP_VENDOR_NEST_NCP_LIMITS.
+
 // The number of memory buffers used to store content until an event is handled
 // to deliver that content to the client via the client callbacks.
 #define THCI_NUM_CALLBACK_BUFFERS   (4)
@@ -82,10 +93,31 @@ typedef enum {
     kModuleStateHostSleep
 } module_state_t;
 
+// What THCI learned about the NCP at initialization.  The limits the NCP
+// does not report keep the values THCI was built with.
+typedef struct
+{
+    uint8_t                     mFlags;                     // THCI_NCP_CAPS_FLAG_*.
+    uint8_t                     mCapCount;
+    uint8_t                     mBaudRateCount;
+    uint8_t                     mUnicastAddressTableSize;
+    uint8_t                     mMulticastAddressTableSize;
+    uint8_t                     mChildTableSize;            // 0 if unknown.
+    uint8_t                     mNeighborTableSize;         // 0 if unknown.
+    uint16_t                    mMaxFrameSize;              // largest Spinel frame the NCP takes.
+    uint32_t                    mBaudRates[THCI_NCP_MAX_BAUD_RATES];
+    uint32_t                    mCaps[THCI_NCP_MAX_CAPS];   // SPINEL_CAP_* values.
+} thci_ncp_caps_t;
+
 // THCI context that is unique to the NCP solution.
 typedef struct
 {
+#if THCI_CONFIG_ARENA
+    uint8_t                     *mMessageRingBuffer;        // carved from the arena.
+#else
     uint8_t                     mMessageRingBuffer[THCI_CONFIG_NCP_TX_MESSAGE_RING_BUFFER_SIZE];
+#endif
+    uint32_t                    mMessageRingSize;
     uint8_t                     *mMessageRingHead;
     uint8_t                     *mMessageRingTail;
     uint16_t                    mMessageRingEndGap;
@@ -107,12 +139,26 @@ typedef struct
     thciLurkerWakeCallback      mLurkerWakeCallback;
 #endif
 
+    thci_ncp_caps_t             mCaps;
+
     uint8_t                     mTransactionId;
     module_state_t              mModuleState;
     spinel_status_t             mLastStatus;
     uint32_t                    mStateChangeFlags;
 } thci_ncp_context_t;
 
+/**
+ * Get the capabilities of the NCP of the current instance, learned at its
+ * last initialization.
+ */
+const thci_ncp_caps_t *thciGetNcpCaps(void);
+
+/**
+ * @return true if the NCP of the current instance listed aCap, a
+ *         SPINEL_CAP_* value, in SPINEL_PROP_CAPS.
+ */
+bool thciNcpHasCap(unsigned int aCap);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
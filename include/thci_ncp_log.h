@@ -0,0 +1,134 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the capture buffer for the NCP debug stream
+ *      (SPINEL_PROP_STREAM_DEBUG).
+ *
+ *      The control frame handler appends the raw stream bytes to a ring
+ *      buffer, subject to a per-second byte budget.  Splitting the stream
+ *      into lines and logging them is left to a reader running outside of
+ *      the THCI task: an event that the first chunk appended while none is
+ *      pending posts to the mLogQueue of the init parameters, served by a
+ *      low priority task.  Without an mLogQueue, the application calls
+ *      thciNcpLogFlush() from such a task itself.
+ *
+ *      Each THCI instance captures the stream of its own NCP in its own
+ *      ring, and tags its lines with the instance past the first one.  The
+ *      functions below act on the instance bound to the calling task.
+ *
+ */
+
+#ifndef __THCI_NCP_LOG_H_INCLUDED__
+#define __THCI_NCP_LOG_H_INCLUDED__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+#include <openthread/types.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * NCP debug stream capture counters.
+ */
+typedef struct
+{
+    uint32_t    mCapturedChunks;    // Debug stream frames stored in the ring.
+    uint32_t    mCapturedBytes;     // Debug stream bytes stored in the ring.
+    uint32_t    mRateLimitedBytes;  // Bytes dropped because the per-second budget was spent.
+    uint32_t    mOverflowBytes;     // Bytes dropped because the ring was full.
+    uint32_t    mHighWater;         // Highest number of bytes in use in the ring.
+} thci_ncp_log_stats_t;
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
+
+/**
+ * Initialize the NCP debug stream ring.
+ *
+ * @retval 0 on success, a negative errno otherwise.
+ */
+int thciNcpLogInit(void);
+
+/**
+ * Append a chunk of the NCP debug stream to the ring.  Called from the
+ * control frame handler; does no formatting.  Only the part of the chunk
+ * within the per-second budget is kept.
+ *
+ * @param[in]  aData      The debug stream bytes.
+ * @param[in]  aLength    The number of bytes.
+ */
+void thciNcpLogAppend(const uint8_t *aData, uint16_t aLength);
+
+/**
+ * Remove the oldest chunk from the ring.
+ *
+ * @param[out] aBuffer     Buffer to receive the chunk.
+ * @param[in]  aSize       The size of aBuffer.
+ * @param[out] aTimestamp  Host time, in milliseconds, at which the chunk was received. May be NULL.
+ *
+ * @return The length of the chunk, 0 if the ring is empty or -ENOSPC if
+ *         aBuffer is too small, in which case the chunk is left in the ring.
+ */
+int thciNcpLogRead(uint8_t *aBuffer, size_t aSize, uint32_t *aTimestamp);
+
+/**
+ * Split the captured stream into lines and write them to the host log.
+ * Each line is tagged with the host time, in msec, at which its first byte
+ * was received and, with THCI_CONFIG_NCP_CLOCK_SYNC, the NCP time and error
+ * bound it converts to.  THCI calls this from its flush event on the mLogQueue;
+ * returns 0 at once if another task is flushing.
+ *
+ * @param[in]  aMaxLines  The maximum number of lines to log, 0 for all.
+ *
+ * @return The number of lines logged.
+ */
+size_t thciNcpLogFlush(size_t aMaxLines);
+
+/**
+ * Retrieve the capture counters.
+ *
+ * @param[out] aStats     The counters.
+ */
+void thciNcpLogGetStats(thci_ncp_log_stats_t *aStats);
+
+/**
+ * Set the NCP's log level (SPINEL_PROP_DEBUG_NCP_LOG_LEVEL).
+ *
+ * @param[in]  aLevel     The OpenThread log level (OT_LOG_LEVEL_*).
+ *
+ * @retval  OT_ERROR_NONE           Successfully set the log level.
+ * @retval  OT_ERROR_INVALID_STATE  THCI is not initialized.
+ * @retval  OT_ERROR_FAILED         The NCP did not accept the log level.
+ */
+otError thciSetNcpLogLevel(uint8_t aLevel);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_NCP_LOG_H_INCLUDED__ */
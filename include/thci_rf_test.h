@@ -0,0 +1,126 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the RF packet error rate test API.
+ *
+ *      A test is a sequence of transmit and receive steps, each on a given
+ *      channel and power level.  The whole sequence is sent to the NCP in
+ *      one request (SPINEL_PROP_VENDOR_NEST_RF_TEST) and the NCP runs it
+ *      on its own, streaming back one binary result per step.  The host
+ *      is not involved between steps.
+ *
+ *      PER is measured with a reference unit: one side runs tx steps while
+ *      the other runs rx steps on the same channels, and the receiver's
+ *      PER is 1 - mFramesReceived / mFrameCount.
+ *
+ */
+
+#ifndef __THCI_RF_TEST_H_INCLUDED__
+#define __THCI_RF_TEST_H_INCLUDED__
+
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#include <openthread/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of buckets of the LQI and RSSI histograms.
+ *
+ * LQI bucket i counts frames with LQI in [32 * i, 32 * i + 31].
+ * RSSI bucket i counts frames with RSSI in [-100 + 10 * i, -91 + 10 * i]
+ * dBm; the first and last buckets also count the frames below and above.
+ */
+#define THCI_RF_TEST_HISTOGRAM_BUCKETS      8
+
+typedef enum
+{
+    kThciRfTestModeTx = 1,          // transmit mFrameCount frames.
+    kThciRfTestModeRx = 2,          // count frames received during mDuration.
+} thci_rf_test_mode_t;
+
+typedef struct
+{
+    thci_rf_test_mode_t mMode;
+    uint8_t             mChannel;
+    int8_t              mPower;         // tx power in dBm, ignored for rx.
+    uint16_t            mFrameCount;    // frames to send, or frames expected for rx.
+    uint8_t             mFrameLength;   // PSDU length in bytes, ignored for rx.
+    uint16_t            mInterval;      // time between frames in msec, ignored for rx.
+    uint32_t            mDuration;      // receive window in msec, ignored for tx.
+} thci_rf_test_step_t;
+
+typedef struct
+{
+    uint16_t            mStep;          // index of the step in the sequence.
+    thci_rf_test_mode_t mMode;
+    uint8_t             mChannel;
+    int8_t              mPower;
+    uint16_t            mFrameCount;    // from the step.
+    uint32_t            mFramesSent;
+    uint32_t            mFramesReceived;    // valid frames; acks in tx mode.
+    uint32_t            mFrameErrors;   // FCS or other receive errors.
+    uint32_t            mDuration;      // actual step duration, in msec.
+    uint16_t            mLqiHistogram[THCI_RF_TEST_HISTOGRAM_BUCKETS];
+    uint16_t            mRssiHistogram[THCI_RF_TEST_HISTOGRAM_BUCKETS];
+} thci_rf_test_result_t;
+
+/**
+ * Called on the THCI task with the result of each step, in order, and then
+ * once with aResult set to NULL when the sequence completes or is stopped.
+ */
+typedef void (*thciRfTestCallback)(const thci_rf_test_result_t *aResult, void *aContext);
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST
+
+/**
+ * Start an RF test sequence.  The NCP diag mode must have been started
+ * ("diag start").  aSteps is copied and may be released on return.
+ *
+ * @param[in]  aSteps       The steps.
+ * @param[in]  aNumSteps    Number of steps, at most THCI_CONFIG_RF_TEST_MAX_STEPS.
+ * @param[in]  aCallback    Receives the results.
+ * @param[in]  aContext     Passed to aCallback.
+ *
+ * @retval  OT_ERROR_NONE           The sequence was started.
+ * @retval  OT_ERROR_BUSY           A sequence is already running.
+ * @retval  OT_ERROR_INVALID_ARGS   Invalid arguments.
+ * @retval  OT_ERROR_INVALID_STATE  THCI is not initialized.
+ * @retval  OT_ERROR_NOT_CAPABLE    The NCP does not list SPINEL_CAP_VENDOR_NEST_RF_TEST.
+ * @retval  OT_ERROR_FAILED         The NCP rejected the sequence.
+ */
+otError thciRfTestStart(const thci_rf_test_step_t *aSteps, uint16_t aNumSteps, thciRfTestCallback aCallback, void *aContext);
+
+/**
+ * Stop the running sequence.  The callback is still called with NULL.
+ */
+otError thciRfTestStop(void);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_RF_TEST_H_INCLUDED__ */
@@ -27,6 +27,8 @@
 
 #include <openthread/types.h>
 #include <thci.h>
+#include <thci_diag.h>
+#include <thci_rf_test.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -82,6 +84,11 @@ otError thciSafeGetChildTable(otChildInfo *aChildTableHead, uint32_t aInSize, ui
 
 otError thciSafeGetNeighborTable(otNeighborInfo *aNeighborTableHead, uint32_t aInSize, uint32_t *aOutSize);
 
+// aVisitor is called on the THCI task, and must not call THCI or the safe API.
+otError thciSafeVisitChildTable(thciChildVisitor aVisitor, void *aContext);
+
+otError thciSafeVisitNeighborTable(thciNeighborVisitor aVisitor, void *aContext);
+
 otError thciSafeGetExtendedAddress(uint8_t *aAddress);
 
 otError thciSafeGetInstantRssi(int8_t *aRssi);
@@ -90,6 +97,26 @@ otError thciSafeGetInstantRssi(int8_t *aRssi);
 bool thciSafeIsNcpPosting(void);
 #endif
 
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
+otError thciSafeSetNcpLogLevel(uint8_t aLevel);
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_CLOCK_SYNC
+otError thciSafeSyncNcpClock(void);
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+otError thciSafeRunDiagScript(const char *aScript, uint8_t aFlags, thci_diag_record_t *aRecords,
+                              uint16_t aMaxRecords, uint16_t *aNumRecords);
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST
+// aCallback is called on the THCI task.
+otError thciSafeRfTestStart(const thci_rf_test_step_t *aSteps, uint16_t aNumSteps, thciRfTestCallback aCallback, void *aContext);
+
+otError thciSafeRfTestStop(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -31,6 +31,9 @@ extern "C" {
 #endif
 
 #include <inttypes.h>
+#include <stdbool.h>
+
+#include <thci_config.h>
 
 int thciShellHandleCommand(int argc, const char * argv[]);
 
@@ -44,6 +47,14 @@ int thciShellMfgSetGpio(uint16_t inPin, uint8_t inValue);
 
 int thciShellMfgGetGpio(uint16_t inPin);
 
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+/**
+ * Run a diag script (see thci_diag.h) and log one record per step.
+ * Returns 0 when every step passed, -EIO otherwise.
+ */
+int thciShellMfgRunScript(const char *inScript, bool inAbortOnFailure);
+#endif
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
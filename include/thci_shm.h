@@ -0,0 +1,224 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the shared memory region of the Spinel shared memory
+ *      transport, its rings and its platform interface.
+ *
+ *      With THCI_CONFIG_NCP_SHM the host and the NCP share a region holding
+ *      two single producer, single consumer rings, one per direction.  Each
+ *      descriptor of a ring points at a frame buffer in the region, holding
+ *      one Spinel frame without HDLC framing.  The producer fills the buffer
+ *      and the descriptor, then advances the head; the consumer reads the
+ *      frame in place, then advances the tail.  Head, tail and the
+ *      doorbells each have a cache line of their own, so that the two cores
+ *      do not write to the same line.  Indices are free running and taken
+ *      modulo THCI_CONFIG_SHM_RING_SIZE.
+ *
+ *      The region must be coherent between the cores, or uncached, and
+ *      aligned on a cache line.  Both sides use the ring functions below;
+ *      the NCP side is built from thci_shm.c alone.
+ *
+ *      After filling or emptying a ring, a side rings the doorbell of the
+ *      other.  The platform provides the region and the doorbells of each
+ *      THCI instance, e.g. an IPC interrupt between the cores.  With
+ *      THCI_CONFIG_SHM_POSIX they are provided by a POSIX shared memory
+ *      object, whose doorbells are futexes, so that the NCP can run in
+ *      another thread or process.
+ *
+ */
+
+#ifndef __THCI_SHM_H_INCLUDED__
+#define __THCI_SHM_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM
+
+#define THCI_SHM_CACHE_LINE_SIZE        64
+
+#define THCI_SHM_MAGIC                  0x54534831  // "TSH1"
+#define THCI_SHM_VERSION                2
+
+typedef enum
+{
+    kThciShmHostToNcp                   = 0,
+    kThciShmNcpToHost                   = 1,
+} thci_shm_direction_t;
+
+/**
+ * An index or doorbell, alone on its cache line.
+ */
+typedef struct
+{
+    volatile uint32_t       mValue;
+    uint8_t                 mPad[THCI_SHM_CACHE_LINE_SIZE - sizeof(uint32_t)];
+} thci_shm_word_t;
+
+typedef struct
+{
+    uint32_t                mOffset;    // of the frame buffer from the start of the region.
+    uint16_t                mLength;
+    uint16_t                mReserved;
+} thci_shm_descriptor_t;
+
+typedef struct
+{
+    thci_shm_word_t         mHead;      // next descriptor to fill, written by the producer only.
+    thci_shm_word_t         mTail;      // next descriptor to take, written by the consumer only.
+    thci_shm_descriptor_t   mDescriptors[THCI_CONFIG_SHM_RING_SIZE];
+} thci_shm_ring_t;
+
+typedef struct
+{
+    uint32_t                mMagic;     // written last by thciShmRegionInit().
+    uint32_t                mVersion;
+    uint32_t                mRingSize;
+    uint32_t                mFrameSize;
+    uint32_t                mOwner;     // platform defined, written after mMagic, e.g. the process that created a POSIX region.
+    uint8_t                 mPad[THCI_SHM_CACHE_LINE_SIZE - 5 * sizeof(uint32_t)];
+    thci_shm_word_t         mHostDoorbell;  // incremented to wake the host.
+    thci_shm_word_t         mNcpDoorbell;   // incremented to wake the NCP.
+    thci_shm_ring_t         mRings[2];      // indexed by thci_shm_direction_t.
+    uint8_t                 mFrames[2][THCI_CONFIG_SHM_RING_SIZE][THCI_CONFIG_SHM_FRAME_SIZE];
+} thci_shm_region_t;
+
+/**
+ * Initialize the header and rings of a region.  Called by the side that
+ * creates it, before the other side uses it.
+ */
+void thciShmRegionInit(thci_shm_region_t *aRegion);
+
+/**
+ * @return true if the region was initialized with the layout of this build.
+ */
+bool thciShmRegionIsValid(const thci_shm_region_t *aRegion);
+
+/**
+ * Get the frame buffer of the next descriptor of a ring, for the producer
+ * to build a frame in place, and thciShmRingCommit() it.
+ *
+ * @return The buffer, of THCI_CONFIG_SHM_FRAME_SIZE bytes, or NULL if the
+ *         ring is full.
+ */
+uint8_t *thciShmRingReserve(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection);
+
+/**
+ * Pass the frame built in the buffer of thciShmRingReserve() to the
+ * consumer.
+ */
+void thciShmRingCommit(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection, uint16_t aLength);
+
+/**
+ * Copy a frame into a ring.
+ *
+ * @retval 0 on success, -EMSGSIZE if the frame is too long or -ENOBUFS if
+ *         the ring is full.
+ */
+int thciShmRingPut(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection, const uint8_t *aFrame, uint16_t aLength);
+
+/**
+ * Get the oldest frame of a ring, in place.  It stays in the ring until
+ * thciShmRingRelease().
+ *
+ * @retval 0 on success, -ENODATA if the ring is empty or -EBADMSG if the
+ *         ring or the descriptor is corrupt.
+ */
+int thciShmRingPeek(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection, uint8_t **aFrame, uint16_t *aLength);
+
+/**
+ * Return the frame of thciShmRingPeek() to the producer.
+ */
+void thciShmRingRelease(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection);
+
+/**
+ * @return The number of frames in a ring.
+ */
+uint32_t thciShmRingCount(const thci_shm_region_t *aRegion, thci_shm_direction_t aDirection);
+
+/**
+ * Called, in ISR context or, with THCI_CONFIG_SHM_POSIX, on the doorbell
+ * thread of the platform, when the NCP of instance aInstanceIndex rings
+ * the host's doorbell.
+ */
+typedef void (*thciShmDoorbellHandler)(uint8_t aInstanceIndex);
+
+/**
+ * Provided by the platform.
+ *
+ * @return The region shared with the NCP of an instance, or NULL if it
+ *         cannot be mapped.
+ */
+thci_shm_region_t *thciShmPlatformGetRegion(uint8_t aInstanceIndex);
+
+/**
+ * Call aHandler on every ring of the host's doorbell by the NCP of an
+ * instance.  A NULL aHandler disables the doorbell; the region stays
+ * mapped.  Provided by the platform.
+ */
+void thciShmPlatformEnable(uint8_t aInstanceIndex, thciShmDoorbellHandler aHandler);
+
+/**
+ * Ring the NCP's doorbell of an instance.  Provided by the platform.
+ */
+void thciShmPlatformRingDoorbell(uint8_t aInstanceIndex);
+
+#if THCI_CONFIG_SHM_POSIX
+
+/**
+ * Map the POSIX shared memory object aName, creating and initializing it
+ * if it does not exist.  For the NCP side of a test.
+ *
+ * An existing object is mapped once its creator sized and published it.
+ * One that is not published in time, has another layout or whose creator
+ * is gone is unlinked and created again.
+ *
+ * @return The region, or NULL with errno set.
+ */
+thci_shm_region_t *thciShmPosixMap(const char *aName);
+
+/**
+ * Increment a doorbell of a region and wake its waiters.
+ */
+void thciShmPosixRing(thci_shm_word_t *aDoorbell);
+
+/**
+ * Wait until a doorbell differs from aSeen, or for aTimeoutMsec, -1 for
+ * ever.
+ *
+ * @return The value of the doorbell.
+ */
+uint32_t thciShmPosixWait(thci_shm_word_t *aDoorbell, uint32_t aSeen, int aTimeoutMsec);
+
+#endif // THCI_CONFIG_SHM_POSIX
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_SHM_H_INCLUDED__ */
@@ -0,0 +1,130 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines the platform interface of the Spinel SPI transport, and the
+ *      simulated SPI NCP.
+ *
+ *      With THCI_CONFIG_NCP_SPI the NCP is a SPI slave.  Every transfer is
+ *      full duplex and starts with a 5 byte header in each direction: a
+ *      flag byte, the number of bytes the sender can accept and the number
+ *      of bytes it sends, both little endian, followed by at most one
+ *      Spinel frame.  A frame longer than the receiver accepts, or than the
+ *      transfer, is sent again in a later transfer.  The NCP asserts its
+ *      interrupt line while it has a frame to send; THCI then transfers
+ *      back to back, up to THCI_CONFIG_SPI_BURST times, until the line is
+ *      released.
+ *
+ *      The platform provides the functions below for each THCI instance.
+ *      With THCI_CONFIG_SPI_SIMULATED_PEER they are provided instead by a
+ *      simulated NCP, which answers property get, set, insert and remove
+ *      requests as an NCP would, echoing the value of the request.  Tests
+ *      replace this with their own frame handler, and send unsolicited
+ *      frames with thciSpiSimSend().
+ *
+ */
+
+#ifndef __THCI_SPI_H_INCLUDED__
+#define __THCI_SPI_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SPI
+
+#define THCI_SPI_HEADER_SIZE            5
+
+#define THCI_SPI_HEADER_RESET_FLAG      0x80    // the sender has reset since its last transfer.
+#define THCI_SPI_HEADER_CRC_FLAG        0x40    // not supported.
+#define THCI_SPI_HEADER_PATTERN_VALUE   0x02
+#define THCI_SPI_HEADER_PATTERN_MASK    0x03
+
+/**
+ * Called in ISR context when the NCP of instance aInstanceIndex asserts its
+ * interrupt line.
+ */
+typedef void (*thciSpiInterruptHandler)(uint8_t aInstanceIndex);
+
+/**
+ * Enable the SPI bus and the interrupt line of the NCP of an instance, and
+ * call aHandler on every assertion of the line.  A NULL aHandler disables
+ * them.  Provided by the platform.
+ */
+void thciSpiPlatformEnable(uint8_t aInstanceIndex, thciSpiInterruptHandler aHandler);
+
+/**
+ * Provided by the platform.
+ *
+ * @return true while the NCP of an instance asserts its interrupt line.
+ */
+bool thciSpiPlatformIsInterruptAsserted(uint8_t aInstanceIndex);
+
+/**
+ * Clock aLength bytes of aTxBuffer out to the NCP of an instance while
+ * reading as many into aRxBuffer, with its chip select asserted
+ * throughout.  Provided by the platform.
+ *
+ * @retval 0 on success, or a negative errno.
+ */
+int thciSpiPlatformTransfer(uint8_t aInstanceIndex, const uint8_t *aTxBuffer, uint8_t *aRxBuffer, uint16_t aLength);
+
+#if THCI_CONFIG_SPI_SIMULATED_PEER
+
+/**
+ * Receives a Spinel frame the host sent to the simulated NCP, during the
+ * transfer that carried it.  It may call thciSpiSimSend().
+ */
+typedef void (*thciSpiSimFrameHandler)(uint8_t aInstanceIndex, const uint8_t *aFrame, uint16_t aLength);
+
+/**
+ * Queue a Spinel frame for the simulated NCP of an instance to send, and
+ * assert its interrupt line.  May be called from any task.
+ *
+ * @retval 0 on success, -EMSGSIZE if the frame is too long or -ENOBUFS if
+ *         the queue is full.
+ */
+int thciSpiSimSend(uint8_t aInstanceIndex, const uint8_t *aFrame, uint16_t aLength);
+
+/**
+ * Set the handler of the frames the host sends, NULL for the default
+ * responder.
+ */
+void thciSpiSimSetFrameHandler(thciSpiSimFrameHandler aHandler);
+
+/**
+ * Make the simulated NCP of an instance drop its queue and report a reset
+ * in its next transfer, as after a power cycle.
+ */
+void thciSpiSimReset(uint8_t aInstanceIndex);
+
+#endif // THCI_CONFIG_SPI_SIMULATED_PEER
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SPI
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_SPI_H_INCLUDED__ */
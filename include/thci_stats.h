@@ -0,0 +1,356 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Defines THCI runtime statistics: latency histograms, per event
+ *      type dispatch statistics for the events THCI posts to the sdk queue
+ *      and attach / role transition statistics.
+ *
+ */
+
+#ifndef __THCI_STATS_H_INCLUDED__
+#define __THCI_STATS_H_INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <thci_config.h>
+
+#include <openthread/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of buckets in a thci_histogram_t.
+ *
+ * Bucket 0 counts samples of 0 msec, bucket n (n > 0) counts samples in
+ * [2^(n-1), 2^n) msec and the last bucket also counts everything above.
+ */
+#define THCI_HISTOGRAM_BUCKETS  16
+
+/**
+ * A log2 histogram of millisecond samples.
+ */
+typedef struct
+{
+    uint32_t    mBuckets[THCI_HISTOGRAM_BUCKETS];
+    uint32_t    mCount;     // number of samples.
+    uint32_t    mSum;       // sum of all samples, in msec.
+    uint32_t    mMax;       // largest sample, in msec.
+} thci_histogram_t;
+
+/**
+ * Add a sample to a histogram.
+ *
+ * @param[inout]  aHistogram  The histogram.
+ * @param[in]     aValue      The sample, in msec.
+ */
+void thciHistogramAdd(thci_histogram_t *aHistogram, uint32_t aValue);
+
+/**
+ * Estimate a percentile of a histogram.
+ *
+ * @param[in]  aHistogram  The histogram.
+ * @param[in]  aPercent    The percentile, 1 to 100.
+ *
+ * @return The upper bound, in msec, of the bucket holding the percentile,
+ *         capped at the largest sample. 0 if the histogram is empty.
+ */
+uint32_t thciHistogramPercentile(const thci_histogram_t *aHistogram, uint8_t aPercent);
+
+/**
+ * Identifies the events that THCI posts to its queues.
+ */
+typedef enum
+{
+    kThciEventUartRxDone = 0,       // UART RX processing, posted to the sdk queue.
+    kThciEventUartRxResponse,       // UART RX processing, posted to the response queue.
+    kThciEventOutgoingIPPacket,
+    kThciEventStateChange,
+    kThciEventLegacyUla,
+    kThciEventScanResult,
+    kThciEventScanComplete,
+    kThciEventNCPRecovery,
+    kThciEventSafeApi,
+    kThciEventRfTest,
+    kThciEventHealth,
+    kThciEventDaemon,
+    kThciEventAsync,
+    kThciEventLogFlush,
+    kThciEventClockSync,
+    kThciEventCount
+} thci_event_id_t;
+
+/**
+ * Dispatch statistics for one event type.
+ *
+ * mLatency measures from the post of the event to the start of its
+ * handler.  When several posts of the same event type are outstanding,
+ * the latency is measured from the oldest one.  Events posted from an ISR
+ * are counted, but their latency is not sampled.
+ */
+typedef struct
+{
+    uint32_t            mPosted;        // events posted.
+    uint32_t            mSuppressed;    // posts skipped because the event was already queued.
+    uint32_t            mDispatched;    // handler invocations.
+    uint32_t            mPending;       // posted but not yet dispatched.
+    uint32_t            mMaxPending;    // high-water of mPending.
+    thci_histogram_t    mLatency;       // post to dispatch, in msec.
+    thci_histogram_t    mRunTime;       // handler run time, in msec.
+} thci_event_stats_t;
+
+#if THCI_CONFIG_EVENT_STATS
+
+void thciEventStatsPosted(thci_event_id_t aId);
+// Same as thciEventStatsPosted(), without reading the clock.
+void thciEventStatsPostedFromIsr(thci_event_id_t aId);
+void thciEventStatsSuppressed(thci_event_id_t aId);
+void thciEventStatsDispatchBegin(thci_event_id_t aId);
+void thciEventStatsDispatchEnd(thci_event_id_t aId);
+
+/**
+ * Account for a pending event of type aFrom that is moved to another queue
+ * as type aTo, without being dispatched.  Its post time is kept.  aTo is
+ * kThciEventCount when the event is dropped, as one is pending there already.
+ */
+void thciEventStatsMoved(thci_event_id_t aFrom, thci_event_id_t aTo);
+
+/**
+ * Retrieve the statistics of one event type.
+ *
+ * @param[in]  aId      The event type.
+ * @param[out] aStats   The statistics.
+ */
+void thciGetEventStats(thci_event_id_t aId, thci_event_stats_t *aStats);
+
+/**
+ * Reset the statistics of all event types.  Pending counts are kept.
+ */
+void thciResetEventStats(void);
+
+/**
+ * Get the number of THCI events posted and not yet dispatched, and the
+ * high-water of that number.
+ *
+ * @param[out] aMaxPending  High-water of the number of pending events. May be NULL.
+ *
+ * @return The number of pending events.
+ */
+uint32_t thciGetPendingEventCount(uint32_t *aMaxPending);
+
+/**
+ * Get a printable name for an event type.
+ */
+const char *thciEventName(thci_event_id_t aId);
+
+#define THCI_EVENT_STATS_POSTED(aId)            thciEventStatsPosted(aId)
+#define THCI_EVENT_STATS_POSTED_FROM_ISR(aId)   thciEventStatsPostedFromIsr(aId)
+#define THCI_EVENT_STATS_SUPPRESSED(aId)        thciEventStatsSuppressed(aId)
+#define THCI_EVENT_STATS_DISPATCH_BEGIN(aId)    thciEventStatsDispatchBegin(aId)
+#define THCI_EVENT_STATS_DISPATCH_END(aId)      thciEventStatsDispatchEnd(aId)
+#define THCI_EVENT_STATS_MOVED(aFrom, aTo)      thciEventStatsMoved(aFrom, aTo)
+
+#else
+
+#define THCI_EVENT_STATS_POSTED(aId)
+#define THCI_EVENT_STATS_POSTED_FROM_ISR(aId)
+#define THCI_EVENT_STATS_SUPPRESSED(aId)
+#define THCI_EVENT_STATS_DISPATCH_BEGIN(aId)
+#define THCI_EVENT_STATS_DISPATCH_END(aId)
+#define THCI_EVENT_STATS_MOVED(aFrom, aTo)
+
+#endif // THCI_CONFIG_EVENT_STATS
+
+/**
+ * NCP UART link counters.
+ */
+typedef struct
+{
+    uint32_t    mRxBytes;           // bytes stored in the RX fifo.
+    uint32_t    mRxDroppedBytes;    // bytes dropped, fifo full or nobody to receive them.
+    uint32_t    mRxFlowOff;         // times the RX interrupt was disabled with the fifo near full.
+    uint32_t    mRxFifoHighWater;   // highest number of bytes in the RX fifo.
+    uint32_t    mRxWakeups;         // times the THCI task was woken for received bytes.
+    uint32_t    mRxFrames;          // HDLC frames decoded.
+    uint32_t    mRxFrameErrors;     // decoded frames that failed to parse as Spinel.
+    uint32_t    mRxDecodeErrors;    // HDLC decode errors.
+    uint32_t    mRxFrameHighWater;  // longest Spinel frame received.
+    uint32_t    mTxFrames;          // Spinel frames sent.
+    uint32_t    mTxBytes;           // Spinel bytes sent, before HDLC encoding.
+    uint32_t    mTxErrors;          // Spinel frames that failed to send.
+    uint32_t    mTxBlocked;         // TX stalls that required draining RX to make progress.
+    uint32_t    mTxFrameHighWater;  // longest Spinel frame sent.
+} thci_uart_counters_t;
+
+/**
+ * Spinel request/response statistics.
+ */
+typedef struct
+{
+    uint32_t            mTransactions;  // requests that waited for a response.
+    uint32_t            mFailures;      // requests that failed, including timeouts.
+    uint32_t            mTimeouts;      // requests that got no response.
+    thci_histogram_t    mGetLatency;    // PROP_VALUE_GET request to response, in msec.
+    thci_histogram_t    mSetLatency;    // any other request to response, in msec.
+} thci_spinel_stats_t;
+
+/**
+ * NCP IP datapath counters and TX message ring occupancy.
+ */
+typedef struct
+{
+    uint32_t    mTxPackets;         // IP packets queued for the NCP.
+    uint32_t    mTxBytes;
+    uint32_t    mTxDropNoBufs;      // IP packets dropped, TX message ring full.
+    uint32_t    mTxDropOther;       // IP packets dropped for any other reason.
+    uint32_t    mTxRejected;        // IP packets the NCP did not accept.
+    uint32_t    mRxPackets;         // IP packets delivered to LwIP.
+    uint32_t    mRxBytes;
+    uint32_t    mRxDropped;         // IP packets received from the NCP and dropped.
+    uint32_t    mTxRingUsed;        // bytes in use in the TX message ring.
+    uint32_t    mTxRingSize;        // size of the TX message ring.
+    uint32_t    mTxRingHighWater;   // highest number of bytes in use in the TX message ring.
+    uint32_t    mCallbackBuffersUsed;
+    uint32_t    mCallbackBuffersSize;
+} thci_datapath_counters_t;
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+
+/**
+ * Retrieve the NCP UART link counters.
+ */
+void thciGetUartCounters(thci_uart_counters_t *aCounters);
+
+/**
+ * Retrieve the Spinel request/response statistics.
+ */
+void thciGetSpinelStats(thci_spinel_stats_t *aStats);
+
+/**
+ * Reset the NCP UART link counters and the Spinel statistics.
+ */
+void thciResetUartCounters(void);
+
+/**
+ * Retrieve the NCP IP datapath counters.  The ring occupancy fields are
+ * sampled at the time of the call.
+ */
+void thciGetDatapathCounters(thci_datapath_counters_t *aCounters);
+
+/**
+ * Reset the NCP IP datapath counters and the TX message ring high-water.
+ */
+void thciResetDatapathCounters(void);
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+
+/**
+ * Unit, in msec, of the attach statistics histograms.  Attach and detach
+ * times run from seconds to minutes, beyond the range of a msec histogram.
+ */
+#define THCI_ATTACH_STATS_UNIT_MSEC     100
+
+/**
+ * Attach and role transition statistics.
+ *
+ * Timestamps are host times in msec.  The histograms are in units of
+ * THCI_ATTACH_STATS_UNIT_MSEC.
+ */
+typedef struct
+{
+    otDeviceRole        mRole;                      // current role.
+    bool                mStarted;                   // thciThreadStart was called and Thread was not stopped since.
+    bool                mHaveRoutableAddress;       // a routable address was seen since the last start.
+    bool                mHaveDatagram;              // a datagram was received since the last start.
+    bool                mHaveDetach;                // a transition from attached to detached was seen since the last start.
+    uint32_t            mThreadStartTime;           // last thciThreadStart.
+    uint32_t            mRoleChangeTime;            // last role transition.
+    uint32_t            mDetachTime;                // last transition from attached to detached.
+    uint32_t            mRoutableAddressTime;       // first routable address since the last start.
+    uint32_t            mDatagramTime;              // first datagram since the last start.
+    uint32_t            mRoleChanges;               // role transitions.
+    uint32_t            mAttaches;                  // transitions from detached or disabled to attached.
+    uint32_t            mDetaches;                  // transitions from attached to detached.
+    uint32_t            mFlaps;                     // role transitions within THCI_CONFIG_ROLE_FLAP_WINDOW_MSEC of the previous one.
+    thci_histogram_t    mTimeToAttach;              // start or detach to attached.
+    thci_histogram_t    mTimeToRoutableAddress;     // start to first routable address.
+    thci_histogram_t    mTimeToDatagram;            // start to first datagram.
+    thci_histogram_t    mDetachDuration;            // detached to attached again.
+    thci_histogram_t    mRoleDwell;                 // time spent in a role before leaving it.
+} thci_attach_stats_t;
+
+#if THCI_CONFIG_ATTACH_STATS
+
+void thciAttachStatsThreadStarted(bool aStarted);
+void thciAttachStatsRoleChanged(otDeviceRole aRole);
+void thciAttachStatsAddress(const otIp6Address *aAddress, const otIp6Address *aLocator);
+void thciAttachStatsDatagramReceived(void);
+
+/**
+ * Check whether an address is a Thread locator (RLOC/ALOC), whose prefix
+ * is the mesh-local prefix.
+ */
+bool thciIsLocatorAddress(const otIp6Address *aAddress);
+
+/**
+ * Check whether an address can be used beyond the Thread mesh: neither
+ * link-local nor mesh-local, which covers the locators and the ML-EID.
+ *
+ * @param[in]  aAddress   The address.
+ * @param[in]  aLocator   A locator of the interface, for its mesh-local
+ *                        prefix.  NULL when there is none, as when
+ *                        detached: no address is routable then.
+ */
+bool thciIsRoutableAddress(const otIp6Address *aAddress, const otIp6Address *aLocator);
+
+/**
+ * Retrieve the attach and role transition statistics.
+ *
+ * @param[out] aStats   The statistics.
+ */
+void thciGetAttachStats(thci_attach_stats_t *aStats);
+
+/**
+ * Reset the attach and role transition counters and histograms.  The
+ * current role and the timestamps are kept.
+ */
+void thciResetAttachStats(void);
+
+#define THCI_ATTACH_STATS_THREAD_STARTED(aStarted)  thciAttachStatsThreadStarted(aStarted)
+#define THCI_ATTACH_STATS_ROLE_CHANGED(aRole)       thciAttachStatsRoleChanged(aRole)
+#define THCI_ATTACH_STATS_ADDRESS(aAddress, aLocator) thciAttachStatsAddress(aAddress, aLocator)
+#define THCI_ATTACH_STATS_DATAGRAM_RECEIVED()       thciAttachStatsDatagramReceived()
+
+#else
+
+#define THCI_ATTACH_STATS_THREAD_STARTED(aStarted)
+#define THCI_ATTACH_STATS_ROLE_CHANGED(aRole)
+#define THCI_ATTACH_STATS_ADDRESS(aAddress, aLocator)
+#define THCI_ATTACH_STATS_DATAGRAM_RECEIVED()
+
+#endif // THCI_CONFIG_ATTACH_STATS
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif /* __THCI_STATS_H_INCLUDED__ */
@@ -29,37 +29,211 @@
 #include <nlassert.h>
 #include <nlerlog.h>
 #include <nlalignment.h>
+#include <nlertask.h>
 
 #include <thci.h>
+#include <thci_arena.h>
 #include <thci_config.h>
 #include <thci_module.h>
+#include <thci_deferred_log.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-thci_sdk_context_t gTHCISDKContext;
+struct thci_instance_s
+{
+    uint8_t mIndex;
+};
+
+#if THCI_CONFIG_MAX_INSTANCES > 1
+/**
+ * A task bound to an instance.  An entry is claimed and released by its
+ * task only, so a task looking up its own entry never races with another.
+ */
+typedef struct
+{
+    nl_task_t * volatile    mTask;
+    uint8_t                 mIndex;
+} thci_instance_binding_t;
+#endif
+
+thci_sdk_context_t gTHCISDKContexts[THCI_CONFIG_MAX_INSTANCES];
+
+static thci_instance_t sInstances[THCI_CONFIG_MAX_INSTANCES] =
+{
+    { 0 },
+#if THCI_CONFIG_MAX_INSTANCES > 1
+    { 1 },
+#endif
+#if THCI_CONFIG_MAX_INSTANCES > 2
+    { 2 },
+#endif
+#if THCI_CONFIG_MAX_INSTANCES > 3
+    { 3 },
+#endif
+};
+
+#if THCI_CONFIG_MAX_INSTANCES > 1
+static thci_instance_binding_t sBindings[THCI_CONFIG_MAX_INSTANCE_TASKS];
+
+static thci_instance_binding_t *FindBinding(nl_task_t *aTask)
+{
+    thci_instance_binding_t *retval = NULL;
+
+    for (size_t i = 0; i < THCI_CONFIG_MAX_INSTANCE_TASKS; i++)
+    {
+        if (sBindings[i].mTask == aTask)
+        {
+            retval = &sBindings[i];
+            break;
+        }
+    }
+
+    return retval;
+}
+
+uint8_t thciGetCurrentInstanceIndex(void)
+{
+    const thci_instance_binding_t *binding = FindBinding(nl_task_get_current());
+
+    return (binding != NULL) ? binding->mIndex : 0;
+}
+#endif // THCI_CONFIG_MAX_INSTANCES > 1
+
+thci_instance_t *thciGetInstance(uint8_t aIndex)
+{
+    return (aIndex < THCI_CONFIG_MAX_INSTANCES) ? &sInstances[aIndex] : NULL;
+}
+
+thci_instance_t *thciSetCurrentInstance(thci_instance_t *aInstance)
+{
+    thci_instance_t *retval = NULL;
+
+#if THCI_CONFIG_MAX_INSTANCES > 1
+    nl_task_t *task = nl_task_get_current();
+    thci_instance_binding_t *binding = FindBinding(task);
+
+    if (binding != NULL)
+    {
+        retval = &sInstances[binding->mIndex];
+
+        if (aInstance != NULL)
+        {
+            binding->mIndex = aInstance->mIndex;
+        }
+        else
+        {
+            binding->mTask = NULL;
+        }
+    }
+    else if (aInstance != NULL)
+    {
+        for (size_t i = 0; i < THCI_CONFIG_MAX_INSTANCE_TASKS; i++)
+        {
+            if (__sync_bool_compare_and_swap(&sBindings[i].mTask, NULL, task))
+            {
+                binding = &sBindings[i];
+                binding->mIndex = aInstance->mIndex;
+                break;
+            }
+        }
+
+        if (binding == NULL)
+        {
+            NL_LOG_CRIT(lrTHCI, "thciSetCurrentInstance: no free binding, increase THCI_CONFIG_MAX_INSTANCE_TASKS\n");
+        }
+    }
+#else
+    (void)aInstance;
+#endif
+
+    return retval;
+}
+
+thci_instance_t *thciGetCurrentInstance(void)
+{
+    return &sInstances[THCI_INSTANCE_INDEX()];
+}
+
+uint8_t thciGetInstanceIndex(const thci_instance_t *aInstance)
+{
+    return aInstance->mIndex;
+}
+
+thci_instance_t *thciGetNetifInstance(const struct netif *aNetif)
+{
+    thci_instance_t *retval = NULL;
+
+    for (size_t i = 0; (i < THCI_CONFIG_MAX_INSTANCES) && (retval == NULL); i++)
+    {
+        for (size_t tag = 0; tag < THCI_NETIF_TAG_COUNT; tag++)
+        {
+            if (gTHCISDKContexts[i].mNetif[tag] == aNetif)
+            {
+                retval = &sInstances[i];
+                break;
+            }
+        }
+    }
+
+    return retval;
+}
 
 /**
-* Function to initialize Thci context.
+* Function to initialize the Thci context of the current instance.
 *
 * @param[in]  aInitParams    thci_init_params_t structure that provides pointers to
 *                            queues that Thci can use to send and receive events.
 *
 * @return 0 when success.
 */
-int thciSDKInit(thci_init_params_t *aInitParams)
+static int SDKInit(thci_init_params_t *aInitParams)
 {
     int retval = 0;
 
-    nlEXPECT_ACTION(gTHCISDKContext.mState == THCI_UNINITIALIZED, done, retval = -EALREADY);
-
     /* Initialize the sdk context with the passed parameters */
     memset(&gTHCISDKContext, 0, sizeof(thci_sdk_context_t));
 
     memcpy(&gTHCISDKContext.mInitParams, aInitParams, sizeof(thci_init_params_t));
 
-    gTHCISDKContext.mState = THCI_INITIALIZED;
+    for (size_t i = 0; i < THCI_MESSAGE_QUEUE_COUNT; i++)
+    {
+        thci_message_queue_t *queue = &gTHCISDKContext.mMessageQueue[i];
+
+#if THCI_CONFIG_ARENA
+        queue->mSize = thciArenaGetProfile()->mMessageQueueSize;
+        queue->mQueue = &thciArenaGetBuffers()->mMessageQueues[i * queue->mSize];
+#else
+        queue->mSize = THCI_CONFIG_MESSAGE_QUEUE_SIZE;
+#endif
+    }
+
+#if THCI_CONFIG_DEFERRED_LOG
+    retval = thciDeferredLogInit();
+#endif
+
+    if (retval == 0)
+    {
+        gTHCISDKContext.mState = THCI_INITIALIZED;
+    }
+
+    return retval;
+}
+
+#if !THCI_CONFIG_ARENA || THCI_CONFIG_ARENA_DEFAULT_REGION
+int thciSDKInit(thci_init_params_t *aInitParams)
+{
+    int retval = 0;
+
+    nlEXPECT_ACTION(gTHCISDKContext.mState == THCI_UNINITIALIZED, done, retval = -EALREADY);
+
+#if THCI_CONFIG_ARENA
+    retval = thciArenaInitDefault();
+    nlREQUIRE(retval == 0, done);
+#endif
+
+    retval = SDKInit(aInitParams);
 
  done:
     if (retval)
@@ -69,6 +243,29 @@ int thciSDKInit(thci_init_params_t *aInitParams)
 
     return retval;
 }
+#endif // !THCI_CONFIG_ARENA || THCI_CONFIG_ARENA_DEFAULT_REGION
+
+#if THCI_CONFIG_ARENA
+int thciSDKInitWithArena(thci_init_params_t *aInitParams, void *aArena, size_t aArenaSize, const thci_arena_profile_t *aProfile)
+{
+    int retval = 0;
+
+    nlEXPECT_ACTION(gTHCISDKContext.mState == THCI_UNINITIALIZED, done, retval = -EALREADY);
+
+    retval = thciArenaInit(aArena, aArenaSize, aProfile);
+    nlREQUIRE(retval == 0, done);
+
+    retval = SDKInit(aInitParams);
+
+ done:
+    if (retval)
+    {
+        NL_LOG_CRIT(lrTHCI, "thciSDKInitWithArena failed with error = %d\n", retval);
+    }
+
+    return retval;
+}
+#endif // THCI_CONFIG_ARENA
 
 /**
  * Check if Thci was initialized.
@@ -80,30 +277,41 @@ int thciInitialized(void)
     return (gTHCISDKContext.mState == THCI_INITIALIZED);
 }
 
-otMessage* DequeueMessage(void)
+otMessage* DequeueMessage(thci_sdk_context_t *aContext, uint8_t aQueue)
 {
     otMessage* retval = NULL;
-    thci_message_queue_t *queue = &gTHCISDKContext.mMessageQueue;
+    thci_message_queue_t *queue = &aContext->mMessageQueue[aQueue];
 
     nlREQUIRE(queue->mQueue[queue->mTail] != NULL, done);
 
     retval = queue->mQueue[queue->mTail];
     queue->mQueue[queue->mTail] = NULL;
-    queue->mTail = (queue->mTail < THCI_CONFIG_MESSAGE_QUEUE_SIZE - 1) ? queue->mTail + 1 : 0;
+    queue->mTail = (queue->mTail < queue->mSize - 1) ? queue->mTail + 1 : 0;
 
  done:
     return retval;
 }
 
-int EnqueueMessage(otMessage *aMessage)
+int EnqueueMessage(thci_sdk_context_t *aContext, uint8_t aQueue, otMessage *aMessage)
 {
     int retval = -ENOSPC;
-    thci_message_queue_t *queue = &gTHCISDKContext.mMessageQueue;
+    thci_message_queue_t *queue = &aContext->mMessageQueue[aQueue];
 
     nlREQUIRE(queue->mQueue[queue->mHead] == NULL, done);
 
     queue->mQueue[queue->mHead] = aMessage;
-    queue->mHead = (queue->mHead < THCI_CONFIG_MESSAGE_QUEUE_SIZE - 1) ? queue->mHead + 1 : 0;
+    queue->mHead = (queue->mHead < queue->mSize - 1) ? queue->mHead + 1 : 0;
+
+    {
+        // The queue is full when the head catches up with the tail.
+        const uint16_t queued = (queue->mHead > queue->mTail) ? (queue->mHead - queue->mTail) :
+                                (queue->mSize - queue->mTail + queue->mHead);
+
+        if (queued > queue->mHighWater)
+        {
+            queue->mHighWater = queued;
+        }
+    }
 
     retval = 0;
 
@@ -111,9 +319,11 @@ int EnqueueMessage(otMessage *aMessage)
     return retval;
 }
 
-bool IsMessageQueueEmpty(void)
+bool IsMessageQueueEmpty(const thci_sdk_context_t *aContext, uint8_t aQueue)
 {
-    return (gTHCISDKContext.mMessageQueue.mQueue[gTHCISDKContext.mMessageQueue.mTail] == NULL);
+    const thci_message_queue_t *queue = &aContext->mMessageQueue[aQueue];
+
+    return (queue->mQueue[queue->mTail] == NULL);
 }
 
 uint16_t thciGetChecksum(const struct pbuf *q)
@@ -0,0 +1,240 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the memory arena of thci_arena.h.
+ *
+ *      The buffers are carved in order from the start of the region, each
+ *      aligned on kArenaAlignment bytes.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_ARENA
+
+#include <errno.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+
+#include <thci.h>
+#include <thci_arena.h>
+#include <thci_module.h>
+#include <thci_module_ncp.h>
+#include <thci_stats.h>
+
+#define UART_TRANSPORT          (!THCI_CONFIG_NCP_SPI && !THCI_CONFIG_NCP_SHM)
+
+#define kArenaAlignment         8
+
+// The UART fifo, as sized without THCI_CONFIG_ARENA.
+#if THCI_CONFIG_POSIX_TTY
+#define kDefaultRxFifoSize      2048
+#else
+#define kDefaultRxFifoSize      128
+#endif
+
+#define ARENA_ALIGN(_size)      (((_size) + kArenaAlignment - 1) & ~(kArenaAlignment - 1))
+
+// thciArenaGetSize() of the default profile, as a constant.
+#if UART_TRANSPORT
+#define kDefaultUartSize        (ARENA_ALIGN(THCI_ARENA_UART_TX_SIZE(THCI_NCP_DEFAULT_MAX_FRAME_SIZE)) + \
+                                 ARENA_ALIGN(THCI_CONFIG_UART_RX_BUFFER_SIZE) + \
+                                 ARENA_ALIGN(kDefaultRxFifoSize))
+#else
+#define kDefaultUartSize        0
+#endif
+
+#define kDefaultArenaSize       (ARENA_ALIGN(THCI_CONFIG_NCP_TX_MESSAGE_RING_BUFFER_SIZE) + \
+                                 ARENA_ALIGN(THCI_MESSAGE_QUEUE_COUNT * THCI_CONFIG_MESSAGE_QUEUE_SIZE * sizeof(otMessage *)) + \
+                                 ARENA_ALIGN(THCI_NCP_DEFAULT_MAX_FRAME_SIZE) + \
+                                 kDefaultUartSize + kArenaAlignment - 1)
+
+// Below these, frames of the NCP's version and capabilities do not fit.
+#define kMinFrameSize           256
+#define kMinRxFifoSize          16
+
+typedef struct
+{
+    uint8_t                 *mBase;         // NULL before thciArenaInit().
+    uint32_t                mSize;
+    uint32_t                mUsed;
+    thci_arena_profile_t    mProfile;
+    thci_arena_buffers_t    mBuffers;
+} thci_arena_t;
+
+static thci_arena_t sArenas[THCI_CONFIG_MAX_INSTANCES];
+
+#define sArena (sArenas[THCI_INSTANCE_INDEX()])
+
+#if THCI_CONFIG_ARENA_DEFAULT_REGION
+static uint8_t sDefaultRegions[THCI_CONFIG_MAX_INSTANCES][kDefaultArenaSize];
+#endif
+
+static size_t ArenaAlign(size_t aSize)
+{
+    return (aSize + kArenaAlignment - 1) & ~(size_t)(kArenaAlignment - 1);
+}
+
+static void *ArenaCarve(thci_arena_t *aArena, size_t aSize)
+{
+    void *retval = aArena->mBase + aArena->mUsed;
+
+    aArena->mUsed += ArenaAlign(aSize);
+
+    return retval;
+}
+
+static bool IsProfileValid(const thci_arena_profile_t *aProfile)
+{
+    bool retval = false;
+
+    nlREQUIRE(aProfile->mTxRingSize > 0, done);
+    nlREQUIRE(aProfile->mMessageQueueSize > 0, done);
+    nlREQUIRE(aProfile->mTxFrameSize >= kMinFrameSize, done);
+    nlREQUIRE(THCI_ARENA_ENCODED_FRAME_SIZE(aProfile->mTxFrameSize) <= UINT16_MAX, done);
+#if UART_TRANSPORT
+    nlREQUIRE(aProfile->mRxFrameSize >= kMinFrameSize, done);
+    nlREQUIRE(aProfile->mRxFifoSize >= kMinRxFifoSize, done);
+#endif
+
+    retval = true;
+
+ done:
+    return retval;
+}
+
+void thciArenaGetDefaultProfile(thci_arena_profile_t *aProfile)
+{
+    aProfile->mTxRingSize = THCI_CONFIG_NCP_TX_MESSAGE_RING_BUFFER_SIZE;
+    aProfile->mMessageQueueSize = THCI_CONFIG_MESSAGE_QUEUE_SIZE;
+    aProfile->mTxFrameSize = THCI_NCP_DEFAULT_MAX_FRAME_SIZE;
+    aProfile->mRxFrameSize = THCI_CONFIG_UART_RX_BUFFER_SIZE;
+    aProfile->mRxFifoSize = kDefaultRxFifoSize;
+}
+
+size_t thciArenaGetSize(const thci_arena_profile_t *aProfile)
+{
+    size_t retval;
+
+    retval = ArenaAlign(aProfile->mTxRingSize);
+    retval += ArenaAlign(THCI_MESSAGE_QUEUE_COUNT * aProfile->mMessageQueueSize * sizeof(otMessage *));
+    retval += ArenaAlign(aProfile->mTxFrameSize);
+#if UART_TRANSPORT
+    retval += ArenaAlign(THCI_ARENA_UART_TX_SIZE(aProfile->mTxFrameSize));
+    retval += ArenaAlign(aProfile->mRxFrameSize);
+    retval += ArenaAlign(aProfile->mRxFifoSize);
+#endif
+
+    // The region may not be aligned.
+    return retval + kArenaAlignment - 1;
+}
+
+int thciArenaInit(void *aArena, size_t aArenaSize, const thci_arena_profile_t *aProfile)
+{
+    thci_arena_t *arena = &sArena;
+    thci_arena_profile_t profile;
+    int retval = 0;
+
+    if (aProfile == NULL)
+    {
+        thciArenaGetDefaultProfile(&profile);
+        aProfile = &profile;
+    }
+
+    // The buffers are in use by the modules.
+    nlREQUIRE_ACTION(arena->mBase == NULL, done, retval = -EALREADY);
+
+    nlREQUIRE_ACTION(aArena != NULL && IsProfileValid(aProfile), done, retval = -EINVAL;
+                     NL_LOG_CRIT(lrTHCI, "%s: invalid profile\n", __FUNCTION__));
+    nlREQUIRE_ACTION(aArenaSize >= thciArenaGetSize(aProfile), done, retval = -ENOMEM;
+                     NL_LOG_CRIT(lrTHCI, "%s: %u bytes, %u needed\n", __FUNCTION__,
+                                 (unsigned int)aArenaSize, (unsigned int)thciArenaGetSize(aProfile)));
+
+    memcpy(&arena->mProfile, aProfile, sizeof(arena->mProfile));
+    arena->mBase = (uint8_t *)ArenaAlign((uintptr_t)aArena);
+    arena->mSize = aArenaSize;
+    arena->mUsed = arena->mBase - (uint8_t *)aArena;
+
+    arena->mBuffers.mTxRing = (uint8_t *)ArenaCarve(arena, aProfile->mTxRingSize);
+    arena->mBuffers.mMessageQueues = (otMessage **)ArenaCarve(arena, THCI_MESSAGE_QUEUE_COUNT * aProfile->mMessageQueueSize * sizeof(otMessage *));
+    arena->mBuffers.mTxFrame = (uint8_t *)ArenaCarve(arena, aProfile->mTxFrameSize);
+#if UART_TRANSPORT
+    arena->mBuffers.mTxFrames = (uint8_t *)ArenaCarve(arena, THCI_ARENA_UART_TX_SIZE(aProfile->mTxFrameSize));
+    arena->mBuffers.mRxFrame = (uint8_t *)ArenaCarve(arena, aProfile->mRxFrameSize);
+    arena->mBuffers.mRxFifo = (uint8_t *)ArenaCarve(arena, aProfile->mRxFifoSize);
+#else
+    arena->mBuffers.mTxFrames = NULL;
+    arena->mBuffers.mRxFrame = NULL;
+    arena->mBuffers.mRxFifo = NULL;
+#endif
+
+    memset(arena->mBuffers.mMessageQueues, 0, THCI_MESSAGE_QUEUE_COUNT * aProfile->mMessageQueueSize * sizeof(otMessage *));
+
+ done:
+    return retval;
+}
+
+#if THCI_CONFIG_ARENA_DEFAULT_REGION
+int thciArenaInitDefault(void)
+{
+    return thciArenaInit(sDefaultRegions[THCI_INSTANCE_INDEX()], sizeof(sDefaultRegions[0]), NULL);
+}
+#endif
+
+const thci_arena_profile_t *thciArenaGetProfile(void)
+{
+    return &sArena.mProfile;
+}
+
+const thci_arena_buffers_t *thciArenaGetBuffers(void)
+{
+    return (sArena.mBase != NULL) ? &sArena.mBuffers : NULL;
+}
+
+void thciGetArenaUsage(thci_arena_usage_t *aUsage)
+{
+    thci_datapath_counters_t datapath;
+    thci_uart_counters_t uart;
+
+    memset(aUsage, 0, sizeof(*aUsage));
+
+    aUsage->mSize = sArena.mSize;
+    aUsage->mUsed = sArena.mUsed;
+    memcpy(&aUsage->mProfile, &sArena.mProfile, sizeof(aUsage->mProfile));
+
+    thciGetDatapathCounters(&datapath);
+    aUsage->mTxRingHighWater = datapath.mTxRingHighWater;
+
+    for (size_t i = 0; i < THCI_MESSAGE_QUEUE_COUNT; i++)
+    {
+        if (gTHCISDKContext.mMessageQueue[i].mHighWater > aUsage->mMessageQueueHighWater)
+        {
+            aUsage->mMessageQueueHighWater = gTHCISDKContext.mMessageQueue[i].mHighWater;
+        }
+    }
+
+    thciGetUartCounters(&uart);
+    aUsage->mTxFrameHighWater = uart.mTxFrameHighWater;
+    aUsage->mRxFrameHighWater = uart.mRxFrameHighWater;
+    aUsage->mRxFifoHighWater = uart.mRxFifoHighWater;
+}
+
+#endif // THCI_CONFIG_ARENA
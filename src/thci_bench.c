@@ -0,0 +1,283 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the THCI traffic generator.
+ *
+ *      The generator uses the LwIP netconn API, so it can run from any
+ *      task other than the LwIP and THCI tasks, which must keep running to
+ *      carry the traffic.  Sending and receiving are interleaved on the
+ *      calling task: between two sends the task waits for replies until
+ *      the next send is due.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_BENCH
+
+#include <errno.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlplatform/nltime.h>
+
+#include <lwip/api.h>
+#include <lwip/ip6.h>
+#include <lwip/ip_addr.h>
+
+#include <thci.h>
+#include <thci_bench.h>
+
+#define kBenchMagic             0x4243484e  // "NHCB"
+#define kBenchHeaderSize        12
+#define kIcmp6HeaderSize        8
+#define kIp6HeaderSize          40
+#define kIcmp6EchoRequest       128
+#define kIcmp6EchoReply         129
+#define kBenchIcmpIdentifier    0x7468
+
+typedef struct
+{
+    uint32_t    mMagic;
+    uint32_t    mSequence;
+    uint32_t    mSendTime;
+} bench_header_t;
+
+static uint8_t sTxBuffer[kIcmp6HeaderSize + THCI_CONFIG_BENCH_MAX_SIZE];
+static uint8_t sRxBuffer[kIp6HeaderSize + kIcmp6HeaderSize + THCI_CONFIG_BENCH_MAX_SIZE];
+// One bit per sequence number, set when its reply is received.
+static uint32_t sReceived[(THCI_CONFIG_BENCH_MAX_PACKETS + 31) / 32];
+
+static uint32_t Now(void)
+{
+    return (uint32_t)nltime_get_system_ms();
+}
+
+static struct netconn *OpenConnection(const thci_bench_config_t *aConfig)
+{
+    struct netconn *retval = NULL;
+
+    if (aConfig->mProto == kThciBenchProtoUdp)
+    {
+        retval = netconn_new(NETCONN_UDP_IPV6);
+        nlREQUIRE(retval != NULL, done);
+
+        if (netconn_bind(retval, IP6_ADDR_ANY, 0) != ERR_OK)
+        {
+            netconn_delete(retval);
+            retval = NULL;
+        }
+    }
+#if LWIP_RAW
+    else
+    {
+        // LwIP fills in the ICMPv6 checksum for raw ICMPv6 connections.
+        retval = netconn_new_with_proto_and_callback(NETCONN_RAW_IPV6, IP6_NEXTH_ICMP6, NULL);
+    }
+#endif
+
+ done:
+    return retval;
+}
+
+static err_t SendPacket(struct netconn *aConn, const thci_bench_config_t *aConfig, const ip_addr_t *aPeer, uint32_t aSequence)
+{
+    bench_header_t header;
+    struct netbuf *buf;
+    uint8_t *payload = sTxBuffer;
+    uint16_t length = aConfig->mSize;
+    err_t retval = ERR_MEM;
+
+    if (aConfig->mProto == kThciBenchProtoIcmp)
+    {
+        sTxBuffer[0] = kIcmp6EchoRequest;
+        sTxBuffer[1] = 0;
+        sTxBuffer[2] = 0;   // checksum
+        sTxBuffer[3] = 0;
+        sTxBuffer[4] = (uint8_t)(kBenchIcmpIdentifier >> 8);
+        sTxBuffer[5] = (uint8_t)kBenchIcmpIdentifier;
+        sTxBuffer[6] = (uint8_t)(aSequence >> 8);
+        sTxBuffer[7] = (uint8_t)aSequence;
+
+        payload += kIcmp6HeaderSize;
+        length += kIcmp6HeaderSize;
+    }
+
+    header.mMagic = kBenchMagic;
+    header.mSequence = aSequence;
+    header.mSendTime = Now();
+    memcpy(payload, &header, sizeof(header));
+
+    buf = netbuf_new();
+    nlREQUIRE(buf != NULL, done);
+
+    retval = netbuf_ref(buf, sTxBuffer, length);
+
+    if (retval == ERR_OK)
+    {
+        retval = netconn_sendto(aConn, buf, aPeer, aConfig->mPort);
+    }
+
+    netbuf_delete(buf);
+
+ done:
+    return retval;
+}
+
+static void ReceivePacket(struct netconn *aConn, const thci_bench_config_t *aConfig, uint32_t aSent,
+                          uint32_t aTimeout, thci_bench_result_t *aResult, uint32_t *aLastReply)
+{
+    struct netbuf *buf = NULL;
+    bench_header_t header;
+    const uint8_t *payload = sRxBuffer;
+    uint16_t length;
+
+    netconn_set_recvtimeout(aConn, (aTimeout > 0) ? aTimeout : 1);
+
+    nlREQUIRE(netconn_recv(aConn, &buf) == ERR_OK, done);
+
+    length = netbuf_copy(buf, sRxBuffer, sizeof(sRxBuffer));
+
+    if (aConfig->mProto == kThciBenchProtoIcmp)
+    {
+        // Raw IPv6 connections may deliver the IPv6 header.
+        if (length >= kIp6HeaderSize && (sRxBuffer[0] >> 4) == 6)
+        {
+            payload += kIp6HeaderSize;
+            length -= kIp6HeaderSize;
+        }
+
+        nlREQUIRE_ACTION(length >= kIcmp6HeaderSize && payload[0] == kIcmp6EchoReply, done, aResult->mInvalid++);
+
+        payload += kIcmp6HeaderSize;
+        length -= kIcmp6HeaderSize;
+    }
+
+    nlREQUIRE_ACTION(length >= sizeof(header), done, aResult->mInvalid++);
+
+    memcpy(&header, payload, sizeof(header));
+    nlREQUIRE_ACTION(header.mMagic == kBenchMagic && header.mSequence < aSent, done, aResult->mInvalid++);
+
+    // e.g. a frame duplicated on the link; its round trip is not a new sample.
+    nlREQUIRE_ACTION(!(sReceived[header.mSequence / 32] & (1U << (header.mSequence % 32))), done, aResult->mDuplicates++);
+    sReceived[header.mSequence / 32] |= (1U << (header.mSequence % 32));
+
+    *aLastReply = Now();
+    thciHistogramAdd(&aResult->mRtt, *aLastReply - header.mSendTime);
+    aResult->mReceived++;
+
+ done:
+    if (buf)
+    {
+        netbuf_delete(buf);
+    }
+}
+
+int thciBenchRun(const thci_bench_config_t *aConfig, thci_bench_result_t *aResult)
+{
+    int retval = 0;
+    struct netconn *conn = NULL;
+    ip_addr_t peer;
+    uint32_t start;
+    uint32_t now;
+    uint32_t nextSend;
+    uint32_t lastReply = 0;
+    uint32_t elapsed;
+
+    nlREQUIRE_ACTION(aConfig != NULL && aResult != NULL, done, retval = -EINVAL);
+    nlREQUIRE_ACTION(aConfig->mSize >= kBenchHeaderSize && aConfig->mSize <= THCI_CONFIG_BENCH_MAX_SIZE, done, retval = -EINVAL);
+    nlREQUIRE_ACTION(aConfig->mRate > 0 && aConfig->mDuration > 0, done, retval = -EINVAL);
+    // A packet is sent at the start, then every 1/mRate sec.
+    nlREQUIRE_ACTION(((uint64_t)aConfig->mRate * aConfig->mDuration) / 1000 < THCI_CONFIG_BENCH_MAX_PACKETS, done, retval = -EINVAL);
+#if !LWIP_RAW
+    nlREQUIRE_ACTION(aConfig->mProto == kThciBenchProtoUdp, done, retval = -ENOTSUP);
+#endif
+
+    memset(aResult, 0, sizeof(*aResult));
+    memset(sReceived, 0, sizeof(sReceived));
+
+    for (size_t i = kBenchHeaderSize; i < THCI_CONFIG_BENCH_MAX_SIZE; i++)
+    {
+        sTxBuffer[kIcmp6HeaderSize + i] = (uint8_t)i;
+    }
+
+    ip_addr_copy_from_ip6(peer, aConfig->mPeer);
+
+    conn = OpenConnection(aConfig);
+    nlREQUIRE_ACTION(conn != NULL, done, retval = -ENOMEM);
+
+    start = nextSend = Now();
+
+    while (true)
+    {
+        now = Now();
+
+        if (now - start < aConfig->mDuration)
+        {
+            if ((int32_t)(now - nextSend) >= 0)
+            {
+                if (SendPacket(conn, aConfig, &peer, aResult->mSent) == ERR_OK)
+                {
+                    aResult->mSent++;
+                }
+                else
+                {
+                    aResult->mSendErrors++;
+                }
+
+                // Schedule from the start time so that rounding does not accumulate.
+                nextSend = start + (uint32_t)(((uint64_t)(aResult->mSent + aResult->mSendErrors) * 1000) / aConfig->mRate);
+                continue;
+            }
+
+            ReceivePacket(conn, aConfig, aResult->mSent, nextSend - now, aResult, &lastReply);
+        }
+        else
+        {
+            const uint32_t deadline = start + aConfig->mDuration + aConfig->mLinger;
+
+            if ((int32_t)(now - deadline) >= 0 || aResult->mReceived >= aResult->mSent)
+            {
+                break;
+            }
+
+            ReceivePacket(conn, aConfig, aResult->mSent, deadline - now, aResult, &lastReply);
+        }
+    }
+
+    elapsed = ((lastReply && lastReply - start > aConfig->mDuration) ? lastReply : Now()) - start;
+    aResult->mElapsed = elapsed;
+
+    if (elapsed)
+    {
+        aResult->mTxBitsPerSec = (uint32_t)(((uint64_t)aResult->mSent * aConfig->mSize * 8 * 1000) / aConfig->mDuration);
+        aResult->mRxBitsPerSec = (uint32_t)(((uint64_t)aResult->mReceived * aConfig->mSize * 8 * 1000) / elapsed);
+    }
+
+ done:
+    if (conn)
+    {
+        netconn_delete(conn);
+    }
+
+    return retval;
+}
+
+#endif // THCI_CONFIG_BENCH
@@ -22,91 +22,53 @@
  *
  */
 
+#include <string.h>
+
 #include <thci.h>
 #include <thci_cert.h>
+#include <thci_fault.h>
 #include <nlassert.h>
 
-#include <lwip/pbuf.h>
-
-static size_t s_tx_corrupted_bits = 0;
-static size_t s_rx_corrupted_bits = 0;
+// Corruption starts past the IPv6 header.
+#define kCertSkipBytes      40
+#define kCertMaxBits        3
 
-static void thci_cert_pbuf_bit_flip(struct pbuf *buff, size_t offset)
+/* The corruption runs in the fault injection engine: each packet of the
+ * stream gets exactly corrupted_bits distinct bit flips from the seeded
+ * stream generator, so a run can be reproduced with thciFaultSeed().
+ */
+static void thci_cert_set_corrupt_bits(thci_fault_stream_t stream, size_t corrupted_bits)
 {
-    size_t bit_offset = offset & 0x07; //offset % 8
-    size_t byte_offset = offset >> 3; //offset / 8
+    thci_fault_config_t config;
 
-    bool flipped = false;
+    memset(&config, 0, sizeof(config));
 
-    while (buff)
+    if (corrupted_bits > 0)
     {
-        if (buff->len > byte_offset)
-        {
-            uint8_t *payload = (uint8_t *)buff->payload;
-            payload[byte_offset] ^= 0x01 << bit_offset;
-
-            break;
-        }
-        else
-        {
-            byte_offset -= buff->len;
-            buff = buff->next;
-        }
+        config.mProbability[kThciFaultActionBitFlip] = THCI_FAULT_PROBABILITY_MAX;
+        config.mSkipBytes = kCertSkipBytes;
+        config.mBitFlips = (uint8_t)corrupted_bits;
     }
 
+    thciFaultConfigure(stream, &config);
 }
 
-static void thci_cert_pbuf_corrupt(struct pbuf *buff, size_t bits)
+void thci_cert_set_tx_corrupt_bits(size_t corrupted_bits)
 {
-    size_t flipped[3];
-    int i = 0;
-
-    nlREQUIRE(buff != NULL, done);
-    nlREQUIRE(bits <= 3, done);
+    nlREQUIRE(corrupted_bits <= kCertMaxBits, done);
 
-    while (i < bits)
-    {
-        // Skip the IPv6 header, start corruption at byte 41
-        size_t offset = rand() % ((buff->tot_len - 40) << 3);
-        offset += 40 << 3;
-
-        for (int j = 0; j < i; j++)
-        {
-            if (flipped[j] == offset)
-            {
-                // If we already used this offset, try again
-                continue;
-            }
-        }
-
-        thci_cert_pbuf_bit_flip(buff, offset);
-
-        flipped[i] = offset;
-        i++;
-    }
+    thci_cert_set_corrupt_bits(kThciFaultStreamIpTx, corrupted_bits);
 
 done:
     return;
 }
 
-void thci_cert_set_tx_corrupt_bits(size_t corrupted_bits)
-{
-    s_tx_corrupted_bits = corrupted_bits;
-}
-
 void thci_cert_set_rx_corrupt_bits(size_t corrupted_bits)
 {
-    s_rx_corrupted_bits = corrupted_bits;
-}
+    nlREQUIRE(corrupted_bits <= kCertMaxBits, done);
 
-void thci_cert_tx_corrupt(struct pbuf *buff)
-{
-    NL_LOG_CRIT(lrTHCI, "s_tx_corrupted_bits %d\n", s_tx_corrupted_bits);
-    thci_cert_pbuf_corrupt(buff, s_tx_corrupted_bits);
-}
+    thci_cert_set_corrupt_bits(kThciFaultStreamIpRx, corrupted_bits);
 
-void thci_cert_rx_corrupt(struct pbuf *buff)
-{
-    NL_LOG_CRIT(lrTHCI, "s_rx_corrupted_bits %d\n", s_rx_corrupted_bits);
-    thci_cert_pbuf_corrupt(buff, s_rx_corrupted_bits);
+done:
+    return;
 }
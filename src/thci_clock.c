@@ -0,0 +1,348 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the host/NCP clock correlation.
+ *
+ *      Both clocks are free running 32-bit millisecond counters, so all
+ *      differences are taken modulo 2^32 and interpreted as signed.
+ *
+ *      Every frame from the NCP is stamped here, and ticks the resync: a
+ *      sample is posted to the THCI task once the last one is
+ *      THCI_CONFIG_NCP_CLOCK_SYNC_INTERVAL old.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_CLOCK_SYNC
+
+#include <errno.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlerlock.h>
+#include <nlerevent.h>
+#include <nlplatform/nltime.h>
+
+#include <thci.h>
+#include <thci_clock.h>
+#include <thci_module.h>
+#include <thci_stats.h>
+
+typedef struct
+{
+    uint32_t    mHostTime;  // host time half way through the exchange.
+    int32_t     mOffset;    // NCP time minus mHostTime.
+    uint32_t    mRtt;       // round trip of the exchange.
+} thci_clock_sample_t;
+
+typedef struct
+{
+    thci_clock_sample_t         mSamples[THCI_CONFIG_NCP_CLOCK_SAMPLES];
+    uint8_t                     mNext;      // index of the next sample to write.
+    uint8_t                     mCount;     // number of valid samples.
+    nl_lock_t                   mLock;
+    uint32_t                    mNextSync;  // host time of the next sample.
+    volatile uint32_t           mEventPosted;
+    thciFrameTimestampObserver  mObserver;
+    void                        *mObserverContext;
+} thci_clock_context_t;
+
+static int ClockSyncEventHandler(nl_event_t *aEvent, void *aClosure);
+
+// Each NCP has its own clock.
+static thci_clock_context_t sClocks[THCI_CONFIG_MAX_INSTANCES];
+
+#define sClock                          (sClocks[THCI_INSTANCE_INDEX()])
+
+static const nl_event_t sClockSyncEvent =
+{
+    NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), ClockSyncEventHandler, NULL)
+};
+
+static uint32_t Now(void)
+{
+    return (uint32_t)nltime_get_system_ms();
+}
+
+static const thci_clock_sample_t *GetSample(uint8_t aAge)
+{
+    // aAge 0 is the oldest sample.
+    return &sClock.mSamples[(sClock.mNext + THCI_CONFIG_NCP_CLOCK_SAMPLES - sClock.mCount + aAge) % THCI_CONFIG_NCP_CLOCK_SAMPLES];
+}
+
+static const thci_clock_sample_t *GetBestSample(uint8_t aFirst, uint8_t aLast)
+{
+    const thci_clock_sample_t *best = NULL;
+    uint8_t i;
+
+    for (i = aFirst; i < aLast; i++)
+    {
+        const thci_clock_sample_t *sample = GetSample(i);
+
+        // on equal round trips prefer the newer sample.
+        if (best == NULL || sample->mRtt <= best->mRtt)
+        {
+            best = sample;
+        }
+    }
+
+    return best;
+}
+
+static bool Estimate(thci_ncp_clock_t *aClock)
+{
+    const thci_clock_sample_t *reference;
+    const thci_clock_sample_t *older;
+    const thci_clock_sample_t *newer;
+    int32_t span;
+    bool retval = false;
+
+    nlREQUIRE(sClock.mCount > 0, done);
+
+    reference = GetBestSample(0, sClock.mCount);
+
+    aClock->mHostTime = reference->mHostTime;
+    aClock->mOffset = reference->mOffset;
+    // Both clocks tick in whole msec, which adds up to 1 msec of uncertainty.
+    aClock->mError = (reference->mRtt / 2) + 1;
+    aClock->mDriftPpm = 0;
+    aClock->mDriftErrorPpm = THCI_CONFIG_NCP_CLOCK_MAX_DRIFT_PPM;
+    aClock->mSamples = sClock.mCount;
+
+    retval = true;
+
+    nlREQUIRE(sClock.mCount >= 2, done);
+
+    older = GetBestSample(0, sClock.mCount / 2);
+    newer = GetBestSample(sClock.mCount / 2, sClock.mCount);
+    span = (int32_t)(newer->mHostTime - older->mHostTime);
+
+    if (span > 0)
+    {
+        uint32_t driftError = (uint32_t)(((uint64_t)((older->mRtt + newer->mRtt) / 2 + 1) * 1000000) / (uint32_t)span);
+
+        // Only trust the drift once the samples are far enough apart for it
+        // to be better than the crystal tolerance.
+        if (driftError < THCI_CONFIG_NCP_CLOCK_MAX_DRIFT_PPM)
+        {
+            aClock->mDriftPpm = (int32_t)(((int64_t)(newer->mOffset - older->mOffset) * 1000000) / span);
+            aClock->mDriftErrorPpm = driftError;
+        }
+    }
+
+ done:
+    return retval;
+}
+
+static int32_t OffsetAt(const thci_ncp_clock_t *aClock, uint32_t aHostTime, uint32_t *aError)
+{
+    int32_t elapsed = (int32_t)(aHostTime - aClock->mHostTime);
+    uint32_t distance = (elapsed < 0) ? (uint32_t)(-elapsed) : (uint32_t)elapsed;
+
+    if (aError)
+    {
+        *aError = aClock->mError + (uint32_t)(((uint64_t)distance * aClock->mDriftErrorPpm) / 1000000);
+    }
+
+    return aClock->mOffset + (int32_t)(((int64_t)elapsed * aClock->mDriftPpm) / 1000000);
+}
+
+int thciNcpClockInit(void)
+{
+    int retval = 0;
+
+    if (sClock.mLock == NULL)
+    {
+        sClock.mLock = nl_er_lock_create();
+        nlREQUIRE_ACTION(sClock.mLock != NULL, done, retval = -ENOMEM);
+    }
+
+    thciNcpClockReset();
+
+ done:
+    return retval;
+}
+
+void thciNcpClockReset(void)
+{
+    nlREQUIRE(sClock.mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(sClock.mLock) == 0, done);
+
+    sClock.mNext = 0;
+    sClock.mCount = 0;
+    // Resync on the next frame.
+    sClock.mNextSync = Now();
+
+    nl_er_lock_exit(sClock.mLock);
+
+ done:
+    return;
+}
+
+void thciNcpClockAddSample(uint32_t aHostSend, uint32_t aNcpTime, uint32_t aHostReceive)
+{
+    thci_clock_sample_t *sample;
+    const uint32_t rtt = aHostReceive - aHostSend;
+
+    nlREQUIRE(sClock.mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(sClock.mLock) == 0, done);
+
+    sample = &sClock.mSamples[sClock.mNext];
+    sample->mHostTime = aHostSend + (rtt / 2);
+    sample->mOffset = (int32_t)(aNcpTime - sample->mHostTime);
+    sample->mRtt = rtt;
+
+    sClock.mNext = (sClock.mNext + 1) % THCI_CONFIG_NCP_CLOCK_SAMPLES;
+
+    if (sClock.mCount < THCI_CONFIG_NCP_CLOCK_SAMPLES)
+    {
+        sClock.mCount++;
+    }
+
+    nl_er_lock_exit(sClock.mLock);
+
+ done:
+    return;
+}
+
+bool thciNcpClockGet(thci_ncp_clock_t *aClock)
+{
+    bool retval = false;
+
+    nlREQUIRE(sClock.mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(sClock.mLock) == 0, done);
+
+    retval = Estimate(aClock);
+
+    nl_er_lock_exit(sClock.mLock);
+
+ done:
+    return retval;
+}
+
+bool thciNcpTimeToHost(uint32_t aNcpTime, uint32_t *aHostTime, uint32_t *aError)
+{
+    thci_ncp_clock_t clock;
+    bool retval;
+
+    retval = thciNcpClockGet(&clock);
+    nlREQUIRE(retval, done);
+
+    // Apply the drift at the host time estimated without it; the second
+    // order term is far below a msec.
+    *aHostTime = aNcpTime - (uint32_t)OffsetAt(&clock, aNcpTime - (uint32_t)clock.mOffset, NULL);
+    (void)OffsetAt(&clock, *aHostTime, aError);
+
+ done:
+    return retval;
+}
+
+bool thciHostTimeToNcp(uint32_t aHostTime, uint32_t *aNcpTime, uint32_t *aError)
+{
+    thci_ncp_clock_t clock;
+    bool retval;
+
+    retval = thciNcpClockGet(&clock);
+    nlREQUIRE(retval, done);
+
+    *aNcpTime = aHostTime + (uint32_t)OffsetAt(&clock, aHostTime, aError);
+
+ done:
+    return retval;
+}
+
+static void PostClockSyncEvent(void)
+{
+    nlREQUIRE(gTHCISDKContext.mInitParams.mSdkQueue != NULL, done);
+
+    if (!__sync_fetch_and_or(&sClock.mEventPosted, 1))
+    {
+        THCI_EVENT_STATS_POSTED(kThciEventClockSync);
+        nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sClockSyncEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventClockSync);
+    }
+
+ done:
+    return;
+}
+
+static int ClockSyncEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    const uint32_t previous = sClock.mNextSync;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventClockSync);
+
+    sClock.mEventPosted = 0;
+
+    // Frames received during the exchange must not post it again.
+    sClock.mNextSync = Now() + THCI_CONFIG_NCP_CLOCK_SYNC_INTERVAL;
+
+    if (thciSyncNcpClock() == OT_ERROR_INVALID_STATE)
+    {
+        // Not initialized yet, or the NCP is being recovered.
+        sClock.mNextSync = previous;
+    }
+
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventClockSync);
+
+    return NLER_SUCCESS;
+}
+
+void thciNcpClockTick(void)
+{
+    if ((sClock.mLock != NULL) && ((int32_t)(Now() - sClock.mNextSync) >= 0))
+    {
+        PostClockSyncEvent();
+    }
+}
+
+void thciNcpClockFrameReceived(const uint8_t *aFrame, uint16_t aLength)
+{
+    const thciFrameTimestampObserver observer = sClock.mObserver;
+    thci_frame_timestamp_t timestamp;
+
+    if (observer)
+    {
+        timestamp.mHostTime = Now();
+        timestamp.mNcpTimeValid = thciHostTimeToNcp(timestamp.mHostTime, &timestamp.mNcpTime, &timestamp.mNcpTimeError);
+
+        if (!timestamp.mNcpTimeValid)
+        {
+            timestamp.mNcpTime = 0;
+            timestamp.mNcpTimeError = 0;
+        }
+
+        observer(aFrame, aLength, &timestamp, sClock.mObserverContext);
+    }
+
+    thciNcpClockTick();
+}
+
+void thciNcpSetFrameTimestampObserver(thciFrameTimestampObserver aObserver, void *aContext)
+{
+    sClock.mObserver = aObserver;
+    sClock.mObserverContext = aContext;
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_CLOCK_SYNC
@@ -0,0 +1,826 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the THCI daemon.
+ *
+ *      The polling task owns the sockets: it accepts, reads and closes
+ *      them.  The THCI task takes the queued requests, sends them to the
+ *      NCP and writes the responses and notifications.  The client table is
+ *      protected by a lock; a client's generation changes when it closes,
+ *      so that a response to a closed client is not sent to the next one in
+ *      its slot.  When the THCI task frees room in a full queue it wakes the
+ *      polling task through a pipe, so that the client is read again.
+ *
+ *      A message the socket of a client has no room for is queued, and the
+ *      polling task sends it when the socket is writable; the THCI task
+ *      wakes it so that it polls for that.  A client whose socket fails, or
+ *      whose queue overflows, is closed: it never misses a message silently.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DAEMON
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlerlock.h>
+#include <nlerevent.h>
+
+#include <openthread/spinel.h>
+
+#include <thci.h>
+#include <thci_daemon.h>
+#include <thci_module.h>
+#include <thci_stats.h>
+
+// Message type, Spinel header, and packed command and key of a response.
+#define kDaemonMessageOverhead      8
+
+typedef struct
+{
+    uint16_t                mLength;
+    uint8_t                 mBuffer[THCI_CONFIG_DAEMON_MAX_MESSAGE];
+} thci_daemon_message_t;
+
+typedef struct
+{
+    int                     mFd;                // -1 when the slot is free.
+    uint32_t                mGeneration;
+    thci_daemon_message_t   mRequests[THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH];   // Spinel frames.
+    uint8_t                 mHead;              // oldest queued request.
+    uint8_t                 mCount;
+    spinel_prop_key_t       mSubscriptions[THCI_CONFIG_DAEMON_MAX_SUBSCRIPTIONS];
+    uint8_t                 mNumSubscriptions;
+    thci_daemon_message_t   mOutput[THCI_CONFIG_DAEMON_CLIENT_OUTPUT_DEPTH];    // messages the socket had no room for.
+    uint8_t                 mOutHead;           // oldest queued message.
+    uint8_t                 mOutCount;
+} thci_daemon_client_t;
+
+/**
+ * A request taken from a client and sent to the NCP.
+ */
+typedef struct
+{
+    uint8_t                 mClient;
+    uint32_t                mGeneration;
+    uint8_t                 mHeader;            // of the request, for its response.
+    thci_daemon_message_t   mRequest;
+    uint8_t                 mResponse[THCI_CONFIG_DAEMON_MAX_MESSAGE - kDaemonMessageOverhead];
+} thci_daemon_pending_t;
+
+typedef struct
+{
+    bool                    mStarted;
+    int                     mListenFd;
+    int                     mWakeFds[2];        // read and write ends of the wake-up pipe.
+    char                    mPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    thci_daemon_client_t    mClients[THCI_CONFIG_DAEMON_MAX_CLIENTS];
+    uint8_t                 mNextClient;        // client served first in the next batch.
+    nl_eventqueue_t         mSdkQueue;
+    nl_lock_t               mLock;
+    volatile uint32_t       mEventPosted;
+    thci_daemon_stats_t     mStats;
+} thci_daemon_context_t;
+
+/**
+ * PROTOTYPES
+ */
+
+static int DaemonEventHandler(nl_event_t *aEvent, void *aClosure);
+
+/**
+ * GLOBALS
+ */
+
+static thci_daemon_context_t sDaemon;
+
+// Only used on the THCI task.
+static thci_daemon_pending_t sPending[THCI_CONFIG_DAEMON_PIPELINE_DEPTH];
+static thci_raw_request_t sRawRequests[THCI_CONFIG_DAEMON_PIPELINE_DEPTH];
+static uint8_t sTxMessage[THCI_CONFIG_DAEMON_MAX_MESSAGE];
+
+static const nl_event_t sDaemonEvent =
+{
+    NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), DaemonEventHandler, NULL)
+};
+
+static void PostDaemonEvent(void)
+{
+    if (!__sync_fetch_and_or(&sDaemon.mEventPosted, 1))
+    {
+        THCI_EVENT_STATS_POSTED(kThciEventDaemon);
+        nl_eventqueue_post_event(sDaemon.mSdkQueue, &sDaemonEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventDaemon);
+    }
+}
+
+static void WakePoll(void)
+{
+    const uint8_t byte = 0;
+
+    (void)write(sDaemon.mWakeFds[1], &byte, sizeof(byte));
+}
+
+// A SOCK_SEQPACKET socket takes a message whole or not at all.
+static bool WouldBlock(ssize_t aSent)
+{
+    return (aSent < 0) && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+static void CloseClient(thci_daemon_client_t *aClient)
+{
+    close(aClient->mFd);
+
+    sDaemon.mStats.mSendDrops += aClient->mOutCount;
+
+    aClient->mFd = -1;
+    aClient->mGeneration++;
+    aClient->mHead = 0;
+    aClient->mCount = 0;
+    aClient->mNumSubscriptions = 0;
+    aClient->mOutHead = 0;
+    aClient->mOutCount = 0;
+
+    sDaemon.mStats.mClients--;
+}
+
+/**
+ * Sends a message to a client, or queues it after the messages the socket
+ * has not taken yet.  Closes the client when its socket fails or its queue
+ * is full.  Called on the THCI task with the lock held.
+ *
+ * @retval false when the client was closed.
+ */
+static bool SendMessage(thci_daemon_client_t *aClient, const uint8_t *aMessage, size_t aLength)
+{
+    thci_daemon_message_t *output;
+    ssize_t sent = -1;
+    bool retval = false;
+
+    if (aClient->mOutCount == 0)
+    {
+        sent = send(aClient->mFd, aMessage, aLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+        nlREQUIRE(sent == (ssize_t)aLength || WouldBlock(sent), fail);
+    }
+
+    if (sent != (ssize_t)aLength)
+    {
+        nlREQUIRE(aClient->mOutCount < THCI_CONFIG_DAEMON_CLIENT_OUTPUT_DEPTH, fail);
+
+        output = &aClient->mOutput[(aClient->mOutHead + aClient->mOutCount) % THCI_CONFIG_DAEMON_CLIENT_OUTPUT_DEPTH];
+        output->mLength = aLength;
+        memcpy(output->mBuffer, aMessage, aLength);
+
+        // The polling task waits for room in the socket from now on.
+        if (aClient->mOutCount++ == 0)
+        {
+            WakePoll();
+        }
+
+        sDaemon.mStats.mSendDeferred++;
+    }
+
+    retval = true;
+
+ fail:
+    if (!retval)
+    {
+        sDaemon.mStats.mSendDrops++;
+        CloseClient(aClient);
+        WakePoll();
+    }
+
+    return retval;
+}
+
+/**
+ * Sends the queued messages of a client that its socket has room for.
+ * Called on the polling task with the lock held.
+ *
+ * @retval false when the socket failed.
+ */
+static bool FlushOutput(thci_daemon_client_t *aClient)
+{
+    bool retval = true;
+
+    while (aClient->mOutCount > 0)
+    {
+        const thci_daemon_message_t *output = &aClient->mOutput[aClient->mOutHead];
+        const ssize_t sent = send(aClient->mFd, output->mBuffer, output->mLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (sent != (ssize_t)output->mLength)
+        {
+            retval = WouldBlock(sent);
+            break;
+        }
+
+        aClient->mOutHead = (aClient->mOutHead + 1) % THCI_CONFIG_DAEMON_CLIENT_OUTPUT_DEPTH;
+        aClient->mOutCount--;
+    }
+
+    return retval;
+}
+
+static int FindSubscription(const thci_daemon_client_t *aClient, spinel_prop_key_t aKey)
+{
+    int retval = -1;
+
+    for (uint8_t i = 0; i < aClient->mNumSubscriptions; i++)
+    {
+        if (aClient->mSubscriptions[i] == aKey)
+        {
+            retval = i;
+            break;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * Handles a message received from a client.  Called on the polling task
+ * with the lock held.
+ *
+ * @retval true when a request was queued.
+ */
+static bool HandleClientMessage(thci_daemon_client_t *aClient, const uint8_t *aMessage, size_t aLength)
+{
+    spinel_ssize_t parsedLength;
+    spinel_prop_key_t key;
+    uint8_t header;
+    unsigned int command;
+    const uint8_t *value;
+    unsigned int valueLength;
+    int index;
+    bool retval = false;
+
+    nlREQUIRE_ACTION(aLength > 1, done, sDaemon.mStats.mInvalid++);
+
+    switch (aMessage[0])
+    {
+    case kThciDaemonMsgRequest:
+        {
+            thci_daemon_message_t *request;
+
+            parsedLength = spinel_datatype_unpack(aMessage + 1, aLength - 1, "CiiD", &header, &command, &key, &value, &valueLength);
+            nlREQUIRE_ACTION(parsedLength == (spinel_ssize_t)(aLength - 1), done, sDaemon.mStats.mInvalid++);
+
+            // The client is not read while its queue is full.
+            nlREQUIRE_ACTION(aClient->mCount < THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH, done, sDaemon.mStats.mInvalid++);
+
+            request = &aClient->mRequests[(aClient->mHead + aClient->mCount) % THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH];
+            request->mLength = aLength - 1;
+            memcpy(request->mBuffer, aMessage + 1, request->mLength);
+
+            aClient->mCount++;
+            retval = true;
+        }
+        break;
+
+    case kThciDaemonMsgSubscribe:
+    case kThciDaemonMsgUnsubscribe:
+        parsedLength = spinel_datatype_unpack(aMessage + 1, aLength - 1, SPINEL_DATATYPE_UINT_PACKED_S, &key);
+        nlREQUIRE_ACTION(parsedLength == (spinel_ssize_t)(aLength - 1), done, sDaemon.mStats.mInvalid++);
+
+        index = FindSubscription(aClient, key);
+
+        if (aMessage[0] == kThciDaemonMsgSubscribe && index < 0)
+        {
+            nlREQUIRE_ACTION(aClient->mNumSubscriptions < THCI_CONFIG_DAEMON_MAX_SUBSCRIPTIONS, done, sDaemon.mStats.mInvalid++);
+
+            aClient->mSubscriptions[aClient->mNumSubscriptions++] = key;
+        }
+        else if (aMessage[0] == kThciDaemonMsgUnsubscribe && index >= 0)
+        {
+            aClient->mSubscriptions[index] = aClient->mSubscriptions[--aClient->mNumSubscriptions];
+        }
+        break;
+
+    default:
+        sDaemon.mStats.mInvalid++;
+        break;
+    }
+
+ done:
+    return retval;
+}
+
+/**
+ * Takes up to THCI_CONFIG_DAEMON_PIPELINE_DEPTH queued requests, one per
+ * client in turn, starting after the client served last.  Called on the
+ * THCI task with the lock held.
+ *
+ * @param[out] aWake    Set when a full queue was drained.
+ *
+ * @retval the number of requests taken.
+ */
+static uint8_t TakeRequests(bool *aWake)
+{
+    const uint8_t first = sDaemon.mNextClient;
+    uint8_t count = 0;
+    bool taken = true;
+
+    while (taken && count < THCI_CONFIG_DAEMON_PIPELINE_DEPTH)
+    {
+        taken = false;
+
+        for (uint8_t i = 0; i < THCI_CONFIG_DAEMON_MAX_CLIENTS && count < THCI_CONFIG_DAEMON_PIPELINE_DEPTH; i++)
+        {
+            const uint8_t index = (first + i) % THCI_CONFIG_DAEMON_MAX_CLIENTS;
+            thci_daemon_client_t *client = &sDaemon.mClients[index];
+            thci_daemon_pending_t *pending = &sPending[count];
+            thci_raw_request_t *raw = &sRawRequests[count];
+            unsigned int command;
+            const uint8_t *value;
+            unsigned int valueLength;
+
+            if (client->mFd < 0 || client->mCount == 0)
+            {
+                continue;
+            }
+
+            pending->mClient = index;
+            pending->mGeneration = client->mGeneration;
+            pending->mRequest = client->mRequests[client->mHead];
+
+            *aWake |= (client->mCount == THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH);
+
+            client->mHead = (client->mHead + 1) % THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH;
+            client->mCount--;
+
+            // Checked when queued.
+            (void)spinel_datatype_unpack(pending->mRequest.mBuffer, pending->mRequest.mLength, "CiiD",
+                                         &pending->mHeader, &command, &raw->mKey, &value, &valueLength);
+
+            raw->mCommand = command;
+            raw->mValue = value;
+            raw->mValueLength = valueLength;
+            raw->mResponse = pending->mResponse;
+            raw->mResponseSize = sizeof(pending->mResponse);
+
+            sDaemon.mNextClient = (index + 1) % THCI_CONFIG_DAEMON_MAX_CLIENTS;
+            sDaemon.mStats.mRequests++;
+
+            count++;
+            taken = true;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Answers a request, with a LAST_STATUS when the NCP did not.  Called on
+ * the THCI task with the lock held.
+ */
+static void SendResponse(const thci_daemon_pending_t *aPending, const thci_raw_request_t *aRaw)
+{
+    thci_daemon_client_t *client = &sDaemon.mClients[aPending->mClient];
+    const thci_raw_request_t *raw = aRaw;
+    spinel_ssize_t length;
+    spinel_status_t status;
+
+    nlREQUIRE(client->mFd >= 0 && client->mGeneration == aPending->mGeneration, done);
+
+    sTxMessage[0] = kThciDaemonMsgResponse;
+
+    if (raw->mError == OT_ERROR_NONE || raw->mError == OT_ERROR_FAILED)
+    {
+        length = spinel_datatype_pack(sTxMessage + 1, sizeof(sTxMessage) - 1, "CiiD",
+                                      aPending->mHeader, raw->mResponseCommand, raw->mResponseKey,
+                                      raw->mResponse, raw->mResponseLength);
+    }
+    else
+    {
+        status = (raw->mError == OT_ERROR_NOT_IMPLEMENTED) ? SPINEL_STATUS_INVALID_COMMAND : SPINEL_STATUS_FAILURE;
+
+        length = spinel_datatype_pack(sTxMessage + 1, sizeof(sTxMessage) - 1, "Cii" SPINEL_DATATYPE_UINT_PACKED_S,
+                                      aPending->mHeader, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_LAST_STATUS, status);
+    }
+
+    nlREQUIRE(length > 0 && (size_t)length < sizeof(sTxMessage), done);
+
+    (void)SendMessage(client, sTxMessage, length + 1);
+
+ done:
+    return;
+}
+
+static int DaemonEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    otError error;
+    uint8_t count = 0;
+    bool wake = false;
+    bool more = false;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventDaemon);
+
+    sDaemon.mEventPosted = 0;
+
+    nlREQUIRE(nl_er_lock_enter(sDaemon.mLock) == 0, done);
+
+    if (sDaemon.mStarted)
+    {
+        count = TakeRequests(&wake);
+    }
+
+    nl_er_lock_exit(sDaemon.mLock);
+
+    nlREQUIRE(count > 0, done);
+
+    // The NCP is used without the lock, so that clients can still be read.
+    error = thciNcpRawTransact(sRawRequests, count);
+
+    nlREQUIRE(nl_er_lock_enter(sDaemon.mLock) == 0, done);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (error != OT_ERROR_NONE)
+        {
+            sRawRequests[i].mError = error;
+        }
+
+        SendResponse(&sPending[i], &sRawRequests[i]);
+    }
+
+    for (uint8_t i = 0; i < THCI_CONFIG_DAEMON_MAX_CLIENTS && !more; i++)
+    {
+        more = (sDaemon.mClients[i].mFd >= 0 && sDaemon.mClients[i].mCount > 0);
+    }
+
+    if (wake && sDaemon.mStarted)
+    {
+        WakePoll();
+    }
+
+    nl_er_lock_exit(sDaemon.mLock);
+
+    // Let the other THCI events run between batches.
+    if (more)
+    {
+        PostDaemonEvent();
+    }
+
+ done:
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventDaemon);
+
+    return NLER_SUCCESS;
+}
+
+/**
+ * Sends an unsolicited NCP frame to the clients subscribed to its key.
+ * Called on the THCI task.
+ */
+static void ObserveFrame(uint32_t aCommand, spinel_prop_key_t aKey, const uint8_t *aValue, uint16_t aLength, void *aContext)
+{
+    spinel_ssize_t length = 0;
+
+    (void)aContext;
+
+    nlREQUIRE(nl_er_lock_enter(sDaemon.mLock) == 0, done);
+
+    for (uint8_t i = 0; i < THCI_CONFIG_DAEMON_MAX_CLIENTS && sDaemon.mStarted; i++)
+    {
+        thci_daemon_client_t *client = &sDaemon.mClients[i];
+
+        if (client->mFd < 0 || FindSubscription(client, aKey) < 0)
+        {
+            continue;
+        }
+
+        if (length == 0)
+        {
+            sTxMessage[0] = kThciDaemonMsgNotify;
+            length = spinel_datatype_pack(sTxMessage + 1, sizeof(sTxMessage) - 1, "CiiD",
+                                          SPINEL_HEADER_FLAG, aCommand, aKey, aValue, aLength);
+
+            if (length <= 0 || (size_t)length >= sizeof(sTxMessage))
+            {
+                sDaemon.mStats.mSendDrops++;
+                length = -1;
+            }
+        }
+
+        if (length > 0 && SendMessage(client, sTxMessage, length + 1))
+        {
+            sDaemon.mStats.mNotifications++;
+        }
+    }
+
+    nl_er_lock_exit(sDaemon.mLock);
+
+ done:
+    return;
+}
+
+/**
+ * Closes the sockets and the wake-up pipe.  Called with the lock held.
+ */
+static void CloseAll(void)
+{
+    for (uint8_t i = 0; i < THCI_CONFIG_DAEMON_MAX_CLIENTS; i++)
+    {
+        if (sDaemon.mClients[i].mFd >= 0)
+        {
+            CloseClient(&sDaemon.mClients[i]);
+        }
+    }
+
+    if (sDaemon.mListenFd >= 0)
+    {
+        close(sDaemon.mListenFd);
+        unlink(sDaemon.mPath);
+        sDaemon.mListenFd = -1;
+    }
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        if (sDaemon.mWakeFds[i] >= 0)
+        {
+            close(sDaemon.mWakeFds[i]);
+            sDaemon.mWakeFds[i] = -1;
+        }
+    }
+
+    sDaemon.mStarted = false;
+}
+
+int thciDaemonStart(const char *aPath)
+{
+    struct sockaddr_un address;
+    int retval = 0;
+
+    nlREQUIRE_ACTION(aPath != NULL && strlen(aPath) < sizeof(address.sun_path), done, retval = -EINVAL);
+    nlREQUIRE_ACTION(gTHCISDKContext.mInitParams.mSdkQueue != NULL, done, retval = -ENXIO);
+
+    if (sDaemon.mLock == NULL)
+    {
+        sDaemon.mLock = nl_er_lock_create();
+        nlREQUIRE_ACTION(sDaemon.mLock != NULL, done, retval = -ENOMEM);
+    }
+
+    nlREQUIRE_ACTION(nl_er_lock_enter(sDaemon.mLock) == 0, done, retval = -EIO);
+    nlREQUIRE_ACTION(!sDaemon.mStarted, unlock, retval = -EALREADY);
+
+    memset(sDaemon.mClients, 0, sizeof(sDaemon.mClients));
+    memset(&sDaemon.mStats, 0, sizeof(sDaemon.mStats));
+
+    for (uint8_t i = 0; i < THCI_CONFIG_DAEMON_MAX_CLIENTS; i++)
+    {
+        sDaemon.mClients[i].mFd = -1;
+    }
+
+    sDaemon.mNextClient = 0;
+    sDaemon.mSdkQueue = gTHCISDKContext.mInitParams.mSdkQueue;
+    sDaemon.mStarted = true;
+    sDaemon.mListenFd = -1;
+    sDaemon.mWakeFds[0] = -1;
+    sDaemon.mWakeFds[1] = -1;
+
+    nlREQUIRE_ACTION(pipe(sDaemon.mWakeFds) == 0, fail, retval = -errno);
+    nlREQUIRE_ACTION(fcntl(sDaemon.mWakeFds[0], F_SETFL, O_NONBLOCK) == 0, fail, retval = -errno);
+    nlREQUIRE_ACTION(fcntl(sDaemon.mWakeFds[1], F_SETFL, O_NONBLOCK) == 0, fail, retval = -errno);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, aPath);
+    strcpy(sDaemon.mPath, aPath);
+
+    sDaemon.mListenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    nlREQUIRE_ACTION(sDaemon.mListenFd >= 0, fail, retval = -errno);
+
+    // A socket file left by a previous run would make bind() fail.
+    (void)unlink(aPath);
+
+    nlREQUIRE_ACTION(bind(sDaemon.mListenFd, (const struct sockaddr *)&address, sizeof(address)) == 0, fail, retval = -errno);
+    nlREQUIRE_ACTION(listen(sDaemon.mListenFd, THCI_CONFIG_DAEMON_MAX_CLIENTS) == 0, fail, retval = -errno);
+
+    NL_LOG_CRIT(lrTHCI, "THCI daemon listening on %s\n", aPath);
+
+ fail:
+    if (retval != 0)
+    {
+        CloseAll();
+    }
+
+ unlock:
+    nl_er_lock_exit(sDaemon.mLock);
+
+    if (retval == 0)
+    {
+        thciNcpSetRawFrameObserver(ObserveFrame, NULL);
+    }
+
+ done:
+    return retval;
+}
+
+void thciDaemonStop(void)
+{
+    nlREQUIRE(sDaemon.mLock != NULL, done);
+
+    thciNcpSetRawFrameObserver(NULL, NULL);
+
+    nlREQUIRE(nl_er_lock_enter(sDaemon.mLock) == 0, done);
+
+    if (sDaemon.mStarted)
+    {
+        CloseAll();
+    }
+
+    nl_er_lock_exit(sDaemon.mLock);
+
+ done:
+    return;
+}
+
+static void AcceptClient(void)
+{
+    const int fd = accept(sDaemon.mListenFd, NULL, NULL);
+    thci_daemon_client_t *client = NULL;
+
+    nlREQUIRE(fd >= 0, done);
+
+    for (uint8_t i = 0; i < THCI_CONFIG_DAEMON_MAX_CLIENTS; i++)
+    {
+        if (sDaemon.mClients[i].mFd < 0)
+        {
+            client = &sDaemon.mClients[i];
+            break;
+        }
+    }
+
+    nlREQUIRE_ACTION(client != NULL, done, close(fd); sDaemon.mStats.mRejected++);
+
+    client->mFd = fd;
+    client->mHead = 0;
+    client->mCount = 0;
+    client->mNumSubscriptions = 0;
+    client->mOutHead = 0;
+    client->mOutCount = 0;
+
+    sDaemon.mStats.mAccepted++;
+    sDaemon.mStats.mClients++;
+
+ done:
+    return;
+}
+
+int thciDaemonPoll(int aTimeoutMsec)
+{
+    struct pollfd fds[2 + THCI_CONFIG_DAEMON_MAX_CLIENTS];
+    int8_t clients[2 + THCI_CONFIG_DAEMON_MAX_CLIENTS];
+    uint32_t generations[2 + THCI_CONFIG_DAEMON_MAX_CLIENTS];
+    uint8_t message[THCI_CONFIG_DAEMON_MAX_MESSAGE];
+    nfds_t count = 0;
+    bool queued = false;
+    int retval = 0;
+
+    nlREQUIRE_ACTION(sDaemon.mLock != NULL && sDaemon.mStarted, done, retval = -ENOTCONN);
+    nlREQUIRE_ACTION(nl_er_lock_enter(sDaemon.mLock) == 0, done, retval = -EIO);
+
+    fds[count].fd = sDaemon.mListenFd;
+    fds[count].events = POLLIN;
+    clients[count++] = -1;
+
+    fds[count].fd = sDaemon.mWakeFds[0];
+    fds[count].events = POLLIN;
+    clients[count++] = -1;
+
+    for (uint8_t i = 0; i < THCI_CONFIG_DAEMON_MAX_CLIENTS; i++)
+    {
+        const thci_daemon_client_t *client = &sDaemon.mClients[i];
+
+        if (client->mFd >= 0)
+        {
+            // A client with a full queue is not read until it drains.
+            fds[count].fd = client->mFd;
+            fds[count].events = (client->mCount < THCI_CONFIG_DAEMON_CLIENT_QUEUE_DEPTH) ? POLLIN : 0;
+            fds[count].events |= (client->mOutCount > 0) ? POLLOUT : 0;
+            generations[count] = client->mGeneration;
+            clients[count++] = i;
+        }
+    }
+
+    nl_er_lock_exit(sDaemon.mLock);
+
+    if (poll(fds, count, aTimeoutMsec) < 0)
+    {
+        retval = (errno == EINTR) ? 0 : -errno;
+        goto done;
+    }
+
+    nlREQUIRE_ACTION(nl_er_lock_enter(sDaemon.mLock) == 0, done, retval = -EIO);
+
+    // thciDaemonStop() closed the sockets during the poll.
+    nlREQUIRE_ACTION(sDaemon.mStarted, unlock, retval = -ENOTCONN);
+
+    if (fds[1].revents & POLLIN)
+    {
+        while (read(sDaemon.mWakeFds[0], message, sizeof(message)) > 0)
+        {
+            continue;
+        }
+    }
+
+    for (nfds_t i = 2; i < count; i++)
+    {
+        thci_daemon_client_t *client = &sDaemon.mClients[clients[i]];
+        ssize_t length;
+
+        // The THCI task closed the client during the poll.
+        if (client->mFd != fds[i].fd || client->mGeneration != generations[i])
+        {
+            continue;
+        }
+
+        if ((fds[i].revents & POLLOUT) && !FlushOutput(client))
+        {
+            CloseClient(client);
+            continue;
+        }
+
+        if (fds[i].revents & POLLIN)
+        {
+            length = recv(client->mFd, message, sizeof(message), MSG_DONTWAIT);
+
+            if (length > 0)
+            {
+                queued |= HandleClientMessage(client, message, length);
+                continue;
+            }
+
+            if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            {
+                continue;
+            }
+        }
+        else if (!(fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)))
+        {
+            continue;
+        }
+
+        CloseClient(client);
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+        AcceptClient();
+    }
+
+ unlock:
+    nl_er_lock_exit(sDaemon.mLock);
+
+    if (queued)
+    {
+        PostDaemonEvent();
+    }
+
+ done:
+    return retval;
+}
+
+void thciDaemonGetStats(thci_daemon_stats_t *aStats)
+{
+    memset(aStats, 0, sizeof(*aStats));
+
+    nlREQUIRE(sDaemon.mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(sDaemon.mLock) == 0, done);
+
+    *aStats = sDaemon.mStats;
+
+    nl_er_lock_exit(sDaemon.mLock);
+
+ done:
+    return;
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DAEMON
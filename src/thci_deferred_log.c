@@ -0,0 +1,287 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements deferred, binary encoded logging for THCI's
+ *      hot-path log sites.
+ *
+ *      Records are stored in a ring of 32-bit words.  Each record is a
+ *      timestamp word, a word holding the format id and argument count,
+ *      followed by the raw argument words.  Records that do not fit are
+ *      dropped and counted rather than overwriting older records, so an
+ *      exported log never contains a partially overwritten record.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_DEFERRED_LOG
+
+#include <errno.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlerlock.h>
+#include <nlerevent.h>
+#include <nlplatform/nltime.h>
+
+#include <lwip/ip6.h>
+#include <lwip/ip6_addr.h>
+
+#include <thci.h>
+#include <thci_deferred_log.h>
+#include <thci_module.h>
+#include <thci_stats.h>
+
+#define kRingWords          (THCI_CONFIG_DEFERRED_LOG_RING_SIZE / sizeof(uint32_t))
+#define kHeaderWords        2
+// Records rendered per flush event, so that a full ring does not hold the
+// THCI task for long.
+#define kFlushBatch         8
+
+typedef struct
+{
+    uint32_t            mRing[kRingWords];
+    uint32_t            mHead;          // free running write index, in words.
+    uint32_t            mTail;          // free running read index, in words.
+    nl_lock_t           mLock;
+    thci_log_stats_t    mStats;
+#if THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH
+    volatile uint32_t   mEventPosted;
+#endif
+} thci_deferred_log_context_t;
+
+static thci_deferred_log_context_t sDeferredLogs[THCI_CONFIG_MAX_INSTANCES];
+
+#define sDeferredLog                    (sDeferredLogs[THCI_INSTANCE_INDEX()])
+
+#if THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH
+static int FlushEventHandler(nl_event_t *aEvent, void *aClosure);
+
+static const nl_event_t sFlushEvent =
+{
+    NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), FlushEventHandler, NULL)
+};
+#endif
+
+static const char *const kIpDirection[kThciLogIdCount] =
+{
+    [kThciLogIdIpTx] = "TX",
+    [kThciLogIdIpRx] = "RX",
+};
+
+int thciDeferredLogInit(void)
+{
+    int retval = 0;
+
+    if (sDeferredLog.mLock == NULL)
+    {
+        sDeferredLog.mLock = nl_er_lock_create();
+        nlREQUIRE_ACTION(sDeferredLog.mLock != NULL, done, retval = -ENOMEM);
+
+        sDeferredLog.mHead = sDeferredLog.mTail = 0;
+        memset(&sDeferredLog.mStats, 0, sizeof(sDeferredLog.mStats));
+    }
+
+ done:
+    return retval;
+}
+
+#if THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH
+static void PostFlushEvent(void)
+{
+    if (!__sync_fetch_and_or(&sDeferredLog.mEventPosted, 1))
+    {
+        THCI_EVENT_STATS_POSTED(kThciEventLogFlush);
+        nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sFlushEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventLogFlush);
+    }
+}
+#endif
+
+void thciDeferredLog(thci_log_id_t aId, const uint32_t *aArgs, uint8_t aArgCount)
+{
+    thci_deferred_log_context_t *context = &sDeferredLog;
+    const uint32_t timestamp = (uint32_t)nltime_get_system_ms();
+    uint32_t used;
+    uint8_t i;
+
+    nlREQUIRE(context->mLock != NULL, done);
+    nlREQUIRE(aArgCount <= THCI_DEFERRED_LOG_MAX_ARGS, done);
+    nlREQUIRE(nl_er_lock_enter(context->mLock) == 0, done);
+
+    used = context->mHead - context->mTail;
+
+    nlREQUIRE_ACTION(used + kHeaderWords + aArgCount <= kRingWords, unlock, context->mStats.mDropped++);
+
+    context->mRing[context->mHead++ % kRingWords] = timestamp;
+    context->mRing[context->mHead++ % kRingWords] = ((uint32_t)aId << 16) | aArgCount;
+
+    for (i = 0; i < aArgCount; i++)
+    {
+        context->mRing[context->mHead++ % kRingWords] = aArgs[i];
+    }
+
+    used += kHeaderWords + aArgCount;
+
+    if (used * sizeof(uint32_t) > context->mStats.mHighWater)
+    {
+        context->mStats.mHighWater = used * sizeof(uint32_t);
+    }
+
+    context->mStats.mRecorded++;
+
+ unlock:
+    nl_er_lock_exit(context->mLock);
+
+#if THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH
+    PostFlushEvent();
+#endif
+
+ done:
+    return;
+}
+
+void thciDeferredLogIp6(thci_log_id_t aId, const struct ip6_hdr *aHeader, uint16_t aLength, bool aSecure, uint16_t aChecksum)
+{
+    uint32_t args[10];
+
+    args[0] = aLength | (aSecure ? THCI_DEFERRED_LOG_IP_FLAG_SECURE : 0);
+    args[1] = aChecksum;
+    memcpy(&args[2], &aHeader->src, sizeof(uint32_t) * 4);
+    memcpy(&args[6], &aHeader->dest, sizeof(uint32_t) * 4);
+
+    thciDeferredLog(aId, args, sizeof(args) / sizeof(args[0]));
+}
+
+bool thciDeferredLogRead(thci_log_record_t *aRecord)
+{
+    thci_deferred_log_context_t *context = &sDeferredLog;
+    bool retval = false;
+    uint32_t word;
+    uint8_t i;
+
+    nlREQUIRE(context->mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(context->mLock) == 0, done);
+
+    nlREQUIRE(context->mHead != context->mTail, unlock);
+
+    aRecord->mTimestamp = context->mRing[context->mTail++ % kRingWords];
+    word = context->mRing[context->mTail++ % kRingWords];
+    aRecord->mId = (uint16_t)(word >> 16);
+    aRecord->mArgCount = (uint8_t)word;
+
+    for (i = 0; i < aRecord->mArgCount; i++)
+    {
+        aRecord->mArgs[i] = context->mRing[context->mTail++ % kRingWords];
+    }
+
+    retval = true;
+
+ unlock:
+    nl_er_lock_exit(context->mLock);
+
+ done:
+    return retval;
+}
+
+static void RenderRecord(const thci_log_record_t *aRecord)
+{
+    switch (aRecord->mId)
+    {
+    case kThciLogIdIpTx:
+    case kThciLogIdIpRx:
+        {
+            ip6_addr_t addr;
+
+            NL_LOG_DEBUG(lrTHCI, "[%u] IP %s len: %u secure: %s cksum: 0x%04x\n",
+                         aRecord->mTimestamp,
+                         kIpDirection[aRecord->mId],
+                         aRecord->mArgs[0] & 0xffff,
+                         (aRecord->mArgs[0] & THCI_DEFERRED_LOG_IP_FLAG_SECURE) ? "yes" : "no",
+                         aRecord->mArgs[1]);
+
+            memset(&addr, 0, sizeof(addr));
+            memcpy(addr.addr, &aRecord->mArgs[2], sizeof(addr.addr));
+            NL_LOG_DEBUG(lrTHCI, "from: %s\n", ip6addr_ntoa(&addr));  // IPv6 Header Source
+
+            memcpy(addr.addr, &aRecord->mArgs[6], sizeof(addr.addr));
+            NL_LOG_DEBUG(lrTHCI, "  to: %s\n", ip6addr_ntoa(&addr));  // IPv6 Header Destination
+        }
+        break;
+
+    case kThciLogIdOpenPort:
+        NL_LOG_DEBUG(lrTHCI, "[%u] Open Port %u\n", aRecord->mTimestamp, aRecord->mArgs[0]);
+        break;
+
+    default:
+        NL_LOG_DEBUG(lrTHCI, "[%u] unknown deferred log id %u (%u args)\n", aRecord->mTimestamp, aRecord->mId, aRecord->mArgCount);
+        break;
+    }
+}
+
+size_t thciDeferredLogFlush(size_t aMaxRecords)
+{
+    thci_log_record_t record;
+    size_t count = 0;
+
+    while ((aMaxRecords == 0 || count < aMaxRecords) && thciDeferredLogRead(&record))
+    {
+        RenderRecord(&record);
+        count++;
+    }
+
+    return count;
+}
+
+#if THCI_CONFIG_DEFERRED_LOG_AUTO_FLUSH
+// Renders on the THCI task, ahead of the events posted after it.  Off by
+// default: the application drains the ring from a low priority task with
+// thciDeferredLogFlush() instead, so that formatting never delays frames.
+static int FlushEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    (void)aEvent;
+    (void)aClosure;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventLogFlush);
+
+    sDeferredLog.mEventPosted = 0;
+
+    // The rest of a full ring is left to the next event, behind the events
+    // posted meanwhile.
+    if ((thciDeferredLogFlush(kFlushBatch) == kFlushBatch) && (sDeferredLog.mHead != sDeferredLog.mTail))
+    {
+        PostFlushEvent();
+    }
+
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventLogFlush);
+
+    return 0;
+}
+#endif
+
+void thciDeferredLogGetStats(thci_log_stats_t *aStats)
+{
+    memcpy(aStats, &sDeferredLog.mStats, sizeof(*aStats));
+}
+
+#endif // THCI_CONFIG_DEFERRED_LOG
@@ -0,0 +1,598 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the THCI fault injection engine.
+ *
+ *      Each unit (packet, frame or byte) gets at most one of drop, duplicate,
+ *      delay and reorder, rolled in that order, and then, unless dropped,
+ *      truncate and bitflip.  Only the actions with a non zero probability
+ *      draw from the stream generator.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_FAULT_INJECTION
+
+#include <errno.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlerlock.h>
+#include <nlplatform/nltime.h>
+
+#include <thci.h>
+#include <thci_fault.h>
+
+#define kActionMask(aAction)    (1 << (aAction))
+
+#define kIpActions              (kActionMask(kThciFaultActionDrop)      | \
+                                 kActionMask(kThciFaultActionDuplicate) | \
+                                 kActionMask(kThciFaultActionDelay)     | \
+                                 kActionMask(kThciFaultActionReorder)   | \
+                                 kActionMask(kThciFaultActionTruncate)  | \
+                                 kActionMask(kThciFaultActionBitFlip))
+#define kFrameActions           (kIpActions & ~kActionMask(kThciFaultActionReorder))
+#define kByteActions            (kActionMask(kThciFaultActionDrop)      | \
+                                 kActionMask(kThciFaultActionDuplicate) | \
+                                 kActionMask(kThciFaultActionBitFlip))
+
+typedef struct
+{
+    thci_fault_config_t mConfig;
+    thci_fault_stats_t  mStats;
+    uint32_t            mState;         // xorshift32 state, never 0 once seeded.
+    struct pbuf        *mHeld;          // ip streams: packet held by a delay or reorder.
+    struct netif       *mHeldNetif;
+    uint32_t            mHeldUntil;     // release time of a delayed packet.
+    bool                mHeldReorder;   // mHeld is released right after the next packet.
+} thci_fault_stream_context_t;
+
+typedef struct
+{
+    thci_fault_stream_context_t mStreams[kThciFaultStreamCount];
+    uint32_t                    mSeed;
+    nl_lock_t                   mLock;      // protects the held packets.
+    bool                        mInOutput;  // thciFaultOutput is sending, bypass the hook.
+} thci_fault_context_t;
+
+volatile uint8_t gThciFaultActiveStreams = 0;
+
+static thci_fault_context_t sFault;
+
+static const uint8_t kSupportedActions[kThciFaultStreamCount] =
+{
+    kIpActions, kIpActions, kFrameActions, kFrameActions, kByteActions, kByteActions
+};
+
+static const char * const kStreamNames[kThciFaultStreamCount] =
+{
+    "ip_tx", "ip_rx", "frame_tx", "frame_rx", "byte_tx", "byte_rx"
+};
+
+static const char * const kActionNames[kThciFaultActionCount] =
+{
+    "drop", "duplicate", "delay", "reorder", "truncate", "bitflip"
+};
+
+static uint32_t Now(void)
+{
+    return (uint32_t)nltime_get_system_ms();
+}
+
+static void SeedStream(thci_fault_stream_t aStream)
+{
+    // splitmix32 of the seed and the stream, so that streams are independent.
+    uint32_t z = sFault.mSeed + ((uint32_t)aStream + 1) * 0x9e3779b9;
+
+    z = (z ^ (z >> 16)) * 0x85ebca6b;
+    z = (z ^ (z >> 13)) * 0xc2b2ae35;
+    z ^= z >> 16;
+
+    sFault.mStreams[aStream].mState = (z != 0) ? z : 0x6d2b79f5;
+}
+
+static thci_fault_stream_context_t *GetStream(thci_fault_stream_t aStream)
+{
+    if (sFault.mStreams[aStream].mState == 0)
+    {
+        SeedStream(aStream);
+    }
+
+    return &sFault.mStreams[aStream];
+}
+
+static uint32_t Random(thci_fault_stream_context_t *aContext)
+{
+    uint32_t x = aContext->mState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    aContext->mState = x;
+
+    return x;
+}
+
+static bool Roll(thci_fault_stream_context_t *aContext, thci_fault_action_t aAction)
+{
+    const uint32_t probability = aContext->mConfig.mProbability[aAction];
+    bool hit = false;
+
+    if (probability != 0)
+    {
+        hit = ((Random(aContext) % THCI_FAULT_PROBABILITY_MAX) < probability);
+
+        if (hit)
+        {
+            aContext->mStats.mInjected[aAction]++;
+        }
+    }
+
+    return hit;
+}
+
+// Returns the action applied to the unit as a whole, or kThciFaultActionCount.
+static thci_fault_action_t RollDisposition(thci_fault_stream_context_t *aContext, bool aCanHold)
+{
+    thci_fault_action_t retval = kThciFaultActionCount;
+
+    if (Roll(aContext, kThciFaultActionDrop))
+    {
+        retval = kThciFaultActionDrop;
+    }
+    else if (Roll(aContext, kThciFaultActionDuplicate))
+    {
+        retval = kThciFaultActionDuplicate;
+    }
+    else if (aCanHold && Roll(aContext, kThciFaultActionDelay))
+    {
+        retval = kThciFaultActionDelay;
+    }
+    else if (aCanHold && Roll(aContext, kThciFaultActionReorder))
+    {
+        retval = kThciFaultActionReorder;
+    }
+
+    return retval;
+}
+
+// Returns the new length of a truncated unit of aLength bytes, or aLength.
+static uint16_t RollTruncate(thci_fault_stream_context_t *aContext, uint16_t aLength)
+{
+    const uint16_t skip = aContext->mConfig.mSkipBytes;
+    uint16_t retval = aLength;
+
+    if ((aLength > skip) && Roll(aContext, kThciFaultActionTruncate))
+    {
+        retval = skip + (uint16_t)(Random(aContext) % (aLength - skip));
+    }
+
+    return retval;
+}
+
+// Picks up to aBits distinct bit offsets past the first aSkipBytes of aLength bytes.
+static uint8_t PickBitOffsets(thci_fault_stream_context_t *aContext, uint16_t aSkipBytes, uint16_t aLength, uint8_t aBits,
+                              uint32_t aOffsets[THCI_FAULT_MAX_BIT_FLIPS])
+{
+    const uint32_t span = (aLength > aSkipBytes) ? ((uint32_t)(aLength - aSkipBytes) << 3) : 0;
+    uint8_t count = 0;
+
+    aBits = (aBits > THCI_FAULT_MAX_BIT_FLIPS) ? THCI_FAULT_MAX_BIT_FLIPS : aBits;
+    aBits = (aBits > span) ? (uint8_t)span : aBits;
+
+    while (count < aBits)
+    {
+        uint32_t offset = ((uint32_t)aSkipBytes << 3) + (Random(aContext) % span);
+        uint8_t i;
+
+        for (i = 0; i < count; i++)
+        {
+            if (aOffsets[i] == offset)
+            {
+                break;
+            }
+        }
+
+        if (i == count)
+        {
+            aOffsets[count++] = offset;
+        }
+    }
+
+    return count;
+}
+
+static uint8_t RollBitFlips(thci_fault_stream_context_t *aContext, uint16_t aLength, uint32_t aOffsets[THCI_FAULT_MAX_BIT_FLIPS])
+{
+    uint8_t retval = 0;
+
+    if ((aLength > aContext->mConfig.mSkipBytes) && Roll(aContext, kThciFaultActionBitFlip))
+    {
+        const uint8_t bits = aContext->mConfig.mBitFlips;
+
+        retval = PickBitOffsets(aContext, aContext->mConfig.mSkipBytes, aLength, (bits == 0) ? 1 : bits, aOffsets);
+    }
+
+    return retval;
+}
+
+static void FlipPbufBits(struct pbuf *aPbuf, const uint32_t *aOffsets, uint8_t aCount)
+{
+    for (uint8_t i = 0; i < aCount; i++)
+    {
+        const uint16_t byteOffset = (uint16_t)(aOffsets[i] >> 3);
+
+        pbuf_put_at(aPbuf, byteOffset, pbuf_get_at(aPbuf, byteOffset) ^ (1 << (aOffsets[i] & 0x07)));
+    }
+}
+
+static struct pbuf *CopyPbuf(const struct pbuf *aPbuf)
+{
+    struct pbuf *retval = pbuf_alloc(PBUF_RAW, aPbuf->tot_len, PBUF_RAM);
+
+    if ((retval != NULL) && (pbuf_copy(retval, aPbuf) != ERR_OK))
+    {
+        pbuf_free(retval);
+        retval = NULL;
+    }
+
+    return retval;
+}
+
+/* Applies the faults of an ip stream to aPbuf, which it takes ownership of,
+ * and returns the packets to pass on, in order, with the netif of each.
+ */
+static uint8_t ApplyPbuf(thci_fault_stream_t aStream, struct pbuf *aPbuf, struct netif *aNetif,
+                         struct pbuf *aOut[3], struct netif *aOutNetif[3])
+{
+    thci_fault_stream_context_t *context = GetStream(aStream);
+    struct pbuf *released = NULL;
+    struct netif *releasedNetif = NULL;
+    bool releasedFirst = true;
+    struct pbuf *duplicate = NULL;
+    thci_fault_action_t action;
+    uint8_t count = 0;
+
+    nl_er_lock_enter(sFault.mLock);
+
+    context->mStats.mUnits++;
+
+    if ((context->mHeld != NULL) && (context->mHeldReorder || ((int32_t)(Now() - context->mHeldUntil) >= 0)))
+    {
+        released = context->mHeld;
+        releasedNetif = context->mHeldNetif;
+        releasedFirst = !context->mHeldReorder;
+        context->mHeld = NULL;
+    }
+
+    action = RollDisposition(context, (context->mHeld == NULL));
+
+    if (action == kThciFaultActionDrop)
+    {
+        pbuf_free(aPbuf);
+        aPbuf = NULL;
+    }
+    else
+    {
+        uint32_t offsets[THCI_FAULT_MAX_BIT_FLIPS];
+        uint16_t length = RollTruncate(context, aPbuf->tot_len);
+        uint8_t bits;
+
+        if (length != aPbuf->tot_len)
+        {
+            pbuf_realloc(aPbuf, length);
+        }
+
+        bits = RollBitFlips(context, aPbuf->tot_len, offsets);
+        FlipPbufBits(aPbuf, offsets, bits);
+
+        if (action == kThciFaultActionDuplicate)
+        {
+            duplicate = CopyPbuf(aPbuf);
+        }
+        else if ((action == kThciFaultActionDelay) || (action == kThciFaultActionReorder))
+        {
+            context->mHeld = aPbuf;
+            context->mHeldNetif = aNetif;
+            context->mHeldUntil = Now() + context->mConfig.mDelay;
+            context->mHeldReorder = (action == kThciFaultActionReorder);
+            aPbuf = NULL;
+        }
+    }
+
+    nl_er_lock_exit(sFault.mLock);
+
+    if ((released != NULL) && releasedFirst)
+    {
+        aOutNetif[count] = releasedNetif;
+        aOut[count++] = released;
+    }
+
+    if (aPbuf != NULL)
+    {
+        aOutNetif[count] = aNetif;
+        aOut[count++] = aPbuf;
+    }
+
+    if (duplicate != NULL)
+    {
+        aOutNetif[count] = aNetif;
+        aOut[count++] = duplicate;
+    }
+
+    if ((released != NULL) && !releasedFirst)
+    {
+        aOutNetif[count] = releasedNetif;
+        aOut[count++] = released;
+    }
+
+    return count;
+}
+
+static int CreateLock(void)
+{
+    int retval = 0;
+
+    if (sFault.mLock == NULL)
+    {
+        sFault.mLock = nl_er_lock_create();
+        nlREQUIRE_ACTION(sFault.mLock != NULL, done, retval = -ENOMEM);
+    }
+
+ done:
+    return retval;
+}
+
+void thciFaultSeed(uint32_t aSeed)
+{
+    sFault.mSeed = aSeed;
+
+    for (int i = 0; i < kThciFaultStreamCount; i++)
+    {
+        SeedStream((thci_fault_stream_t)i);
+    }
+
+    thciFaultResetStats();
+}
+
+int thciFaultConfigure(thci_fault_stream_t aStream, const thci_fault_config_t *aConfig)
+{
+    int retval = 0;
+    bool enable = false;
+    struct pbuf *held = NULL;
+    thci_fault_stream_context_t *context;
+
+    nlREQUIRE_ACTION(aStream < kThciFaultStreamCount, done, retval = -EINVAL);
+
+    if (aConfig != NULL)
+    {
+        for (int i = 0; i < kThciFaultActionCount; i++)
+        {
+            nlREQUIRE_ACTION(aConfig->mProbability[i] <= THCI_FAULT_PROBABILITY_MAX, done, retval = -EINVAL);
+
+            if (aConfig->mProbability[i] != 0)
+            {
+                nlREQUIRE_ACTION(kSupportedActions[aStream] & kActionMask(i), done, retval = -EINVAL);
+                enable = true;
+            }
+        }
+    }
+
+    retval = CreateLock();
+    nlREQUIRE(retval == 0, done);
+
+    gThciFaultActiveStreams &= ~(1 << aStream);
+
+    context = GetStream(aStream);
+
+    nl_er_lock_enter(sFault.mLock);
+
+    if (enable)
+    {
+        context->mConfig = *aConfig;
+    }
+    else
+    {
+        memset(&context->mConfig, 0, sizeof(context->mConfig));
+    }
+
+    // A held packet is lost, as it would be on a link that goes down.
+    held = context->mHeld;
+    context->mHeld = NULL;
+
+    nl_er_lock_exit(sFault.mLock);
+
+    if (held != NULL)
+    {
+        pbuf_free(held);
+    }
+
+    if (enable)
+    {
+        gThciFaultActiveStreams |= (1 << aStream);
+    }
+
+ done:
+    return retval;
+}
+
+void thciFaultDisableAll(void)
+{
+    for (int i = 0; i < kThciFaultStreamCount; i++)
+    {
+        thciFaultConfigure((thci_fault_stream_t)i, NULL);
+    }
+}
+
+void thciFaultGetConfig(thci_fault_stream_t aStream, thci_fault_config_t *aConfig)
+{
+    *aConfig = sFault.mStreams[aStream].mConfig;
+}
+
+void thciFaultGetStats(thci_fault_stream_t aStream, thci_fault_stats_t *aStats)
+{
+    *aStats = sFault.mStreams[aStream].mStats;
+}
+
+void thciFaultResetStats(void)
+{
+    for (int i = 0; i < kThciFaultStreamCount; i++)
+    {
+        memset(&sFault.mStreams[i].mStats, 0, sizeof(sFault.mStreams[i].mStats));
+    }
+}
+
+const char *thciFaultStreamName(thci_fault_stream_t aStream)
+{
+    return (aStream < kThciFaultStreamCount) ? kStreamNames[aStream] : "unknown";
+}
+
+const char *thciFaultActionName(thci_fault_action_t aAction)
+{
+    return (aAction < kThciFaultActionCount) ? kActionNames[aAction] : "unknown";
+}
+
+err_t thciFaultInput(struct pbuf *aPbuf, struct netif *aNetif)
+{
+    struct pbuf *out[3];
+    struct netif *outNetif[3];
+    uint8_t count = ApplyPbuf(kThciFaultStreamIpRx, aPbuf, aNetif, out, outNetif);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (tcpip_input(out[i], outNetif[i]) != ERR_OK)
+        {
+            pbuf_free(out[i]);
+        }
+    }
+
+    return ERR_OK;
+}
+
+bool thciFaultOutput(struct netif *aNetif, struct pbuf *aPbuf, thci_fault_ip6_addr_t aAddress, err_t *aResult)
+{
+    bool retval = false;
+    struct pbuf *copy;
+    struct pbuf *out[3];
+    struct netif *outNetif[3];
+    uint8_t count;
+
+    // Only the LwIP task sends, so the flag needs no lock.
+    nlREQUIRE(!sFault.mInOutput, done);
+
+    retval = true;
+    *aResult = ERR_OK;
+
+    // The caller keeps ownership of aPbuf, so the faults apply to a copy.
+    copy = CopyPbuf(aPbuf);
+    nlREQUIRE_ACTION(copy != NULL, done, *aResult = ERR_MEM);
+
+    count = ApplyPbuf(kThciFaultStreamIpTx, copy, aNetif, out, outNetif);
+
+    sFault.mInOutput = true;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        err_t err = outNetif[i]->output_ip6(outNetif[i], out[i], aAddress);
+
+        if (*aResult == ERR_OK)
+        {
+            *aResult = err;
+        }
+
+        pbuf_free(out[i]);
+    }
+
+    sFault.mInOutput = false;
+
+ done:
+    return retval;
+}
+
+uint8_t thciFaultFrame(thci_fault_stream_t aStream, uint8_t *aFrame, uint16_t *aLength, uint16_t *aDelay)
+{
+    thci_fault_stream_context_t *context = GetStream(aStream);
+    uint32_t offsets[THCI_FAULT_MAX_BIT_FLIPS];
+    uint8_t retval = THCI_FAULT_VERDICT_PASS;
+    uint8_t bits;
+
+    context->mStats.mUnits++;
+
+    switch (RollDisposition(context, true))
+    {
+        case kThciFaultActionDrop:
+            retval = THCI_FAULT_VERDICT_DROP;
+            goto done;
+
+        case kThciFaultActionDuplicate:
+            retval = THCI_FAULT_VERDICT_DUPLICATE;
+            break;
+
+        case kThciFaultActionDelay:
+            retval = THCI_FAULT_VERDICT_DELAY;
+            *aDelay = context->mConfig.mDelay;
+            break;
+
+        default:
+            break;
+    }
+
+    *aLength = RollTruncate(context, *aLength);
+
+    bits = RollBitFlips(context, *aLength, offsets);
+
+    for (uint8_t i = 0; i < bits; i++)
+    {
+        aFrame[offsets[i] >> 3] ^= (1 << (offsets[i] & 0x07));
+    }
+
+ done:
+    return retval;
+}
+
+uint8_t thciFaultByte(thci_fault_stream_t aStream, uint8_t *aByte)
+{
+    thci_fault_stream_context_t *context = GetStream(aStream);
+    uint8_t retval = THCI_FAULT_VERDICT_PASS;
+
+    context->mStats.mUnits++;
+
+    if (Roll(context, kThciFaultActionDrop))
+    {
+        retval = THCI_FAULT_VERDICT_DROP;
+    }
+    else
+    {
+        if (Roll(context, kThciFaultActionBitFlip))
+        {
+            *aByte ^= (1 << (Random(context) & 0x07));
+        }
+
+        if (Roll(context, kThciFaultActionDuplicate))
+        {
+            retval = THCI_FAULT_VERDICT_DUPLICATE;
+        }
+    }
+
+    return retval;
+}
+
+#endif // THCI_CONFIG_FAULT_INJECTION
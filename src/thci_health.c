@@ -0,0 +1,421 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the NCP health monitor.
+ *
+ *      The probe itself blocks the THCI task for up to the response timeout,
+ *      like any other synchronous THCI request; the state is protected by a
+ *      lock so that the monitor can be started, stopped and read from any
+ *      task.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_HEALTH
+
+#include <errno.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlerlock.h>
+#include <nlerevent.h>
+#include <nlplatform/nltime.h>
+
+#include <thci.h>
+#include <thci_health.h>
+#include <thci_module.h>
+#include <thci_stats.h>
+
+typedef struct
+{
+    uint32_t    mRtt;
+    bool        mFailed;
+} thci_health_sample_t;
+
+typedef struct
+{
+    thci_health_config_t    mConfig;
+    thci_health_status_t    mStatus;
+    thci_health_sample_t    mWindow[THCI_CONFIG_NCP_HEALTH_WINDOW];
+    uint16_t                mNext;          // index of the next sample to write.
+    thciHealthCallback      mCallback;
+    void                   *mCallbackContext;
+    nl_lock_t               mLock;
+    volatile uint32_t       mEventPosted;
+    bool                    mRetry;         // probe again without waiting for the interval.
+} thci_health_context_t;
+
+/**
+ * PROTOTYPES
+ */
+
+static int HealthEventHandler(nl_event_t *aEvent, void *aClosure);
+
+/**
+ * GLOBALS
+ */
+
+static thci_health_context_t sHealths[THCI_CONFIG_MAX_INSTANCES];
+
+#define sHealth                         (sHealths[THCI_INSTANCE_INDEX()])
+
+static const nl_event_t sHealthEvent =
+{
+    NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), HealthEventHandler, NULL)
+};
+
+static uint32_t Now(void)
+{
+    return (uint32_t)nltime_get_system_ms();
+}
+
+static void AddSample(uint32_t aRtt, bool aFailed)
+{
+    thci_health_status_t *status = &sHealth.mStatus;
+
+    sHealth.mWindow[sHealth.mNext].mRtt = aRtt;
+    sHealth.mWindow[sHealth.mNext].mFailed = aFailed;
+    sHealth.mNext = (sHealth.mNext + 1) % THCI_CONFIG_NCP_HEALTH_WINDOW;
+
+    status->mProbes++;
+    status->mLastProbeTime = Now();
+
+    if (status->mWindowProbes < THCI_CONFIG_NCP_HEALTH_WINDOW)
+    {
+        status->mWindowProbes++;
+    }
+
+    if (aFailed)
+    {
+        status->mFailures++;
+        status->mConsecutiveFailures++;
+    }
+    else
+    {
+        status->mConsecutiveFailures = 0;
+        thciHistogramAdd(&status->mRtt, aRtt);
+    }
+}
+
+// Whether a probe is due.  Called with the lock held.
+static bool IsProbeDue(void)
+{
+    const thci_health_status_t *status = &sHealth.mStatus;
+
+    return (status->mState != kThciHealthStopped) &&
+           (sHealth.mRetry || (status->mProbes == 0) ||
+            ((int32_t)(Now() - (status->mLastProbeTime + status->mInterval)) >= 0));
+}
+
+static void PostHealthEvent(void)
+{
+    nlREQUIRE(gTHCISDKContext.mInitParams.mSdkQueue != NULL, done);
+
+    if (!__sync_fetch_and_or(&sHealth.mEventPosted, 1))
+    {
+        THCI_EVENT_STATS_POSTED(kThciEventHealth);
+        nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sHealthEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventHealth);
+    }
+
+ done:
+    return;
+}
+
+static thci_health_state_t Evaluate(void)
+{
+    thci_health_status_t *status = &sHealth.mStatus;
+    thci_histogram_t rtt;
+    uint32_t failures = 0;
+    thci_health_state_t retval = kThciHealthOk;
+
+    memset(&rtt, 0, sizeof(rtt));
+
+    // The window holds the last mWindowProbes samples, wherever they are.
+    for (uint32_t i = 0; i < status->mWindowProbes; i++)
+    {
+        const thci_health_sample_t *sample = &sHealth.mWindow[i];
+
+        if (sample->mFailed)
+        {
+            failures++;
+        }
+        else
+        {
+            thciHistogramAdd(&rtt, sample->mRtt);
+        }
+    }
+
+    status->mWindowRttP99 = thciHistogramPercentile(&rtt, 99);
+    status->mWindowFailures = (uint8_t)((failures * 100) / status->mWindowProbes);
+
+    if (status->mConsecutiveFailures >= sHealth.mConfig.mFailureThreshold)
+    {
+        retval = kThciHealthFailed;
+    }
+    else if ((status->mWindowRttP99 > sHealth.mConfig.mRttSlo) || (status->mWindowFailures > sHealth.mConfig.mFailureSlo))
+    {
+        retval = kThciHealthDegraded;
+    }
+
+    return retval;
+}
+
+static int HealthEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    otError error;
+    uint32_t rtt = 0;
+    thci_health_state_t previous;
+    thci_health_state_t state = kThciHealthStopped;
+    thci_health_status_t status;
+    thciHealthCallback callback = NULL;
+    void *callbackContext = NULL;
+    bool recover = false;
+    bool retry = false;
+    bool due;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventHealth);
+
+    sHealth.mEventPosted = 0;
+
+    // The event may have been posted again by a frame received while the
+    // last probe was waiting for its response.
+    nlREQUIRE(nl_er_lock_enter(sHealth.mLock) == 0, done);
+
+    due = IsProbeDue();
+    sHealth.mRetry = false;
+
+    nl_er_lock_exit(sHealth.mLock);
+
+    nlREQUIRE(due, done);
+
+    error = thciPingNcp(&rtt);
+
+    // THCI is not initialized or the NCP is being recovered: nothing was probed.
+    nlREQUIRE(error != OT_ERROR_INVALID_STATE, done);
+
+    nlREQUIRE(nl_er_lock_enter(sHealth.mLock) == 0, done);
+
+    previous = sHealth.mStatus.mState;
+
+    if (previous != kThciHealthStopped)
+    {
+        AddSample(rtt, (error != OT_ERROR_NONE));
+
+        state = Evaluate();
+
+        if ((previous == kThciHealthOk) && (state != kThciHealthOk))
+        {
+            sHealth.mStatus.mDegradations++;
+        }
+
+        // Recover on reaching the threshold, and again on every further
+        // mFailureThreshold failures if the recovery did not help.
+        if ((state == kThciHealthFailed) && sHealth.mConfig.mAutoRecover &&
+            ((sHealth.mStatus.mConsecutiveFailures % sHealth.mConfig.mFailureThreshold) == 0))
+        {
+            sHealth.mStatus.mRecoveries++;
+            recover = true;
+        }
+
+        sHealth.mStatus.mState = state;
+        sHealth.mStatus.mInterval = (state == kThciHealthOk) ? sHealth.mConfig.mMaxInterval : sHealth.mConfig.mMinInterval;
+
+        // A silent NCP sends no frames to tick the monitor: probe it again
+        // at once, each failed probe having waited for the response
+        // timeout, until it is declared failed.
+        retry = (error != OT_ERROR_NONE) && (state != kThciHealthFailed);
+        sHealth.mRetry = retry;
+
+        if (state != previous)
+        {
+            status = sHealth.mStatus;
+            callback = sHealth.mCallback;
+            callbackContext = sHealth.mCallbackContext;
+        }
+    }
+
+    nl_er_lock_exit(sHealth.mLock);
+
+    if (state != previous)
+    {
+        NL_LOG_CRIT(lrTHCI, "NCP health %s -> %s (p99 %u ms, %u%% failed, %u consecutive)\n",
+                    thciHealthStateName(previous), thciHealthStateName(state),
+                    status.mWindowRttP99, status.mWindowFailures, status.mConsecutiveFailures);
+
+        if (callback)
+        {
+            callback(state, &status, callbackContext);
+        }
+    }
+
+    if (recover)
+    {
+        thciInitiateNCPRecovery();
+    }
+
+    if (retry)
+    {
+        PostHealthEvent();
+    }
+
+ done:
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventHealth);
+
+    return NLER_SUCCESS;
+}
+
+int thciHealthInit(void)
+{
+    int retval = 0;
+
+    if (sHealth.mLock == NULL)
+    {
+        sHealth.mLock = nl_er_lock_create();
+        nlREQUIRE_ACTION(sHealth.mLock != NULL, done, retval = -ENOMEM);
+    }
+
+ done:
+    return retval;
+}
+
+otError thciHealthStart(const thci_health_config_t *aConfig, thciHealthCallback aCallback, void *aContext)
+{
+    otError retval = OT_ERROR_NONE;
+    thci_health_config_t config;
+
+    if (aConfig != NULL)
+    {
+        config = *aConfig;
+    }
+    else
+    {
+        config.mMinInterval = THCI_HEALTH_DEFAULT_MIN_INTERVAL_MSEC;
+        config.mMaxInterval = THCI_HEALTH_DEFAULT_MAX_INTERVAL_MSEC;
+        config.mRttSlo = THCI_HEALTH_DEFAULT_RTT_SLO_MSEC;
+        config.mFailureSlo = THCI_HEALTH_DEFAULT_FAILURE_SLO_PERCENT;
+        config.mFailureThreshold = THCI_HEALTH_DEFAULT_FAILURE_THRESHOLD;
+        config.mAutoRecover = true;
+    }
+
+    nlREQUIRE_ACTION(config.mMinInterval > 0, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(config.mMaxInterval >= config.mMinInterval, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(config.mFailureSlo <= 100, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(config.mFailureThreshold > 0, done, retval = OT_ERROR_INVALID_ARGS);
+
+    nlREQUIRE_ACTION(sHealth.mLock != NULL, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(nl_er_lock_enter(sHealth.mLock) == 0, done, retval = OT_ERROR_FAILED);
+
+    sHealth.mConfig = config;
+    sHealth.mCallback = aCallback;
+    sHealth.mCallbackContext = aContext;
+    sHealth.mNext = 0;
+
+    memset(&sHealth.mStatus, 0, sizeof(sHealth.mStatus));
+    sHealth.mStatus.mState = kThciHealthOk;
+    sHealth.mStatus.mInterval = config.mMaxInterval;
+    sHealth.mRetry = false;
+
+    nl_er_lock_exit(sHealth.mLock);
+
+    // The first probe does not wait for a tick.
+    PostHealthEvent();
+
+ done:
+    return retval;
+}
+
+void thciHealthStop(void)
+{
+    nlREQUIRE(sHealth.mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(sHealth.mLock) == 0, done);
+
+    sHealth.mStatus.mState = kThciHealthStopped;
+
+    nl_er_lock_exit(sHealth.mLock);
+
+ done:
+    return;
+}
+
+void thciHealthTick(void)
+{
+    bool due = false;
+
+    // The lock is created by thciHealthInit().
+    if ((sHealth.mLock != NULL) && (nl_er_lock_enter(sHealth.mLock) == 0))
+    {
+        due = IsProbeDue();
+
+        nl_er_lock_exit(sHealth.mLock);
+    }
+
+    if (due)
+    {
+        PostHealthEvent();
+    }
+}
+
+void thciGetHealthStatus(thci_health_status_t *aStatus)
+{
+    memset(aStatus, 0, sizeof(*aStatus));
+
+    nlREQUIRE(sHealth.mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(sHealth.mLock) == 0, done);
+
+    *aStatus = sHealth.mStatus;
+
+    nl_er_lock_exit(sHealth.mLock);
+
+ done:
+    return;
+}
+
+const char *thciHealthStateName(thci_health_state_t aState)
+{
+    const char *retval = "unknown";
+
+    switch (aState)
+    {
+        case kThciHealthStopped:
+            retval = "stopped";
+            break;
+
+        case kThciHealthOk:
+            retval = "ok";
+            break;
+
+        case kThciHealthDegraded:
+            retval = "degraded";
+            break;
+
+        case kThciHealthFailed:
+            retval = "failed";
+            break;
+    }
+
+    return retval;
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_HEALTH
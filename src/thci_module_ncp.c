@@ -36,6 +36,7 @@
 #include <nlerevent.h>
 #include <nlererror.h>
 #include <nlertask.h>
+#include <nlplatform/nltime.h>
 #if THCI_CONFIG_INITIALIZE_WITHOUT_NCP_RESET
 #include <nlboard.h>
 #endif
@@ -55,7 +56,18 @@
 #include <thci_module_ncp.h>
 #include <thci_module_ncp_uart.h>
 #include <thci_update.h>
-#include <thci_cert.h>
+#include <thci_fault.h>
+#include <thci_deferred_log.h>
+#include <thci_ncp_log.h>
+#include <thci_stats.h>
+#include <thci_clock.h>
+#include <thci_diag.h>
+#include <thci_rf_test.h>
+#include <thci_health.h>
+#include <thci_daemon.h>
+#include <thci_async.h>
+#include <thci_module_ncp_vendor.h>
+#include <thci_arena.h>
 
 /* LWIP Includes */
 #include <lwip/ip6.h>
@@ -76,6 +88,10 @@ const uint8_t kDontCareTransactionId    = 0x01;
 const uint8_t kEmptyTransactionId       = 0x00;
 
 #define kDefaultSpinelPropertyKey   SPINEL_PROP_LAST_STATUS
+// The header, command, key and length of a stream frame, at most.
+#define kSpinelStreamFrameOverhead  9
+// The header, command, key and page fields of a table page, at most.
+#define kTablePageOverhead          16
 
 /**
  * PROTOTYPES
@@ -87,6 +103,12 @@ static int LegacyUlaChangeEventHandler(nl_event_t *aEvent, void *aClosure);
 static int ScanCompleteEventHandler(nl_event_t *aEvent, void *aClosure);
 static int ScanResultEventHandler(nl_event_t *aEvent, void *aClosure);
 static int NCPRecoveryEventHandler(nl_event_t *aEvent, void *aClosure);
+#if THCI_CONFIG_RF_TEST
+static int RfTestEventHandler(nl_event_t *aEvent, void *aClosure);
+#endif
+#if THCI_CONFIG_ASYNC_REQUESTS
+static int AsyncEventHandler(nl_event_t *aEvent, void *aClosure);
+#endif
 
 extern int thciSafeInitialize(void);
 extern int thciSafeFinalize(void);
@@ -99,12 +121,27 @@ void HandleLastStatusUpdate(const uint8_t *aArgPtr, unsigned int aArgLen);
  * GLOBALS
  */
 
-// THCI context that is common between the NCP and SOC solutions.
-extern thci_sdk_context_t gTHCISDKContext;
+// The NCP context and data path state of each instance; the names below
+// refer to those of the current instance.
+thci_ncp_context_t gTHCINCPContexts[THCI_CONFIG_MAX_INSTANCES];
+
+static uint8_t sOutgoingIPPacketEventPostedFlags[THCI_CONFIG_MAX_INSTANCES];
+
+static thci_datapath_counters_t sDatapathCountersTable[THCI_CONFIG_MAX_INSTANCES];
 
-thci_ncp_context_t gTHCINCPContext;
+#define gTHCINCPContext                 (gTHCINCPContexts[THCI_INSTANCE_INDEX()])
+#define sDatapathCounters               (sDatapathCountersTable[THCI_INSTANCE_INDEX()])
 
-static uint8_t sOutgoingIPPacketEventPosted;
+#if THCI_CONFIG_SPINEL_IID_MUX
+// The Spinel interface id each netif is carried on.
+static const uint8_t kNetifIids[THCI_NETIF_TAG_COUNT] =
+{
+    [THCI_NETIF_TAG_THREAD] = 0,
+#if THCI_CONFIG_LEGACY_ALARM_SUPPORT
+    [THCI_NETIF_TAG_LEGACY] = THCI_CONFIG_SPINEL_IID_LEGACY,
+#endif
+};
+#endif
 
 static const nl_event_t sOutgoingIPPacketEvent =
 {
@@ -136,6 +173,88 @@ static const nl_event_t sNCPRecoveryEvent =
     NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), NCPRecoveryEventHandler, NULL)
 };
 
+#if THCI_CONFIG_RF_TEST
+#define kRfTestResultQueueSize      4
+#define kRfTestStepEncodedSize      14  // t(CCcSCSL)
+
+typedef struct
+{
+    thciRfTestCallback      mCallback;
+    void                    *mContext;
+    thci_rf_test_result_t   mResults[kRfTestResultQueueSize];
+    uint8_t                 mHead;          // next result to deliver.
+    uint8_t                 mCount;         // results waiting for delivery.
+    uint16_t                mDropped;       // results lost because the queue was full.
+    uint8_t                 mEventPosted;
+    bool                    mActive;
+    bool                    mComplete;      // the sequence ended; deliver the NULL result.
+} thci_rf_test_context_t;
+
+static thci_rf_test_context_t sRfTests[THCI_CONFIG_MAX_INSTANCES];
+
+#define sRfTest                         (sRfTests[THCI_INSTANCE_INDEX()])
+
+static const nl_event_t sRfTestEvent =
+{
+    NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), RfTestEventHandler, NULL)
+};
+#endif
+
+#if THCI_CONFIG_DAEMON
+typedef struct
+{
+    thciRawFrameObserver    mObserver;
+    void                    *mContext;
+} thci_raw_frame_observer_t;
+
+static thci_raw_frame_observer_t sRawFrameObservers[THCI_CONFIG_MAX_INSTANCES];
+
+#define sRawFrameObserver               (sRawFrameObservers[THCI_INSTANCE_INDEX()])
+#endif
+
+#if THCI_CONFIG_ASYNC_REQUESTS
+typedef struct
+{
+    uint8_t             mTransactionId;     // 0 when the slot is free.
+    bool                mReceived;          // mError and the response are set.
+    uint8_t             mResponseCommand;   // expected.
+    spinel_prop_key_t   mResponseKey;       // expected.
+    uint32_t            mSendTime;
+    thciAsyncCallback   mCallback;
+    void                *mContext;
+    otError             mError;
+    unsigned int        mCommand;
+    spinel_prop_key_t   mKey;
+    uint16_t            mLength;
+    uint8_t             mValue[THCI_CONFIG_ASYNC_VALUE_SIZE];
+} thci_async_request_t;
+
+typedef struct
+{
+    thciAsyncFunction   mFunction;
+    void                *mContext;
+} thci_async_call_t;
+
+typedef struct
+{
+    thci_async_request_t    mRequests[THCI_CONFIG_ASYNC_MAX_REQUESTS];
+    thci_async_call_t       mCalls[THCI_CONFIG_ASYNC_MAX_CALLS];
+    uint8_t                 mCallHead;
+    uint8_t                 mCallCount;
+    nl_lock_t               mCallLock;      // calls are posted from any task.
+    volatile uint32_t       mEventPosted;
+} thci_async_context_t;
+
+static thci_async_context_t sAsyncs[THCI_CONFIG_MAX_INSTANCES];
+
+#define sAsync                          (sAsyncs[THCI_INSTANCE_INDEX()])
+
+static const nl_event_t sAsyncEvent =
+{
+    NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), AsyncEventHandler, NULL)
+};
+#endif
+
 static const nl_event_t sFreeMessageEvent =
 {
     NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), NULL, NULL)
@@ -194,11 +313,11 @@ static const spinel_prop_key_t kIpCounterPropertyList[] =
  * THCI must open the source port selected by the TCP/IP stack by calling
  * OpenSourcePort().
  */
-static bool NeedToOpenInsecureSourcePort(void)
+static bool NeedToOpenInsecureSourcePort(const thci_sdk_context_t *aContext)
 {
-    return (!THCI_ENABLE_MESSAGE_SECURITY(gTHCISDKContext.mSecurityFlags) &&
-             THCI_TEST_INSECURE_PORTS(gTHCISDKContext.mSecurityFlags) &&
-            !THCI_TEST_INSECURE_SOURCE_PORT(gTHCISDKContext.mSecurityFlags));
+    return (!THCI_ENABLE_MESSAGE_SECURITY(aContext->mSecurityFlags) &&
+             THCI_TEST_INSECURE_PORTS(aContext->mSecurityFlags) &&
+            !THCI_TEST_INSECURE_SOURCE_PORT(aContext->mSecurityFlags));
 }
 
 /**
@@ -209,11 +328,11 @@ static bool NeedToOpenInsecureSourcePort(void)
  * function will return false to indicate that outgoing frames
  * on the insecure port should be sent securely.
  */
-static bool SendProvisionalJoinResponseInsecurely(void)
+static bool SendProvisionalJoinResponseInsecurely(const thci_sdk_context_t *aContext)
 {
-    return (THCI_ENABLE_MESSAGE_SECURITY(gTHCISDKContext.mSecurityFlags) &&
-            THCI_TEST_INSECURE_PORTS(gTHCISDKContext.mSecurityFlags) &&
-            !THCI_RECEIVED_SECURE_MESSAGE_ON_INSECURE_PORT(gTHCISDKContext.mSecurityFlags));
+    return (THCI_ENABLE_MESSAGE_SECURITY(aContext->mSecurityFlags) &&
+            THCI_TEST_INSECURE_PORTS(aContext->mSecurityFlags) &&
+            !THCI_RECEIVED_SECURE_MESSAGE_ON_INSECURE_PORT(aContext->mSecurityFlags));
 }
 
 static otDeviceRole TranslateSpinelRole(spinel_net_role_t aRole)
@@ -241,6 +360,50 @@ static otDeviceRole TranslateSpinelRole(spinel_net_role_t aRole)
     return retval;
 }
 
+#if THCI_CONFIG_ATTACH_STATS
+static void HandleAddressTableUpdate(const uint8_t *aArgPtr, unsigned int aArgLen)
+{
+    otIp6Address *addr;
+    const otIp6Address *locator = NULL;
+    uint8_t prefixLength;
+    uint32_t preferred, valid;
+    spinel_ssize_t parsedLength;
+
+    // The first pass finds a locator, for the mesh-local prefix, as it may
+    // come after the ML-EID in the table.
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (parsedLength = 0; aArgLen > parsedLength; )
+        {
+            spinel_ssize_t subLength = spinel_datatype_unpack(aArgPtr + parsedLength, aArgLen - parsedLength, "T(6CLL).",
+                                                              &addr,
+                                                              &prefixLength,
+                                                              &preferred,
+                                                              &valid);
+            nlREQUIRE(subLength > 0, done);
+
+            parsedLength += subLength;
+
+            if (pass == 0)
+            {
+                if (thciIsLocatorAddress(addr))
+                {
+                    locator = addr;
+                    break;
+                }
+            }
+            else
+            {
+                THCI_ATTACH_STATS_ADDRESS(addr, locator);
+            }
+        }
+    }
+
+ done:
+    return;
+}
+#endif // THCI_CONFIG_ATTACH_STATS
+
 static void HandleChildTableUpdate(const uint8_t *aArgPtr, unsigned int aArgLen)
 {
     spinel_ssize_t parsedLength;
@@ -308,34 +471,6 @@ static void HandleChildTableUpdate(const uint8_t *aArgPtr, unsigned int aArgLen)
     return;
 }
 
-#if THCI_CONFIG_LOG_NCP_LOGS
-static void HandleDebugStream(const uint8_t *aArgPtr, unsigned int aArgLen)
-{
-    char linebuffer[96 + 1];
-    int linepos = 0;
-
-    while (aArgLen--)
-    {
-        char nextchar = *aArgPtr++;
-
-        if ((nextchar == '\t') || (nextchar >= 32)) {
-            linebuffer[linepos++] = nextchar;
-        }
-
-        if ((linepos != 0) &&
-            ((nextchar == '\n') ||
-             (nextchar == '\r') ||
-             (linepos >= (sizeof(linebuffer) - 1)) ||
-             !aArgLen))
-        {
-            // flush.
-            linebuffer[linepos] = 0;
-            NL_LOG_CRIT(lrTHCI, "NCP => %s\n", linebuffer);
-            linepos = 0;
-        }
-    }
-}
-#endif
 
 
 #if THCI_CONFIG_LEGACY_ALARM_SUPPORT
@@ -387,24 +522,53 @@ void HandleLastStatusUpdate(const uint8_t *aArgPtr, unsigned int aArgLen)
     }
 }
 
+#if THCI_CONFIG_ASYNC_REQUESTS
+static thci_async_request_t *FindAsyncRequest(uint8_t aTransactionId)
+{
+    thci_async_request_t *retval = NULL;
+
+    for (size_t i = 0; i < THCI_CONFIG_ASYNC_MAX_REQUESTS; i++)
+    {
+        if (sAsync.mRequests[i].mTransactionId == aTransactionId)
+        {
+            retval = &sAsync.mRequests[i];
+            break;
+        }
+    }
+
+    return retval;
+}
+#endif
+
 // The Spinel transaction ID is packed in a bit field 4-bits wide.
 // value = 1, the kDontCareTransactionId, is reserved by this module to be
 // used for Transactions which don't require a response. value = 0 is
-// reserved by Spinel.  All other values are returned by this function.
+// reserved by Spinel.  All other values are returned by this function,
+// except those held by outstanding non-blocking requests.
 static uint8_t GetNewTransactionId(void)
 {
-    uint8_t newId = gTHCINCPContext.mTransactionId + 1;
+    uint8_t newId = gTHCINCPContext.mTransactionId;
     const uint8_t kMinTransactionId = kDontCareTransactionId + 1;
 
-    if (newId >= kMaxTransactionId)
+    do
     {
-        newId = kMinTransactionId;
-    }
+        newId++;
 
-    if (newId < kMinTransactionId)
-    {
-        newId = kMinTransactionId;
+        if (newId >= kMaxTransactionId)
+        {
+            newId = kMinTransactionId;
+        }
+
+        if (newId < kMinTransactionId)
+        {
+            newId = kMinTransactionId;
+        }
     }
+#if THCI_CONFIG_ASYNC_REQUESTS
+    while (FindAsyncRequest(newId) != NULL);
+#else
+    while (false);
+#endif
 
     gTHCINCPContext.mTransactionId = newId;
 
@@ -450,29 +614,49 @@ static callback_buffer_t* AllocateCallbackBuffer(callback_buffer_state_t aState)
     return retval;
 }
 
-static thci_message_t *NewMessage(bool aSecurity, uint16_t aLength)
+// Must be called with mMessageLock held.
+static uint32_t GetMessageRingUsed(const thci_ncp_context_t *aContext)
+{
+    const uint8_t *ringStart = &aContext->mMessageRingBuffer[0];
+    const uint8_t *ringEnd = &aContext->mMessageRingBuffer[aContext->mMessageRingSize];
+    uint32_t retval;
+
+    if (aContext->mMessageRingHead >= aContext->mMessageRingTail)
+    {
+        retval = aContext->mMessageRingHead - aContext->mMessageRingTail;
+    }
+    else
+    {
+        retval = (ringEnd - aContext->mMessageRingTail) + (aContext->mMessageRingHead - ringStart);
+    }
+
+    return retval;
+}
+
+static thci_message_t *NewMessage(uint8_t aInstanceIndex, bool aSecurity, uint16_t aLength)
 {
+    thci_ncp_context_t *context = &gTHCINCPContexts[aInstanceIndex];
     thci_message_t *retval = NULL;
-    uint8_t *ringStart = &gTHCINCPContext.mMessageRingBuffer[0];
-    uint8_t *ringEnd = &gTHCINCPContext.mMessageRingBuffer[THCI_CONFIG_NCP_TX_MESSAGE_RING_BUFFER_SIZE];
+    uint8_t *ringStart = &context->mMessageRingBuffer[0];
+    uint8_t *ringEnd = &context->mMessageRingBuffer[context->mMessageRingSize];
     int status;
 
-    status = nl_er_lock_enter(gTHCINCPContext.mMessageLock);
+    status = nl_er_lock_enter(context->mMessageLock);
     nlREQUIRE(!status, done);
 
-    if (gTHCINCPContext.mMessageRingHead == gTHCINCPContext.mMessageRingTail)
+    if (context->mMessageRingHead == context->mMessageRingTail)
     {
         // The logic below is simplified if the head and tail are reset to ringStart
         // whenever they are found to be equal.
-        gTHCINCPContext.mMessageRingHead = ringStart;
-        gTHCINCPContext.mMessageRingTail = ringStart;
+        context->mMessageRingHead = ringStart;
+        context->mMessageRingTail = ringStart;
     }
 
     {
         // terminating point at the end of the ring buffer.
-        const uint8_t *termEnd = (gTHCINCPContext.mMessageRingHead < gTHCINCPContext.mMessageRingTail) ? gTHCINCPContext.mMessageRingTail : ringEnd;
+        const uint8_t *termEnd = (context->mMessageRingHead < context->mMessageRingTail) ? context->mMessageRingTail : ringEnd;
         // termination point at the start of the ring buffer.
-        const uint8_t *termStart = (gTHCINCPContext.mMessageRingHead > gTHCINCPContext.mMessageRingTail) ? gTHCINCPContext.mMessageRingTail : NULL;
+        const uint8_t *termStart = (context->mMessageRingHead > context->mMessageRingTail) ? context->mMessageRingTail : NULL;
 
         // include sizeof message header.
         aLength += sizeof(thci_message_t);
@@ -480,18 +664,18 @@ static thci_message_t *NewMessage(bool aSecurity, uint16_t aLength)
         // All allocations must be 4-byte aligned.
         aLength += (sizeof(uint32_t) - (aLength & (sizeof(uint32_t) - 1))) & (sizeof(uint32_t) - 1);
 
-        if (aLength + gTHCINCPContext.mMessageRingHead < termEnd)
+        if (aLength + context->mMessageRingHead < termEnd)
         {
             // The message fits in the space available at the end of the ring buffer?
-            retval = (thci_message_t *)gTHCINCPContext.mMessageRingHead;
-            gTHCINCPContext.mMessageRingHead += aLength;
+            retval = (thci_message_t *)context->mMessageRingHead;
+            context->mMessageRingHead += aLength;
         }
         else if (termStart && aLength + ringStart < termStart)
         {
             // The message fits in the space available at the beginning of the ring buffer?
             retval = (thci_message_t *)ringStart;
-            gTHCINCPContext.mMessageRingEndGap = ringEnd - gTHCINCPContext.mMessageRingHead;
-            gTHCINCPContext.mMessageRingHead = ringStart + aLength;
+            context->mMessageRingEndGap = ringEnd - context->mMessageRingHead;
+            context->mMessageRingHead = ringStart + aLength;
         }
         else
         {
@@ -510,66 +694,72 @@ static thci_message_t *NewMessage(bool aSecurity, uint16_t aLength)
         {
             retval->mFlags |= THCI_MESSAGE_FLAG_SECURE;
         }
+
+        if (GetMessageRingUsed(context) > sDatapathCountersTable[aInstanceIndex].mTxRingHighWater)
+        {
+            sDatapathCountersTable[aInstanceIndex].mTxRingHighWater = GetMessageRingUsed(context);
+        }
     }
 
  unlock:
-    nl_er_lock_exit(gTHCINCPContext.mMessageLock);
+    nl_er_lock_exit(context->mMessageLock);
 
  done:
     return retval;
 }
 
-static void FreeMessage(thci_message_t *aMessage)
+static void FreeMessage(uint8_t aInstanceIndex, thci_message_t *aMessage)
 {
+    thci_ncp_context_t *context = &gTHCINCPContexts[aInstanceIndex];
     uint8_t *messageHead = (uint8_t*)aMessage;
-    uint8_t *ringStart = &gTHCINCPContext.mMessageRingBuffer[0];
-    uint8_t *ringEnd = &gTHCINCPContext.mMessageRingBuffer[THCI_CONFIG_NCP_TX_MESSAGE_RING_BUFFER_SIZE];
+    uint8_t *ringStart = &context->mMessageRingBuffer[0];
+    uint8_t *ringEnd = &context->mMessageRingBuffer[context->mMessageRingSize];
     int status;
 
     nlREQUIRE(aMessage, done);
 
-    status = nl_er_lock_enter(gTHCINCPContext.mMessageLock);
+    status = nl_er_lock_enter(context->mMessageLock);
     nlREQUIRE(!status, done);
 
     /** 
      * aMessage must either be the oldest message as identified by the ring-tail or the newest
      * message as identified by the ring-head
      */
-    nlREQUIRE_ACTION(messageHead == gTHCINCPContext.mMessageRingTail || messageHead + aMessage->mTotalLength == gTHCINCPContext.mMessageRingHead, unlock,
-                     NL_LOG_CRIT(lrTHCI, "ERROR: freed message does not align with head or tail %x, %x, %x\n", messageHead, gTHCINCPContext.mMessageRingTail, gTHCINCPContext.mMessageRingHead));
+    nlREQUIRE_ACTION(messageHead == context->mMessageRingTail || messageHead + aMessage->mTotalLength == context->mMessageRingHead, unlock,
+                     NL_LOG_CRIT(lrTHCI, "ERROR: freed message does not align with head or tail %x, %x, %x\n", messageHead, context->mMessageRingTail, context->mMessageRingHead));
 
-    if (messageHead == gTHCINCPContext.mMessageRingTail)
+    if (messageHead == context->mMessageRingTail)
     {
         // move the tail forward.
-        gTHCINCPContext.mMessageRingTail += aMessage->mTotalLength;
+        context->mMessageRingTail += aMessage->mTotalLength;
 
-        if (gTHCINCPContext.mMessageRingTail + gTHCINCPContext.mMessageRingEndGap >= ringEnd)
+        if (context->mMessageRingTail + context->mMessageRingEndGap >= ringEnd)
         {
             // advance the tail beyond the end-gap that was created when the last message was allocated.
-            gTHCINCPContext.mMessageRingTail = ringStart;
-            gTHCINCPContext.mMessageRingEndGap = 0;
+            context->mMessageRingTail = ringStart;
+            context->mMessageRingEndGap = 0;
         }
     }
     else
     {
         // Move the head backward.
-        gTHCINCPContext.mMessageRingHead = messageHead;
+        context->mMessageRingHead = messageHead;
 
-        if (gTHCINCPContext.mMessageRingHead == ringStart && gTHCINCPContext.mMessageRingEndGap)
+        if (context->mMessageRingHead == ringStart && context->mMessageRingEndGap)
         {
-            gTHCINCPContext.mMessageRingHead = ringEnd - gTHCINCPContext.mMessageRingEndGap;
-            gTHCINCPContext.mMessageRingEndGap = 0;
+            context->mMessageRingHead = ringEnd - context->mMessageRingEndGap;
+            context->mMessageRingEndGap = 0;
         }
     }
 
-    if (gTHCINCPContext.mWaitFreeQueueEmpty)
+    if (context->mWaitFreeQueueEmpty)
     {
-        gTHCINCPContext.mWaitFreeQueueEmpty = false;
-        nl_eventqueue_post_event(gTHCINCPContext.mWaitFreeQueue, &sFreeMessageEvent);
+        context->mWaitFreeQueueEmpty = false;
+        nl_eventqueue_post_event(context->mWaitFreeQueue, &sFreeMessageEvent);
     }
 
  unlock:
-    nl_er_lock_exit(gTHCINCPContext.mMessageLock);
+    nl_er_lock_exit(context->mMessageLock);
 
  done:
     return;
@@ -642,9 +832,11 @@ static int ReadMessage(thci_message_t *aMessage, uint8_t *aBuf, uint16_t aLen)
     return retval;
 }
 
-static int CreateTHCIMessageFromPbuf(struct pbuf *aPbuf, thci_message_t **aMessage)
+static int CreateTHCIMessageFromPbuf(uint8_t aInstanceIndex, struct pbuf *aPbuf, thci_message_t **aMessage)
 {
-    bool linkSecurityEnabled = THCI_ENABLE_MESSAGE_SECURITY(gTHCISDKContext.mSecurityFlags);
+    const thci_sdk_context_t *sdk = &gTHCISDKContexts[aInstanceIndex];
+    thci_ncp_context_t *context = &gTHCINCPContexts[aInstanceIndex];
+    bool linkSecurityEnabled = THCI_ENABLE_MESSAGE_SECURITY(sdk->mSecurityFlags);
     thci_message_t *message = NULL;
     int retval = -EINVAL;
 
@@ -656,17 +848,17 @@ static int CreateTHCIMessageFromPbuf(struct pbuf *aPbuf, thci_message_t **aMessa
         const nl_time_ms_t timeout = 2000;
 
         // allocate a thci_message_t. Block if one is not immediately available.
-        message = NewMessage(linkSecurityEnabled, aPbuf->tot_len);
+        message = NewMessage(aInstanceIndex, linkSecurityEnabled, aPbuf->tot_len);
 
         if (message)
         {
             break;
         }
 
-        ev = nl_eventqueue_get_event_with_timeout(gTHCINCPContext.mWaitFreeQueue, timeout);
+        ev = nl_eventqueue_get_event_with_timeout(context->mWaitFreeQueue, timeout);
         nlREQUIRE_ACTION(ev != NULL, done, retval = -ENOMEM; NL_LOG_CRIT(lrTHCI, "ERROR: Wait for free message timed out.\n"));
         // reset the variable after pulling an event.
-        gTHCINCPContext.mWaitFreeQueueEmpty = true;
+        context->mWaitFreeQueueEmpty = true;
 
     } while (message == NULL);
 
@@ -697,7 +889,7 @@ static int CreateTHCIMessageFromPbuf(struct pbuf *aPbuf, thci_message_t **aMessa
 
         nlREQUIRE_ACTION(tot_len == 0, done, NL_LOG_CRIT(lrTHCI, "%s: pbuf parse error tot_len=%u\n", __FUNCTION__, tot_len));
 
-        if (SendProvisionalJoinResponseInsecurely())
+        if (SendProvisionalJoinResponseInsecurely(sdk))
         {
             struct ip6_hdr ip6Hdr;
             uint16_t srcPort;
@@ -715,7 +907,7 @@ static int CreateTHCIMessageFromPbuf(struct pbuf *aPbuf, thci_message_t **aMessa
 
                 srcPort = lwip_ntohs(srcPort);
 
-                if (srcPort == gTHCISDKContext.mInsecureSourcePort)
+                if (srcPort == sdk->mInsecureSourcePort)
                 {
                     // set the message as insecure.
                     SetMessageSecurity(message, false);
@@ -733,22 +925,158 @@ static int CreateTHCIMessageFromPbuf(struct pbuf *aPbuf, thci_message_t **aMessa
  done:
     if (message && retval)
     {
-        FreeMessage(message);
+        FreeMessage(aInstanceIndex, message);
+    }
+
+    return retval;
+}
+
+// Find the netif a received data frame is for, THCI_NETIF_TAG_COUNT if none.
+static thci_netif_tags_t GetFrameNetifTag(uint8_t aHeader, unsigned int aCommand)
+{
+    thci_netif_tags_t retval = THCI_NETIF_TAG_THREAD;
+
+#if THCI_CONFIG_SPINEL_IID_MUX
+    retval = THCI_NETIF_TAG_COUNT;
+
+    for (uint8_t tag = 0; tag < THCI_NETIF_TAG_COUNT; tag++)
+    {
+        if (kNetifIids[tag] == SPINEL_HEADER_GET_IID(aHeader))
+        {
+            retval = (thci_netif_tags_t)tag;
+            break;
+        }
+    }
+#elif THCI_CONFIG_LEGACY_ALARM_SUPPORT
+    if (aCommand == SPINEL_CMD_VENDOR_NEST_PROP_VALUE_IS)
+    {
+        retval = THCI_NETIF_TAG_LEGACY;
     }
+#endif
+
+    (void)aHeader;
+    (void)aCommand;
 
     return retval;
 }
 
-static void ReceiveIp6Datagram(unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aBuf, unsigned int aBufLength)
+#if THCI_CONFIG_DAEMON
+static void NotifyRawFrameObserver(uint8_t aInstanceIndex, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen)
+{
+    const thci_raw_frame_observer_t *observer = &sRawFrameObservers[aInstanceIndex];
+
+    if (observer->mObserver)
+    {
+        observer->mObserver(aCommand, aKey, aArgPtr, aArgLen, observer->mContext);
+    }
+}
+#else
+#define NotifyRawFrameObserver(aInstanceIndex, aCommand, aKey, aArgPtr, aArgLen)
+#endif
+
+#if THCI_CONFIG_ASYNC_REQUESTS
+static void PostAsyncEvent(void)
+{
+    if (!__sync_fetch_and_or(&sAsync.mEventPosted, 1))
+    {
+        THCI_EVENT_STATS_POSTED(kThciEventAsync);
+        nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sAsyncEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventAsync);
+    }
+}
+
+/**
+ * Keeps the response to a non-blocking request for the async event, as the
+ * frame may be received while a blocking request waits.
+ *
+ * @retval true when the frame is such a response.
+ */
+static bool HandleAsyncResponse(uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen)
+{
+    thci_async_request_t *request = NULL;
+    const uint8_t tid = SPINEL_HEADER_GET_TID(aHeader);
+
+    nlREQUIRE(tid != 0 && tid != kDontCareTransactionId, done);
+
+    request = FindAsyncRequest(tid);
+    nlREQUIRE(request != NULL && !request->mReceived, done);
+
+    if (aCommand == request->mResponseCommand && aKey == request->mResponseKey)
+    {
+        request->mError = OT_ERROR_NONE;
+    }
+    else
+    {
+        request->mError = OT_ERROR_FAILED;
+
+        if (aKey == SPINEL_PROP_LAST_STATUS)
+        {
+            HandleLastStatusUpdate(aArgPtr, aArgLen);
+        }
+    }
+
+    request->mCommand = aCommand;
+    request->mKey = aKey;
+    request->mLength = (aArgLen < sizeof(request->mValue)) ? aArgLen : sizeof(request->mValue);
+    memcpy(request->mValue, aArgPtr, request->mLength);
+    request->mReceived = true;
+
+    PostAsyncEvent();
+
+ done:
+    return (request != NULL);
+}
+
+// The NCP is reset: outstanding requests will not be answered.
+static void AbortAsyncRequests(void)
 {
+    bool aborted = false;
+
+    for (size_t i = 0; i < THCI_CONFIG_ASYNC_MAX_REQUESTS; i++)
+    {
+        thci_async_request_t *request = &sAsync.mRequests[i];
+
+        if (request->mTransactionId != 0 && !request->mReceived)
+        {
+            request->mError = OT_ERROR_ABORT;
+            request->mLength = 0;
+            request->mReceived = true;
+            aborted = true;
+        }
+    }
+
+    if (aborted)
+    {
+        PostAsyncEvent();
+    }
+}
+#endif
+
+static void ReceiveIp6Datagram(uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aBuf, unsigned int aBufLength)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_sdk_context_t *sdk = &gTHCISDKContexts[index];
+    thci_datapath_counters_t *counters = &sDatapathCountersTable[index];
     struct pbuf *pbuf = NULL;
     err_t err;
     spinel_ssize_t parsedLength;
     const uint8_t *argPtr = NULL;
     unsigned int argLen = 0;
     struct ip6_hdr ip6Hdr;
-    thci_netif_tags_t tag = THCI_NETIF_TAG_THREAD;
+    const thci_netif_tags_t tag = GetFrameNetifTag(aHeader, aCommand);
     const bool isSecure = (aKey != SPINEL_PROP_STREAM_NET_INSECURE);
+    bool delivered = false;
+
+#if THCI_CONFIG_NCP_HEALTH
+    thciHealthTick();
+#endif
+
+    NotifyRawFrameObserver(index, aCommand, aKey, aBuf, aBufLength);
+
+    nlREQUIRE_ACTION(tag < THCI_NETIF_TAG_COUNT, done, NL_LOG_CRIT(lrTHCI, "No netif for Spinel IID %u\n", SPINEL_HEADER_GET_IID(aHeader)));
 
     parsedLength = spinel_datatype_unpack(aBuf, aBufLength, "D.", &argPtr, &argLen);
     nlREQUIRE_ACTION(parsedLength == aBufLength, done, NL_LOG_CRIT(lrTHCI, "Failed to parse length from Ip6Datagram\n"));
@@ -760,11 +1088,7 @@ static void ReceiveIp6Datagram(unsigned int aCommand, spinel_prop_key_t aKey, co
     memcpy(pbuf->payload, argPtr, argLen);
     memcpy(&ip6Hdr, pbuf->payload, sizeof(ip6Hdr));
 
-#ifdef BUILD_FEATURE_THCI_CERT
-    thci_cert_rx_corrupt(pbuf);
-#endif //BUILD_FEATURE_THCI_CERT
-
-    if (isSecure && SendProvisionalJoinResponseInsecurely())
+    if (isSecure && SendProvisionalJoinResponseInsecurely(sdk))
     {
         if (IP6H_NEXTH((&ip6Hdr)) == IP6_NEXTH_TCP)
         {
@@ -776,30 +1100,29 @@ static void ReceiveIp6Datagram(unsigned int aCommand, spinel_prop_key_t aKey, co
 
             // If this frame has the insecure port assigned as the dst port, then
             // future frames must be secure.
-            if (dstPort == gTHCISDKContext.mInsecureSourcePort)
+            if (dstPort == sdk->mInsecureSourcePort)
             {
-                gTHCISDKContext.mSecurityFlags |= THCI_SECURITY_FLAG_SECURE_MSG_RXD_ON_INSECURE_PORT;
+                sdk->mSecurityFlags |= THCI_SECURITY_FLAG_SECURE_MSG_RXD_ON_INSECURE_PORT;
                 NL_LOG_CRIT(lrTHCI, "Received secure message on insecure port\n");
             }
         }
     }
 
+#if THCI_CONFIG_DEFERRED_LOG
+    thciDeferredLogIp6(kThciLogIdIpRx, &ip6Hdr, argLen, isSecure, thciGetChecksum(pbuf));
+#else
     NL_LOG_DEBUG(lrTHCI, "IP RX len: %u secure: %s cksum: 0x%04x\n", argLen, ((isSecure) ? "yes" : "no"), thciGetChecksum(pbuf));
     NL_LOG_DEBUG(lrTHCI, "from: %s\n", ip6addr_ntoa((const ip6_addr_t *)&ip6Hdr.src));  // IPv6 Header Source
     NL_LOG_DEBUG(lrTHCI, "  to: %s\n", ip6addr_ntoa((const ip6_addr_t *)&ip6Hdr.dest)); // IPv6 Header Destination
-
-#if THCI_CONFIG_LEGACY_ALARM_SUPPORT
-    if (aCommand == SPINEL_CMD_VENDOR_NEST_PROP_VALUE_IS)
-    {
-        tag = THCI_NETIF_TAG_LEGACY;
-    }
 #endif
 
-    err = tcpip_input(pbuf, gTHCISDKContext.mNetif[tag]);
+    err = THCI_FAULT_TCPIP_INPUT(pbuf, sdk->mNetif[tag]);
 
     if (err == ERR_OK)
     {
         pbuf = NULL;
+        delivered = true;
+        THCI_ATTACH_STATS_DATAGRAM_RECEIVED();
     }
 
  done:
@@ -808,11 +1131,23 @@ static void ReceiveIp6Datagram(unsigned int aCommand, spinel_prop_key_t aKey, co
         pbuf_free(pbuf);
     }
 
+    if (delivered)
+    {
+        counters->mRxPackets++;
+        counters->mRxBytes += argLen;
+    }
+    else
+    {
+        counters->mRxDropped++;
+    }
+
     return;
 }
 
 static int StateChangeEventHandler(nl_event_t *aEvent, void *aClosure)
 {
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventStateChange);
+
     if (gTHCINCPContext.mStateChangeCallback)
     {
         uint32_t flags = gTHCINCPContext.mStateChangeFlags;
@@ -820,11 +1155,15 @@ static int StateChangeEventHandler(nl_event_t *aEvent, void *aClosure)
         gTHCINCPContext.mStateChangeCallback(flags, NULL);
     }
 
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventStateChange);
+
     return NLER_SUCCESS;
 }
 
 static int LegacyUlaChangeEventHandler(nl_event_t *aEvent, void *aClosure)
 {
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventLegacyUla);
+
     for (size_t i = 0 ; i < THCI_NUM_CALLBACK_BUFFERS ; i++)
     {
         if (gTHCINCPContext.mCallbackBuffers[i].mState == kCallbackBufferStateLegacyUla)
@@ -838,11 +1177,15 @@ static int LegacyUlaChangeEventHandler(nl_event_t *aEvent, void *aClosure)
         }
     }
 
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventLegacyUla);
+
     return NLER_SUCCESS;
 }
 
 static int ScanResultEventHandler(nl_event_t *aEvent, void *aClosure)
 {
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventScanResult);
+
     for (size_t i = 0 ; i < THCI_NUM_CALLBACK_BUFFERS ; i++)
     {
         if (gTHCINCPContext.mCallbackBuffers[i].mState == kCallbackBufferStateScanResult)
@@ -856,76 +1199,239 @@ static int ScanResultEventHandler(nl_event_t *aEvent, void *aClosure)
         }
     }
 
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventScanResult);
+
     return NLER_SUCCESS;
 }
 
 static int ScanCompleteEventHandler(nl_event_t *aEvent, void *aClosure)
 {
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventScanComplete);
+
     if (gTHCINCPContext.mScanResultCallback)
     {
         // pass NULL as the scan result to indicate scan complete.
         gTHCINCPContext.mScanResultCallback(NULL, gTHCINCPContext.mScanResultCallbackContext);
     }
 
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventScanComplete);
+
     return NLER_SUCCESS;
 }
 
 static int NCPRecoveryEventHandler(nl_event_t *aEvent, void *aClosure)
 {
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventNCPRecovery);
+
+#if THCI_CONFIG_ASYNC_REQUESTS
+    AbortAsyncRequests();
+#endif
+
     // announce recovery to Upper layer so that it can re-establish state.
     if (gTHCINCPContext.mResetRecoveryCallback)
     {
         gTHCINCPContext.mResetRecoveryCallback();
     }
 
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventNCPRecovery);
+
     return NLER_SUCCESS;
 }
 
-// This function handles unsolicited control frames from the NCP.
-// Handling consists of extracting pertinent information from aArgPtr and posting an appropriate event for
-// post processing.  Posting an event is necessary to avoid recursive execution.
-// Do not call client callbacks from this function as those callbacks may make calls to
-// thci API's which result in a new effort to extract bytes from the UART fifo. This call was made from
-// the UART fifo extraction routine, hence executing callbacks from here could result in recursive execution.
-static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen)
+#if THCI_CONFIG_RF_TEST
+static void PostRfTestEvent(void)
 {
-    spinel_ssize_t parsedLength;
-    uint32_t prevStateFlags = gTHCINCPContext.mStateChangeFlags;
+    if (!sRfTest.mEventPosted)
+    {
+        sRfTest.mEventPosted = 1;
+        THCI_EVENT_STATS_POSTED(kThciEventRfTest);
+        nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sRfTestEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventRfTest);
+    }
+}
 
-    if (aCommand == SPINEL_CMD_PROP_VALUE_IS)
+static void UnpackRfTestHistogram(const uint8_t *aData, spinel_size_t aLength, uint16_t *aHistogram)
+{
+    for (size_t i = 0; i < THCI_RF_TEST_HISTOGRAM_BUCKETS && (i + 1) * sizeof(uint16_t) <= aLength; i++)
     {
-        switch ((uint16_t)aKey)
-        {
-        case SPINEL_PROP_LAST_STATUS:
-            HandleLastStatusUpdate(aArgPtr, aArgLen);
-            break;
+        spinel_datatype_unpack(&aData[i * sizeof(uint16_t)], sizeof(uint16_t), SPINEL_DATATYPE_UINT16_S, &aHistogram[i]);
+    }
+}
 
-        case SPINEL_PROP_NET_ROLE:
-            {
-                // OpenThread Role Change
-                spinel_net_role_t spinelRole;
+static void HandleRfTestResult(const uint8_t *aArgPtr, unsigned int aArgLen)
+{
+    thci_rf_test_result_t *result;
+    const uint8_t *lqi = NULL;
+    const uint8_t *rssi = NULL;
+    spinel_size_t lqiLen = 0;
+    spinel_size_t rssiLen = 0;
+    uint8_t mode;
+    spinel_ssize_t parsedLength;
 
-                parsedLength = spinel_datatype_unpack(aArgPtr, aArgLen, SPINEL_DATATYPE_UINT8_S, &spinelRole);
-                nlREQUIRE_ACTION(parsedLength > 0, done, NL_LOG_CRIT(lrTHCI, "Failed to parse role from frame.\n"));
+    nlREQUIRE(sRfTest.mActive, done);
+    nlREQUIRE_ACTION(sRfTest.mCount < kRfTestResultQueueSize, done, sRfTest.mDropped++);
+
+    result = &sRfTest.mResults[(sRfTest.mHead + sRfTest.mCount) % kRfTestResultQueueSize];
+    memset(result, 0, sizeof(*result));
+
+    parsedLength = spinel_datatype_unpack(aArgPtr, aArgLen, "SCCcSLLLLdd",
+                                          &result->mStep,
+                                          &mode,
+                                          &result->mChannel,
+                                          &result->mPower,
+                                          &result->mFrameCount,
+                                          &result->mFramesSent,
+                                          &result->mFramesReceived,
+                                          &result->mFrameErrors,
+                                          &result->mDuration,
+                                          &lqi, &lqiLen,
+                                          &rssi, &rssiLen);
+    nlREQUIRE_ACTION(parsedLength > 0, done, NL_LOG_CRIT(lrTHCI, "Failed to parse rf test result.\n"));
+
+    result->mMode = (thci_rf_test_mode_t)mode;
+    UnpackRfTestHistogram(lqi, lqiLen, result->mLqiHistogram);
+    UnpackRfTestHistogram(rssi, rssiLen, result->mRssiHistogram);
+
+    sRfTest.mCount++;
+    PostRfTestEvent();
 
-                gTHCISDKContext.mDeviceRole = TranslateSpinelRole(spinelRole);
+ done:
+    return;
+}
 
-                gTHCINCPContext.mStateChangeFlags |= OT_CHANGED_THREAD_ROLE;
-            }
-            break;
+static void CompleteRfTest(void)
+{
+    if (sRfTest.mActive)
+    {
+        sRfTest.mComplete = true;
+        PostRfTestEvent();
+    }
+}
 
-        case SPINEL_PROP_NEST_LEGACY_ULA_PREFIX:
-            {
-                const uint8_t *legacyUlaPrefix = NULL;
-                spinel_size_t len;
-                callback_buffer_t *callbackBuffer = AllocateCallbackBuffer(kCallbackBufferStateLegacyUla);
+static int RfTestEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventRfTest);
 
-                nlREQUIRE(callbackBuffer != NULL, done);
+    sRfTest.mEventPosted = 0;
 
-                parsedLength = spinel_datatype_unpack(aArgPtr, aArgLen, SPINEL_DATATYPE_DATA_S, &legacyUlaPrefix, &len);
-                nlREQUIRE_ACTION(parsedLength > 0, done, NL_LOG_CRIT(lrTHCI, "Failed to parse legacy ula.\n"));
+    // The callback may call into THCI and queue more results.
+    while (sRfTest.mCount > 0)
+    {
+        const thci_rf_test_result_t *result = &sRfTest.mResults[sRfTest.mHead];
 
-                memcpy(&callbackBuffer->mContent.mLegacyUla[0], legacyUlaPrefix, THCI_LEGACY_ULA_SIZE_BYTES);
+        if (sRfTest.mCallback)
+        {
+            sRfTest.mCallback(result, sRfTest.mContext);
+        }
+
+        sRfTest.mHead = (sRfTest.mHead + 1) % kRfTestResultQueueSize;
+        sRfTest.mCount--;
+    }
+
+    if (sRfTest.mActive && sRfTest.mComplete)
+    {
+        sRfTest.mActive = false;
+
+        if (sRfTest.mDropped)
+        {
+            NL_LOG_CRIT(lrTHCI, "rf test: %u results dropped\n", sRfTest.mDropped);
+        }
+
+        if (sRfTest.mCallback)
+        {
+            // pass NULL as the result to indicate the end of the sequence.
+            sRfTest.mCallback(NULL, sRfTest.mContext);
+        }
+    }
+
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventRfTest);
+
+    return NLER_SUCCESS;
+}
+#endif // THCI_CONFIG_RF_TEST
+
+// The control state here is that of the Thread interface, IID 0.  A property
+// of a secondary interface would be taken for its own, so only the legacy ULA
+// prefix is taken from the legacy netif IID.
+static bool IsControlFrameIidHandled(uint8_t aHeader, spinel_prop_key_t aKey)
+{
+    const uint8_t iid = SPINEL_HEADER_GET_IID(aHeader);
+    bool retval = (iid == 0);
+
+#if THCI_CONFIG_SPINEL_IID_MUX && THCI_CONFIG_LEGACY_ALARM_SUPPORT
+    retval = retval || ((iid == kNetifIids[THCI_NETIF_TAG_LEGACY]) && (aKey == SPINEL_PROP_NEST_LEGACY_ULA_PREFIX));
+#endif
+
+    (void)aKey;
+
+    return retval;
+}
+
+// This function handles unsolicited control frames from the NCP.
+// Handling consists of extracting pertinent information from aArgPtr and posting an appropriate event for
+// post processing.  Posting an event is necessary to avoid recursive execution.
+// Do not call client callbacks from this function as those callbacks may make calls to
+// thci API's which result in a new effort to extract bytes from the UART fifo. This call was made from
+// the UART fifo extraction routine, hence executing callbacks from here could result in recursive execution.
+static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen)
+{
+    spinel_ssize_t parsedLength;
+    uint32_t prevStateFlags = gTHCINCPContext.mStateChangeFlags;
+
+#if THCI_CONFIG_NCP_HEALTH
+    thciHealthTick();
+#endif
+
+    nlREQUIRE_ACTION(IsControlFrameIidHandled(aHeader, aKey), done,
+                     NL_LOG_DEBUG(lrTHCI, "Dropped control frame for Spinel IID %u\n", SPINEL_HEADER_GET_IID(aHeader)));
+
+#if THCI_CONFIG_ASYNC_REQUESTS
+    nlREQUIRE(!HandleAsyncResponse(aHeader, aCommand, aKey, aArgPtr, aArgLen), done);
+#endif
+
+    NotifyRawFrameObserver(THCI_INSTANCE_INDEX(), aCommand, aKey, aArgPtr, aArgLen);
+
+    if (aCommand == SPINEL_CMD_PROP_VALUE_IS)
+    {
+        switch ((uint16_t)aKey)
+        {
+        case SPINEL_PROP_LAST_STATUS:
+            HandleLastStatusUpdate(aArgPtr, aArgLen);
+            break;
+
+        case SPINEL_PROP_NET_ROLE:
+            {
+                // OpenThread Role Change
+                spinel_net_role_t spinelRole;
+
+                parsedLength = spinel_datatype_unpack(aArgPtr, aArgLen, SPINEL_DATATYPE_UINT8_S, &spinelRole);
+                nlREQUIRE_ACTION(parsedLength > 0, done, NL_LOG_CRIT(lrTHCI, "Failed to parse role from frame.\n"));
+
+                gTHCISDKContext.mDeviceRole = TranslateSpinelRole(spinelRole);
+
+                THCI_ATTACH_STATS_ROLE_CHANGED(gTHCISDKContext.mDeviceRole);
+
+                gTHCINCPContext.mStateChangeFlags |= OT_CHANGED_THREAD_ROLE;
+            }
+            break;
+
+        case SPINEL_PROP_NEST_LEGACY_ULA_PREFIX:
+            {
+                const uint8_t *legacyUlaPrefix = NULL;
+                spinel_size_t len;
+                callback_buffer_t *callbackBuffer = AllocateCallbackBuffer(kCallbackBufferStateLegacyUla);
+
+                nlREQUIRE(callbackBuffer != NULL, done);
+
+                parsedLength = spinel_datatype_unpack(aArgPtr, aArgLen, SPINEL_DATATYPE_DATA_S, &legacyUlaPrefix, &len);
+                nlREQUIRE_ACTION(parsedLength > 0, done, NL_LOG_CRIT(lrTHCI, "Failed to parse legacy ula.\n"));
+
+                memcpy(&callbackBuffer->mContent.mLegacyUla[0], legacyUlaPrefix, THCI_LEGACY_ULA_SIZE_BYTES);
+
+                THCI_EVENT_STATS_POSTED(kThciEventLegacyUla);
 
                 nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sLegacyUlaChangeEvent);
             }
@@ -933,6 +1439,7 @@ static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_p
 
         case SPINEL_PROP_MAC_SCAN_STATE:
             // scan complete
+            THCI_EVENT_STATS_POSTED(kThciEventScanComplete);
             nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sScanCompleteEvent);
             break;
 
@@ -945,6 +1452,10 @@ static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_p
             // there is no way to know. NetworkManager currently doesn't care which flag provoked
             // this property event.
             gTHCINCPContext.mStateChangeFlags |= OT_CHANGED_IP6_ADDRESS_ADDED;
+
+#if THCI_CONFIG_ATTACH_STATS
+            HandleAddressTableUpdate(aArgPtr, aArgLen);
+#endif
             break;
 
         case SPINEL_PROP_IPV6_MULTICAST_ADDRESS_TABLE:
@@ -956,7 +1467,8 @@ static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_p
 
 #if THCI_CONFIG_LOG_NCP_LOGS
         case SPINEL_PROP_STREAM_DEBUG:
-            HandleDebugStream(aArgPtr, aArgLen);
+            // Only capture the raw stream here, line splitting and logging is done by the flush event.
+            thciNcpLogAppend(aArgPtr, (uint16_t)aArgLen);
             break;
 #endif
 
@@ -965,6 +1477,13 @@ static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_p
             HandleNetworkWake(aArgPtr, aArgLen);
             break;
 #endif
+
+#if THCI_CONFIG_RF_TEST
+        case SPINEL_PROP_VENDOR_NEST_RF_TEST:
+            // end of the sequence
+            CompleteRfTest();
+            break;
+#endif
         default:
             break; // Ignore this control frame.
         }
@@ -972,6 +1491,7 @@ static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_p
         // If mStateChangeFlags transitioned from 0 to non-zero an StateChangeEvent needs to be posted.
         if (!prevStateFlags && gTHCINCPContext.mStateChangeFlags)
         {
+            THCI_EVENT_STATS_POSTED(kThciEventStateChange);
             nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sStateChangeEvent);
         }
     }
@@ -1013,10 +1533,18 @@ static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_p
                 memcpy(result->mExtendedPanId.m8, xpanid, sizeof(result->mExtendedPanId.m8));
                 result->mIsJoinable = (flags & SPINEL_BEACON_THREAD_FLAG_JOINABLE) ? true : false;
 
+                THCI_EVENT_STATS_POSTED(kThciEventScanResult);
+
                 nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sScanResultEvent);
             }
             break;
 
+#if THCI_CONFIG_RF_TEST
+        case SPINEL_PROP_VENDOR_NEST_RF_TEST:
+            HandleRfTestResult(aArgPtr, aArgLen);
+            break;
+#endif
+
         default:
             break; // Ignore this control frame.
         }
@@ -1026,6 +1554,22 @@ static void ReceiveControlFrame(uint8_t aHeader, unsigned int aCommand, spinel_p
     return;
 }
 
+// Race conditions can exist between the LWIP task in LwIPOutputIP6 and the THCI task
+// which can result in multiple sOutgoingIPPacketEvents posted to the event queue.
+// This __sync_fetch_and_or ensures that only one sOutgoingIPPacketEvent is ever posted to the queue.
+static void PostOutgoingIPPacketEvent(uint8_t aInstanceIndex)
+{
+    if (!__sync_fetch_and_or(&sOutgoingIPPacketEventPostedFlags[aInstanceIndex], 1))
+    {
+        THCI_EVENT_STATS_POSTED(kThciEventOutgoingIPPacket);
+        nl_eventqueue_post_event(gTHCISDKContexts[aInstanceIndex].mInitParams.mSdkQueue, &sOutgoingIPPacketEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventOutgoingIPPacket);
+    }
+}
+
 /* Called by LwIP for transmission of IP packets.
  *
  * Note that the pbuf q passed in is not owned by this method. Thus, it must
@@ -1036,54 +1580,89 @@ static err_t LwIPOutputIP6(struct netif *netif, struct pbuf *pbuf,
 {
     err_t retval = ERR_OK;
     thci_message_t *message = NULL;
+    uint8_t queue = THCI_MESSAGE_QUEUE_OF(THCI_NETIF_TAG_THREAD);
+#if THCI_CONFIG_MAX_INSTANCES > 1
+    thci_instance_t *instance = thciGetNetifInstance(netif);
+    const uint8_t index = (instance != NULL) ? instance->mIndex : 0;
+    thci_instance_t *previous;
+#else
+    const uint8_t index = 0;
+#endif
+    thci_sdk_context_t *sdk = &gTHCISDKContexts[index];
+    thci_datapath_counters_t *counters = &sDatapathCountersTable[index];
+
+#if THCI_CONFIG_FAULT_INJECTION
+    if (THCI_FAULT_ACTIVE(kThciFaultStreamIpTx) && thciFaultOutput(netif, pbuf, ipaddr, &retval))
+    {
+        return retval;
+    }
+#endif
 
-#ifdef BUILD_FEATURE_THCI_CERT
-    thci_cert_tx_corrupt(pbuf);
-#endif //BUILD_FEATURE_THCI_CERT
+#if THCI_CONFIG_MAX_INSTANCES > 1
+    // LwIP calls this on the tcpip task, which serves every instance: act
+    // on the instance that owns the netif.  The data path below is passed
+    // its index; the binding is for the logs.
+    previous = thciSetCurrentInstance(instance);
+#endif
 
     nlREQUIRE_ACTION(pbuf->len <= (NL_THCI_PAYLOAD_MTU), done, retval = ERR_VAL);
 #if THCI_CONFIG_LEGACY_ALARM_SUPPORT
-    nlREQUIRE_ACTION(netif == gTHCISDKContext.mNetif[THCI_NETIF_TAG_THREAD] || netif == gTHCISDKContext.mNetif[THCI_NETIF_TAG_LEGACY], done, retval = ERR_IF);
+    nlREQUIRE_ACTION(netif == sdk->mNetif[THCI_NETIF_TAG_THREAD] || netif == sdk->mNetif[THCI_NETIF_TAG_LEGACY], done, retval = ERR_IF);
 #else
-    nlREQUIRE_ACTION(netif == gTHCISDKContext.mNetif[THCI_NETIF_TAG_THREAD], done, retval = ERR_IF);
+    nlREQUIRE_ACTION(netif == sdk->mNetif[THCI_NETIF_TAG_THREAD], done, retval = ERR_IF);
 #endif
-    nlREQUIRE_ACTION(0 == CreateTHCIMessageFromPbuf(pbuf, &message), done, retval = ERR_MEM);
+    nlREQUIRE_ACTION(0 == CreateTHCIMessageFromPbuf(index, pbuf, &message), done, retval = ERR_MEM);
 
 #if THCI_CONFIG_LEGACY_ALARM_SUPPORT
-    if (netif == gTHCISDKContext.mNetif[THCI_NETIF_TAG_LEGACY])
+    if (netif == sdk->mNetif[THCI_NETIF_TAG_LEGACY])
     {
         SetMessageLegacy(message, true);
+        queue = THCI_MESSAGE_QUEUE_OF(THCI_NETIF_TAG_LEGACY);
     }
 #endif
-    nlREQUIRE_ACTION(0 == EnqueueMessage((otMessage*)message), done, retval = ERR_INPROGRESS);
+    nlREQUIRE_ACTION(0 == EnqueueMessage(sdk, queue, (otMessage*)message), done, retval = ERR_INPROGRESS);
 
     {
         struct ip6_hdr *pHeader = pbuf->payload;
 
+#if THCI_CONFIG_DEFERRED_LOG
+        thciDeferredLogIp6(kThciLogIdIpTx, pHeader, message->mLength, IsMessageSecure(message), thciGetChecksum(pbuf));
+#else
         NL_LOG_DEBUG(lrTHCI, "IP TX len: %u secure: %s cksum: 0x%04x\n", message->mLength, ((IsMessageSecure(message)) ? "yes" : "no"), thciGetChecksum(pbuf));
         NL_LOG_DEBUG(lrTHCI, "from: %s\n", ip6addr_ntoa((const ip6_addr_t*)&(pHeader->src)));  // IPv6 Header Source
         NL_LOG_DEBUG(lrTHCI, "  to: %s\n", ip6addr_ntoa((const ip6_addr_t*)&(pHeader->dest))); // IPv6 Header Destination
+#endif
     }
 
-    // Race conditions can exist between the LWIP task here and the THCI task 
-    // in OutgoingIPPacketEventHandler which can result in multiple sOutgoingIPPacketEvents posted to the event queue.
-    // This __sync_fetch_and_or ensures that only one sOutgoingIPPacketEvent is ever posted to the queue.
-    if (!__sync_fetch_and_or(&sOutgoingIPPacketEventPosted, 1))
-    {
-        nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sOutgoingIPPacketEvent);
-    }
+    PostOutgoingIPPacketEvent(index);
+
+    counters->mTxPackets++;
+    counters->mTxBytes += pbuf->tot_len;
 
  done:
     if (retval != ERR_OK)
     {
         NL_LOG_CRIT(lrTHCI, "Message queue error (%d)...dropping outgoing packet.\n", retval);
 
+        if (retval == ERR_MEM)
+        {
+            counters->mTxDropNoBufs++;
+        }
+        else
+        {
+            counters->mTxDropOther++;
+        }
+
         if (message)
         {
-            FreeMessage(message);
+            FreeMessage(index, message);
         }
     }
 
+#if THCI_CONFIG_MAX_INSTANCES > 1
+    thciSetCurrentInstance(previous);
+#endif
+
     return retval;
 }
 
@@ -1106,7 +1685,14 @@ static void OpenSourcePort(thci_message_t *aMessage)
 
     srcPort = lwip_ntohs(srcPort);
 
+#if THCI_CONFIG_DEFERRED_LOG
+    {
+        const uint32_t port = srcPort;
+        thciDeferredLog(kThciLogIdOpenPort, &port, 1);
+    }
+#else
     NL_LOG_DEBUG(lrTHCI, "Open Port %d\n", srcPort);
+#endif
 
     error = thciAddUnsecurePort(srcPort);
     nlREQUIRE(error == OT_ERROR_NONE, done);
@@ -1125,71 +1711,150 @@ static void OpenSourcePort(thci_message_t *aMessage)
     return;
 }
 
-// Process pbufs on the outgoing queue.
-static int OutgoingIPPacketEventHandler(nl_event_t *aEvent, void *aClosure)
+static bool IsMessageQueueReady(uint8_t aInstanceIndex, uint8_t aQueue)
 {
-    thci_message_t *message;
-    otError status = OT_ERROR_NONE;
-    spinel_prop_key_t key;
-    uint32_t command;
+    const thci_sdk_context_t *sdk = &gTHCISDKContexts[aInstanceIndex];
 
-    sOutgoingIPPacketEventPosted = 0;
+    return (!IsMessageQueueEmpty(sdk, aQueue) && !(sdk->mStalledMessageQueues & (1 << aQueue)));
+}
 
-    nlREQUIRE(gTHCINCPContext.mModuleState == kModuleStateInitialized, done);
-    // When the Stall is on don't post an event even if message queue is not empty.
-    nlREQUIRE(!gTHCISDKContext.mStallOutgoingDataPackets, nopost_exit);
+static bool HasReadyMessages(uint8_t aInstanceIndex)
+{
+    bool retval = false;
 
-    while(!IsMessageQueueEmpty())
+    for (uint8_t queue = 0; (queue < THCI_MESSAGE_QUEUE_COUNT) && !retval; queue++)
     {
-        message = (thci_message_t *)DequeueMessage();
+        retval = IsMessageQueueReady(aInstanceIndex, queue);
+    }
 
-        if (NeedToOpenInsecureSourcePort())
-        {
-            // If this condition is true, then this is a device that is joining provisionally.
-            // As such, it is necessary that the source port also be made insecure. We pass the
-            // outgoing IP packet to OpenSourcePort so that it can extract the source
-            // port from the TCP header and add it to OT's insecure port list.
-            OpenSourcePort(message);
-        }
+    return retval;
+}
+
+// Send one outgoing IP packet to the NCP and wait for its status.  Frees aMessage.
+static otError SendIp6Datagram(uint8_t aInstanceIndex, thci_message_t *aMessage)
+{
+    otError status = OT_ERROR_NONE;
+    spinel_prop_key_t key;
+    uint32_t command;
+    uint8_t iid = 0;
+    uint8_t tid = GetNewTransactionId();
+    uint32_t last;
+    spinel_ssize_t parsedLength;
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
 
 #if THCI_CONFIG_LEGACY_ALARM_SUPPORT
-        if (IsMessageLegacy(message))
+    if (IsMessageLegacy(aMessage))
+    {
+#if THCI_CONFIG_SPINEL_IID_MUX
+        // An NCP without the interface would take the packet for the
+        // Thread netif.
+        if (!thciNcpHasCap(SPINEL_CAP_VENDOR_NEST_IID_MUX))
         {
-            command = SPINEL_CMD_VENDOR_NEST_PROP_VALUE_SET;
-            key = SPINEL_PROP_STREAM_NET;
+            sDatapathCountersTable[aInstanceIndex].mTxRejected++;
+            NL_LOG_CRIT(lrTHCI, "NCP has no legacy Spinel IID! %u\n", aMessage->mLength);
+
+            FreeMessage(aInstanceIndex, aMessage);
+            status = OT_ERROR_NOT_CAPABLE;
+            goto done;
         }
-        else
+
+        command = SPINEL_CMD_PROP_VALUE_SET;
+        iid = kNetifIids[THCI_NETIF_TAG_LEGACY];
+#else
+        command = SPINEL_CMD_VENDOR_NEST_PROP_VALUE_SET;
 #endif
-        {
-            command = SPINEL_CMD_PROP_VALUE_SET;
-            key = (IsMessageSecure(message)) ? SPINEL_PROP_STREAM_NET : SPINEL_PROP_STREAM_NET_INSECURE;
-        }
+        key = SPINEL_PROP_STREAM_NET;
+    }
+    else
+#endif
+    {
+        command = SPINEL_CMD_PROP_VALUE_SET;
+        key = (IsMessageSecure(aMessage)) ? SPINEL_PROP_STREAM_NET : SPINEL_PROP_STREAM_NET_INSECURE;
+    }
 
-        {
-            uint8_t tid = GetNewTransactionId();
-            uint32_t last;
-            spinel_ssize_t parsedLength;
-            const uint8_t *argPtr = NULL;
-            size_t argLen;
+    // The NCP would drop the frame, and the wait for its status time out.
+    if (aMessage->mLength + kSpinelStreamFrameOverhead > gTHCINCPContexts[aInstanceIndex].mCaps.mMaxFrameSize)
+    {
+        sDatapathCountersTable[aInstanceIndex].mTxRejected++;
+        NL_LOG_CRIT(lrTHCI, "IP packet too long for the NCP! %u\n", aMessage->mLength);
 
-            status = thciUartFrameSend(tid, command, key, SPINEL_DATATYPE_DATA_WLEN_S, message->mBuffer, message->mLength);
+        FreeMessage(aInstanceIndex, aMessage);
+        goto done;
+    }
 
-            FreeMessage(message);
-            nlREQUIRE(status == OT_ERROR_NONE, done);
+    status = thciUartFrameSendOnIid(iid, tid, command, key, SPINEL_DATATYPE_DATA_WLEN_S, aMessage->mBuffer, aMessage->mLength);
 
+    FreeMessage(aInstanceIndex, aMessage);
+    nlREQUIRE(status == OT_ERROR_NONE, done);
 
-            status = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_LAST_STATUS, &argPtr, &argLen);
-            nlREQUIRE(status == OT_ERROR_NONE, done);
+    status = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_LAST_STATUS, &argPtr, &argLen);
+    nlREQUIRE(status == OT_ERROR_NONE, done);
+
+    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UINT_PACKED_S, &last);
+    nlREQUIRE_ACTION(parsedLength > 0, done, status = OT_ERROR_PARSE);
+
+    if (last != SPINEL_STATUS_OK)
+    {
+        sDatapathCountersTable[aInstanceIndex].mTxRejected++;
+        NL_LOG_CRIT(lrTHCI, "IP packet NCP rejected! %x %x\n", last, key);
+    }
+
+ done:
+    return status;
+}
+
+// Process pbufs on the outgoing queues.  When each netif has its own queue
+// the queues are served round robin, one packet each per round, so that a
+// busy netif cannot starve the others.
+static int OutgoingIPPacketEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_sdk_context_t *sdk = &gTHCISDKContexts[index];
+    thci_message_t *message;
+    otError status = OT_ERROR_NONE;
+    bool sent;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventOutgoingIPPacket);
+
+    sOutgoingIPPacketEventPostedFlags[index] = 0;
+
+#if THCI_CONFIG_NCP_HEALTH
+    thciHealthTick();
+#endif
+
+    nlREQUIRE(gTHCINCPContexts[index].mModuleState == kModuleStateInitialized, done);
+    // When the Stall is on don't post an event even if message queue is not empty.
+    nlREQUIRE(!sdk->mStallOutgoingDataPackets, nopost_exit);
+
+    do
+    {
+        sent = false;
+
+        for (uint8_t queue = 0; queue < THCI_MESSAGE_QUEUE_COUNT; queue++)
+        {
+            if (!IsMessageQueueReady(index, queue))
+            {
+                continue;
+            }
 
-            parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UINT_PACKED_S, &last);
-            nlREQUIRE_ACTION(parsedLength > 0, done, status = OT_ERROR_PARSE);
+            message = (thci_message_t *)DequeueMessage(sdk, queue);
 
-            if (last != SPINEL_STATUS_OK)
+            if (NeedToOpenInsecureSourcePort(sdk))
             {
-                NL_LOG_CRIT(lrTHCI, "IP packet NCP rejected! %x %x\n", last, key);
+                // If this condition is true, then this is a device that is joining provisionally.
+                // As such, it is necessary that the source port also be made insecure. We pass the
+                // outgoing IP packet to OpenSourcePort so that it can extract the source
+                // port from the TCP header and add it to OT's insecure port list.
+                OpenSourcePort(message);
             }
+
+            status = SendIp6Datagram(index, message);
+            nlREQUIRE(status == OT_ERROR_NONE, done);
+
+            sent = true;
         }
-    }
+    } while (sent);
 
  done:
     if (status != OT_ERROR_NONE)
@@ -1197,22 +1862,17 @@ static int OutgoingIPPacketEventHandler(nl_event_t *aEvent, void *aClosure)
         NL_LOG_CRIT(lrTHCI, "ERROR: OutgoingIPPacketEventHandler %d\n", status);
     }
 
-    if (!IsMessageQueueEmpty())
+    if (HasReadyMessages(index))
     {
         // If this function exits while the message queue is not empty an event must be posted so that the
         // producer-consumer flow does not stall. This can happen for instance if this function
         // exits prematurely with an error.
-
-        // Race conditions can exist between the LWIP task in LwIPOutputIP6 and the THCI task 
-        // here which can result in multiple sOutgoingIPPacketEvents posted to the event queue.
-        // This __sync_fetch_and_or ensures that only one sOutgoingIPPacketEvent is ever posted to the queue.
-        if (!__sync_fetch_and_or(&sOutgoingIPPacketEventPosted, 1))
-        {
-            nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sOutgoingIPPacketEvent);
-        }
+        PostOutgoingIPPacketEvent(index);
     }
 
  nopost_exit:
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventOutgoingIPPacket);
+
     return NLER_SUCCESS;
 }
 
@@ -1302,60 +1962,163 @@ done:
     return retval;
 }
 
-static otError thciGetSpinelDataProperty(spinel_prop_key_t aKey, spinel_datatype_t *aType, 
-                                         uint8_t *aOutData, uint16_t aInSize, uint16_t *aOutSize)
+typedef struct
 {
-    otError retval = OT_ERROR_NONE;
-    uint8_t tid = GetNewTransactionId();
+    uint8_t                     *mData;
+    uint16_t                    mSize;
+    uint16_t                    mLength;
+} thci_data_page_context_t;
+
+typedef struct
+{
+    void                        *mTable;        // of mSize entries.
+    uint32_t                    mSize;
+    uint32_t                    mCount;
+    uint32_t                    mChildren;      // neighbors that are children, still to match.
+} thci_table_page_context_t;
+
+/**
+ * Called with the entries of a table property: a page at a time from an
+ * NCP that supports SPINEL_PROP_VENDOR_NEST_TABLE_PAGE, otherwise all of
+ * them at once.  Returns OT_ERROR_ABORT to stop once the caller is done
+ * with the table, or another error to fail the retrieval.
+ */
+typedef otError (*thciTablePageHandler)(const uint8_t *aEntries, size_t aLength, void *aContext);
+
+/**
+ * Reads the table property aKey and passes its entries to aHandler.  Paged,
+ * the table is not bounded by the RX frame; as the NCP may change it
+ * between pages, an entry may then be missed or seen twice.
+ */
+static otError GetTableProperty(spinel_prop_key_t aKey, thciTablePageHandler aHandler, void *aContext)
+{
+    otError retval;
+    uint8_t tid;
     const uint8_t *argPtr = NULL;
     size_t argLen;
-    spinel_ssize_t parseLength;
-    uint8_t *dataPtr = NULL;
-    unsigned int dataLen;
+    spinel_ssize_t parsedLength;
+    unsigned int key;
+    uint16_t maxFrameSize;
+    uint16_t first = 0;
+    uint16_t pageFirst;
+    uint16_t pageCount;
+    uint16_t total;
 
-    nlREQUIRE_ACTION(aOutData != NULL, done, retval = OT_ERROR_INVALID_ARGS);
-    nlREQUIRE_ACTION(aOutSize != NULL, done, retval = OT_ERROR_INVALID_ARGS);
-    nlREQUIRE_ACTION(aInSize  >  0,    done, retval = OT_ERROR_INVALID_ARGS);
     nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
 
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, aKey, NULL);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+    if (!thciNcpHasCap(SPINEL_CAP_VENDOR_NEST_TABLE_PAGE))
+    {
+        tid = GetNewTransactionId();
 
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, aKey, &argPtr, &argLen);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+        retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, aKey, NULL);
+        nlREQUIRE(retval == OT_ERROR_NONE, done);
 
-    parseLength = spinel_datatype_unpack(argPtr, argLen, aType, &dataPtr, &dataLen);
-    nlREQUIRE_ACTION(parseLength >  0, done, retval = OT_ERROR_FAILED);
-    nlREQUIRE_ACTION(dataPtr     != 0, done, retval = OT_ERROR_FAILED);
+        retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, aKey, &argPtr, &argLen);
+        nlREQUIRE(retval == OT_ERROR_NONE, done);
 
-    nlREQUIRE_ACTION(dataLen <= aInSize, done, retval = OT_ERROR_FAILED);
+        retval = aHandler(argPtr, argLen, aContext);
+        goto done;
+    }
 
-    memcpy(aOutData, dataPtr, dataLen);
-    *aOutSize = dataLen;
+    // Each page fits both the RX frame of THCI and the frames of the NCP.
+    maxFrameSize = thciUartGetMaxRxFrameSize();
 
-done:
+    if (maxFrameSize > gTHCINCPContext.mCaps.mMaxFrameSize)
+    {
+        maxFrameSize = gTHCINCPContext.mCaps.mMaxFrameSize;
+    }
+
+    nlREQUIRE_ACTION(maxFrameSize > kTablePageOverhead, done, retval = OT_ERROR_NO_BUFS);
+
+    do
+    {
+        tid = GetNewTransactionId();
+
+        retval = thciUartFrameSend(tid, SPINEL_CMD_VENDOR_NEST_PROP_VALUE_GET, SPINEL_PROP_VENDOR_NEST_TABLE_PAGE,
+                                   SPINEL_DATATYPE_UINT_PACKED_S SPINEL_DATATYPE_UINT16_S SPINEL_DATATYPE_UINT16_S,
+                                   aKey, first, maxFrameSize - kTablePageOverhead);
+        nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+        retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_VENDOR_NEST_TABLE_PAGE, &argPtr, &argLen);
+        nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+        parsedLength = spinel_datatype_unpack(argPtr, argLen,
+                                              SPINEL_DATATYPE_UINT_PACKED_S // Table property
+                                              SPINEL_DATATYPE_UINT16_S      // First entry
+                                              SPINEL_DATATYPE_UINT16_S      // Entries in the page
+                                              SPINEL_DATATYPE_UINT16_S,     // Entries in the table
+                                              &key,
+                                              &pageFirst,
+                                              &pageCount,
+                                              &total);
+        nlREQUIRE_ACTION(parsedLength > 0 && key == aKey && pageFirst == first, done, retval = OT_ERROR_PARSE);
+
+        retval = aHandler(argPtr + parsedLength, argLen - parsedLength, aContext);
+
+        first += pageCount;
+    } while (retval == OT_ERROR_NONE && pageCount > 0 && first < total);
+
+ done:
     return retval;
 }
 
-static otError ThreadStartStop(bool aStart)
+static otError DataPageHandler(const uint8_t *aEntries, size_t aLength, void *aContext)
 {
+    thci_data_page_context_t *context = (thci_data_page_context_t *)aContext;
     otError retval = OT_ERROR_NONE;
-    uint8_t tid = GetNewTransactionId();
-    const uint8_t *argPtr = NULL;
-    size_t argLen;
-    bool status;
-    spinel_ssize_t parsedLength;
 
-    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(aLength <= (size_t)(context->mSize - context->mLength), done, retval = OT_ERROR_FAILED);
 
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_NET_STACK_UP, SPINEL_DATATYPE_BOOL_S, aStart);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+    memcpy(context->mData + context->mLength, aEntries, aLength);
+    context->mLength += aLength;
 
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_NET_STACK_UP, &argPtr, &argLen);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+ done:
+    return retval;
+}
 
-    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_BOOL_S, &status);
-    nlREQUIRE_ACTION(parsedLength > 0 && status == aStart, done, retval = OT_ERROR_FAILED);
+static otError thciGetSpinelDataProperty(spinel_prop_key_t aKey, uint8_t *aOutData, uint16_t aInSize, uint16_t *aOutSize)
+{
+    otError retval = OT_ERROR_NONE;
+    thci_data_page_context_t context;
+
+    nlREQUIRE_ACTION(aOutData != NULL, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(aOutSize != NULL, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(aInSize  >  0,    done, retval = OT_ERROR_INVALID_ARGS);
+
+    context.mData = aOutData;
+    context.mSize = aInSize;
+    context.mLength = 0;
+
+    retval = GetTableProperty(aKey, DataPageHandler, &context);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    *aOutSize = context.mLength;
+
+done:
+    return retval;
+}
+
+static otError ThreadStartStop(bool aStart)
+{
+    otError retval = OT_ERROR_NONE;
+    uint8_t tid = GetNewTransactionId();
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    bool status;
+    spinel_ssize_t parsedLength;
+
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_NET_STACK_UP, SPINEL_DATATYPE_BOOL_S, aStart);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_NET_STACK_UP, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_BOOL_S, &status);
+    nlREQUIRE_ACTION(parsedLength > 0 && status == aStart, done, retval = OT_ERROR_FAILED);
+
+    THCI_ATTACH_STATS_THREAD_STARTED(aStart);
 
     // When Thead Starts on the NCP all data packets must be secured.
     if (aStart)
@@ -1467,6 +2230,164 @@ static otError ReEstablishNcpComm(thciUartDataFrameCallback_t aDataCB, thciUartC
     return retval;
 }
 
+static void ResetNcpCaps(void)
+{
+    thci_ncp_caps_t *caps = &gTHCINCPContext.mCaps;
+
+    memset(caps, 0, sizeof(*caps));
+
+    caps->mMaxFrameSize = THCI_NCP_DEFAULT_MAX_FRAME_SIZE;
+    caps->mUnicastAddressTableSize = THCI_CACHED_UNICAST_ADDRESS_SIZE;
+    caps->mMulticastAddressTableSize = THCI_CACHED_MULTICAST_ADDRESS_SIZE;
+}
+
+static otError QueryNcpCapList(thci_ncp_caps_t *aCaps)
+{
+    otError retval;
+    uint8_t tid = GetNewTransactionId();
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    spinel_ssize_t parsedLength;
+    spinel_ssize_t subLength;
+    unsigned int cap;
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_CAPS, NULL);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    retval = thciUartWaitForResponseIgnoreTimeout(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_CAPS, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    for (parsedLength = 0 ; argLen > (size_t)parsedLength && aCaps->mCapCount < THCI_NCP_MAX_CAPS ; parsedLength += subLength)
+    {
+        subLength = spinel_datatype_unpack(argPtr + parsedLength, argLen - parsedLength, SPINEL_DATATYPE_UINT_PACKED_S, &cap);
+        nlREQUIRE_ACTION(subLength > 0, done, retval = OT_ERROR_PARSE);
+
+        aCaps->mCaps[aCaps->mCapCount++] = cap;
+    }
+
+    aCaps->mFlags |= THCI_NCP_CAPS_FLAG_CAPS;
+
+ done:
+    return retval;
+}
+
+static otError QueryNcpLimits(thci_ncp_caps_t *aCaps)
+{
+    otError retval;
+    uint8_t tid = GetNewTransactionId();
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    spinel_ssize_t parsedLength;
+    spinel_ssize_t subLength;
+    uint16_t maxFrameSize;
+    uint8_t unicastSize;
+    uint8_t multicastSize;
+    uint8_t childSize;
+    uint8_t neighborSize;
+    uint32_t baudRate;
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_VENDOR_NEST_NCP_LIMITS, NULL);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    retval = thciUartWaitForResponseIgnoreTimeout(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_VENDOR_NEST_NCP_LIMITS, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    parsedLength = spinel_datatype_unpack(argPtr, argLen,
+                                          SPINEL_DATATYPE_UINT16_S  // Max frame size
+                                          SPINEL_DATATYPE_UINT8_S   // Unicast address table size
+                                          SPINEL_DATATYPE_UINT8_S   // Multicast address table size
+                                          SPINEL_DATATYPE_UINT8_S   // Child table size
+                                          SPINEL_DATATYPE_UINT8_S,  // Neighbor table size
+                                          &maxFrameSize,
+                                          &unicastSize,
+                                          &multicastSize,
+                                          &childSize,
+                                          &neighborSize);
+    nlREQUIRE_ACTION(parsedLength > 0 && maxFrameSize > 0, done, retval = OT_ERROR_PARSE);
+
+    for ( ; argLen > (size_t)parsedLength && aCaps->mBaudRateCount < THCI_NCP_MAX_BAUD_RATES ; parsedLength += subLength)
+    {
+        subLength = spinel_datatype_unpack(argPtr + parsedLength, argLen - parsedLength, SPINEL_DATATYPE_UINT32_S, &baudRate);
+        nlREQUIRE_ACTION(subLength > 0, done, retval = OT_ERROR_PARSE);
+
+        aCaps->mBaudRates[aCaps->mBaudRateCount++] = baudRate;
+    }
+
+    // Only a whole answer replaces the limits THCI was built with.
+    aCaps->mMaxFrameSize = maxFrameSize;
+    aCaps->mUnicastAddressTableSize = unicastSize;
+    aCaps->mMulticastAddressTableSize = multicastSize;
+    aCaps->mChildTableSize = childSize;
+    aCaps->mNeighborTableSize = neighborSize;
+
+    aCaps->mFlags |= THCI_NCP_CAPS_FLAG_LIMITS;
+
+ done:
+    if (retval != OT_ERROR_NONE)
+    {
+        aCaps->mBaudRateCount = 0;
+    }
+
+    return retval;
+}
+
+/**
+ * Learns what the NCP supports, once it answers.  An NCP that does not
+ * report it keeps the values THCI was built with, so this never fails the
+ * initialization.
+ */
+static void QueryNcpCaps(void)
+{
+    thci_ncp_caps_t *caps = &gTHCINCPContext.mCaps;
+    otError error;
+
+    error = QueryNcpCapList(caps);
+
+    if (error != OT_ERROR_NONE)
+    {
+        NL_LOG_DEBUG(lrTHCI, "%s: no capability list (%d)\n", __FUNCTION__, error);
+    }
+
+    error = QueryNcpLimits(caps);
+
+    if (error != OT_ERROR_NONE)
+    {
+        NL_LOG_DEBUG(lrTHCI, "%s: no limits, assuming THCI's (%d)\n", __FUNCTION__, error);
+    }
+
+    // The address caches cannot grow: report what would be missed by the
+    // tables the NCP reported.
+    if ((caps->mFlags & THCI_NCP_CAPS_FLAG_LIMITS) &&
+        (caps->mUnicastAddressTableSize > THCI_CACHED_UNICAST_ADDRESS_SIZE ||
+         caps->mMulticastAddressTableSize > THCI_CACHED_MULTICAST_ADDRESS_SIZE))
+    {
+        NL_LOG_CRIT(lrTHCI, "%s: NCP address tables %d/%d larger than THCI's %d/%d\n", __FUNCTION__,
+                    caps->mUnicastAddressTableSize, caps->mMulticastAddressTableSize,
+                    THCI_CACHED_UNICAST_ADDRESS_SIZE, THCI_CACHED_MULTICAST_ADDRESS_SIZE);
+    }
+
+#if !THCI_CONFIG_NCP_SPI && !THCI_CONFIG_NCP_SHM
+    if ((caps->mFlags & THCI_NCP_CAPS_FLAG_LIMITS) && caps->mBaudRateCount > 0)
+    {
+        bool listed = false;
+        uint8_t i;
+
+        for (i = 0 ; i < caps->mBaudRateCount ; i++)
+        {
+            listed = listed || (caps->mBaudRates[i] == THCI_CONFIG_UART_OPERATIONAL_BAUD_RATE);
+        }
+
+        if (!listed)
+        {
+            NL_LOG_CRIT(lrTHCI, "%s: NCP does not list %d baud\n", __FUNCTION__, THCI_CONFIG_UART_OPERATIONAL_BAUD_RATE);
+        }
+    }
+#endif
+
+    NL_LOG_DEBUG(lrTHCI, "%s: %d caps, frame %d, children %d, neighbors %d\n", __FUNCTION__,
+                 caps->mCapCount, caps->mMaxFrameSize, caps->mChildTableSize, caps->mNeighborTableSize);
+}
+
 /**
  * API IMPLEMENTATION
  */
@@ -1534,6 +2455,15 @@ otError InitializeInternal(bool aMandatoryNcpReset, bool aAPIInitialize, thci_ca
             gTHCINCPContext.mMessageLock = nl_er_lock_create();
             nlREQUIRE_ACTION(gTHCINCPContext.mMessageLock != NULL, done, retval = OT_ERROR_FAILED);
 
+#if THCI_CONFIG_ARENA
+            nlREQUIRE_ACTION(thciArenaGetBuffers() != NULL, done, retval = OT_ERROR_INVALID_STATE);
+
+            gTHCINCPContext.mMessageRingBuffer = thciArenaGetBuffers()->mTxRing;
+            gTHCINCPContext.mMessageRingSize = thciArenaGetProfile()->mTxRingSize;
+#else
+            gTHCINCPContext.mMessageRingSize = THCI_CONFIG_NCP_TX_MESSAGE_RING_BUFFER_SIZE;
+#endif
+
             // equating the RingHead and RingTail effectively free's the entire ring buffer.
             gTHCINCPContext.mMessageRingHead = gTHCINCPContext.mMessageRingTail = &gTHCINCPContext.mMessageRingBuffer[0];
             gTHCINCPContext.mMessageRingEndGap = 0;
@@ -1552,10 +2482,32 @@ otError InitializeInternal(bool aMandatoryNcpReset, bool aAPIInitialize, thci_ca
         {
             gTHCINCPContext.mCallbackBuffers[i].mState = kCallbackBufferStateFree;
         }
+
+#if THCI_CONFIG_LOG_NCP_LOGS
+        nlREQUIRE_ACTION(thciNcpLogInit() == 0, done, retval = OT_ERROR_FAILED);
+#endif
+
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+        nlREQUIRE_ACTION(thciNcpClockInit() == 0, done, retval = OT_ERROR_FAILED);
+#endif
+
+#if THCI_CONFIG_NCP_HEALTH
+        nlREQUIRE_ACTION(thciHealthInit() == 0, done, retval = OT_ERROR_FAILED);
+#endif
+
+#if THCI_CONFIG_ASYNC_REQUESTS
+        // thciAsyncPost() may be called from any task.
+        if (sAsync.mCallLock == NULL)
+        {
+            sAsync.mCallLock = nl_er_lock_create();
+            nlREQUIRE_ACTION(sAsync.mCallLock != NULL, done, retval = OT_ERROR_FAILED);
+        }
+#endif
     }
 
     gTHCINCPContext.mStateChangeFlags = 0;
     gTHCINCPContext.mModuleState = kModuleStateInitialized;
+    ResetNcpCaps();
 
     if (!aMandatoryNcpReset)
     {
@@ -1566,9 +2518,20 @@ otError InitializeInternal(bool aMandatoryNcpReset, bool aAPIInitialize, thci_ca
     {
         retval = ResetNcpWithVerify(aDataCB, aControlCB);
         nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+        // The NCP clock restarted with the NCP.
+        thciNcpClockReset();
+#endif
+
+#if THCI_CONFIG_RF_TEST
+        // A running sequence died with the NCP.
+        CompleteRfTest();
+#endif
     }
 
-    
+    // Also after a recovery: the NCP may have been updated.
+    QueryNcpCaps();
 
  done:
     return retval;
@@ -1736,6 +2699,97 @@ otError thciSetIcmpEchoEnabled(bool aEnable)
     return retval;
 }
 
+#if THCI_CONFIG_LOG_NCP_LOGS
+otError thciSetNcpLogLevel(uint8_t aLevel)
+{
+    otError retval = OT_ERROR_NONE;
+    uint8_t tid = GetNewTransactionId();
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    uint8_t level;
+    spinel_ssize_t parsedLength;
+
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_DEBUG_NCP_LOG_LEVEL, SPINEL_DATATYPE_UINT8_S, aLevel);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_DEBUG_NCP_LOG_LEVEL, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UINT8_S, &level);
+    nlREQUIRE_ACTION(parsedLength > 0 && level == aLevel, done, retval = OT_ERROR_FAILED);
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_LOG_NCP_LOGS
+
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+otError thciSyncNcpClock(void)
+{
+    otError retval = OT_ERROR_NONE;
+    uint8_t tid = GetNewTransactionId();
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    uint32_t hostSend;
+    uint32_t hostReceive;
+    uint32_t ncpTime;
+    spinel_ssize_t parsedLength;
+
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(thciNcpHasCap(SPINEL_CAP_VENDOR_NEST_NCP_TIMESTAMP), done, retval = OT_ERROR_NOT_CAPABLE);
+
+    hostSend = (uint32_t)nltime_get_system_ms();
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_VENDOR_NEST_NCP_TIMESTAMP, NULL);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_VENDOR_NEST_NCP_TIMESTAMP, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    hostReceive = (uint32_t)nltime_get_system_ms();
+
+    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UINT32_S, &ncpTime);
+    nlREQUIRE_ACTION(parsedLength > 0, done, retval = OT_ERROR_FAILED);
+
+    thciNcpClockAddSample(hostSend, ncpTime, hostReceive);
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_NCP_CLOCK_SYNC
+
+#if THCI_CONFIG_NCP_HEALTH
+otError thciPingNcp(uint32_t *aRtt)
+{
+    otError retval = OT_ERROR_NONE;
+    uint8_t tid = GetNewTransactionId();
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    uint32_t sendTime;
+
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+
+    sendTime = (uint32_t)nltime_get_system_ms();
+
+    // LAST_STATUS is answered from NCP memory, without touching the radio
+    // or the Thread stack, so the round trip measures the host link and
+    // the NCP scheduling only.
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_LAST_STATUS, NULL);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    // The health monitor decides when to recover, not the first timeout.
+    retval = thciUartWaitForResponseIgnoreTimeout(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_LAST_STATUS, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    *aRtt = (uint32_t)nltime_get_system_ms() - sendTime;
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_NCP_HEALTH
+
 otError thciGetExtendedAddress(uint8_t *aAddress)
 {
     otError retval = OT_ERROR_NONE;
@@ -2268,6 +3322,39 @@ otDeviceRole thciGetDeviceRole(void)
     return gTHCISDKContext.mDeviceRole;
 }
 
+void thciGetDatapathCounters(thci_datapath_counters_t *aCounters)
+{
+    memcpy(aCounters, &sDatapathCounters, sizeof(*aCounters));
+
+    aCounters->mTxRingSize = gTHCINCPContext.mMessageRingSize;
+    aCounters->mCallbackBuffersSize = THCI_NUM_CALLBACK_BUFFERS;
+    aCounters->mCallbackBuffersUsed = 0;
+
+    for (size_t i = 0 ; i < THCI_NUM_CALLBACK_BUFFERS ; i++)
+    {
+        if (gTHCINCPContext.mCallbackBuffers[i].mState != kCallbackBufferStateFree)
+        {
+            aCounters->mCallbackBuffersUsed++;
+        }
+    }
+
+    if (gTHCINCPContext.mMessageLock && nl_er_lock_enter(gTHCINCPContext.mMessageLock) == 0)
+    {
+        aCounters->mTxRingUsed = GetMessageRingUsed(&gTHCINCPContext);
+        nl_er_lock_exit(gTHCINCPContext.mMessageLock);
+    }
+}
+
+void thciResetDatapathCounters(void)
+{
+    memset(&sDatapathCounters, 0, sizeof(sDatapathCounters));
+
+    for (size_t i = 0; i < THCI_MESSAGE_QUEUE_COUNT; i++)
+    {
+        gTHCISDKContext.mMessageQueue[i].mHighWater = 0;
+    }
+}
+
 void thciSetLocalDeviceRole(void)
 {
     // Nothing to do here as the THCI_NCP module will capture the device role when it receives
@@ -2427,111 +3514,807 @@ otError thciGetMacCounters(otMacCounters *aCounters)
     return retval;
 }
 
-otError thciGetIpCounters(otIpCounters *aCounters)
+otError thciGetIpCounters(otIpCounters *aCounters)
+{
+    spinel_ssize_t parsedLength;
+    otError retval = OT_ERROR_NONE;
+    uint32_t value;
+    uint32_t i;
+
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+
+    // This loop requires that the order of properties in kMacCounterPropertyList match the order
+    // of counters found in otMacCounters.
+    for (i = 0 ; i < sizeof(kIpCounterPropertyList) / sizeof(kIpCounterPropertyList[0]) ; i++)
+    {
+        retval = thciGetSpinelProperty(kIpCounterPropertyList[i], SPINEL_DATATYPE_UINT32_S,
+                                       &value, &parsedLength);
+        nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+        ((uint32_t *)aCounters)[i] = value;
+    }
+
+ done:
+    return retval;
+}
+
+
+const thci_ncp_caps_t *thciGetNcpCaps(void)
+{
+    return &gTHCINCPContext.mCaps;
+}
+
+bool thciNcpHasCap(unsigned int aCap)
+{
+    bool retval = false;
+    uint8_t i;
+
+    for (i = 0 ; i < gTHCINCPContext.mCaps.mCapCount && !retval ; i++)
+    {
+        retval = (gTHCINCPContext.mCaps.mCaps[i] == aCap);
+    }
+
+    return retval;
+}
+
+otError thciGetVersionString(char *aString, size_t aLength)
+{
+    otError retval = OT_ERROR_NONE;
+    uint8_t tid = GetNewTransactionId();
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    spinel_ssize_t parsedLength;
+    const char *version = NULL;
+    size_t versionLength;
+
+    nlREQUIRE_ACTION(aString != NULL && aLength != 0, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_NCP_VERSION, NULL);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_NCP_VERSION, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UTF8_S, &version);
+    nlREQUIRE_ACTION(parsedLength > 0 && version != NULL, done, retval = OT_ERROR_PARSE);
+
+    versionLength = strlen(version);
+
+    if (aLength < versionLength + 1)
+    {
+        versionLength = aLength - 1;
+    }
+
+    memcpy(aString, version, versionLength);
+    aString[versionLength] = '\0';
+
+ done:
+    return retval;
+}
+
+void thciSetMaxTxPower(int8_t aPower)
+{
+    otError status;
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    uint8_t tid = GetNewTransactionId();
+
+    nlREQUIRE(gTHCINCPContext.mModuleState == kModuleStateInitialized, done);
+
+    status = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_PHY_TX_POWER, SPINEL_DATATYPE_INT8_S, aPower);
+    nlREQUIRE(status == OT_ERROR_NONE, done);
+
+    status = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_TX_POWER, &argPtr, &argLen);
+    nlREQUIRE(status == OT_ERROR_NONE, done);
+
+ done:
+    return;
+}
+
+otError thciDiagnosticsCommand(const char *aCommandString)
+{
+    otError retval = OT_ERROR_INVALID_ARGS;
+    const uint8_t *argPtr = NULL;
+    size_t argLen;
+    uint8_t tid = GetNewTransactionId();
+    const char *result = NULL;
+    spinel_ssize_t parsedLength;
+
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_NEST_STREAM_MFG, SPINEL_DATATYPE_UTF8_S, aCommandString);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_NEST_STREAM_MFG, &argPtr, &argLen);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UTF8_S, &result);
+    nlREQUIRE_ACTION(parsedLength > 0 && result != NULL, done, retval = OT_ERROR_PARSE);
+
+    NL_LOG_CRIT(lrTHCI, "NCP Diagnostics output: %s\n", result);
+
+ done:
+    return retval;
+}
+
+#if THCI_CONFIG_DIAG_SEQUENCER
+/**
+ * Copies the next step of a diag script into aCommand, with the "diag"
+ * prefix, and parses its optional "= <value>" expectation.
+ *
+ * @retval 1 when a step was found, 0 at the end of the script, a negative
+ *         errno when the step does not fit or cannot be parsed.
+ */
+static int NextDiagStep(const char **aCursor, char *aCommand, size_t aCommandSize, thci_diag_record_t *aRecord)
+{
+    const char *step;
+    const char *end;
+    const char *expect;
+    size_t length;
+    int n;
+    int retval = 0;
+
+    while (**aCursor != '\0')
+    {
+        step = *aCursor;
+        end = step + strcspn(step, ";\n");
+        *aCursor = (*end != '\0') ? end + 1 : end;
+
+        while (step < end && (*step == ' ' || *step == '\t' || *step == '\r'))
+        {
+            step++;
+        }
+
+        while (end > step && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        {
+            end--;
+        }
+
+        if (step == end || *step == '#')
+        {
+            continue;
+        }
+
+        aRecord->mHasExpected = false;
+        expect = memchr(step, '=', end - step);
+
+        if (expect != NULL)
+        {
+            char *valueEnd;
+
+            aRecord->mExpected = strtol(expect + 1, &valueEnd, 0);
+            nlREQUIRE_ACTION(valueEnd != expect + 1 && valueEnd == end, done, retval = -EINVAL);
+
+            aRecord->mHasExpected = true;
+            end = expect;
+
+            while (end > step && end[-1] == ' ')
+            {
+                end--;
+            }
+        }
+
+        length = end - step;
+
+        if (length >= 4 && !strncmp(step, "diag", 4) && (length == 4 || step[4] == ' '))
+        {
+            n = snprintf(aCommand, aCommandSize, "%.*s", (int)length, step);
+        }
+        else
+        {
+            n = snprintf(aCommand, aCommandSize, "diag %.*s", (int)length, step);
+        }
+
+        nlREQUIRE_ACTION(n > 0 && (size_t)n < aCommandSize, done, retval = -EINVAL);
+
+        retval = 1;
+        break;
+    }
+
+ done:
+    return retval;
+}
+
+/**
+ * Fills in a diag record from the output of its command.
+ */
+static void ParseDiagOutput(const char *aOutput, thci_diag_record_t *aRecord)
+{
+    const char *line = aOutput;
+    bool failed = false;
+
+    snprintf(aRecord->mOutput, sizeof(aRecord->mOutput), "%s", aOutput);
+
+    while (*line != '\0')
+    {
+        const size_t length = strcspn(line, "\r\n");
+        char *valueEnd;
+        long value;
+
+        if (!strncmp(line, "status ", 7))
+        {
+            aRecord->mStatus = (uint8_t)strtoul(line + 7, NULL, 16);
+        }
+        else if (!strncmp(line, "failed", 6) || !strncmp(line, "Error", 5))
+        {
+            failed = true;
+        }
+        else if (length > 0)
+        {
+            value = strtol(line, &valueEnd, 0);
+
+            if (valueEnd == line + length)
+            {
+                aRecord->mValue = (int32_t)value;
+                aRecord->mHasValue = true;
+            }
+        }
+
+        line += length;
+        line += strspn(line, "\r\n");
+    }
+
+    if (failed || aRecord->mStatus != 0)
+    {
+        aRecord->mResult = kThciDiagResultFail;
+    }
+    else if (aRecord->mHasExpected && (!aRecord->mHasValue || aRecord->mValue != aRecord->mExpected))
+    {
+        aRecord->mResult = kThciDiagResultFail;
+    }
+    else
+    {
+        aRecord->mResult = kThciDiagResultPass;
+    }
+}
+
+otError thciDiagnosticsRunScript(const char *aScript, uint8_t aFlags, thci_diag_record_t *aRecords,
+                                 uint16_t aMaxRecords, uint16_t *aNumRecords)
+{
+    otError retval = OT_ERROR_NONE;
+    const char *cursor = aScript;
+    char command[64];
+    uint8_t tids[THCI_CONFIG_DIAG_PIPELINE_DEPTH];
+    uint32_t sendTimes[THCI_CONFIG_DIAG_PIPELINE_DEPTH];
+    uint16_t sent = 0;
+    uint16_t received = 0;
+    uint16_t stepNumber = 0;
+    bool stop = false;
+    bool aborted = false;
+    int step;
+
+    nlREQUIRE_ACTION(aScript != NULL && aRecords != NULL && aNumRecords != NULL, exit, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, exit, retval = OT_ERROR_INVALID_STATE);
+
+    while (true)
+    {
+        // Keep the pipeline full.
+        while (!stop && (sent - received) < THCI_CONFIG_DIAG_PIPELINE_DEPTH)
+        {
+            thci_diag_record_t *record;
+            const uint8_t slot = sent % THCI_CONFIG_DIAG_PIPELINE_DEPTH;
+            thci_diag_record_t next;
+            otError error;
+
+            step = NextDiagStep(&cursor, command, sizeof(command), &next);
+            stepNumber++;
+
+            if (step <= 0)
+            {
+                if (step < 0)
+                {
+                    NL_LOG_CRIT(lrTHCI, "diag script: cannot parse step %u\n", stepNumber);
+                    retval = OT_ERROR_INVALID_ARGS;
+                }
+
+                stop = true;
+                break;
+            }
+
+            if (sent == aMaxRecords)
+            {
+                retval = OT_ERROR_NO_BUFS;
+                stop = true;
+                break;
+            }
+
+            record = &aRecords[sent];
+            memset(record, 0, sizeof(*record));
+            record->mStep = stepNumber;
+            record->mHasExpected = next.mHasExpected;
+            record->mExpected = next.mExpected;
+
+            tids[slot] = GetNewTransactionId();
+            sendTimes[slot] = (uint32_t)nltime_get_system_ms();
+
+            error = thciUartFrameSend(tids[slot], SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_NEST_STREAM_MFG, SPINEL_DATATYPE_UTF8_S, command);
+
+            if (error == OT_ERROR_NONE)
+            {
+                error = thciUartExpectResponse(tids[slot]);
+            }
+
+            if (error != OT_ERROR_NONE)
+            {
+                record->mError = error;
+                record->mResult = kThciDiagResultError;
+                tids[slot] = 0;
+                aborted = (aFlags & THCI_DIAG_FLAG_ABORT_ON_FAILURE) != 0;
+                stop = aborted;
+            }
+
+            sent++;
+        }
+
+        nlREQUIRE(received < sent, done);
+
+        // Collect the oldest outstanding step.
+        {
+            thci_diag_record_t *record = &aRecords[received];
+            const uint8_t slot = received % THCI_CONFIG_DIAG_PIPELINE_DEPTH;
+            const uint8_t *argPtr = NULL;
+            size_t argLen;
+            const char *output = NULL;
+            spinel_ssize_t parsedLength;
+
+            received++;
+
+            if (tids[slot] == 0)
+            {
+                continue;
+            }
+
+            record->mError = thciUartWaitForResponse(tids[slot], SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_NEST_STREAM_MFG, &argPtr, &argLen);
+            record->mLatency = (uint32_t)nltime_get_system_ms() - sendTimes[slot];
+
+            if (record->mError == OT_ERROR_NONE)
+            {
+                parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UTF8_S, &output);
+
+                if (parsedLength > 0 && output != NULL)
+                {
+                    ParseDiagOutput(output, record);
+                }
+                else
+                {
+                    record->mError = OT_ERROR_PARSE;
+                    record->mResult = kThciDiagResultError;
+                }
+            }
+            else if (record->mError == OT_ERROR_FAILED)
+            {
+                // The NCP rejected the command with a LAST_STATUS.
+                record->mResult = kThciDiagResultFail;
+            }
+            else if (record->mError == OT_ERROR_NO_BUFS)
+            {
+                // The output arrived early and did not fit in its UART slot.
+                record->mResult = kThciDiagResultError;
+            }
+            else
+            {
+                // The NCP is being recovered; the remaining steps are lost.
+                record->mResult = kThciDiagResultError;
+                thciUartCancelExpectedResponses();
+
+                while (received < sent)
+                {
+                    aRecords[received].mError = OT_ERROR_ABORT;
+                    aRecords[received].mResult = kThciDiagResultError;
+                    received++;
+                }
+
+                aborted = true;
+                stop = true;
+            }
+
+            if (record->mResult != kThciDiagResultPass && (aFlags & THCI_DIAG_FLAG_ABORT_ON_FAILURE))
+            {
+                aborted = true;
+                stop = true;
+            }
+        }
+    }
+
+ done:
+    // Report the steps skipped by an abort.
+    while (aborted && sent < aMaxRecords)
+    {
+        thci_diag_record_t *record = &aRecords[sent];
+
+        memset(record, 0, sizeof(*record));
+
+        step = NextDiagStep(&cursor, command, sizeof(command), record);
+        nlREQUIRE(step > 0, report);
+
+        record->mStep = ++stepNumber;
+        record->mResult = kThciDiagResultNotRun;
+        sent++;
+    }
+
+ report:
+    *aNumRecords = sent;
+
+    for (uint16_t i = 0; i < sent && retval == OT_ERROR_NONE; i++)
+    {
+        if (aRecords[i].mResult != kThciDiagResultPass)
+        {
+            retval = OT_ERROR_FAILED;
+        }
+    }
+
+ exit:
+    return retval;
+}
+#endif // THCI_CONFIG_DIAG_SEQUENCER
+
+#if THCI_CONFIG_DAEMON || THCI_CONFIG_ASYNC_REQUESTS
+/**
+ * The command of the response to a request passed through for the daemon
+ * or made without blocking, 0 when the command is not supported.
+ */
+static uint8_t GetRawResponseCommand(uint32_t aCommand)
+{
+    uint8_t retval = 0;
+
+    switch (aCommand)
+    {
+    case SPINEL_CMD_PROP_VALUE_GET:
+    case SPINEL_CMD_PROP_VALUE_SET:
+    case SPINEL_CMD_VENDOR_NEST_PROP_VALUE_GET:
+    case SPINEL_CMD_VENDOR_NEST_PROP_VALUE_SET:
+        retval = SPINEL_CMD_PROP_VALUE_IS;
+        break;
+
+    case SPINEL_CMD_PROP_VALUE_INSERT:
+        retval = SPINEL_CMD_PROP_VALUE_INSERTED;
+        break;
+
+    case SPINEL_CMD_PROP_VALUE_REMOVE:
+        retval = SPINEL_CMD_PROP_VALUE_REMOVED;
+        break;
+
+    default:
+        break;
+    }
+
+    return retval;
+}
+#endif // THCI_CONFIG_DAEMON || THCI_CONFIG_ASYNC_REQUESTS
+
+#if THCI_CONFIG_DAEMON
+otError thciNcpRawTransact(thci_raw_request_t *aRequests, uint8_t aCount)
+{
+    otError retval = OT_ERROR_NONE;
+    uint8_t tids[THCI_CONFIG_DAEMON_PIPELINE_DEPTH];
+    uint8_t sent;
+    uint8_t received;
+
+    nlREQUIRE_ACTION(aCount <= THCI_CONFIG_DAEMON_PIPELINE_DEPTH, exit, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, exit, retval = OT_ERROR_INVALID_STATE);
+
+    for (sent = 0; sent < aCount; sent++)
+    {
+        thci_raw_request_t *request = &aRequests[sent];
+
+        tids[sent] = 0;
+        request->mResponseLength = 0;
+
+        if (GetRawResponseCommand(request->mCommand) == 0)
+        {
+            request->mError = OT_ERROR_NOT_IMPLEMENTED;
+            continue;
+        }
+
+        tids[sent] = GetNewTransactionId();
+
+        request->mError = thciUartFrameSend(tids[sent], request->mCommand, request->mKey, SPINEL_DATATYPE_DATA_S, request->mValue, request->mValueLength);
+
+#if THCI_CONFIG_DAEMON_PIPELINE_DEPTH > 1
+        if (request->mError == OT_ERROR_NONE)
+        {
+            request->mError = thciUartExpectResponse(tids[sent]);
+        }
+#endif
+
+        if (request->mError != OT_ERROR_NONE)
+        {
+            tids[sent] = 0;
+        }
+    }
+
+    for (received = 0; received < sent; received++)
+    {
+        thci_raw_request_t *request = &aRequests[received];
+        const uint8_t *argPtr = NULL;
+        size_t argLen = 0;
+        unsigned int command;
+
+        if (tids[received] == 0)
+        {
+            continue;
+        }
+
+        request->mError = thciUartWaitForResponse(tids[received], GetRawResponseCommand(request->mCommand), request->mKey, &argPtr, &argLen);
+
+        if (request->mError == OT_ERROR_NONE || request->mError == OT_ERROR_FAILED)
+        {
+            thciUartGetResponseType(&command, &request->mResponseKey);
+
+            request->mResponseCommand = command;
+            request->mResponseLength = (argLen < request->mResponseSize) ? argLen : request->mResponseSize;
+            memcpy(request->mResponse, argPtr, request->mResponseLength);
+        }
+        else if (request->mError == OT_ERROR_NO_BUFS)
+        {
+            // Only this response was lost; see THCI_CONFIG_PIPELINED_RESPONSE_SIZE.
+        }
+        else
+        {
+            // The NCP is being recovered; the remaining responses are lost.
+#if THCI_CONFIG_DAEMON_PIPELINE_DEPTH > 1
+            thciUartCancelExpectedResponses();
+#endif
+
+            while (++received < sent)
+            {
+                if (tids[received] != 0)
+                {
+                    aRequests[received].mError = OT_ERROR_ABORT;
+                }
+            }
+        }
+    }
+
+ exit:
+    return retval;
+}
+
+void thciNcpSetRawFrameObserver(thciRawFrameObserver aObserver, void *aContext)
+{
+    sRawFrameObserver.mObserver = aObserver;
+    sRawFrameObserver.mContext = aContext;
+}
+#endif // THCI_CONFIG_DAEMON
+
+#if THCI_CONFIG_ASYNC_REQUESTS
+static int AsyncEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    const uint32_t now = (uint32_t)nltime_get_system_ms();
+    thci_async_call_t call;
+    bool expired = false;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventAsync);
+
+    sAsync.mEventPosted = 0;
+
+    // Calls posted by thciAsyncPost, in order.  Only those queued so far
+    // are run, so that a call that posts another does not starve the task.
+    for (uint8_t count = sAsync.mCallCount; count > 0; count--)
+    {
+        nlREQUIRE(nl_er_lock_enter(sAsync.mCallLock) == 0, requests);
+
+        call = sAsync.mCalls[sAsync.mCallHead];
+        sAsync.mCallHead = (sAsync.mCallHead + 1) % THCI_CONFIG_ASYNC_MAX_CALLS;
+        sAsync.mCallCount--;
+
+        nl_er_lock_exit(sAsync.mCallLock);
+
+        call.mFunction(call.mContext);
+    }
+
+ requests:
+    for (size_t i = 0; i < THCI_CONFIG_ASYNC_MAX_REQUESTS; i++)
+    {
+        thci_async_request_t *request = &sAsync.mRequests[i];
+        thci_async_request_t response;
+
+        if (request->mTransactionId == 0)
+        {
+            continue;
+        }
+
+        if (!request->mReceived)
+        {
+            if ((int32_t)(now - (request->mSendTime + THCI_CONFIG_ASYNC_TIMEOUT_MSEC)) < 0)
+            {
+                continue;
+            }
+
+            NL_LOG_CRIT(lrTHCI, "Async request %u timed out\n", request->mTransactionId);
+
+            request->mError = OT_ERROR_RESPONSE_TIMEOUT;
+            request->mCommand = 0;
+            request->mKey = request->mResponseKey;
+            request->mLength = 0;
+            expired = true;
+        }
+
+        // The slot is released first so that the callback can make a new request.
+        response = *request;
+        request->mTransactionId = 0;
+
+        response.mCallback(response.mError, response.mCommand, response.mKey, response.mValue, response.mLength, response.mContext);
+    }
+
+    if (expired)
+    {
+        thciInitiateNCPRecovery();
+    }
+
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventAsync);
+
+    return NLER_SUCCESS;
+}
+
+otError thciAsyncRequest(uint32_t aCommand, spinel_prop_key_t aKey, const uint8_t *aValue, uint16_t aValueLength,
+                         thciAsyncCallback aCallback, void *aContext)
+{
+    thci_async_request_t *request;
+    const uint8_t responseCommand = GetRawResponseCommand(aCommand);
+    uint8_t tid;
+    otError retval;
+
+    nlREQUIRE_ACTION(aCallback != NULL, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(aValue != NULL || aValueLength == 0, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(aValueLength <= THCI_CONFIG_ASYNC_VALUE_SIZE, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(responseCommand != 0, done, retval = OT_ERROR_NOT_IMPLEMENTED);
+
+    request = FindAsyncRequest(0);
+    nlREQUIRE_ACTION(request != NULL, done, retval = OT_ERROR_NO_BUFS);
+
+    tid = GetNewTransactionId();
+
+    retval = thciUartFrameSend(tid, aCommand, aKey, SPINEL_DATATYPE_DATA_S, aValue, aValueLength);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    request->mTransactionId = tid;
+    request->mReceived = false;
+    request->mResponseCommand = responseCommand;
+    request->mResponseKey = aKey;
+    request->mSendTime = (uint32_t)nltime_get_system_ms();
+    request->mCallback = aCallback;
+    request->mContext = aContext;
+
+ done:
+    return retval;
+}
+
+otError thciAsyncPost(thciAsyncFunction aFunction, void *aContext)
 {
-    spinel_ssize_t parsedLength;
     otError retval = OT_ERROR_NONE;
-    uint32_t value;
-    uint32_t i;
 
-    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(aFunction != NULL, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(gTHCISDKContext.mInitParams.mSdkQueue != NULL, done, retval = OT_ERROR_INVALID_STATE);
 
-    // This loop requires that the order of properties in kMacCounterPropertyList match the order
-    // of counters found in otMacCounters.
-    for (i = 0 ; i < sizeof(kIpCounterPropertyList) / sizeof(kIpCounterPropertyList[0]) ; i++)
+    nlREQUIRE_ACTION(sAsync.mCallLock != NULL, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(nl_er_lock_enter(sAsync.mCallLock) == 0, done, retval = OT_ERROR_FAILED);
+
+    if (sAsync.mCallCount < THCI_CONFIG_ASYNC_MAX_CALLS)
     {
-        retval = thciGetSpinelProperty(kIpCounterPropertyList[i], SPINEL_DATATYPE_UINT32_S,
-                                       &value, &parsedLength);
-        nlREQUIRE(retval == OT_ERROR_NONE, done);
+        thci_async_call_t *call = &sAsync.mCalls[(sAsync.mCallHead + sAsync.mCallCount) % THCI_CONFIG_ASYNC_MAX_CALLS];
 
-        ((uint32_t *)aCounters)[i] = value;
+        call->mFunction = aFunction;
+        call->mContext = aContext;
+        sAsync.mCallCount++;
+    }
+    else
+    {
+        retval = OT_ERROR_NO_BUFS;
     }
 
+    nl_er_lock_exit(sAsync.mCallLock);
+
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+    PostAsyncEvent();
+
  done:
     return retval;
 }
 
-
-otError thciGetVersionString(char *aString, size_t aLength)
+void thciAsyncTick(void)
 {
-    otError retval = OT_ERROR_NONE;
-    uint8_t tid = GetNewTransactionId();
-    const uint8_t *argPtr = NULL;
-    size_t argLen;
-    spinel_ssize_t parsedLength;
-    const char *version = NULL;
-    size_t versionLength;
-
-    nlREQUIRE_ACTION(aString != NULL && aLength != 0, done, retval = OT_ERROR_INVALID_ARGS);
-    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+    bool outstanding = false;
 
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_NCP_VERSION, NULL);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
-
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_NCP_VERSION, &argPtr, &argLen);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
-
-    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UTF8_S, &version);
-    nlREQUIRE_ACTION(parsedLength > 0 && version != NULL, done, retval = OT_ERROR_PARSE);
+    nlREQUIRE(gTHCISDKContext.mInitParams.mSdkQueue != NULL, done);
 
-    versionLength = strlen(version);
-
-    if (aLength < versionLength + 1)
+    for (size_t i = 0; i < THCI_CONFIG_ASYNC_MAX_REQUESTS && !outstanding; i++)
     {
-        versionLength = aLength - 1;
+        outstanding = (sAsync.mRequests[i].mTransactionId != 0);
     }
 
-    memcpy(aString, version, versionLength);
-    aString[versionLength] = '\0';
+    nlREQUIRE(outstanding, done);
+
+    PostAsyncEvent();
 
  done:
-    return retval;
+    return;
 }
+#endif // THCI_CONFIG_ASYNC_REQUESTS
 
-void thciSetMaxTxPower(int8_t aPower)
+#if THCI_CONFIG_RF_TEST
+otError thciRfTestStart(const thci_rf_test_step_t *aSteps, uint16_t aNumSteps, thciRfTestCallback aCallback, void *aContext)
 {
-    otError status;
+    otError retval = OT_ERROR_INVALID_ARGS;
+    uint8_t steps[THCI_CONFIG_RF_TEST_MAX_STEPS * kRfTestStepEncodedSize];
+    spinel_size_t length = 0;
+    spinel_ssize_t packedLength;
     const uint8_t *argPtr = NULL;
     size_t argLen;
-    uint8_t tid = GetNewTransactionId();
+    uint8_t tid;
 
-    nlREQUIRE(gTHCINCPContext.mModuleState == kModuleStateInitialized, done);
+    nlREQUIRE(aSteps != NULL && aNumSteps > 0 && aNumSteps <= THCI_CONFIG_RF_TEST_MAX_STEPS && aCallback != NULL, done);
+    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(thciNcpHasCap(SPINEL_CAP_VENDOR_NEST_RF_TEST), done, retval = OT_ERROR_NOT_CAPABLE);
+    nlREQUIRE_ACTION(!sRfTest.mActive, done, retval = OT_ERROR_BUSY);
 
-    status = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_PHY_TX_POWER, SPINEL_DATATYPE_INT8_S, aPower);
-    nlREQUIRE(status == OT_ERROR_NONE, done);
+    for (uint16_t i = 0; i < aNumSteps; i++)
+    {
+        packedLength = spinel_datatype_pack(&steps[length], sizeof(steps) - length, "t(CCcSCSL)",
+                                            (uint8_t)aSteps[i].mMode,
+                                            aSteps[i].mChannel,
+                                            aSteps[i].mPower,
+                                            aSteps[i].mFrameCount,
+                                            aSteps[i].mFrameLength,
+                                            aSteps[i].mInterval,
+                                            aSteps[i].mDuration);
+        nlREQUIRE_ACTION(packedLength > 0 && (size_t)packedLength <= sizeof(steps) - length, done, retval = OT_ERROR_NO_BUFS);
+
+        length += packedLength;
+    }
 
-    status = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_TX_POWER, &argPtr, &argLen);
-    nlREQUIRE(status == OT_ERROR_NONE, done);
+    sRfTest.mHead = 0;
+    sRfTest.mCount = 0;
+    sRfTest.mDropped = 0;
+    sRfTest.mComplete = false;
+    sRfTest.mCallback = aCallback;
+    sRfTest.mContext = aContext;
+    // Results may be processed while waiting for the response.
+    sRfTest.mActive = true;
+
+    tid = GetNewTransactionId();
+
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_VENDOR_NEST_RF_TEST, SPINEL_DATATYPE_DATA_S, steps, length);
+
+    if (retval == OT_ERROR_NONE)
+    {
+        retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_VENDOR_NEST_RF_TEST, &argPtr, &argLen);
+    }
+
+    if (retval != OT_ERROR_NONE)
+    {
+        sRfTest.mActive = false;
+    }
 
  done:
-    return;
+    return retval;
 }
 
-otError thciDiagnosticsCommand(const char *aCommandString)
+otError thciRfTestStop(void)
 {
-    otError retval = OT_ERROR_INVALID_ARGS;
+    otError retval = OT_ERROR_NONE;
     const uint8_t *argPtr = NULL;
     size_t argLen;
     uint8_t tid = GetNewTransactionId();
-    const char *result = NULL;
-    spinel_ssize_t parsedLength;
 
     nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE(sRfTest.mActive, done);
 
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_NEST_STREAM_MFG, SPINEL_DATATYPE_UTF8_S, aCommandString);
+    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_VENDOR_NEST_RF_TEST, SPINEL_DATATYPE_DATA_S, NULL, 0);
     nlREQUIRE(retval == OT_ERROR_NONE, done);
 
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_NEST_STREAM_MFG, &argPtr, &argLen);
+    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_VENDOR_NEST_RF_TEST, &argPtr, &argLen);
     nlREQUIRE(retval == OT_ERROR_NONE, done);
 
-    parsedLength = spinel_datatype_unpack(argPtr, argLen, SPINEL_DATATYPE_UTF8_S, &result);
-    nlREQUIRE_ACTION(parsedLength > 0 && result != NULL, done, retval = OT_ERROR_PARSE);
-
-    NL_LOG_CRIT(lrTHCI, "NCP Diagnostics output: %s\n", result);
+    CompleteRfTest();
 
  done:
     return retval;
 }
+#endif // THCI_CONFIG_RF_TEST
 
 otError thciIsNodeCommissioned(bool *aCommissioned)
 {
@@ -2673,6 +4456,7 @@ void thciInitiateNCPRecovery(void)
 
     if (gTHCISDKContext.mInitParams.mSdkQueue)
     {
+        THCI_EVENT_STATS_POSTED(kThciEventNCPRecovery);
         nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sNCPRecoveryEvent);
     }
 
@@ -2777,146 +4561,226 @@ otError thciGetLeaderRouterId(uint8_t *aLeaderId)
 
 otError thciGetNetworkData(uint8_t *aNetworkData, uint16_t aInSize, uint16_t *aOutSize)
 {
-    return thciGetSpinelDataProperty(SPINEL_PROP_THREAD_NETWORK_DATA, SPINEL_DATATYPE_DATA_S,
-                                     aNetworkData, aInSize, aOutSize);
+    return thciGetSpinelDataProperty(SPINEL_PROP_THREAD_NETWORK_DATA, aNetworkData, aInSize, aOutSize);
 }
 
 otError thciGetStableNetworkData(uint8_t *aNetworkData, uint16_t aInSize, uint16_t *aOutSize)
 {
-    return thciGetSpinelDataProperty(SPINEL_PROP_THREAD_STABLE_NETWORK_DATA, SPINEL_DATATYPE_DATA_S,
-                                     aNetworkData, aInSize, aOutSize);
+    return thciGetSpinelDataProperty(SPINEL_PROP_THREAD_STABLE_NETWORK_DATA, aNetworkData, aInSize, aOutSize);
 }
 
-otError thciGetCombinedNeighborTable(thci_neighbor_child_info_t *aTableHead, uint32_t aInSize, uint32_t *aOutSize)
+static spinel_ssize_t UnpackNeighborEntry(const uint8_t *aEntry, size_t aLength, otNeighborInfo *aNeighbor)
 {
-    otError        retval;
-    uint8_t        tid = GetNewTransactionId();
+    // The EUI-64 is unpacked as a pointer instead of a value.
+    uint64_t       *eui64;
+    uint8_t         modeFlags;
+    bool            isChild;
+    spinel_ssize_t  parsedLen;
+
+    parsedLen = spinel_datatype_unpack(aEntry, aLength,
+                                       SPINEL_DATATYPE_STRUCT_S(
+                                           SPINEL_DATATYPE_EUI64_S   // EUI64 Address
+                                           SPINEL_DATATYPE_UINT16_S  // Rloc16
+                                           SPINEL_DATATYPE_UINT32_S  // Age
+                                           SPINEL_DATATYPE_UINT8_S   // Link Quality In
+                                           SPINEL_DATATYPE_INT8_S    // Average RSS
+                                           SPINEL_DATATYPE_UINT8_S   // Mode (flags)
+                                           SPINEL_DATATYPE_BOOL_S    // Is Child
+                                           SPINEL_DATATYPE_UINT32_S  // Link Frame Counter
+                                           SPINEL_DATATYPE_UINT32_S  // MLE Frame Counter
+                                           SPINEL_DATATYPE_INT8_S    // Most recent RSS
+                                           ),
+                                       &eui64,
+                                       &aNeighbor->mRloc16,
+                                       &aNeighbor->mAge,
+                                       &aNeighbor->mLinkQualityIn,
+                                       &aNeighbor->mAverageRssi,
+                                       &modeFlags,
+                                       &isChild,
+                                       &aNeighbor->mLinkFrameCounter,
+                                       &aNeighbor->mMleFrameCounter,
+                                       &aNeighbor->mLastRssi);
+
+    nlREQUIRE(parsedLen > 0, done);
+
+    aNeighbor->mIsChild = isChild;
+
+    aNeighbor->mRxOnWhenIdle      = (modeFlags & SPINEL_THREAD_MODE_RX_ON_WHEN_IDLE    ) ? true : false;
+    aNeighbor->mSecureDataRequest = (modeFlags & SPINEL_THREAD_MODE_SECURE_DATA_REQUEST) ? true : false;
+    aNeighbor->mFullFunction      = (modeFlags & SPINEL_THREAD_MODE_FULL_FUNCTION_DEV  ) ? true : false;
+    aNeighbor->mFullNetworkData   = (modeFlags & SPINEL_THREAD_MODE_FULL_NETWORK_DATA  ) ? true : false;
+
+    memcpy(aNeighbor->mExtAddress.m8, eui64, sizeof(uint64_t));
 
-    const uint8_t *argPtr = NULL;
-    size_t         argLen;
+done:
+    return parsedLen;
+}
+
+static spinel_ssize_t UnpackChildEntry(const uint8_t *aEntry, size_t aLength, otChildInfo *aChild)
+{
+    // The EUI-64 is unpacked as a pointer instead of a value.
+    uint64_t       *eui64;
+    uint8_t         modeFlags;
+    spinel_ssize_t  parsedLen;
+
+    parsedLen = spinel_datatype_unpack(aEntry, aLength,
+                                       SPINEL_DATATYPE_STRUCT_S(
+                                           SPINEL_DATATYPE_EUI64_S   // EUI64 Address
+                                           SPINEL_DATATYPE_UINT16_S  // Rloc16
+                                           SPINEL_DATATYPE_UINT32_S  // Timeout
+                                           SPINEL_DATATYPE_UINT32_S  // Age
+                                           SPINEL_DATATYPE_UINT8_S   // Network Data Version
+                                           SPINEL_DATATYPE_UINT8_S   // Link Quality In
+                                           SPINEL_DATATYPE_INT8_S    // Average RSS
+                                           SPINEL_DATATYPE_UINT8_S   // Mode (flags)
+                                           SPINEL_DATATYPE_INT8_S    // Most recent RSS
+                                           ),
+                                       &eui64,
+                                       &aChild->mRloc16,
+                                       &aChild->mTimeout,
+                                       &aChild->mAge,
+                                       &aChild->mNetworkDataVersion,
+                                       &aChild->mLinkQualityIn,
+                                       &aChild->mAverageRssi,
+                                       &modeFlags,
+                                       &aChild->mLastRssi);
+
+    nlREQUIRE(parsedLen > 0, done);
+
+    aChild->mRxOnWhenIdle      = (modeFlags & SPINEL_THREAD_MODE_RX_ON_WHEN_IDLE    ) ? true : false;
+    aChild->mSecureDataRequest = (modeFlags & SPINEL_THREAD_MODE_SECURE_DATA_REQUEST) ? true : false;
+    aChild->mFullFunction      = (modeFlags & SPINEL_THREAD_MODE_FULL_FUNCTION_DEV  ) ? true : false;
+    aChild->mFullNetworkData   = (modeFlags & SPINEL_THREAD_MODE_FULL_NETWORK_DATA  ) ? true : false;
+
+    memcpy(aChild->mExtAddress.m8, eui64, sizeof(uint64_t));
+
+done:
+    return parsedLen;
+}
+
+typedef struct
+{
+    thciChildVisitor            mChildVisitor;
+    thciNeighborVisitor         mNeighborVisitor;
+    void                        *mContext;
+} thci_table_visit_context_t;
 
+// The entries are decoded one at a time, from the response frame.
+static otError NeighborVisitHandler(const uint8_t *aEntries, size_t aLength, void *aContext)
+{
+    thci_table_visit_context_t *context = (thci_table_visit_context_t *)aContext;
+    otNeighborInfo neighbor;
     spinel_ssize_t parsedLen;
-    unsigned int   neighborLen = 0;
+    otError retval = OT_ERROR_NONE;
 
-    uint32_t       numIsChild = 0;
+    while (aLength > 0)
+    {
+        parsedLen = UnpackNeighborEntry(aEntries, aLength, &neighbor);
+        nlREQUIRE_ACTION(parsedLen > 0, done, retval = OT_ERROR_PARSE);
 
-    nlREQUIRE_ACTION(aTableHead                   != NULL                   , done, retval = OT_ERROR_INVALID_ARGS );
-    nlREQUIRE_ACTION(aInSize                      != 0                      , done, retval = OT_ERROR_INVALID_ARGS );
-    nlREQUIRE_ACTION(aOutSize                     != NULL                   , done, retval = OT_ERROR_INVALID_ARGS );
-    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
+        nlREQUIRE_ACTION(context->mNeighborVisitor(&neighbor, context->mContext), done, retval = OT_ERROR_ABORT);
 
-    // Get the neighbour table
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_THREAD_NEIGHBOR_TABLE, NULL);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+        aEntries += parsedLen;
+        aLength -= parsedLen;
+    }
 
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_THREAD_NEIGHBOR_TABLE, &argPtr, &argLen);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+done:
+    return retval;
+}
 
-    *aOutSize = 0;
+static otError ChildVisitHandler(const uint8_t *aEntries, size_t aLength, void *aContext)
+{
+    thci_table_visit_context_t *context = (thci_table_visit_context_t *)aContext;
+    otChildInfo child;
+    spinel_ssize_t parsedLen;
+    otError retval = OT_ERROR_NONE;
 
-    while (argLen > 0 && neighborLen < aInSize)
+    while (aLength > 0)
     {
-        otNeighborInfo *currNeighbor = &aTableHead[neighborLen].mNeighborInfo;
+        parsedLen = UnpackChildEntry(aEntries, aLength, &child);
+        nlREQUIRE_ACTION(parsedLen > 0, done, retval = OT_ERROR_PARSE);
 
-        // The EUI-64 is unpacked as a pointer instead of a value.
-        uint64_t       *eui64;
-        uint8_t         modeFlags;
-        bool            isChild;
+        nlREQUIRE_ACTION(context->mChildVisitor(&child, context->mContext), done, retval = OT_ERROR_ABORT);
 
-        parsedLen = spinel_datatype_unpack(argPtr, argLen,
-                                           SPINEL_DATATYPE_STRUCT_S(
-                                               SPINEL_DATATYPE_EUI64_S   // EUI64 Address
-                                               SPINEL_DATATYPE_UINT16_S  // Rloc16
-                                               SPINEL_DATATYPE_UINT32_S  // Age
-                                               SPINEL_DATATYPE_UINT8_S   // Link Quality In
-                                               SPINEL_DATATYPE_INT8_S    // Average RSS
-                                               SPINEL_DATATYPE_UINT8_S   // Mode (flags)
-                                               SPINEL_DATATYPE_BOOL_S    // Is Child
-                                               SPINEL_DATATYPE_UINT32_S  // Link Frame Counter
-                                               SPINEL_DATATYPE_UINT32_S  // MLE Frame Counter
-                                               SPINEL_DATATYPE_INT8_S    // Most recent RSS
-                                               ),
-                                           &eui64,
-                                           &currNeighbor->mRloc16,
-                                           &currNeighbor->mAge,
-                                           &currNeighbor->mLinkQualityIn,
-                                           &currNeighbor->mAverageRssi,
-                                           &modeFlags,
-                                           &isChild,
-                                           &currNeighbor->mLinkFrameCounter,
-                                           &currNeighbor->mMleFrameCounter,
-                                           &currNeighbor->mLastRssi);
+        aEntries += parsedLen;
+        aLength -= parsedLen;
+    }
 
-        nlREQUIRE_ACTION(parsedLen > 0, done, retval = OT_ERROR_PARSE);
+done:
+    return retval;
+}
+
+static bool CopyNeighborVisitor(const otNeighborInfo *aNeighbor, void *aContext)
+{
+    thci_table_page_context_t *context = (thci_table_page_context_t *)aContext;
+
+    ((otNeighborInfo *)context->mTable)[context->mCount++] = *aNeighbor;
+
+    return (context->mCount < context->mSize);
+}
+
+static bool CopyChildVisitor(const otChildInfo *aChild, void *aContext)
+{
+    thci_table_page_context_t *context = (thci_table_page_context_t *)aContext;
+
+    ((otChildInfo *)context->mTable)[context->mCount++] = *aChild;
+
+    return (context->mCount < context->mSize);
+}
 
-        currNeighbor->mIsChild = isChild;
+static otError CombinedNeighborPageHandler(const uint8_t *aEntries, size_t aLength, void *aContext)
+{
+    thci_table_page_context_t *context = (thci_table_page_context_t *)aContext;
+    thci_neighbor_child_info_t *table = (thci_neighbor_child_info_t *)context->mTable;
+    spinel_ssize_t parsedLen;
+    otError retval = OT_ERROR_NONE;
 
-        currNeighbor->mRxOnWhenIdle      = (modeFlags & SPINEL_THREAD_MODE_RX_ON_WHEN_IDLE    ) ? true : false;
-        currNeighbor->mSecureDataRequest = (modeFlags & SPINEL_THREAD_MODE_SECURE_DATA_REQUEST) ? true : false;
-        currNeighbor->mFullFunction      = (modeFlags & SPINEL_THREAD_MODE_FULL_FUNCTION_DEV  ) ? true : false;
-        currNeighbor->mFullNetworkData   = (modeFlags & SPINEL_THREAD_MODE_FULL_NETWORK_DATA  ) ? true : false;
+    while (aLength > 0)
+    {
+        nlREQUIRE_ACTION(context->mCount < context->mSize, done, retval = OT_ERROR_ABORT);
 
-        memcpy(currNeighbor->mExtAddress.m8, eui64, sizeof(uint64_t));
+        parsedLen = UnpackNeighborEntry(aEntries, aLength, &table[context->mCount].mNeighborInfo);
+        nlREQUIRE_ACTION(parsedLen > 0, done, retval = OT_ERROR_PARSE);
 
-        if (isChild)
+        if (table[context->mCount].mNeighborInfo.mIsChild)
         {
-            numIsChild++;
+            context->mChildren++;
         }
 
-        aTableHead[neighborLen].mFoundChild = false;
+        table[context->mCount].mFoundChild = false;
 
-        argPtr += parsedLen;
-        argLen -= parsedLen;
-        neighborLen++;
+        aEntries += parsedLen;
+        aLength -= parsedLen;
+        context->mCount++;
     }
 
-    // Now get the child info
-    tid = GetNewTransactionId();
-
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_THREAD_CHILD_TABLE, NULL);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+done:
+    return retval;
+}
 
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_THREAD_CHILD_TABLE, &argPtr, &argLen);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+// For each child, find the neighbour associated with it.
+// This prevents us from having to actualy store both tables in full at the same time.
+static otError CombinedChildPageHandler(const uint8_t *aEntries, size_t aLength, void *aContext)
+{
+    thci_table_page_context_t *context = (thci_table_page_context_t *)aContext;
+    thci_neighbor_child_info_t *table = (thci_neighbor_child_info_t *)context->mTable;
+    spinel_ssize_t parsedLen;
+    otError retval = OT_ERROR_NONE;
 
-    // For each child, find the neighbour associated with it.
-    // This prevents us from having to actualy store both tables in full at the same time.
-    while (argLen > 0)
+    while (aLength > 0)
     {
-        uint64_t                   *eui64;
-        uint8_t                     modeFlags;
-
         otChildInfo                 tempChild;
         thci_neighbor_child_info_t *entry = NULL;
 
-        parsedLen = spinel_datatype_unpack(argPtr, argLen,
-                                           SPINEL_DATATYPE_STRUCT_S(
-                                               SPINEL_DATATYPE_EUI64_S   // EUI64 Address
-                                               SPINEL_DATATYPE_UINT16_S  // Rloc16
-                                               SPINEL_DATATYPE_UINT32_S  // Timeout
-                                               SPINEL_DATATYPE_UINT32_S  // Age
-                                               SPINEL_DATATYPE_UINT8_S   // Network Data Version
-                                               SPINEL_DATATYPE_UINT8_S   // Link Quality In
-                                               SPINEL_DATATYPE_INT8_S    // Average RSS
-                                               SPINEL_DATATYPE_UINT8_S   // Mode (flags)
-                                               SPINEL_DATATYPE_INT8_S    // Most recent RSS
-                                               ),
-                                           &eui64,
-                                           &tempChild.mRloc16,
-                                           &tempChild.mTimeout,
-                                           &tempChild.mAge,
-                                           &tempChild.mNetworkDataVersion,
-                                           &tempChild.mLinkQualityIn,
-                                           &tempChild.mAverageRssi,
-                                           &modeFlags,
-                                           &tempChild.mLastRssi);
+        parsedLen = UnpackChildEntry(aEntries, aLength, &tempChild);
+        nlREQUIRE_ACTION(parsedLen > 0, done, retval = OT_ERROR_PARSE);
 
         // Now find the neighbour entry
-        for (uint32_t i = 0; i < neighborLen; i++)
+        for (uint32_t i = 0; i < context->mCount; i++)
         {
-            if (aTableHead[i].mNeighborInfo.mRloc16 == tempChild.mRloc16)
+            if (table[i].mNeighborInfo.mRloc16 == tempChild.mRloc16)
             {
-                entry = &aTableHead[i];
+                entry = &table[i];
                 break;
             }
         }
@@ -2932,26 +4796,52 @@ otError thciGetCombinedNeighborTable(thci_neighbor_child_info_t *aTableHead, uin
 
             entry->mFoundChild = true;
 
-            numIsChild--;
+            context->mChildren--;
         }
 
-        argPtr += parsedLen;
-        argLen -= parsedLen;
+        aEntries += parsedLen;
+        aLength -= parsedLen;
     }
 
+done:
+    return retval;
+}
+
+otError thciGetCombinedNeighborTable(thci_neighbor_child_info_t *aTableHead, uint32_t aInSize, uint32_t *aOutSize)
+{
+    otError                   retval;
+    thci_table_page_context_t context;
+
+    nlREQUIRE_ACTION(aTableHead                   != NULL                   , done, retval = OT_ERROR_INVALID_ARGS );
+    nlREQUIRE_ACTION(aInSize                      != 0                      , done, retval = OT_ERROR_INVALID_ARGS );
+    nlREQUIRE_ACTION(aOutSize                     != NULL                   , done, retval = OT_ERROR_INVALID_ARGS );
+
+    context.mTable    = aTableHead;
+    context.mSize     = aInSize;
+    context.mCount    = 0;
+    context.mChildren = 0;
+
+    // Get the neighbour table, up to aInSize entries.
+    retval = GetTableProperty(SPINEL_PROP_THREAD_NEIGHBOR_TABLE, CombinedNeighborPageHandler, &context);
+    nlREQUIRE(retval == OT_ERROR_NONE || retval == OT_ERROR_ABORT, done);
+
+    // Now get the child info
+    retval = GetTableProperty(SPINEL_PROP_THREAD_CHILD_TABLE, CombinedChildPageHandler, &context);
+    nlREQUIRE(retval == OT_ERROR_NONE, done);
+
     // Is there a neighbour that said its a child, but no child for it?
     {
         // Need to find the offenders
         uint32_t i = 0;
-        while (numIsChild > 0 && i < neighborLen)
+        while (context.mChildren > 0 && i < context.mCount)
         {
             if (aTableHead[i].mNeighborInfo.mIsChild == true &&
                 aTableHead[i].mFoundChild            == false)
             {
                 // This entry needs to be purged
-                aTableHead[i] = aTableHead[neighborLen - 1];
-                neighborLen--;
-                numIsChild--;
+                aTableHead[i] = aTableHead[context.mCount - 1];
+                context.mCount--;
+                context.mChildren--;
             }
             else
             {
@@ -2960,13 +4850,17 @@ otError thciGetCombinedNeighborTable(thci_neighbor_child_info_t *aTableHead, uin
         }
     }
 
-    *aOutSize = neighborLen;
+    *aOutSize = context.mCount;
 
 done:
     if (retval != OT_ERROR_NONE)
     {
         NL_LOG_CRIT(lrTHCI, "Error getting Neighbor/Child table\n");
-        *aOutSize = 0;
+
+        if (aOutSize != NULL)
+        {
+            *aOutSize = 0;
+        }
     }
 
     return retval;
@@ -2975,74 +4869,42 @@ done:
 
 otError thciGetChildTable(otChildInfo *aChildTableHead, uint32_t aInSize, uint32_t *aOutSize)
 {
-    spinel_ssize_t parsedLength;
     otError retval;
-    uint8_t tid = GetNewTransactionId();
-    const uint8_t *argPtr = NULL;
-    size_t argLen;
+    thci_table_page_context_t table;
+    thci_table_visit_context_t context;
 
     nlREQUIRE_ACTION(aChildTableHead != NULL, done, retval = OT_ERROR_INVALID_ARGS);
     nlREQUIRE_ACTION(aInSize         != 0,    done, retval = OT_ERROR_INVALID_ARGS);
     nlREQUIRE_ACTION(aOutSize        != NULL, done, retval = OT_ERROR_INVALID_ARGS);
-    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
 
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_THREAD_CHILD_TABLE, NULL);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+    table.mTable    = aChildTableHead;
+    table.mSize     = aInSize;
+    table.mCount    = 0;
+    table.mChildren = 0;
 
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_THREAD_CHILD_TABLE, &argPtr, &argLen);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+    context.mChildVisitor    = CopyChildVisitor;
+    context.mNeighborVisitor = NULL;
+    context.mContext         = &table;
 
-    *aOutSize = 0;
+    // Stops at aInSize entries.
+    retval = GetTableProperty(SPINEL_PROP_THREAD_CHILD_TABLE, ChildVisitHandler, &context);
 
-    while (argLen > 0 && *aOutSize < aInSize)
+    if (retval == OT_ERROR_ABORT)
     {
-        // The EUI-64 is unpacked as a pointer instead of a value.
-        uint64_t    *eui64;
-
-        otChildInfo *currChild = &aChildTableHead[*aOutSize];
-        uint8_t      modeFlags;
-
-        parsedLength = spinel_datatype_unpack(argPtr, argLen,
-                                           SPINEL_DATATYPE_STRUCT_S(
-                                               SPINEL_DATATYPE_EUI64_S   // EUI64 Address
-                                               SPINEL_DATATYPE_UINT16_S  // Rloc16
-                                               SPINEL_DATATYPE_UINT32_S  // Timeout
-                                               SPINEL_DATATYPE_UINT32_S  // Age
-                                               SPINEL_DATATYPE_UINT8_S   // Network Data Version
-                                               SPINEL_DATATYPE_UINT8_S   // Link Quality In
-                                               SPINEL_DATATYPE_INT8_S    // Average RSS
-                                               SPINEL_DATATYPE_UINT8_S   // Mode (flags)
-                                               SPINEL_DATATYPE_INT8_S    // Most recent RSS
-                                               ),
-                                           &eui64,
-                                           &currChild->mRloc16,
-                                           &currChild->mTimeout,
-                                           &currChild->mAge,
-                                           &currChild->mNetworkDataVersion,
-                                           &currChild->mLinkQualityIn,
-                                           &currChild->mAverageRssi,
-                                           &modeFlags,
-                                           &currChild->mLastRssi);
-
-        nlREQUIRE_ACTION(parsedLength > 0, done, retval = OT_ERROR_PARSE);
-
-        currChild->mRxOnWhenIdle      = (modeFlags & SPINEL_THREAD_MODE_RX_ON_WHEN_IDLE    ) ? true : false;
-        currChild->mSecureDataRequest = (modeFlags & SPINEL_THREAD_MODE_SECURE_DATA_REQUEST) ? true : false;
-        currChild->mFullFunction      = (modeFlags & SPINEL_THREAD_MODE_FULL_FUNCTION_DEV  ) ? true : false;
-        currChild->mFullNetworkData   = (modeFlags & SPINEL_THREAD_MODE_FULL_NETWORK_DATA  ) ? true : false;
-
-        memcpy(currChild->mExtAddress.m8, eui64, sizeof(uint64_t));
-
-        argPtr += parsedLength;
-        argLen -= parsedLength;
-        (*aOutSize)++;
+        retval = OT_ERROR_NONE;
     }
 
+    *aOutSize = table.mCount;
+
 done:
     if (retval != OT_ERROR_NONE)
     {
         NL_LOG_CRIT(lrTHCI, "Error getting child table\n");
-        *aOutSize = 0;
+
+        if (aOutSize != NULL)
+        {
+            *aOutSize = 0;
+        }
     }
 
     return retval;
@@ -3051,80 +4913,97 @@ done:
 otError thciGetNeighborTable(otNeighborInfo *aNeighborTableHead, uint32_t aInSize, uint32_t *aOutSize)
 {
     otError retval;
-    uint8_t tid = GetNewTransactionId();
-
-    const uint8_t *argPtr = NULL;
-    size_t argLen;
-
-    spinel_ssize_t parsedLen;
+    thci_table_page_context_t table;
+    thci_table_visit_context_t context;
 
     nlREQUIRE_ACTION(aNeighborTableHead != NULL, done, retval = OT_ERROR_INVALID_ARGS);
     nlREQUIRE_ACTION(aInSize            != 0,    done, retval = OT_ERROR_INVALID_ARGS);
     nlREQUIRE_ACTION(aOutSize           != NULL, done, retval = OT_ERROR_INVALID_ARGS);
-    nlREQUIRE_ACTION(gTHCINCPContext.mModuleState == kModuleStateInitialized, done, retval = OT_ERROR_INVALID_STATE);
 
-    retval = thciUartFrameSend(tid, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_THREAD_NEIGHBOR_TABLE, NULL);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+    table.mTable    = aNeighborTableHead;
+    table.mSize     = aInSize;
+    table.mCount    = 0;
+    table.mChildren = 0;
 
-    retval = thciUartWaitForResponse(tid, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_THREAD_NEIGHBOR_TABLE, &argPtr, &argLen);
-    nlREQUIRE(retval == OT_ERROR_NONE, done);
+    context.mChildVisitor    = NULL;
+    context.mNeighborVisitor = CopyNeighborVisitor;
+    context.mContext         = &table;
 
-    *aOutSize = 0;
+    // Stops at aInSize entries.
+    retval = GetTableProperty(SPINEL_PROP_THREAD_NEIGHBOR_TABLE, NeighborVisitHandler, &context);
 
-    while (argLen > 0 && *aOutSize < aInSize)
+    if (retval == OT_ERROR_ABORT)
     {
-        // The EUI-64 is unpacked as a pointer instead of a value.
-        uint64_t       *eui64;
+        retval = OT_ERROR_NONE;
+    }
 
-        otNeighborInfo *currNeighbor = &aNeighborTableHead[*aOutSize];
-        uint8_t         modeFlags;
-        bool            isChild;
+    *aOutSize = table.mCount;
 
-        parsedLen = spinel_datatype_unpack(argPtr, argLen,
-                                           SPINEL_DATATYPE_STRUCT_S(
-                                               SPINEL_DATATYPE_EUI64_S   // EUI64 Address
-                                               SPINEL_DATATYPE_UINT16_S  // Rloc16
-                                               SPINEL_DATATYPE_UINT32_S  // Age
-                                               SPINEL_DATATYPE_UINT8_S   // Link Quality In
-                                               SPINEL_DATATYPE_INT8_S    // Average RSS
-                                               SPINEL_DATATYPE_UINT8_S   // Mode (flags)
-                                               SPINEL_DATATYPE_BOOL_S    // Is Child
-                                               SPINEL_DATATYPE_UINT32_S  // Link Frame Counter
-                                               SPINEL_DATATYPE_UINT32_S  // MLE Frame Counter
-                                               SPINEL_DATATYPE_INT8_S    // Most recent RSS
-                                               ),
-                                           &eui64,
-                                           &currNeighbor->mRloc16,
-                                           &currNeighbor->mAge,
-                                           &currNeighbor->mLinkQualityIn,
-                                           &currNeighbor->mAverageRssi,
-                                           &modeFlags,
-                                           &isChild,
-                                           &currNeighbor->mLinkFrameCounter,
-                                           &currNeighbor->mMleFrameCounter,
-                                           &currNeighbor->mLastRssi);
+done:
+    if (retval != OT_ERROR_NONE)
+    {
+        NL_LOG_CRIT(lrTHCI, "Error getting neighbor table\n");
 
-        nlREQUIRE_ACTION(parsedLen > 0, done, retval = OT_ERROR_PARSE);
+        if (aOutSize != NULL)
+        {
+            *aOutSize = 0;
+        }
+    }
+
+    return retval;
+}
+
+otError thciVisitChildTable(thciChildVisitor aVisitor, void *aContext)
+{
+    otError retval;
+    thci_table_visit_context_t context;
 
-        currNeighbor->mIsChild = isChild;
+    nlREQUIRE_ACTION(aVisitor != NULL, done, retval = OT_ERROR_INVALID_ARGS);
 
-        currNeighbor->mRxOnWhenIdle      = (modeFlags & SPINEL_THREAD_MODE_RX_ON_WHEN_IDLE    ) ? true : false;
-        currNeighbor->mSecureDataRequest = (modeFlags & SPINEL_THREAD_MODE_SECURE_DATA_REQUEST) ? true : false;
-        currNeighbor->mFullFunction      = (modeFlags & SPINEL_THREAD_MODE_FULL_FUNCTION_DEV  ) ? true : false;
-        currNeighbor->mFullNetworkData   = (modeFlags & SPINEL_THREAD_MODE_FULL_NETWORK_DATA  ) ? true : false;
+    context.mChildVisitor    = aVisitor;
+    context.mNeighborVisitor = NULL;
+    context.mContext         = aContext;
 
-        memcpy(currNeighbor->mExtAddress.m8, eui64, sizeof(uint64_t));
+    retval = GetTableProperty(SPINEL_PROP_THREAD_CHILD_TABLE, ChildVisitHandler, &context);
 
-        argPtr += parsedLen;
-        argLen -= parsedLen;
-        (*aOutSize)++;
+    // Stopped by the visitor.
+    if (retval == OT_ERROR_ABORT)
+    {
+        retval = OT_ERROR_NONE;
     }
 
 done:
     if (retval != OT_ERROR_NONE)
     {
-        NL_LOG_CRIT(lrTHCI, "Error getting neighbor table\n");
-        *aOutSize = 0;
+        NL_LOG_CRIT(lrTHCI, "Error visiting child table\n");
+    }
+
+    return retval;
+}
+
+otError thciVisitNeighborTable(thciNeighborVisitor aVisitor, void *aContext)
+{
+    otError retval;
+    thci_table_visit_context_t context;
+
+    nlREQUIRE_ACTION(aVisitor != NULL, done, retval = OT_ERROR_INVALID_ARGS);
+
+    context.mChildVisitor    = NULL;
+    context.mNeighborVisitor = aVisitor;
+    context.mContext         = aContext;
+
+    retval = GetTableProperty(SPINEL_PROP_THREAD_NEIGHBOR_TABLE, NeighborVisitHandler, &context);
+
+    // Stopped by the visitor.
+    if (retval == OT_ERROR_ABORT)
+    {
+        retval = OT_ERROR_NONE;
+    }
+
+done:
+    if (retval != OT_ERROR_NONE)
+    {
+        NL_LOG_CRIT(lrTHCI, "Error visiting neighbor table\n");
     }
 
     return retval;
@@ -3133,24 +5012,42 @@ done:
 
 void thciStallOutgoingDataPackets(bool aEnable)
 {
-    if (gTHCISDKContext.mStallOutgoingDataPackets != aEnable)
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_sdk_context_t *sdk = &gTHCISDKContexts[index];
+
+    if (sdk->mStallOutgoingDataPackets != aEnable)
     {
-        gTHCISDKContext.mStallOutgoingDataPackets = aEnable;
+        sdk->mStallOutgoingDataPackets = aEnable;
 
-        if (!gTHCISDKContext.mStallOutgoingDataPackets && !IsMessageQueueEmpty())
+        if (!sdk->mStallOutgoingDataPackets && HasReadyMessages(index))
         {
             // post an event to restart the flow of outgoing packets.
+            PostOutgoingIPPacketEvent(index);
+        }
+    }
+}
 
-            // Race conditions can exist between the LWIP task in LwIPOutputIP6 and the THCI task 
-            // here which can result in multiple sOutgoingIPPacketEvents posted to the event queue.
-            // This __sync_fetch_and_or ensures that only one sOutgoingIPPacketEvent is ever posted to the queue.
-            if (!__sync_fetch_and_or(&sOutgoingIPPacketEventPosted, 1))
-            {
-                nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sOutgoingIPPacketEvent);
-            }
+#if THCI_CONFIG_SPINEL_IID_MUX
+void thciStallNetifDataPackets(thci_netif_tags_t aTag, bool aEnable)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_sdk_context_t *sdk = &gTHCISDKContexts[index];
+    const uint8_t mask = (1 << THCI_MESSAGE_QUEUE_OF(aTag));
+
+    if (aEnable)
+    {
+        __sync_fetch_and_or(&sdk->mStalledMessageQueues, mask);
+    }
+    else if (__sync_fetch_and_and(&sdk->mStalledMessageQueues, (uint8_t)~mask) & mask)
+    {
+        if (!sdk->mStallOutgoingDataPackets && HasReadyMessages(index))
+        {
+            // post an event to restart the flow of outgoing packets.
+            PostOutgoingIPPacketEvent(index);
         }
     }
 }
+#endif
 
 #if THCI_CONFIG_LEGACY_ALARM_SUPPORT
 otError thciSetLegacyNetworkWake(bool aEnable, uint8_t aReason)
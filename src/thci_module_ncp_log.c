@@ -0,0 +1,390 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements capture of the NCP debug stream.
+ *
+ *      Each debug stream frame is stored verbatim as a chunk: a 4-byte
+ *      receive timestamp, a 2-byte length and the stream bytes.  A chunk
+ *      is either stored whole or dropped whole, so the reader never sees
+ *      a torn chunk.  Frames longer than kMaxChunkLength are stored as
+ *      several chunks so the reader only needs a small scratch buffer.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlerlock.h>
+#include <nlerevent.h>
+#include <nlplatform/nltime.h>
+
+#include <thci.h>
+#include <thci_clock.h>
+#include <thci_module.h>
+#include <thci_ncp_log.h>
+#include <thci_stats.h>
+
+#define kChunkHeaderSize    (sizeof(uint32_t) + sizeof(uint16_t))
+#define kMaxChunkLength     128
+#define kLineLength         96
+#define kRateWindowMsec     1000
+// Lines logged per flush event and instance, so that a full ring does not
+// hold the log task for long.
+#define kFlushLines         8
+
+typedef struct
+{
+    uint8_t                 mRing[THCI_CONFIG_NCP_LOG_RING_SIZE];
+    uint32_t                mHead;              // free running write index.
+    uint32_t                mTail;              // free running read index.
+    uint32_t                mWindowStart;       // start of the current rate limit window.
+    uint32_t                mWindowBytes;       // bytes accepted in the current window.
+    nl_lock_t               mLock;
+    thci_ncp_log_stats_t    mStats;
+    volatile uint32_t       mEventPosted;
+    char                    mTag[8];            // "NCP", followed by the instance index past the first one.
+
+    // reader state, only touched by thciNcpLogFlush() while it holds mReading.
+    volatile uint32_t       mReading;
+    char                    mLine[kLineLength + 1];
+    size_t                  mLinePos;
+    uint32_t                mLineTime;          // host time of the chunk that started mLine.
+} thci_ncp_log_context_t;
+
+static thci_ncp_log_context_t sNcpLogs[THCI_CONFIG_MAX_INSTANCES];
+
+#define sNcpLog                         (sNcpLogs[THCI_INSTANCE_INDEX()])
+
+static int FlushEventHandler(nl_event_t *aEvent, void *aClosure);
+
+static const nl_event_t sFlushEvent =
+{
+    NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), FlushEventHandler, NULL)
+};
+
+// Flushing is left to the low priority task serving mLogQueue, never to the
+// THCI task; without one, to the application.
+static void PostFlushEvent(void)
+{
+    const nl_eventqueue_t queue = gTHCISDKContext.mInitParams.mLogQueue;
+
+    if (queue == NULL)
+    {
+        return;
+    }
+
+    if (!__sync_fetch_and_or(&sNcpLog.mEventPosted, 1))
+    {
+        THCI_EVENT_STATS_POSTED(kThciEventLogFlush);
+        nl_eventqueue_post_event(queue, &sFlushEvent);
+    }
+    else
+    {
+        THCI_EVENT_STATS_SUPPRESSED(kThciEventLogFlush);
+    }
+}
+
+static void RingWrite(thci_ncp_log_context_t *aContext, const void *aData, size_t aLength)
+{
+    const uint8_t *data = (const uint8_t *)aData;
+    size_t offset = aContext->mHead % sizeof(aContext->mRing);
+    size_t first = sizeof(aContext->mRing) - offset;
+
+    if (first > aLength)
+    {
+        first = aLength;
+    }
+
+    memcpy(&aContext->mRing[offset], data, first);
+    memcpy(&aContext->mRing[0], data + first, aLength - first);
+
+    aContext->mHead += aLength;
+}
+
+static void RingPeek(const thci_ncp_log_context_t *aContext, uint32_t aIndex, void *aData, size_t aLength)
+{
+    uint8_t *data = (uint8_t *)aData;
+    size_t offset = aIndex % sizeof(aContext->mRing);
+    size_t first = sizeof(aContext->mRing) - offset;
+
+    if (first > aLength)
+    {
+        first = aLength;
+    }
+
+    memcpy(data, &aContext->mRing[offset], first);
+    memcpy(data + first, &aContext->mRing[0], aLength - first);
+}
+
+int thciNcpLogInit(void)
+{
+    int retval = 0;
+
+    if (sNcpLog.mLock == NULL)
+    {
+        sNcpLog.mLock = nl_er_lock_create();
+        nlREQUIRE_ACTION(sNcpLog.mLock != NULL, done, retval = -ENOMEM);
+
+        sNcpLog.mHead = sNcpLog.mTail = 0;
+        sNcpLog.mLinePos = 0;
+        memset(&sNcpLog.mStats, 0, sizeof(sNcpLog.mStats));
+
+        if (THCI_INSTANCE_INDEX() == 0)
+        {
+            snprintf(sNcpLog.mTag, sizeof(sNcpLog.mTag), "NCP");
+        }
+        else
+        {
+            snprintf(sNcpLog.mTag, sizeof(sNcpLog.mTag), "NCP%u", THCI_INSTANCE_INDEX());
+        }
+    }
+
+ done:
+    return retval;
+}
+
+void thciNcpLogAppend(const uint8_t *aData, uint16_t aLength)
+{
+    thci_ncp_log_context_t *context = &sNcpLog;
+    const uint32_t now = (uint32_t)nltime_get_system_ms();
+    uint32_t used;
+    uint32_t chunks;
+    uint16_t remaining;
+    uint16_t chunkLength;
+#if THCI_CONFIG_NCP_LOG_RATE_LIMIT
+    uint32_t budget;
+#endif
+
+    nlREQUIRE(context->mLock != NULL && aLength > 0, done);
+    nlREQUIRE(nl_er_lock_enter(context->mLock) == 0, done);
+
+    if (now - context->mWindowStart >= kRateWindowMsec)
+    {
+        context->mWindowStart = now;
+        context->mWindowBytes = 0;
+    }
+
+#if THCI_CONFIG_NCP_LOG_RATE_LIMIT
+    // Keep what fits in the budget, so that a frame longer than the whole
+    // budget is still logged in part.
+    budget = THCI_CONFIG_NCP_LOG_RATE_LIMIT - context->mWindowBytes;
+
+    if (aLength > budget)
+    {
+        context->mStats.mRateLimitedBytes += aLength - budget;
+        aLength = (uint16_t)budget;
+    }
+
+    nlREQUIRE(aLength > 0, unlock);
+#endif
+
+    used = context->mHead - context->mTail;
+    chunks = (aLength + kMaxChunkLength - 1) / kMaxChunkLength;
+
+    nlREQUIRE_ACTION(used + (chunks * kChunkHeaderSize) + aLength <= sizeof(context->mRing), unlock,
+                     context->mStats.mOverflowBytes += aLength);
+
+    for (remaining = aLength; remaining > 0; remaining -= chunkLength)
+    {
+        chunkLength = (remaining > kMaxChunkLength) ? kMaxChunkLength : remaining;
+
+        RingWrite(context, &now, sizeof(now));
+        RingWrite(context, &chunkLength, sizeof(chunkLength));
+        RingWrite(context, aData, chunkLength);
+
+        aData += chunkLength;
+    }
+
+    used += (chunks * kChunkHeaderSize) + aLength;
+
+    if (used > context->mStats.mHighWater)
+    {
+        context->mStats.mHighWater = used;
+    }
+
+    context->mWindowBytes += aLength;
+    context->mStats.mCapturedChunks += chunks;
+    context->mStats.mCapturedBytes += aLength;
+
+ unlock:
+    nl_er_lock_exit(context->mLock);
+
+    if (context->mHead != context->mTail)
+    {
+        PostFlushEvent();
+    }
+
+ done:
+    return;
+}
+
+int thciNcpLogRead(uint8_t *aBuffer, size_t aSize, uint32_t *aTimestamp)
+{
+    thci_ncp_log_context_t *context = &sNcpLog;
+    int retval = 0;
+    uint32_t timestamp;
+    uint16_t length;
+
+    nlREQUIRE(context->mLock != NULL, done);
+    nlREQUIRE(nl_er_lock_enter(context->mLock) == 0, done);
+
+    nlREQUIRE(context->mHead != context->mTail, unlock);
+
+    RingPeek(context, context->mTail, &timestamp, sizeof(timestamp));
+    RingPeek(context, context->mTail + sizeof(timestamp), &length, sizeof(length));
+
+    nlREQUIRE_ACTION(length <= aSize, unlock, retval = -ENOSPC);
+
+    RingPeek(context, context->mTail + kChunkHeaderSize, aBuffer, length);
+    context->mTail += kChunkHeaderSize + length;
+
+    if (aTimestamp)
+    {
+        *aTimestamp = timestamp;
+    }
+
+    retval = length;
+
+ unlock:
+    nl_er_lock_exit(context->mLock);
+
+ done:
+    return retval;
+}
+
+size_t thciNcpLogFlush(size_t aMaxLines)
+{
+    thci_ncp_log_context_t *context = &sNcpLog;
+    uint8_t chunk[kMaxChunkLength];
+    size_t lines = 0;
+    uint32_t timestamp;
+    int length;
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+    uint32_t ncpTime;
+    uint32_t ncpError;
+#endif
+
+    // The shell may flush while the event does.
+    nlREQUIRE(!__sync_lock_test_and_set(&context->mReading, 1), done);
+
+    while (aMaxLines == 0 || lines < aMaxLines)
+    {
+        length = thciNcpLogRead(chunk, sizeof(chunk), &timestamp);
+
+        if (length <= 0)
+        {
+            break;
+        }
+
+        for (int i = 0; i < length; i++)
+        {
+            char nextchar = (char)chunk[i];
+
+            if ((nextchar == '\t') || (nextchar >= 32))
+            {
+                if (context->mLinePos == 0)
+                {
+                    context->mLineTime = timestamp;
+                }
+
+                context->mLine[context->mLinePos++] = nextchar;
+            }
+
+            // Lines may be split across debug stream frames, so a line is
+            // only flushed on an end of line or when the line buffer is full.
+            if ((context->mLinePos != 0) &&
+                ((nextchar == '\n') ||
+                 (nextchar == '\r') ||
+                 (context->mLinePos >= kLineLength)))
+            {
+                context->mLine[context->mLinePos] = 0;
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+                // The NCP time of the line, to match the timestamps of its
+                // own logs.
+                if (thciHostTimeToNcp(context->mLineTime, &ncpTime, &ncpError))
+                {
+                    NL_LOG_CRIT(lrTHCI, "%s => [%u ncp %u~%u] %s\n", context->mTag, context->mLineTime, ncpTime, ncpError, context->mLine);
+                }
+                else
+#endif
+                {
+                    NL_LOG_CRIT(lrTHCI, "%s => [%u] %s\n", context->mTag, context->mLineTime, context->mLine);
+                }
+                context->mLinePos = 0;
+                lines++;
+            }
+        }
+    }
+
+    __sync_lock_release(&context->mReading);
+
+ done:
+    return lines;
+}
+
+// Runs on the log task, which may serve every instance: each posted ring is
+// flushed with the task bound to its instance, for its tag and clock.
+static int FlushEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    thci_instance_t *previous;
+
+    (void)aEvent;
+    (void)aClosure;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventLogFlush);
+
+    for (uint8_t i = 0; i < THCI_CONFIG_MAX_INSTANCES; i++)
+    {
+        if (!sNcpLogs[i].mEventPosted)
+        {
+            continue;
+        }
+
+        previous = thciSetCurrentInstance(thciGetInstance(i));
+
+        sNcpLog.mEventPosted = 0;
+
+        // The rest of a full ring is left to the next event, behind the
+        // events posted meanwhile.
+        if ((thciNcpLogFlush(kFlushLines) == kFlushLines) && (sNcpLog.mHead != sNcpLog.mTail))
+        {
+            PostFlushEvent();
+        }
+
+        thciSetCurrentInstance(previous);
+    }
+
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventLogFlush);
+
+    return 0;
+}
+
+void thciNcpLogGetStats(thci_ncp_log_stats_t *aStats)
+{
+    memcpy(aStats, &sNcpLog.mStats, sizeof(*aStats));
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
@@ -0,0 +1,243 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the Spinel shared memory transport of the NCP
+ *      module.
+ *
+ *      Received frames are passed to the frame callback in place, in the
+ *      NCP to host ring.  A frame the Spinel layer holds on to stays in the
+ *      ring until the next thciTransportProcess().  Sent frames are copied
+ *      into the host to NCP ring.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM
+
+#include <errno.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlertask.h>
+
+#include <openthread/types.h>
+
+#include <thci.h>
+#include <thci_module.h>
+#include <thci_module_ncp_transport.h>
+#include <thci_shm.h>
+
+// How long thciTransportSendFrame() waits for room in a full ring.
+#define SHM_TX_RETRY_MSEC               1
+#define SHM_TX_TIMEOUT_MSEC             3000
+
+typedef struct
+{
+    const thci_transport_callbacks_t *mCallbacks;   // NULL while disabled.
+    thci_shm_region_t  *mRegion;
+    volatile bool       mDoorbellEnabled;
+    bool                mRxHeld;        // the oldest frame of the ring is still in use.
+} thci_shm_context_t;
+
+static thci_shm_context_t sShmContexts[THCI_CONFIG_MAX_INSTANCES];
+
+// The POSIX platform rings from its doorbell thread, others from an interrupt.
+#if THCI_CONFIG_SHM_POSIX
+#define SHM_DOORBELL_CONTEXT            kThciTransportContextThread
+#else
+#define SHM_DOORBELL_CONTEXT            kThciTransportContextIsr
+#endif
+
+static void ShmDoorbellHandler(uint8_t aInstanceIndex)
+{
+    thci_shm_context_t *shm = &sShmContexts[aInstanceIndex];
+
+    // The frames stay in the ring when nobody processes them.
+    if (shm->mDoorbellEnabled)
+    {
+        (void)shm->mCallbacks->mReady(aInstanceIndex, SHM_DOORBELL_CONTEXT);
+    }
+}
+
+static uint32_t ShmRxCount(const thci_shm_context_t *aShm)
+{
+    return thciShmRingCount(aShm->mRegion, kThciShmNcpToHost) - aShm->mRxHeld;
+}
+
+static void ShmDoorbellEnable(uint8_t aInstanceIndex)
+{
+    thci_shm_context_t *shm = &sShmContexts[aInstanceIndex];
+
+    shm->mDoorbellEnabled = true;
+    thciShmPlatformEnable(aInstanceIndex, ShmDoorbellHandler);
+
+    // A ring before the handler was installed was missed.
+    if (ShmRxCount(shm) > 0)
+    {
+        (void)shm->mCallbacks->mReady(aInstanceIndex, kThciTransportContextTask);
+    }
+}
+
+otError thciTransportEnable(const thci_transport_callbacks_t *aCallbacks)
+{
+    otError retval = OT_ERROR_NONE;
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_shm_context_t *shm = &sShmContexts[index];
+    thci_shm_region_t *region = thciShmPlatformGetRegion(index);
+
+    nlREQUIRE_ACTION(region != NULL, done, retval = OT_ERROR_FAILED;
+                     NL_LOG_CRIT(lrTHCI, "%s: no shared memory region\n", __FUNCTION__));
+    nlREQUIRE_ACTION(thciShmRegionIsValid(region), done, retval = OT_ERROR_FAILED;
+                     NL_LOG_CRIT(lrTHCI, "%s: shared memory region of another layout\n", __FUNCTION__));
+
+    shm->mCallbacks = aCallbacks;
+    shm->mRegion = region;
+    shm->mRxHeld = false;
+
+    ShmDoorbellEnable(index);
+
+ done:
+    return retval;
+}
+
+void thciTransportDisable(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_shm_context_t *shm = &sShmContexts[index];
+
+    shm->mDoorbellEnabled = false;
+    thciShmPlatformEnable(index, NULL);
+
+    if (shm->mRxHeld)
+    {
+        thciShmRingRelease(shm->mRegion, kThciShmNcpToHost);
+        shm->mRxHeld = false;
+    }
+
+    shm->mCallbacks = NULL;
+    shm->mRegion = NULL;
+}
+
+void thciTransportSleepEnable(void)
+{
+    ShmDoorbellEnable(THCI_INSTANCE_INDEX());
+}
+
+bool thciTransportSleepDisable(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_shm_context_t *shm = &sShmContexts[index];
+    bool retval = false;
+
+    nlREQUIRE(ShmRxCount(shm) == 0, done);
+
+    shm->mDoorbellEnabled = false;
+    thciShmPlatformEnable(index, NULL);
+    retval = true;
+
+ done:
+    return retval;
+}
+
+otError thciTransportSendFrame(const uint8_t *aFrame, uint16_t aLength)
+{
+    otError retval = OT_ERROR_NONE;
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_shm_context_t *shm = &sShmContexts[index];
+    uint32_t tries = 0;
+    int err;
+
+    nlREQUIRE_ACTION(shm->mRegion != NULL, done, retval = OT_ERROR_INVALID_STATE);
+
+    while ((err = thciShmRingPut(shm->mRegion, kThciShmHostToNcp, aFrame, aLength)) == -ENOBUFS)
+    {
+        nlREQUIRE_ACTION(++tries < (SHM_TX_TIMEOUT_MSEC / SHM_TX_RETRY_MSEC), done, retval = OT_ERROR_BUSY);
+
+        // Let other tasks run while the NCP drains the ring.
+        nl_task_sleep_ms(SHM_TX_RETRY_MSEC);
+    }
+
+    nlREQUIRE_ACTION(err == 0, done, retval = OT_ERROR_INVALID_ARGS);
+
+    thciShmPlatformRingDoorbell(index);
+
+ done:
+    return retval;
+}
+
+void thciTransportProcess(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_shm_context_t *shm = &sShmContexts[index];
+    bool released = false;
+    uint8_t *frame;
+    uint16_t length;
+    int err;
+
+    nlREQUIRE(shm->mRegion != NULL, done);
+
+    if (shm->mRxHeld)
+    {
+        thciShmRingRelease(shm->mRegion, kThciShmNcpToHost);
+        shm->mRxHeld = false;
+        released = true;
+    }
+
+    while ((err = thciShmRingPeek(shm->mRegion, kThciShmNcpToHost, &frame, &length)) == 0)
+    {
+        if (!shm->mCallbacks->mFrame(index, frame, length))
+        {
+            shm->mRxHeld = true;
+            break;
+        }
+
+        thciShmRingRelease(shm->mRegion, kThciShmNcpToHost);
+        released = true;
+    }
+
+    // Room for the NCP, which may wait for it.
+    if (released)
+    {
+        thciShmPlatformRingDoorbell(index);
+    }
+
+    if (err == -EBADMSG)
+    {
+        NL_LOG_CRIT(lrTHCI, "%s: corrupt ring of instance %d\n", __FUNCTION__, index);
+        shm->mCallbacks->mError(index, OT_ERROR_PARSE);
+    }
+
+ done:
+    return;
+}
+
+bool thciTransportIsPending(void)
+{
+    const thci_shm_context_t *shm = &sShmContexts[THCI_INSTANCE_INDEX()];
+
+    return (shm->mRegion != NULL) && (ShmRxCount(shm) > 0);
+}
+
+uint16_t thciTransportGetMaxRxFrameSize(void)
+{
+    return THCI_CONFIG_SHM_FRAME_SIZE;
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM
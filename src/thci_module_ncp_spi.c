@@ -0,0 +1,395 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the Spinel SPI transport of the NCP module.
+ *
+ *      THCI is the SPI master.  Received frames are kept in a ring of
+ *      THCI_CONFIG_SPI_RX_FRAMES slots, and a transfer offers to receive a
+ *      frame only while a slot is free, so that the NCP holds on to its
+ *      frames while the Spinel layer is behind.  A frame passed to the frame
+ *      callback stays in its slot until the next thciTransportProcess().
+ *
+ *      A transfer clocks the larger of the frame sent and the frame the NCP
+ *      announced in its last header; when its length is not known yet,
+ *      THCI_CONFIG_SPI_SMALL_PACKET_SIZE bytes, so that small frames need a
+ *      single transfer and larger ones two.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SPI
+
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlertask.h>
+
+#include <openthread/types.h>
+
+#include <thci.h>
+#include <thci_module.h>
+#include <thci_module_ncp_transport.h>
+#include <thci_spi.h>
+
+// How long thciTransportSendFrame() waits for the NCP to accept a frame.
+#define SPI_TX_RETRY_MSEC               1
+#define SPI_TX_TIMEOUT_MSEC             3000
+
+// Transfers in a row that move nothing while the NCP claims to have a frame
+// before the link is reported as failed.
+#define SPI_MAX_STALLED_TRANSFERS       100
+
+typedef struct
+{
+    const thci_transport_callbacks_t *mCallbacks;   // NULL while disabled.
+    volatile bool   mInterruptEnabled;
+    bool            mResetPending;      // announce a reset in the next transfer.
+    bool            mRxHeld;            // the slot before mRxHead is still in use.
+    uint8_t         mRxHead;            // oldest frame not yet processed.
+    uint8_t         mRxCount;
+    uint16_t        mNcpDataLength;     // of the frame the NCP announced, 0 if none.
+    uint16_t        mStalledTransfers;
+    uint16_t        mRxLength[THCI_CONFIG_SPI_RX_FRAMES];
+    uint8_t         mRxFrames[THCI_CONFIG_SPI_RX_FRAMES][THCI_SPI_HEADER_SIZE + THCI_CONFIG_SPI_FRAME_SIZE];
+    uint8_t         mRxDiscard[THCI_SPI_HEADER_SIZE + THCI_CONFIG_SPI_FRAME_SIZE];   // when no slot is free.
+    uint8_t         mTxBuffer[THCI_SPI_HEADER_SIZE + THCI_CONFIG_SPI_FRAME_SIZE];
+} thci_spi_context_t;
+
+static thci_spi_context_t sSpiContexts[THCI_CONFIG_MAX_INSTANCES];
+
+static void SpiInterruptIsr(uint8_t aInstanceIndex)
+{
+    thci_spi_context_t *spi = &sSpiContexts[aInstanceIndex];
+
+    // The NCP keeps its frame until it is transferred, so there is nothing
+    // to drop when nobody processes it.
+    if (spi->mInterruptEnabled)
+    {
+        (void)spi->mCallbacks->mReady(aInstanceIndex, kThciTransportContextIsr);
+    }
+}
+
+static void SpiWriteLength(uint8_t *aBuffer, uint16_t aLength)
+{
+    aBuffer[0] = (uint8_t)(aLength & 0xff);
+    aBuffer[1] = (uint8_t)(aLength >> 8);
+}
+
+static uint16_t SpiReadLength(const uint8_t *aBuffer)
+{
+    return (uint16_t)(aBuffer[0] | (aBuffer[1] << 8));
+}
+
+static bool SpiNcpHasData(uint8_t aInstanceIndex)
+{
+    return (sSpiContexts[aInstanceIndex].mNcpDataLength > 0) || thciSpiPlatformIsInterruptAsserted(aInstanceIndex);
+}
+
+static void SpiResetRx(thci_spi_context_t *aSpi)
+{
+    aSpi->mRxHead = 0;
+    aSpi->mRxCount = 0;
+    aSpi->mRxHeld = false;
+    aSpi->mNcpDataLength = 0;
+    aSpi->mStalledTransfers = 0;
+}
+
+/**
+ * Make one transfer, sending the aTxLength bytes of frame in mTxBuffer, if
+ * any, and receiving a frame from the NCP if a slot is free.
+ *
+ * @param[out] aTxAccepted  Set to true if the NCP took the frame sent.
+ *
+ * @retval OT_ERROR_NONE    The transfer was made, whether or not it moved a frame.
+ * @retval OT_ERROR_FAILED  The platform failed the transfer.
+ * @retval OT_ERROR_NO_BUFS The NCP has a frame longer than THCI_CONFIG_SPI_FRAME_SIZE.
+ */
+static otError SpiTransfer(uint8_t aInstanceIndex, uint16_t aTxLength, bool *aTxAccepted)
+{
+    otError retval = OT_ERROR_NONE;
+    thci_spi_context_t *spi = &sSpiContexts[aInstanceIndex];
+    const bool rxFree = (spi->mRxCount + spi->mRxHeld) < THCI_CONFIG_SPI_RX_FRAMES;
+    const uint8_t slot = (spi->mRxHead + spi->mRxCount) % THCI_CONFIG_SPI_RX_FRAMES;
+    uint8_t *rx = rxFree ? spi->mRxFrames[slot] : spi->mRxDiscard;
+    uint16_t rxLength = 0;
+    uint16_t length = aTxLength;
+    uint16_t ncpAccept;
+    uint16_t ncpData;
+    bool moved;
+    int err;
+
+    *aTxAccepted = false;
+
+    if (rxFree)
+    {
+        rxLength = (spi->mNcpDataLength > 0) ? spi->mNcpDataLength : THCI_CONFIG_SPI_SMALL_PACKET_SIZE;
+
+        if (rxLength < aTxLength)
+        {
+            rxLength = aTxLength;
+        }
+
+        if (rxLength > THCI_CONFIG_SPI_FRAME_SIZE)
+        {
+            rxLength = THCI_CONFIG_SPI_FRAME_SIZE;
+        }
+
+        length = rxLength;
+    }
+
+    spi->mTxBuffer[0] = THCI_SPI_HEADER_PATTERN_VALUE | (spi->mResetPending ? THCI_SPI_HEADER_RESET_FLAG : 0);
+    SpiWriteLength(&spi->mTxBuffer[1], rxLength);
+    SpiWriteLength(&spi->mTxBuffer[3], aTxLength);
+
+    err = thciSpiPlatformTransfer(aInstanceIndex, spi->mTxBuffer, rx, THCI_SPI_HEADER_SIZE + length);
+    nlREQUIRE_ACTION(err == 0, done, retval = OT_ERROR_FAILED;
+                     NL_LOG_CRIT(lrTHCI, "%s: transfer failed (%d)\n", __FUNCTION__, err));
+
+    spi->mResetPending = false;
+
+    // An NCP that is booting, or not there, answers with an invalid header;
+    // the transfer moved nothing.  Only transfers made to receive count as
+    // stalled; thciTransportSendFrame() has its own timeout.
+    nlREQUIRE_ACTION((rx[0] & THCI_SPI_HEADER_PATTERN_MASK) == THCI_SPI_HEADER_PATTERN_VALUE, done,
+                     spi->mStalledTransfers += (aTxLength == 0));
+
+    if (rx[0] & THCI_SPI_HEADER_RESET_FLAG)
+    {
+        NL_LOG_CRIT(lrTHCI, "%s: NCP of instance %d reset\n", __FUNCTION__, aInstanceIndex);
+    }
+
+    ncpAccept = SpiReadLength(&rx[1]);
+    ncpData = SpiReadLength(&rx[3]);
+
+    *aTxAccepted = (aTxLength > 0) && (aTxLength <= ncpAccept);
+    moved = *aTxAccepted;
+
+    if ((ncpData > 0) && (ncpData <= rxLength))
+    {
+        spi->mRxLength[slot] = ncpData;
+        spi->mRxCount++;
+        spi->mNcpDataLength = 0;
+        moved = true;
+    }
+    else
+    {
+        // Clocked again, longer if need be, once a slot is free.
+        moved = moved || (rxFree && ncpData != spi->mNcpDataLength);
+        spi->mNcpDataLength = ncpData;
+    }
+
+    if (moved)
+    {
+        spi->mStalledTransfers = 0;
+    }
+    else if (aTxLength == 0)
+    {
+        spi->mStalledTransfers++;
+    }
+
+    nlREQUIRE_ACTION(ncpData <= THCI_CONFIG_SPI_FRAME_SIZE, done, retval = OT_ERROR_NO_BUFS;
+                     NL_LOG_CRIT(lrTHCI, "%s: NCP frame of %d bytes is too long\n", __FUNCTION__, ncpData));
+
+ done:
+    return retval;
+}
+
+static void SpiReportError(uint8_t aInstanceIndex, otError aError)
+{
+    thci_spi_context_t *spi = &sSpiContexts[aInstanceIndex];
+
+    SpiResetRx(spi);
+    spi->mCallbacks->mError(aInstanceIndex, aError);
+}
+
+otError thciTransportEnable(const thci_transport_callbacks_t *aCallbacks)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_spi_context_t *spi = &sSpiContexts[index];
+
+    SpiResetRx(spi);
+    spi->mCallbacks = aCallbacks;
+    spi->mResetPending = true;
+    spi->mInterruptEnabled = true;
+
+    thciSpiPlatformEnable(index, SpiInterruptIsr);
+
+    // An assertion before the handler was installed was missed.
+    if (thciSpiPlatformIsInterruptAsserted(index))
+    {
+        (void)spi->mCallbacks->mReady(index, kThciTransportContextTask);
+    }
+
+    return OT_ERROR_NONE;
+}
+
+void thciTransportDisable(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_spi_context_t *spi = &sSpiContexts[index];
+
+    spi->mInterruptEnabled = false;
+    thciSpiPlatformEnable(index, NULL);
+    spi->mCallbacks = NULL;
+    SpiResetRx(spi);
+}
+
+void thciTransportSleepEnable(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_spi_context_t *spi = &sSpiContexts[index];
+
+    spi->mInterruptEnabled = true;
+    thciSpiPlatformEnable(index, SpiInterruptIsr);
+
+    if (thciSpiPlatformIsInterruptAsserted(index))
+    {
+        (void)spi->mCallbacks->mReady(index, kThciTransportContextTask);
+    }
+}
+
+bool thciTransportSleepDisable(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_spi_context_t *spi = &sSpiContexts[index];
+    bool retval = false;
+
+    nlREQUIRE(spi->mRxCount == 0 && !SpiNcpHasData(index), done);
+
+    spi->mInterruptEnabled = false;
+    thciSpiPlatformEnable(index, NULL);
+    retval = true;
+
+ done:
+    return retval;
+}
+
+otError thciTransportSendFrame(const uint8_t *aFrame, uint16_t aLength)
+{
+    otError retval = OT_ERROR_NONE;
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_spi_context_t *spi = &sSpiContexts[index];
+    uint32_t tries = 0;
+    bool accepted = false;
+
+    nlREQUIRE_ACTION(spi->mCallbacks != NULL, done, retval = OT_ERROR_INVALID_STATE);
+    nlREQUIRE_ACTION(aLength > 0 && aLength <= THCI_CONFIG_SPI_FRAME_SIZE, done, retval = OT_ERROR_INVALID_ARGS);
+
+    memcpy(&spi->mTxBuffer[THCI_SPI_HEADER_SIZE], aFrame, aLength);
+
+    while (true)
+    {
+        retval = SpiTransfer(index, aLength, &accepted);
+        nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+        if (accepted)
+        {
+            break;
+        }
+
+        nlREQUIRE_ACTION(++tries < (SPI_TX_TIMEOUT_MSEC / SPI_TX_RETRY_MSEC), done, retval = OT_ERROR_BUSY);
+
+        // Let other tasks run while the NCP is not ready for the frame.
+        nl_task_sleep_ms(SPI_TX_RETRY_MSEC);
+    }
+
+ done:
+    // Frames that arrived meanwhile, or that the NCP still holds.  A failed
+    // link is reported when they are processed.
+    if (spi->mCallbacks != NULL && (spi->mRxCount > 0 || SpiNcpHasData(index)))
+    {
+        (void)spi->mCallbacks->mReady(index, kThciTransportContextTask);
+    }
+
+    return retval;
+}
+
+void thciTransportProcess(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+    thci_spi_context_t *spi = &sSpiContexts[index];
+    uint8_t transfers = 0;
+    bool accepted;
+    otError err;
+
+    nlREQUIRE(spi->mCallbacks != NULL, done);
+
+    // The frame the Spinel layer held on to has been used.
+    spi->mRxHeld = false;
+
+    while (true)
+    {
+        if (spi->mRxCount > 0)
+        {
+            const uint8_t slot = spi->mRxHead;
+
+            spi->mRxHead = (spi->mRxHead + 1) % THCI_CONFIG_SPI_RX_FRAMES;
+            spi->mRxCount--;
+
+            if (!spi->mCallbacks->mFrame(index, &spi->mRxFrames[slot][THCI_SPI_HEADER_SIZE], spi->mRxLength[slot]))
+            {
+                spi->mRxHeld = true;
+                break;
+            }
+
+            continue;
+        }
+
+        // The Spinel layer reposts while thciTransportIsPending(), so a busy
+        // NCP does not hold the THCI task beyond a burst.
+        if (transfers == THCI_CONFIG_SPI_BURST || !SpiNcpHasData(index))
+        {
+            break;
+        }
+
+        err = SpiTransfer(index, 0, &accepted);
+        transfers++;
+
+        if (err == OT_ERROR_NONE && spi->mStalledTransfers >= SPI_MAX_STALLED_TRANSFERS)
+        {
+            NL_LOG_CRIT(lrTHCI, "%s: NCP of instance %d stalled\n", __FUNCTION__, index);
+            err = OT_ERROR_FAILED;
+        }
+
+        if (err != OT_ERROR_NONE)
+        {
+            SpiReportError(index, err);
+            break;
+        }
+    }
+
+ done:
+    return;
+}
+
+bool thciTransportIsPending(void)
+{
+    const uint8_t index = THCI_INSTANCE_INDEX();
+
+    return (sSpiContexts[index].mCallbacks != NULL) && ((sSpiContexts[index].mRxCount > 0) || SpiNcpHasData(index));
+}
+
+uint16_t thciTransportGetMaxRxFrameSize(void)
+{
+    return THCI_CONFIG_SPI_FRAME_SIZE;
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SPI
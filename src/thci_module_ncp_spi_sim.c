@@ -0,0 +1,292 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the simulated SPI NCP, which stands in for the
+ *      SPI platform of thci_spi.h.
+ *
+ *      Each instance has a queue of frames to send.  Its interrupt line is
+ *      asserted while the queue is not empty, and thciSpiSimSend() calls the
+ *      interrupt handler, on the calling task, unless a transfer is under
+ *      way, after which the transport checks the line itself.  The queue is
+ *      protected by a lock, which is not held while the frame handler runs.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SPI && THCI_CONFIG_SPI_SIMULATED_PEER
+
+#include <errno.h>
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlerlock.h>
+
+#include <openthread/spinel.h>
+
+#include <thci_spi.h>
+
+#define SPI_SIM_QUEUE_DEPTH             8
+
+typedef struct
+{
+    thciSpiInterruptHandler mHandler;   // NULL while disabled.
+    bool                    mResetPending;
+    bool                    mInTransfer;
+    uint8_t                 mHead;
+    volatile uint8_t        mCount;
+    uint16_t                mLength[SPI_SIM_QUEUE_DEPTH];
+    uint8_t                 mFrames[SPI_SIM_QUEUE_DEPTH][THCI_CONFIG_SPI_FRAME_SIZE];
+} thci_spi_sim_peer_t;
+
+static void SpiSimRespond(uint8_t aInstanceIndex, const uint8_t *aFrame, uint16_t aLength);
+
+static thci_spi_sim_peer_t sSpiSimPeers[THCI_CONFIG_MAX_INSTANCES];
+static thciSpiSimFrameHandler sSpiSimFrameHandler = SpiSimRespond;
+static nl_lock_t sSpiSimLock;
+
+// Only used on the THCI task, during a transfer.
+static uint8_t sSpiSimRxFrame[THCI_CONFIG_SPI_FRAME_SIZE];
+static uint8_t sSpiSimTxFrame[THCI_CONFIG_SPI_FRAME_SIZE];
+
+static void SpiSimWriteLength(uint8_t *aBuffer, uint16_t aLength)
+{
+    aBuffer[0] = (uint8_t)(aLength & 0xff);
+    aBuffer[1] = (uint8_t)(aLength >> 8);
+}
+
+static uint16_t SpiSimReadLength(const uint8_t *aBuffer)
+{
+    return (uint16_t)(aBuffer[0] | (aBuffer[1] << 8));
+}
+
+static int SpiSimEnqueue(thci_spi_sim_peer_t *aPeer, const uint8_t *aFrame, uint16_t aLength)
+{
+    int retval = 0;
+
+    nlREQUIRE_ACTION(aLength > 0 && aLength <= THCI_CONFIG_SPI_FRAME_SIZE, done, retval = -EMSGSIZE);
+    nlREQUIRE_ACTION(sSpiSimLock != NULL, done, retval = -ENOTCONN);
+
+    nl_er_lock_enter(sSpiSimLock);
+
+    if (aPeer->mCount < SPI_SIM_QUEUE_DEPTH)
+    {
+        const uint8_t slot = (aPeer->mHead + aPeer->mCount) % SPI_SIM_QUEUE_DEPTH;
+
+        memcpy(aPeer->mFrames[slot], aFrame, aLength);
+        aPeer->mLength[slot] = aLength;
+        aPeer->mCount++;
+    }
+    else
+    {
+        retval = -ENOBUFS;
+    }
+
+    nl_er_lock_exit(sSpiSimLock);
+
+ done:
+    return retval;
+}
+
+/**
+ * Answer a property request as an NCP would, echoing its value; other
+ * commands get an invalid command status.
+ */
+static void SpiSimRespond(uint8_t aInstanceIndex, const uint8_t *aFrame, uint16_t aLength)
+{
+    uint8_t header;
+    unsigned int command;
+    unsigned int key;
+    spinel_ssize_t parsed;
+    spinel_ssize_t packed;
+    uint16_t valueLength;
+    bool isStatus = false;
+
+    parsed = spinel_datatype_unpack(aFrame, aLength, "Cii", &header, &command, &key);
+    nlREQUIRE(parsed > 0, done);
+
+    valueLength = aLength - (uint16_t)parsed;
+
+    switch (command)
+    {
+    case SPINEL_CMD_PROP_VALUE_GET:
+    case SPINEL_CMD_VENDOR_NEST_PROP_VALUE_GET:
+        valueLength = 0;
+        command = SPINEL_CMD_PROP_VALUE_IS;
+        break;
+
+    case SPINEL_CMD_PROP_VALUE_SET:
+    case SPINEL_CMD_VENDOR_NEST_PROP_VALUE_SET:
+        command = SPINEL_CMD_PROP_VALUE_IS;
+        break;
+
+    case SPINEL_CMD_PROP_VALUE_INSERT:
+        command = SPINEL_CMD_PROP_VALUE_INSERTED;
+        break;
+
+    case SPINEL_CMD_PROP_VALUE_REMOVE:
+        command = SPINEL_CMD_PROP_VALUE_REMOVED;
+        break;
+
+    default:
+        command = SPINEL_CMD_PROP_VALUE_IS;
+        key = SPINEL_PROP_LAST_STATUS;
+        isStatus = true;
+        break;
+    }
+
+    if (isStatus)
+    {
+        valueLength = 0;
+        packed = spinel_datatype_pack(sSpiSimTxFrame, sizeof(sSpiSimTxFrame), "Cii" SPINEL_DATATYPE_UINT_PACKED_S,
+                                      header, command, key, SPINEL_STATUS_INVALID_COMMAND);
+    }
+    else
+    {
+        packed = spinel_datatype_pack(sSpiSimTxFrame, sizeof(sSpiSimTxFrame), "Cii", header, command, key);
+    }
+
+    nlREQUIRE(packed > 0 && (size_t)packed + valueLength <= sizeof(sSpiSimTxFrame), done);
+
+    memcpy(&sSpiSimTxFrame[packed], &aFrame[parsed], valueLength);
+
+    (void)SpiSimEnqueue(&sSpiSimPeers[aInstanceIndex], sSpiSimTxFrame, (uint16_t)packed + valueLength);
+
+ done:
+    return;
+}
+
+void thciSpiPlatformEnable(uint8_t aInstanceIndex, thciSpiInterruptHandler aHandler)
+{
+    // THCI enables its instances before anything is sent to them.
+    if (sSpiSimLock == NULL)
+    {
+        sSpiSimLock = nl_er_lock_create();
+    }
+
+    sSpiSimPeers[aInstanceIndex].mHandler = aHandler;
+}
+
+bool thciSpiPlatformIsInterruptAsserted(uint8_t aInstanceIndex)
+{
+    return sSpiSimPeers[aInstanceIndex].mCount > 0;
+}
+
+int thciSpiPlatformTransfer(uint8_t aInstanceIndex, const uint8_t *aTxBuffer, uint8_t *aRxBuffer, uint16_t aLength)
+{
+    thci_spi_sim_peer_t *peer = &sSpiSimPeers[aInstanceIndex];
+    const uint16_t payload = aLength - THCI_SPI_HEADER_SIZE;
+    uint16_t dataLength = 0;
+    uint16_t hostLength = 0;
+    int retval = 0;
+
+    nlREQUIRE_ACTION(aLength >= THCI_SPI_HEADER_SIZE, done, retval = -EINVAL);
+
+    nl_er_lock_enter(sSpiSimLock);
+
+    peer->mInTransfer = true;
+
+    if (peer->mCount > 0)
+    {
+        dataLength = peer->mLength[peer->mHead];
+    }
+
+    memset(aRxBuffer, 0, aLength);
+    aRxBuffer[0] = THCI_SPI_HEADER_PATTERN_VALUE | (peer->mResetPending ? THCI_SPI_HEADER_RESET_FLAG : 0);
+    SpiSimWriteLength(&aRxBuffer[1], (payload < THCI_CONFIG_SPI_FRAME_SIZE) ? payload : THCI_CONFIG_SPI_FRAME_SIZE);
+    SpiSimWriteLength(&aRxBuffer[3], dataLength);
+    memcpy(&aRxBuffer[THCI_SPI_HEADER_SIZE], peer->mFrames[peer->mHead], (dataLength < payload) ? dataLength : payload);
+
+    peer->mResetPending = false;
+
+    if ((aTxBuffer[0] & THCI_SPI_HEADER_PATTERN_MASK) == THCI_SPI_HEADER_PATTERN_VALUE)
+    {
+        // The frame is sent if the host takes it whole.
+        if (dataLength > 0 && dataLength <= SpiSimReadLength(&aTxBuffer[1]) && dataLength <= payload)
+        {
+            peer->mHead = (peer->mHead + 1) % SPI_SIM_QUEUE_DEPTH;
+            peer->mCount--;
+        }
+
+        hostLength = SpiSimReadLength(&aTxBuffer[3]);
+
+        if (hostLength > payload || hostLength > THCI_CONFIG_SPI_FRAME_SIZE)
+        {
+            hostLength = 0;
+        }
+
+        memcpy(sSpiSimRxFrame, &aTxBuffer[THCI_SPI_HEADER_SIZE], hostLength);
+    }
+
+    nl_er_lock_exit(sSpiSimLock);
+
+    if (hostLength > 0)
+    {
+        sSpiSimFrameHandler(aInstanceIndex, sSpiSimRxFrame, hostLength);
+    }
+
+    peer->mInTransfer = false;
+
+ done:
+    return retval;
+}
+
+int thciSpiSimSend(uint8_t aInstanceIndex, const uint8_t *aFrame, uint16_t aLength)
+{
+    thci_spi_sim_peer_t *peer = &sSpiSimPeers[aInstanceIndex];
+    thciSpiInterruptHandler handler = peer->mHandler;
+    int retval;
+
+    retval = SpiSimEnqueue(peer, aFrame, aLength);
+    nlREQUIRE(retval == 0, done);
+
+    if (!peer->mInTransfer && handler != NULL)
+    {
+        handler(aInstanceIndex);
+    }
+
+ done:
+    return retval;
+}
+
+void thciSpiSimSetFrameHandler(thciSpiSimFrameHandler aHandler)
+{
+    sSpiSimFrameHandler = (aHandler != NULL) ? aHandler : SpiSimRespond;
+}
+
+void thciSpiSimReset(uint8_t aInstanceIndex)
+{
+    thci_spi_sim_peer_t *peer = &sSpiSimPeers[aInstanceIndex];
+
+    nlREQUIRE(sSpiSimLock != NULL, done);
+
+    nl_er_lock_enter(sSpiSimLock);
+
+    peer->mHead = 0;
+    peer->mCount = 0;
+    peer->mResetPending = true;
+
+    nl_er_lock_exit(sSpiSimLock);
+
+ done:
+    return;
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SPI && THCI_CONFIG_SPI_SIMULATED_PEER
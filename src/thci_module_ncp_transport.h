@@ -0,0 +1,112 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/*
+ *    @file
+ *      This file declares the transport that carries Spinel frames between
+ *      the NCP module and the NCP.
+ *
+ *      The Spinel layer in thci_module_ncp_uart.cpp sends and receives
+ *      whole Spinel frames; the transport frames them on its bus.  One
+ *      transport is built: the HDLC-lite UART in thci_module_ncp_uart.cpp,
+ *      HDLC-lite over a POSIX tty in thci_module_ncp_tty.cpp when
+ *      THCI_CONFIG_POSIX_TTY is set, Spinel SPI in thci_module_ncp_spi.c
+ *      when THCI_CONFIG_NCP_SPI is set, or shared memory rings in
+ *      thci_module_ncp_shm.c when THCI_CONFIG_NCP_SHM is set.
+ *
+ *      When data arrives the transport calls the ready callback, from ISR
+ *      context, another thread or the THCI task, and the Spinel layer later calls
+ *      thciTransportProcess() on the THCI task, which passes the received
+ *      frames to the frame callback.  All functions but the ready callback
+ *      run on the THCI task of the instance.
+ *
+ */
+
+#ifndef __THCI_MODULE_NCP_TRANSPORT_H_INCLUDED__
+#define __THCI_MODULE_NCP_TRANSPORT_H_INCLUDED__
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <openthread/types.h>
+
+#include <thci_stats.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Where the ready callback is called from, which decides how it posts.
+typedef enum
+{
+    kThciTransportContextTask,      // the THCI task of the instance, which polls the transport while it waits.
+    kThciTransportContextThread,    // another task or thread, e.g. one that blocks on a device.
+    kThciTransportContextIsr,       // ISR context.
+} thci_transport_context_t;
+
+typedef struct
+{
+    // A whole received frame of instance aInstanceIndex, valid until the next
+    // call to thciTransportProcess().  Returns false to stop
+    // thciTransportProcess() after this frame.
+    bool (*mFrame)(uint8_t aInstanceIndex, uint8_t *aFrame, uint16_t aLength);
+
+    // The link of instance aInstanceIndex failed, e.g. on a framing error.
+    // The Spinel layer starts NCP recovery.
+    void (*mError)(uint8_t aInstanceIndex, otError aError);
+
+    // Data arrived for instance aInstanceIndex.  Returns false when nobody
+    // will process it, in which case the transport may drop it.
+    bool (*mReady)(uint8_t aInstanceIndex, thci_transport_context_t aContext);
+} thci_transport_callbacks_t;
+
+// Start the transport and its reception.
+otError thciTransportEnable(const thci_transport_callbacks_t *aCallbacks);
+void    thciTransportDisable(void);
+// Restart the transport after thciTransportSleepDisable() stopped it.
+void    thciTransportSleepEnable(void);
+// Stop the transport unless it is receiving; returns true if it stopped.
+bool    thciTransportSleepDisable(void);
+// Send one Spinel frame, waiting until the NCP has taken it.
+otError thciTransportSendFrame(const uint8_t *aFrame, uint16_t aLength);
+// Pass the frames received so far to the frame callback.
+void    thciTransportProcess(void);
+// True if thciTransportProcess() has data to work on.
+bool    thciTransportIsPending(void);
+// The longest Spinel frame the transport can receive.
+uint16_t thciTransportGetMaxRxFrameSize(void);
+
+#if THCI_CONFIG_POSIX_TTY
+// The tty transport keeps the RX fifo, flow control and TX stall fields of
+// the UART counters; sets them in aCounters.
+void    thciTtyGetCounters(thci_uart_counters_t *aCounters);
+void    thciTtyResetCounters(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+
+#endif // __THCI_MODULE_NCP_TRANSPORT_H_INCLUDED__
@@ -0,0 +1,1061 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the HDLC-lite POSIX tty transport of the NCP
+ *      module.
+ *
+ *      A thread of each instance reads the tty into an RX fifo, in place of
+ *      the RX ISR of the UART, and the THCI task decodes the fifo.  The
+ *      THCI task encodes each frame sent into one of
+ *      THCI_CONFIG_UART_TX_FRAMES buffers, and the thread writes the queued
+ *      frames to the tty, all of them in one writev(), while the task packs
+ *      and encodes the next one.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_POSIX_TTY
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+
+#include <nlalignment.h>
+#include <nlnew.hpp>
+#include <nlassert.h>
+#include <nlerlog.h>
+
+#include <openthread/types.h>
+#include <openthread/hdlc.hpp>
+
+#include <thci.h>
+#include <thci_module.h>
+#include <thci_module_ncp_transport.h>
+#include <thci_stats.h>
+#include <thci_fault.h>
+#include <thci_arena.h>
+
+/**
+ * SECTION - Definitions
+ */
+
+// The largest Spinel frame the Spinel layer sends without THCI_CONFIG_ARENA.
+#define TTY_FRAME_BUFFER_SIZE               (1500)
+// Each TX buffer holds a whole HDLC encoded frame, every byte escaped.
+#define TTY_TX_BUFFER_SIZE                  (2 * TTY_FRAME_BUFFER_SIZE + 8)
+#define TTY_RX_BUFFER_SIZE                  (THCI_CONFIG_UART_RX_BUFFER_SIZE)
+// The HDLC decoder keeps the FCS in the RX buffer.
+#define HDLC_FCS_SIZE                       (2)
+#define HDLC_FLAG_SEQUENCE                  (0x7e)
+// Each read() takes whatever the tty has buffered.
+#define TTY_RX_FIFO_SIZE                    (2048)
+#if THCI_CONFIG_ARENA
+// The buffers are carved from the arena, sized by its profile.
+#define RX_BUFFER_SIZE(aTty)                ((aTty).mRxBufferSize)
+#define RX_FIFO_LENGTH(aTty)                ((aTty).mRxFifoSize)
+#else
+#define RX_BUFFER_SIZE(aTty)                (sizeof((aTty).mRxBuffer))
+#define RX_FIFO_LENGTH(aTty)                (TTY_RX_FIFO_SIZE)
+#endif
+#define RX_FIFO_NEAR_FULL_THRESHOLD(aTty)   (RX_FIFO_LENGTH(aTty) / 10)
+// The THCI task is woken at the end of a frame, or once the fifo is half
+// full, rather than for every read.
+#define RX_FIFO_WAKE_THRESHOLD(aTty)        (RX_FIFO_LENGTH(aTty) / 2)
+// How long the THCI task waits for the queued frames to go out.
+#define TTY_TX_TIMEOUT_MSEC                 (3000)
+#define TTY_TX_POLL_MSEC                    (10)
+#define TTY_RX_FLOW_POLL_MSEC               (10)
+
+// The tty of each THCI instance.  Hosts with more than one NCP define this
+// to select by instance index.
+#ifndef THCI_INSTANCE_TTY_PATH
+#define THCI_INSTANCE_TTY_PATH(aIndex)      THCI_CONFIG_POSIX_TTY_PATH
+#endif
+
+class TtyTxBuffer : public ot::Hdlc::Encoder::BufferWriteIterator
+{
+public:
+    TtyTxBuffer(void);
+
+    void            Clear(void);
+    uint16_t        GetLength(void) const;
+    const uint8_t   *GetBuffer(void) const;
+#if THCI_CONFIG_ARENA
+    void            SetBuffer(uint8_t *aBuffer, uint16_t aSize);
+#endif
+
+private:
+#if THCI_CONFIG_ARENA
+    uint8_t         *mBuffer;           // carved from the arena.
+    uint16_t        mSize;
+#else
+    uint8_t         mBuffer[TTY_TX_BUFFER_SIZE];
+#endif
+};
+
+/**
+ * SECTION - Globals
+ */
+
+/**
+ * The tty transport of one THCI instance.
+ */
+struct TtyInstance
+{
+    const thci_transport_callbacks_t *mCallbacks;
+    volatile bool                   mRxDisabled;        // the tty is not read, the RX fifo near full.
+    volatile bool                   mRxWakePending;     // the task was woken for bytes in the fifo.
+    volatile bool                   mFailed;            // a decode error was reported; bytes drop until enabled again.
+    bool                            mRxPaused;          // the frame callback asked to stop.
+    uint16_t                        mFrameByteCount;
+    ot::Hdlc::Decoder               *mFrameDecoder;
+#if THCI_CONFIG_ARENA
+    uint8_t                         *mRxFifo;           // buffers carved from the arena.
+    uint16_t                        mRxFifoSize;
+    uint8_t                         *mRxBuffer;
+    uint16_t                        mRxBufferSize;
+#else
+    uint8_t                         mRxFifo[TTY_RX_FIFO_SIZE];
+    uint8_t                         mRxBuffer[TTY_RX_BUFFER_SIZE];
+#endif
+    uint16_t                        mRxFifoHead;        // written by the tty thread.
+    uint16_t                        mRxFifoTail;        // written by the THCI task.
+    TtyTxBuffer                     mTxFrames[THCI_CONFIG_UART_TX_FRAMES];  // encoded frames, the oldest at mTxTail.
+    volatile uint8_t                mTxHead;            // frames queued, written by the THCI task.
+    volatile uint8_t                mTxTail;            // frames sent, written by the tty thread.
+    uint16_t                        mTxSent;            // bytes sent of the frame at mTxTail.
+    bool                            mOpen;
+    int                             mFd;
+    int                             mEpollFd;
+    int                             mWakeFd;            // eventfd that wakes mThread.
+    pthread_t                       mThread;            // reads the tty, in place of the RX ISR, and sends the TX queue.
+    volatile bool                   mStop;
+    thci_uart_counters_t            mCounters;          // the RX fifo, flow control and TX stall fields only.
+    DEFINE_ALIGNED_VAR(mFrameDecoderBuffer, sizeof(ot::Hdlc::Decoder), uint64_t);
+};
+
+static TtyInstance                      sTtyInstances[THCI_CONFIG_MAX_INSTANCES];
+
+// The tty transport of the current instance.  The tty thread is passed its
+// instance instead.
+#define sTty                            (sTtyInstances[THCI_INSTANCE_INDEX()])
+
+static inline uint8_t InstanceIndex(const TtyInstance &aTty)
+{
+    return static_cast<uint8_t>(&aTty - sTtyInstances);
+}
+
+/**
+ * SECTION - Implementation
+ */
+
+TtyTxBuffer::TtyTxBuffer(void)
+    : ot::Hdlc::Encoder::BufferWriteIterator()
+#if THCI_CONFIG_ARENA
+    , mBuffer(NULL)
+    , mSize(0)
+#endif
+{
+    Clear();
+}
+
+void TtyTxBuffer::Clear(void)
+{
+    mWritePointer = mBuffer;
+#if THCI_CONFIG_ARENA
+    mRemainingLength = mSize;
+#else
+    mRemainingLength = sizeof(mBuffer);
+#endif
+}
+
+uint16_t TtyTxBuffer::GetLength(void) const
+{
+    return static_cast<uint16_t>(mWritePointer - mBuffer);
+}
+
+const uint8_t *TtyTxBuffer::GetBuffer(void) const
+{
+    return mBuffer;
+}
+
+#if THCI_CONFIG_ARENA
+void TtyTxBuffer::SetBuffer(uint8_t *aBuffer, uint16_t aSize)
+{
+    mBuffer = aBuffer;
+    mSize = aSize;
+    Clear();
+}
+#endif
+
+/**
+ * Wakes the tty thread, which then watches the tty or not as mRxDisabled
+ * says.  Only the tty thread changes its epoll set.
+ */
+static void TtyWake(TtyInstance &aTty)
+{
+    const uint64_t count = 1;
+
+    if (aTty.mOpen)
+    {
+        (void)write(aTty.mWakeFd, &count, sizeof(count));
+    }
+}
+
+static void RxEnable(TtyInstance &aTty, bool aForce)
+{
+    if (aForce || aTty.mRxDisabled)
+    {
+        aTty.mRxDisabled = false;
+        TtyWake(aTty);
+    }
+}
+
+static void RxDisable(TtyInstance &aTty)
+{
+    if (!aTty.mRxDisabled)
+    {
+        aTty.mRxDisabled = true;
+        aTty.mCounters.mRxFlowOff++;
+        TtyWake(aTty);
+    }
+}
+
+static int GetRxFifoChar(TtyInstance &aTty, uint8_t *aByte)
+{
+    int retval = 0;
+
+    nlREQUIRE_ACTION(aTty.mRxFifoTail != aTty.mRxFifoHead, done, retval = -ENODATA);
+
+    *aByte = aTty.mRxFifo[aTty.mRxFifoTail];
+
+    aTty.mRxFifoTail = (aTty.mRxFifoTail < RX_FIFO_LENGTH(aTty) - 1) ? aTty.mRxFifoTail + 1 : 0;
+
+ done:
+    return retval;
+}
+
+static bool IsRxFifoNearFull(TtyInstance &aTty, size_t aThreshold)
+{
+    size_t newHead = (aTty.mRxFifoHead < RX_FIFO_LENGTH(aTty) - aThreshold) ?
+                    aTty.mRxFifoHead + aThreshold :
+                    aThreshold - (RX_FIFO_LENGTH(aTty) - aTty.mRxFifoHead);
+    bool retval = true;
+
+    if (aTty.mRxFifoHead > aTty.mRxFifoTail)
+    {
+        if (newHead > aTty.mRxFifoHead ||
+            newHead < aTty.mRxFifoTail)
+        {
+            retval = false;
+        }
+    }
+    else
+    {
+        if (newHead < aTty.mRxFifoTail &&
+            newHead > aTty.mRxFifoHead)
+        {
+            retval = false;
+        }
+    }
+
+    return retval;
+}
+
+static bool IsRxFifoEmpty(const TtyInstance &aTty)
+{
+    return (aTty.mRxFifoTail == aTty.mRxFifoHead);
+}
+
+#if THCI_CONFIG_FAULT_INJECTION
+static void DecodeFaultyChar(TtyInstance &aTty, uint8_t aChar)
+{
+    const uint8_t verdict = thciFaultByte(kThciFaultStreamByteRx, &aChar);
+
+    if (!(verdict & THCI_FAULT_VERDICT_DROP))
+    {
+        aTty.mFrameDecoder->Decode(&aChar, sizeof(uint8_t));
+
+        if (verdict & THCI_FAULT_VERDICT_DUPLICATE)
+        {
+            aTty.mFrameDecoder->Decode(&aChar, sizeof(uint8_t));
+        }
+    }
+}
+#endif // THCI_CONFIG_FAULT_INJECTION
+
+/**
+ * Process received bytes stored in the FIFO.
+ */
+static void RxFifoProcess(TtyInstance &aTty)
+{
+    uint8_t ch;
+
+    aTty.mRxPaused = false;
+
+    // Bytes put after this are signalled again.
+    aTty.mRxWakePending = false;
+    __sync_synchronize();
+
+    // Stop once the frame callback asks to, so that the response it holds
+    // on to is not overwritten.
+    while (!aTty.mFailed &&
+           !aTty.mRxPaused &&
+           !GetRxFifoChar(aTty, &ch))
+    {
+        aTty.mFrameByteCount++;
+
+#if THCI_CONFIG_FAULT_INJECTION
+        if (THCI_FAULT_ACTIVE(kThciFaultStreamByteRx))
+        {
+            DecodeFaultyChar(aTty, ch);
+        }
+        else
+#endif
+        {
+            aTty.mFrameDecoder->Decode(&ch, sizeof(uint8_t));
+        }
+
+        // Read the tty again once the fifo has been sufficiently drained.
+        if (aTty.mRxDisabled && !IsRxFifoNearFull(aTty, 2*RX_FIFO_NEAR_FULL_THRESHOLD(aTty)))
+        {
+            const bool force = true;
+            RxEnable(aTty, !force);
+        }
+    }
+
+    // Stopped before the end of the fifo: what is left may hold whole frames.
+    if (aTty.mRxPaused && !IsRxFifoEmpty(aTty))
+    {
+        aTty.mRxWakePending = true;
+    }
+}
+
+/**
+ * Returns the number of encoded frames waiting to be sent.
+ */
+static uint8_t TxQueued(const TtyInstance &aTty)
+{
+    return static_cast<uint8_t>(aTty.mTxHead - aTty.mTxTail);
+}
+
+static void TxQueueReset(TtyInstance &aTty)
+{
+    aTty.mTxHead = 0;
+    aTty.mTxTail = 0;
+    aTty.mTxSent = 0;
+}
+
+/**
+ * Waits until no more than aQueued frames are waiting to be sent.
+ */
+static otError TxWait(TtyInstance &aTty, uint8_t aQueued)
+{
+    uint8_t tail = aTty.mTxTail;
+    uint16_t sent = aTty.mTxSent;
+    uint32_t waited = 0;
+    otError retval = OT_ERROR_NONE;
+
+    while (TxQueued(aTty) > aQueued)
+    {
+        if (aTty.mTxTail != tail || aTty.mTxSent != sent)
+        {
+            tail = aTty.mTxTail;
+            sent = aTty.mTxSent;
+            waited = 0;
+            continue;
+        }
+
+        nlREQUIRE_ACTION(waited < TTY_TX_TIMEOUT_MSEC, done, retval = OT_ERROR_BUSY);
+
+        if (aTty.mRxDisabled)
+        {
+            aTty.mCounters.mTxBlocked++;
+
+            // If no byte goes out while the tty is not read, the NCP is
+            // likely blocked sending to the host.  To avoid a deadlock,
+            // drain the RX fifo.
+            RxFifoProcess(aTty);
+        }
+
+        // The tty thread sends the frames.
+        (void)poll(NULL, 0, TTY_TX_POLL_MSEC);
+        waited += TTY_TX_POLL_MSEC;
+    }
+
+ done:
+    if (retval != OT_ERROR_NONE)
+    {
+        NL_LOG_CRIT(lrTHCI, "%s: Failed with err (%d) %d\n", __FUNCTION__, retval, aTty.mRxDisabled);
+    }
+
+    return retval;
+}
+
+#if THCI_CONFIG_FAULT_INJECTION
+/**
+ * Writes aBuffer to the tty, waiting for room while it is full.
+ */
+static otError TtyWrite(TtyInstance &aTty, const uint8_t *aBuffer, uint16_t aLength)
+{
+    struct pollfd pfd;
+    uint16_t put = 0;
+    uint32_t waited = 0;
+    ssize_t written;
+    otError retval = OT_ERROR_NONE;
+
+    nlREQUIRE_ACTION(aTty.mOpen, done, retval = OT_ERROR_INVALID_STATE);
+
+    pfd.fd = aTty.mFd;
+    pfd.events = POLLOUT;
+
+    while (aLength > put)
+    {
+        written = write(aTty.mFd, aBuffer + put, aLength - put);
+
+        if (written > 0)
+        {
+            put += static_cast<uint16_t>(written);
+            waited = 0;
+            continue;
+        }
+
+        nlREQUIRE_ACTION(written < 0 && (errno == EAGAIN || errno == EINTR), done, retval = OT_ERROR_FAILED);
+
+        nlREQUIRE_ACTION(waited < TTY_TX_TIMEOUT_MSEC, done, retval = OT_ERROR_BUSY);
+
+        if (aTty.mRxDisabled)
+        {
+            aTty.mCounters.mTxBlocked++;
+
+            // As in TxWait, drain the RX fifo to avoid a deadlock.
+            RxFifoProcess(aTty);
+        }
+
+        (void)poll(&pfd, 1, TTY_TX_POLL_MSEC);
+        waited += TTY_TX_POLL_MSEC;
+    }
+
+ done:
+    return retval;
+}
+
+static void PutFaultyChar(TtyInstance &aTty, uint8_t aChar)
+{
+    const uint8_t verdict = thciFaultByte(kThciFaultStreamByteTx, &aChar);
+
+    if (!(verdict & THCI_FAULT_VERDICT_DROP))
+    {
+        (void)TtyWrite(aTty, &aChar, sizeof(uint8_t));
+
+        if (verdict & THCI_FAULT_VERDICT_DUPLICATE)
+        {
+            (void)TtyWrite(aTty, &aChar, sizeof(uint8_t));
+        }
+    }
+}
+#endif // THCI_CONFIG_FAULT_INJECTION
+
+/**
+ * Wakes the THCI task for the bytes put in the fifo.  Called at the end of
+ * a frame, once the fifo passes its wake threshold, or once the line is
+ * idle, so that the task decodes whole frames.
+ *
+ * @return false if nobody will process the bytes.
+ */
+static bool RxWake(TtyInstance &aTty)
+{
+    if (!aTty.mRxWakePending)
+    {
+        aTty.mRxWakePending = true;
+        aTty.mCounters.mRxWakeups++;
+    }
+
+    return aTty.mCallbacks->mReady(InstanceIndex(aTty), kThciTransportContextThread);
+}
+
+/**
+ * Stops watching a tty that hung up, e.g. when socat exits.  NCP recovery
+ * reopens it.
+ */
+static void TtyHangUp(TtyInstance &aTty)
+{
+    NL_LOG_CRIT(lrTHCI, "%s: tty of instance %d hung up (%d)\n", __FUNCTION__, InstanceIndex(aTty), errno);
+
+    (void)epoll_ctl(aTty.mEpollFd, EPOLL_CTL_DEL, aTty.mFd, NULL);
+}
+
+/**
+ * Changes what the tty thread waits for on the tty: reading, the
+ * counterpart of the RX interrupt enable, and room to write the TX queue.
+ * Called by the tty thread only.
+ */
+static void TtyWatch(TtyInstance &aTty, bool aRead, bool aWrite)
+{
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = ((aRead) ? static_cast<uint32_t>(EPOLLIN) : 0) | ((aWrite) ? static_cast<uint32_t>(EPOLLOUT) : 0);
+    event.data.fd = aTty.mFd;
+
+    // Fails with ENOENT once the tty has hung up, which is harmless.
+    (void)epoll_ctl(aTty.mEpollFd, EPOLL_CTL_MOD, aTty.mFd, &event);
+}
+
+/**
+ * Reads what the tty holds straight into the RX fifo, up to its end or
+ * its tail, then wakes the THCI task at the end of a frame.
+ */
+static void TtyRead(TtyInstance &aTty)
+{
+    const uint16_t head = aTty.mRxFifoHead;
+    const uint16_t tail = aTty.mRxFifoTail;
+    uint8_t discard[64];
+    uint16_t room;
+    uint16_t used;
+    ssize_t received;
+
+    if (aTty.mFailed)
+    {
+        // let the bytes drop until NCP recovery enables the transport again.
+        received = read(aTty.mFd, discard, sizeof(discard));
+        nlREQUIRE_ACTION(received != 0 && (received > 0 || errno == EAGAIN || errno == EINTR), done, TtyHangUp(aTty));
+
+        goto done;
+    }
+
+    room = (head >= tail) ? (RX_FIFO_LENGTH(aTty) - head - ((tail == 0) ? 1 : 0)) : (tail - head - 1);
+
+    if (room == 0)
+    {
+        RxDisable(aTty);
+        goto done;
+    }
+
+    received = read(aTty.mFd, &aTty.mRxFifo[head], room);
+    nlREQUIRE_ACTION(received != 0 && (received > 0 || errno == EAGAIN || errno == EINTR), done, TtyHangUp(aTty));
+    nlREQUIRE(received > 0, done);
+
+    // The THCI task reads the fifo concurrently: publish the bytes before
+    // the head, and the head before the posted flags are read.
+    __sync_synchronize();
+    aTty.mRxFifoHead = (head + received < RX_FIFO_LENGTH(aTty)) ? (head + received) : 0;
+    __sync_synchronize();
+
+    aTty.mCounters.mRxBytes += received;
+
+    used = (aTty.mRxFifoHead >= tail) ?
+           (aTty.mRxFifoHead - tail) :
+           (RX_FIFO_LENGTH(aTty) - tail + aTty.mRxFifoHead);
+
+    if (used > aTty.mCounters.mRxFifoHighWater)
+    {
+        aTty.mCounters.mRxFifoHighWater = used;
+    }
+
+    // Unlike the UART ISR, keep the bytes when nobody receives them yet, as
+    // in AUPD between responses: they wait in the fifo for the next one.
+    if ((memchr(&aTty.mRxFifo[head], HDLC_FLAG_SEQUENCE, received) != NULL) ||
+        IsRxFifoNearFull(aTty, RX_FIFO_WAKE_THRESHOLD(aTty)))
+    {
+        (void)RxWake(aTty);
+    }
+
+    if (IsRxFifoNearFull(aTty, RX_FIFO_NEAR_FULL_THRESHOLD(aTty)))
+    {
+        RxDisable(aTty);
+    }
+
+ done:
+    return;
+}
+
+/**
+ * Writes the TX queue to the tty until it is empty or the tty is full,
+ * every frame queued in one writev().  Called by the tty thread only.
+ *
+ * @return true if frames are left to write.
+ */
+static bool TtyTxPump(TtyInstance &aTty)
+{
+    struct iovec iov[THCI_CONFIG_UART_TX_FRAMES];
+    uint8_t queued;
+    uint8_t i;
+    uint16_t left;
+    ssize_t written;
+    bool retval = false;
+
+    while ((queued = TxQueued(aTty)) > 0)
+    {
+        // The head before the frames it publishes.
+        __sync_synchronize();
+
+        for (i = 0; i < queued; i++)
+        {
+            const TtyTxBuffer &frame = aTty.mTxFrames[static_cast<uint8_t>(aTty.mTxTail + i) % THCI_CONFIG_UART_TX_FRAMES];
+            const uint16_t sent = (i == 0) ? aTty.mTxSent : 0;
+
+            iov[i].iov_base = const_cast<uint8_t *>(frame.GetBuffer() + sent);
+            iov[i].iov_len = frame.GetLength() - sent;
+        }
+
+        written = writev(aTty.mFd, iov, queued);
+
+        if (written <= 0)
+        {
+            // A tty that hung up is reported by epoll; the THCI task times
+            // out waiting for the frames.
+            nlREQUIRE_ACTION(written < 0 && errno == EINTR, done, retval = true);
+            continue;
+        }
+
+        // The frames written whole, then the part of the next one.
+        while (written > 0)
+        {
+            left = aTty.mTxFrames[aTty.mTxTail % THCI_CONFIG_UART_TX_FRAMES].GetLength() - aTty.mTxSent;
+
+            if (written < left)
+            {
+                aTty.mTxSent += static_cast<uint16_t>(written);
+                break;
+            }
+
+            written -= left;
+            aTty.mTxSent = 0;
+
+            // Done with the buffer before the task may reuse it.
+            __sync_synchronize();
+            aTty.mTxTail++;
+        }
+    }
+
+ done:
+    return retval;
+}
+
+/**
+ * Reads the tty of an instance in place of the RX ISR of the UART, and
+ * writes the frames the THCI task queued, until TtyClose() stops it.  The
+ * tty is watched for reading only while reception is enabled; while it is
+ * not, the thread checks the RX fifo periodically and turns reception back
+ * on once it has drained, in case the THCI task stopped reading it just
+ * before reception was turned off.  The task wakes the thread when it
+ * queues a frame, and the tty is watched for writing while it is full.
+ */
+static void *TtyThread(void *aContext)
+{
+    TtyInstance &tty = *static_cast<TtyInstance *>(aContext);
+    struct epoll_event events[2];
+    uint64_t count;
+    bool watching = false;
+    bool writing = false;
+    bool sending;
+    bool unsignalled;
+    const bool force = true;
+    int timeout;
+    int ready;
+    int i;
+
+    while (!tty.mStop)
+    {
+        sending = TtyTxPump(tty);
+
+        if (watching == tty.mRxDisabled || writing != sending)
+        {
+            watching = !tty.mRxDisabled;
+            writing = sending;
+            TtyWatch(tty, watching, writing);
+        }
+
+        // Bytes the task was not woken for wait until the line is idle.
+        unsignalled = (tty.mRxFifoHead != tty.mRxFifoTail) && !tty.mRxWakePending;
+        timeout = (!watching) ? TTY_RX_FLOW_POLL_MSEC : (unsignalled) ? THCI_CONFIG_POSIX_TTY_RX_IDLE_MSEC : -1;
+
+        ready = epoll_wait(tty.mEpollFd, events, sizeof(events) / sizeof(events[0]), timeout);
+
+        if (ready == 0 && unsignalled && !tty.mFailed)
+        {
+            (void)RxWake(tty);
+        }
+
+        for (i = 0; i < ready; i++)
+        {
+            if (events[i].data.fd == tty.mWakeFd)
+            {
+                (void)read(tty.mWakeFd, &count, sizeof(count));
+            }
+            else if (events[i].events & EPOLLIN)
+            {
+                TtyRead(tty);
+            }
+            else if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                TtyHangUp(tty);
+            }
+            // EPOLLOUT: the tty has room, written at the top of the loop.
+        }
+
+        if (tty.mRxDisabled && !IsRxFifoNearFull(tty, 2*RX_FIFO_NEAR_FULL_THRESHOLD(tty)))
+        {
+            RxEnable(tty, !force);
+        }
+    }
+
+    return NULL;
+}
+
+// upon receiving a complete frame from the tty this function will get called.
+static void HdlcHandleFrame(void *aContext, uint8_t *aBuf, uint16_t aBufLength)
+{
+    TtyInstance &tty = *static_cast<TtyInstance *>(aContext);
+
+    tty.mFrameByteCount = 0;
+    tty.mRxPaused = !tty.mCallbacks->mFrame(InstanceIndex(tty), aBuf, aBufLength);
+}
+
+// In the event of a frame decoder error during receive this function will get called.
+static void HdlcHandleError(void *aContext, otError aError, uint8_t *aFrame, uint16_t aFrameLength)
+{
+    TtyInstance &tty = *static_cast<TtyInstance *>(aContext);
+
+    (void)aFrame;
+
+    tty.mFrameByteCount = 0;
+    tty.mFailed = true;
+
+    NL_LOG_CRIT(lrTHCI, "%s: %d %d.\n", __FUNCTION__, aError, aFrameLength);
+
+    tty.mCallbacks->mError(InstanceIndex(tty), aError);
+}
+
+static speed_t TtySpeed(uint32_t aBaudRate)
+{
+    speed_t retval;
+
+    switch (aBaudRate)
+    {
+    case 9600:      retval = B9600;     break;
+    case 19200:     retval = B19200;    break;
+    case 38400:     retval = B38400;    break;
+    case 57600:     retval = B57600;    break;
+    case 115200:    retval = B115200;   break;
+    case 230400:    retval = B230400;   break;
+    case 460800:    retval = B460800;   break;
+    case 921600:    retval = B921600;   break;
+    case 1000000:   retval = B1000000;  break;
+    case 2000000:   retval = B2000000;  break;
+    default:        retval = B0;        break;
+    }
+
+    return retval;
+}
+
+static void TtyCloseFds(TtyInstance &aTty)
+{
+    if (aTty.mWakeFd >= 0)
+    {
+        close(aTty.mWakeFd);
+    }
+
+    if (aTty.mEpollFd >= 0)
+    {
+        close(aTty.mEpollFd);
+    }
+
+    if (aTty.mFd >= 0)
+    {
+        close(aTty.mFd);
+    }
+
+    aTty.mFd = aTty.mEpollFd = aTty.mWakeFd = -1;
+}
+
+/**
+ * Opens the tty of aTty in raw, non-blocking mode and starts the thread
+ * that reads it.  Reception starts with RxEnable().
+ */
+static void TtyOpen(TtyInstance &aTty)
+{
+    const char *path = THCI_INSTANCE_TTY_PATH(InstanceIndex(aTty));
+    const speed_t speed = TtySpeed(THCI_CONFIG_UART_OPERATIONAL_BAUD_RATE);
+    struct termios tios;
+    struct epoll_event event;
+    const char *step = NULL;
+
+    // Woken from sleep without having been disabled.
+    nlREQUIRE(!aTty.mOpen, exit);
+
+    aTty.mRxFifoHead = aTty.mRxFifoTail = 0;
+    aTty.mFrameByteCount = 0;
+
+    aTty.mStop = false;
+    aTty.mEpollFd = aTty.mWakeFd = -1;
+
+    aTty.mFd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    nlREQUIRE_ACTION(aTty.mFd >= 0, exit, step = "open");
+
+    nlREQUIRE_ACTION(tcgetattr(aTty.mFd, &tios) == 0, exit, step = "tcgetattr");
+
+    cfmakeraw(&tios);
+    tios.c_cflag |= CLOCAL | CREAD;
+#if THCI_CONFIG_POSIX_TTY_FLOW_CONTROL
+    tios.c_cflag |= CRTSCTS;
+#else
+    tios.c_cflag &= ~CRTSCTS;
+#endif
+    tios.c_cc[VMIN] = 0;
+    tios.c_cc[VTIME] = 0;
+
+    nlREQUIRE_ACTION(speed != B0, exit, step = "baud rate");
+    nlREQUIRE_ACTION(cfsetispeed(&tios, speed) == 0 && cfsetospeed(&tios, speed) == 0, exit, step = "cfsetspeed");
+    nlREQUIRE_ACTION(tcsetattr(aTty.mFd, TCSANOW, &tios) == 0, exit, step = "tcsetattr");
+
+    // Drop bytes left over from before the tty was opened.
+    (void)tcflush(aTty.mFd, TCIOFLUSH);
+
+    aTty.mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    nlREQUIRE_ACTION(aTty.mEpollFd >= 0, exit, step = "epoll_create1");
+
+    aTty.mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    nlREQUIRE_ACTION(aTty.mWakeFd >= 0, exit, step = "eventfd");
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = aTty.mWakeFd;
+    nlREQUIRE_ACTION(epoll_ctl(aTty.mEpollFd, EPOLL_CTL_ADD, aTty.mWakeFd, &event) == 0, exit, step = "epoll_ctl");
+
+    // The tty thread watches the tty once reception is enabled.
+    event.events = 0;
+    event.data.fd = aTty.mFd;
+    nlREQUIRE_ACTION(epoll_ctl(aTty.mEpollFd, EPOLL_CTL_ADD, aTty.mFd, &event) == 0, exit, step = "epoll_ctl");
+
+    aTty.mOpen = true;
+    nlREQUIRE_ACTION(pthread_create(&aTty.mThread, NULL, TtyThread, &aTty) == 0, exit,
+                     aTty.mOpen = false; step = "pthread_create");
+
+ exit:
+    if (step != NULL)
+    {
+        NL_LOG_CRIT(lrTHCI, "%s: %s %s failed (%d)\n", __FUNCTION__, path, step, errno);
+
+        TtyCloseFds(aTty);
+    }
+}
+
+static void TtyClose(TtyInstance &aTty)
+{
+    if (aTty.mOpen)
+    {
+        aTty.mStop = true;
+        TtyWake(aTty);
+
+        pthread_join(aTty.mThread, NULL);
+
+        aTty.mOpen = false;
+        TtyCloseFds(aTty);
+    }
+}
+
+otError thciTransportEnable(const thci_transport_callbacks_t *aCallbacks)
+{
+    TtyInstance &tty = sTty;
+    const bool force = true;
+    otError retval = OT_ERROR_NONE;
+#if THCI_CONFIG_ARENA
+    const thci_arena_buffers_t *buffers = thciArenaGetBuffers();
+    const thci_arena_profile_t *profile = thciArenaGetProfile();
+    const uint16_t encodedSize = THCI_ARENA_ENCODED_FRAME_SIZE(profile->mTxFrameSize);
+
+    nlREQUIRE_ACTION(buffers != NULL, done, retval = OT_ERROR_INVALID_STATE);
+
+    tty.mRxFifo = buffers->mRxFifo;
+    tty.mRxFifoSize = profile->mRxFifoSize;
+    tty.mRxBuffer = buffers->mRxFrame;
+    tty.mRxBufferSize = profile->mRxFrameSize;
+
+    for (size_t i = 0; i < THCI_CONFIG_UART_TX_FRAMES; i++)
+    {
+        tty.mTxFrames[i].SetBuffer(&buffers->mTxFrames[i * encodedSize], encodedSize);
+    }
+#endif
+
+    tty.mCallbacks = aCallbacks;
+    tty.mFrameDecoder = new (&tty.mFrameDecoderBuffer) ot::Hdlc::Decoder(tty.mRxBuffer, RX_BUFFER_SIZE(tty), HdlcHandleFrame, HdlcHandleError, &tty);
+    tty.mFailed = false;
+    tty.mRxWakePending = false;
+    TxQueueReset(tty);
+
+    TtyOpen(tty);
+    RxEnable(tty, force);
+
+#if THCI_CONFIG_ARENA
+ done:
+#endif
+    return retval;
+}
+
+void thciTransportSleepEnable(void)
+{
+    TtyInstance &tty = sTty;
+    const bool force = true;
+
+    tty.mFailed = false;
+
+    TtyOpen(tty);
+    RxEnable(tty, force);
+}
+
+void thciTransportDisable(void)
+{
+    TtyInstance &tty = sTty;
+
+    TtyClose(tty);
+
+    tty.mRxFifoHead = tty.mRxFifoTail = 0;
+    tty.mRxWakePending = false;
+    TxQueueReset(tty);
+}
+
+bool thciTransportSleepDisable(void)
+{
+    TtyInstance &tty = sTty;
+    bool retval = false;
+    const bool force = true;
+
+    RxDisable(tty);
+
+    if (IsRxFifoEmpty(tty) && tty.mFrameByteCount == 0 && TxQueued(tty) == 0)
+    {
+        TtyClose(tty);
+        retval = true;
+    }
+    else
+    {
+        RxEnable(tty, !force);
+    }
+
+    return retval;
+}
+
+/**
+ * Encodes the frame into the next buffer of the TX queue, for the tty
+ * thread to send while the next one is packed and encoded.
+ */
+otError thciTransportSendFrame(const uint8_t *aFrame, uint16_t aLength)
+{
+    TtyInstance &tty = sTty;
+    ot::Hdlc::Encoder frameEncoder;
+    otError retval;
+    TtyTxBuffer *txFrame;
+    uint16_t framePos;
+    const char *step = NULL;
+
+    // Room for one more frame.
+    retval = TxWait(tty, THCI_CONFIG_UART_TX_FRAMES - 1);
+    nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Wait");
+
+    txFrame = &tty.mTxFrames[tty.mTxHead % THCI_CONFIG_UART_TX_FRAMES];
+    txFrame->Clear();
+
+    retval = frameEncoder.Init(*txFrame);
+    nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Init");
+
+    // The buffer holds the frame with every byte escaped.
+    for (framePos = 0; framePos < aLength; framePos++)
+    {
+        retval = frameEncoder.Encode(aFrame[framePos], *txFrame);
+        nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Encode");
+    }
+
+    retval = frameEncoder.Finalize(*txFrame);
+    nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Finalize");
+
+#if THCI_CONFIG_FAULT_INJECTION
+    // Faulty bytes are written by the THCI task, after the frames queued before.
+    if (THCI_FAULT_ACTIVE(kThciFaultStreamByteTx))
+    {
+        retval = TxWait(tty, 0);
+        nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Flush");
+
+        for (framePos = 0; framePos < txFrame->GetLength(); framePos++)
+        {
+            PutFaultyChar(tty, txFrame->GetBuffer()[framePos]);
+        }
+
+        goto exit;
+    }
+#endif
+
+    // The frame before the head.
+    __sync_synchronize();
+    tty.mTxHead++;
+
+    TtyWake(tty);
+
+ exit:
+    if (retval != OT_ERROR_NONE)
+    {
+        NL_LOG_CRIT(lrTHCI, "%s: Failed %s %d\n", __FUNCTION__, step, retval);
+    }
+
+    return retval;
+}
+
+void thciTransportProcess(void)
+{
+    RxFifoProcess(sTty);
+}
+
+bool thciTransportIsPending(void)
+{
+    // Bytes that do not end a frame wait for the rest of it.  The tty
+    // thread sends the TX queue on its own.
+    return sTty.mRxWakePending;
+}
+
+uint16_t thciTransportGetMaxRxFrameSize(void)
+{
+    return RX_BUFFER_SIZE(sTty) - HDLC_FCS_SIZE;
+}
+
+void thciTtyGetCounters(thci_uart_counters_t *aCounters)
+{
+    const thci_uart_counters_t *counters = &sTty.mCounters;
+
+    aCounters->mRxBytes = counters->mRxBytes;
+    aCounters->mRxFlowOff = counters->mRxFlowOff;
+    aCounters->mRxFifoHighWater = counters->mRxFifoHighWater;
+    aCounters->mRxWakeups = counters->mRxWakeups;
+    aCounters->mTxBlocked = counters->mTxBlocked;
+}
+
+void thciTtyResetCounters(void)
+{
+    memset(&sTty.mCounters, 0, sizeof(sTty.mCounters));
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_POSIX_TTY
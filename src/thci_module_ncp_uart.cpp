@@ -43,16 +43,25 @@
 #include <nlplatform.h>
 #include <nlplatform/nltime.h>
 #include <nlertime.h>
+
+// Spinel is carried by the HDLC-lite UART of this file unless another
+// transport is configured, see thci_module_ncp_transport.h.
+#define UART_TRANSPORT          (!THCI_CONFIG_NCP_SPI && !THCI_CONFIG_NCP_SHM && !THCI_CONFIG_POSIX_TTY)
+
+#if UART_TRANSPORT
 // pumice uses older console API's rather than nlplatform/nluart.h
 extern "C" {
 #include <nlconsole.h>
 #include <nlproduct.h>
 #include <nluart.h>
 } // extern "C"
+#endif
 
 /* OpenThread library includes */
 #include <openthread/types.h>
+#if UART_TRANSPORT
 #include <openthread/hdlc.hpp>
+#endif
 #include <openthread/spinel.h>
 
 /* thci includes */
@@ -60,17 +69,59 @@ extern "C" {
 #include <thci_module.h>
 #include <thci_module_ncp.h>
 #include <thci_module_ncp_uart.h>
+#include <thci_module_ncp_transport.h>
+#include <thci_stats.h>
+#include <thci_fault.h>
+#include <thci_arena.h>
+#include <thci_clock.h>
 
 /**
  * SECTION - Definitions
  */
 
-#define UART_TX_BUFFER_SIZE                 (128)
-#define UART_RX_BUFFER_SIZE                 (1500)
 #define UART_FRAME_BUFFER_SIZE              (1500)
-#define RX_UART_FIFO_SIZE                   (128)
-#define RX_UART_FIFO_NEAR_FULL_THRESHOLD    (RX_UART_FIFO_SIZE / 10)
+#if THCI_CONFIG_ARENA
+#define TX_BUFFER_SIZE(aUart)               ((aUart).mTxBufferSize)
+#else
+#define TX_BUFFER_SIZE(aUart)               (sizeof((aUart).mTxBuffer))
+#endif
 #define MAX_NCP_APP_RESPONSE_TIME_MSEC      (3000)
+// Without an event queue, as in AUPD, the response is polled for with a
+// delay that doubles from the minimum up to the maximum, and restarts
+// from the minimum whenever bytes arrive.
+#define NCP_RESPONSE_POLL_MIN_USEC          (20)
+#define NCP_RESPONSE_POLL_MAX_USEC          (2000)
+// Charged against the timeout for a pass that processes the transport, on
+// top of its delay, so that bytes that keep arriving cannot extend the
+// wait.  A pass processes at most the RX fifo and is assumed to take no
+// longer than this.
+#define NCP_RESPONSE_POLL_PROCESS_USEC      (NCP_RESPONSE_POLL_MAX_USEC)
+
+#if UART_TRANSPORT
+#define UART_RX_BUFFER_SIZE                 (THCI_CONFIG_UART_RX_BUFFER_SIZE)
+// The HDLC decoder keeps the FCS in the RX buffer.
+#define HDLC_FCS_SIZE                       (2)
+#if THCI_CONFIG_ARENA
+#define RX_BUFFER_SIZE(aUart)               ((aUart).mRxBufferSize)
+#else
+#define RX_BUFFER_SIZE(aUart)               (sizeof((aUart).mRxBuffer))
+#endif
+// Frames are encoded in chunks of this size, on the stack, then moved to
+// the TX fifo.
+#define UART_TX_BUFFER_SIZE                 (64)
+#define TX_UART_FIFO_SIZE                   (THCI_CONFIG_UART_TX_FIFO_SIZE)
+#define RX_UART_FIFO_SIZE                   (128)
+#if THCI_CONFIG_ARENA
+// The fifo is carved from the arena, sized by its profile.
+#define RX_UART_FIFO_LENGTH(aUart)          ((aUart).mRxUartFifoSize)
+#else
+#define RX_UART_FIFO_LENGTH(aUart)          (RX_UART_FIFO_SIZE)
+#endif
+#define RX_UART_FIFO_NEAR_FULL_THRESHOLD(aUart) (RX_UART_FIFO_LENGTH(aUart) / 10)
+// The THCI task is woken at the end of a frame, or once the fifo is half
+// full, rather than for every byte.
+#define RX_UART_FIFO_WAKE_THRESHOLD(aUart)  (RX_UART_FIFO_LENGTH(aUart) / 2)
+#define HDLC_FLAG_SEQUENCE                  (0x7e)
 #define MAX_NCP_PUTCHAR_TIME                (3000)
 
 #if defined(BUILD_PRODUCT_ANTIGUA) || defined(BUILD_PRODUCT_T2)
@@ -79,6 +130,37 @@ extern "C" {
 #error THCI_UART_ID has not been defined for this product!
 #endif
 
+// The UART and console of each THCI instance.  Products with more than one
+// NCP define these to select by instance index.
+#ifndef THCI_INSTANCE_UART_ID
+#define THCI_INSTANCE_UART_ID(aIndex)       THCI_UART_ID
+#endif
+
+#ifndef THCI_INSTANCE_CONSOLE
+#define THCI_INSTANCE_CONSOLE(aIndex)       NL_PRODUCT_CONSOLE(6LOWPAN)
+#endif
+#endif // UART_TRANSPORT
+
+#if THCI_CONFIG_PIPELINED_RESPONSES
+// Room for the largest stashed response payload, plus its string terminator.
+#define STASHED_RESPONSE_SIZE               (THCI_CONFIG_PIPELINED_RESPONSE_SIZE + 1)
+
+typedef struct
+{
+    uint8_t             mTransactionId;     // 0 when the slot is free.
+    bool                mReceived;
+    bool                mOverflowed;        // the response did not fit in mBuffer.
+    uint8_t             mHeader;
+    uint8_t             mCommand;
+    spinel_prop_key_t   mKey;
+    nl_time_ms_t        mSendTime;
+    uint32_t            mSendCommand;       // the command of the request, for its latency.
+    uint16_t            mLength;
+    uint8_t             mBuffer[STASHED_RESPONSE_SIZE];
+} StashedResponse;
+#endif
+
+#if UART_TRANSPORT
 class UartTxBuffer : public ot::Hdlc::Encoder::BufferWriteIterator
 {
 public:
@@ -92,12 +174,12 @@ public:
 private:
     uint8_t         mBuffer[UART_TX_BUFFER_SIZE];
 };
+#endif // UART_TRANSPORT
 
 /**
  * SECTION - Prototypes
  */
 
-static void UartRxReadyIsr(void *aContext);
 static int UartRxDoneEventHandler(nl_event_t *aEvent, void *aClosure);
 extern "C" void HandleLastStatusUpdate(const uint8_t *aArgPtr, unsigned int aArgLen);
 
@@ -105,37 +187,90 @@ extern "C" void HandleLastStatusUpdate(const uint8_t *aArgPtr, unsigned int aArg
  * SECTION - Globals
  */
 
-// THCI context that is common between the NCP and SOC solutions.
-extern thci_sdk_context_t gTHCISDKContext; 
 extern "C" const uint8_t kDontCareTransactionId;
 
-static volatile bool                    sProvideInternalResponse;
-static volatile uint8_t                 sRxEventPostedToResponseQueue;
-static volatile uint8_t                 sRxEventPostedToSdkQueue;
-static volatile bool                    sRxIsrDisabled;
-static uint16_t                         sFrameByteCount;
-static ot::Hdlc::Decoder                *sFrameDecoder;
-static uint8_t                          sRxUartFifo[RX_UART_FIFO_SIZE];
-static uint16_t                         sRxUartFifoHead;
-static uint16_t                         sRxUartFifoTail;
-static uint8_t                          sRxBuffer[UART_RX_BUFFER_SIZE];
-static uint8_t                          sTxBuffer[UART_FRAME_BUFFER_SIZE];
-static nl_eventqueue_t                  sResponseQueueHandle;
-static nl_eventqueue_t                  *sResponseQueue[1];
-static uint8_t                          sResponseCommand;
-static spinel_prop_key_t                sResponseKey;
-static const uint8_t                    *sResponseBuffer;
-static size_t                           sResponseLength;
-static bool                             sResponseReceived;
-static uint8_t                          sResponseTransactionId;
-static bool                             sResponseSuccess;
-static bool                             sDecodeFailure;
-static const nl_console_t               *sUartConsole;
-static thciUartDataFrameCallback_t      sDataFrameCB;
-static thciUartControlFrameCallback_t   sControlFrameCB;
-static nl_time_ms_t                     (*sGetMillisecondTimeFunc)(void) = NULL;
-
-static DEFINE_ALIGNED_VAR(sFrameDecoderBuffer, sizeof(ot::Hdlc::Decoder), uint64_t);
+/**
+ * The UART state of one THCI instance: its Spinel layer and, unless the NCP
+ * is on SPI, shared memory or a tty, its HDLC-lite UART transport.
+ */
+struct UartInstance
+{
+    volatile bool                   mProvideInternalResponse;
+    volatile uint8_t                mRxEventPostedToResponseQueue;
+    volatile uint8_t                mRxEventPostedToSdkQueue;
+#if UART_TRANSPORT
+    const thci_transport_callbacks_t *mTransport;
+    volatile bool                   mRxIsrDisabled;
+    volatile bool                   mRxWakePending;     // the task was woken for bytes in the fifo.
+    bool                            mRxAccepting;       // the last wake found a receiver; ISR only.
+    bool                            mRxPaused;          // the frame callback asked to stop.
+    uint16_t                        mFrameByteCount;
+    ot::Hdlc::Decoder               *mFrameDecoder;
+#if THCI_CONFIG_ARENA
+    uint8_t                         *mRxUartFifo;       // buffers carved from the arena.
+    uint16_t                        mRxUartFifoSize;
+    uint8_t                         *mRxBuffer;
+    uint16_t                        mRxBufferSize;
+#else
+    uint8_t                         mRxUartFifo[RX_UART_FIFO_SIZE];
+    uint8_t                         mRxBuffer[UART_RX_BUFFER_SIZE];
+#endif
+    uint16_t                        mRxUartFifoHead;
+    uint16_t                        mRxUartFifoTail;
+#if THCI_CONFIG_ARENA
+    uint8_t                         *mTxUartFifo;       // carved from the arena.
+#else
+    uint8_t                         mTxUartFifo[TX_UART_FIFO_SIZE];     // encoded bytes, the oldest at mTxTail.
+#endif
+    uint16_t                        mTxHead;            // bytes queued, free running.
+    uint16_t                        mTxTail;            // bytes passed to the UART driver, free running.
+#endif
+#if THCI_CONFIG_ARENA
+    uint8_t                         *mTxBuffer;
+    uint16_t                        mTxBufferSize;
+#else
+    uint8_t                         mTxBuffer[UART_FRAME_BUFFER_SIZE];
+#endif
+    nl_eventqueue_t                 mResponseQueueHandle;
+    nl_eventqueue_t                 *mResponseQueue[1];
+    uint8_t                         mResponseCommand;
+    spinel_prop_key_t               mResponseKey;
+    const uint8_t                   *mResponseBuffer;
+    size_t                          mResponseLength;
+    bool                            mResponseReceived;
+    unsigned int                    mReceivedCommand;
+    spinel_prop_key_t               mReceivedKey;
+    uint8_t                         mResponseTransactionId;
+    bool                            mResponseSuccess;
+    bool                            mDecodeFailure;
+#if UART_TRANSPORT
+    const nl_console_t              *mUartConsole;
+#endif
+    thciUartDataFrameCallback_t     mDataFrameCB;
+    thciUartControlFrameCallback_t  mControlFrameCB;
+    nl_time_ms_t                    (*mGetMillisecondTimeFunc)(void);
+    nl_time_ms_t                    mFrameSendTime;
+    uint32_t                        mFrameSendCommand;
+    thci_uart_counters_t            mUartCounters;
+    thci_spinel_stats_t             mSpinelStats;
+#if THCI_CONFIG_PIPELINED_RESPONSES
+    StashedResponse                 mStashedResponses[THCI_CONFIG_PIPELINED_RESPONSES];
+#endif
+#if UART_TRANSPORT
+    DEFINE_ALIGNED_VAR(mFrameDecoderBuffer, sizeof(ot::Hdlc::Decoder), uint64_t);
+#endif
+};
+
+static UartInstance                     sUartInstances[THCI_CONFIG_MAX_INSTANCES];
+
+// The UART state of the current instance.  The ISR and the functions it
+// calls are passed their instance instead.
+#define sUart                           (sUartInstances[THCI_INSTANCE_INDEX()])
+
+static inline uint8_t InstanceIndex(const UartInstance &aUart)
+{
+    return static_cast<uint8_t>(&aUart - sUartInstances);
+}
 
 const nl_event_t sUartRxDoneEvent =
 {
@@ -147,6 +282,31 @@ const nl_event_t sUartRxDoneEvent =
  * SECTION - Implementation
  */
 
+static void DelayMs(nl_time_ms_t aDelay)
+{
+    NL_CPU_spinWaitUs(1000 * aDelay);
+}
+
+/**
+ * Used to get the current time in Milliseconds. 
+ * WARNING: Do not call this function directly. Instead 
+ * call it through the function pointer mGetMillisecondTimeFunc.
+ * Otherwise AUPD will fail as it does not support nl_get_time_native.
+ */
+static nl_time_ms_t GetMillisecondTime(void)
+{
+    return (nl_time_ms_t)nltime_get_system_ms();
+}
+
+/**
+ * Used when nl_get_time_native is not available as in AUPD.
+ */
+static nl_time_ms_t GetNoTime(void)
+{
+    return 0;
+}
+
+#if UART_TRANSPORT
 UartTxBuffer::UartTxBuffer(void)
     : ot::Hdlc::Encoder::BufferWriteIterator()
 {
@@ -174,96 +334,85 @@ const uint8_t *UartTxBuffer::GetBuffer(void) const
     return mBuffer;
 }
 
-static void DelayMs(nl_time_ms_t aDelay)
-{
-    NL_CPU_spinWaitUs(1000 * aDelay);
-}
-
-static void RxISREnable(bool aForce)
+static void RxISREnable(UartInstance &aUart, bool aForce)
 {
-    if (aForce || sRxIsrDisabled)
+    if (aForce || aUart.mRxIsrDisabled)
     {
-        sRxIsrDisabled = false;
-        uart_enable_rie(THCI_UART_ID, true);
+        aUart.mRxIsrDisabled = false;
+        uart_enable_rie(THCI_INSTANCE_UART_ID(InstanceIndex(aUart)), true);
     }
 }
 
-static void RxISRDisable(void)
+static void RxISRDisable(UartInstance &aUart)
 {
-    if (!sRxIsrDisabled)
+    if (!aUart.mRxIsrDisabled)
     {
-        sRxIsrDisabled = true;
-        uart_enable_rie(THCI_UART_ID, false);
+        aUart.mRxIsrDisabled = true;
+        aUart.mUartCounters.mRxFlowOff++;
+        uart_enable_rie(THCI_INSTANCE_UART_ID(InstanceIndex(aUart)), false);
     }
 }
 
-/**
- * Used to get the current time in Milliseconds. 
- * WARNING: Do not call this function directly. Instead 
- * call it through the function pointer sGetMillisecondTimeFunc.
- * Otherwise AUPD will fail as it does not support nl_get_time_native.
- */
-static nl_time_ms_t GetMillisecondTime(void)
-{
-    return (nl_time_ms_t)nltime_get_system_ms();
-}
-
-/**
- * Used when nl_get_time_native is not available as in AUPD.
- */
-static nl_time_ms_t GetNoTime(void)
-{
-    return 0;
-}
-
-static int GetRxFifoChar(uint8_t *aByte)
+static int GetRxFifoChar(UartInstance &aUart, uint8_t *aByte)
 {
     int retval = 0;
 
-    nlREQUIRE_ACTION(sRxUartFifoTail != sRxUartFifoHead, done, retval = -ENODATA);
+    nlREQUIRE_ACTION(aUart.mRxUartFifoTail != aUart.mRxUartFifoHead, done, retval = -ENODATA);
 
-    *aByte = sRxUartFifo[sRxUartFifoTail];
+    *aByte = aUart.mRxUartFifo[aUart.mRxUartFifoTail];
 
-    sRxUartFifoTail = (sRxUartFifoTail < RX_UART_FIFO_SIZE - 1) ? sRxUartFifoTail + 1 : 0;
+    aUart.mRxUartFifoTail = (aUart.mRxUartFifoTail < RX_UART_FIFO_LENGTH(aUart) - 1) ? aUart.mRxUartFifoTail + 1 : 0;
 
  done:
     return retval;
 }
 
-static int PutRxFifoChar(uint8_t aByte)
+static int PutRxFifoChar(UartInstance &aUart, uint8_t aByte)
 {
     int retval = 0;
-    size_t newHead = (sRxUartFifoHead < RX_UART_FIFO_SIZE - 1) ? sRxUartFifoHead + 1 : 0;
+    size_t newHead = (aUart.mRxUartFifoHead < RX_UART_FIFO_LENGTH(aUart) - 1) ? aUart.mRxUartFifoHead + 1 : 0;
+    uint16_t used;
+
+    nlREQUIRE_ACTION(newHead != aUart.mRxUartFifoTail, done, retval = -EOVERFLOW; aUart.mUartCounters.mRxDroppedBytes++);
+
+    aUart.mRxUartFifo[aUart.mRxUartFifoHead] = aByte;
+
+    aUart.mRxUartFifoHead = newHead;
 
-    nlREQUIRE_ACTION(newHead != sRxUartFifoTail, done, retval = -EOVERFLOW);
+    aUart.mUartCounters.mRxBytes++;
 
-    sRxUartFifo[sRxUartFifoHead] = aByte;
+    used = (aUart.mRxUartFifoHead >= aUart.mRxUartFifoTail) ?
+           (aUart.mRxUartFifoHead - aUart.mRxUartFifoTail) :
+           (RX_UART_FIFO_LENGTH(aUart) - aUart.mRxUartFifoTail + aUart.mRxUartFifoHead);
 
-    sRxUartFifoHead = newHead;
+    if (used > aUart.mUartCounters.mRxFifoHighWater)
+    {
+        aUart.mUartCounters.mRxFifoHighWater = used;
+    }
 
  done:
     return retval;    
 }
 
-static bool IsRxFifoNearFull(size_t aThreshold)
+static bool IsRxFifoNearFull(UartInstance &aUart, size_t aThreshold)
 {
-    size_t newHead = (sRxUartFifoHead < RX_UART_FIFO_SIZE - aThreshold) ? 
-                    sRxUartFifoHead + aThreshold : 
-                    aThreshold - (RX_UART_FIFO_SIZE - sRxUartFifoHead);
+    size_t newHead = (aUart.mRxUartFifoHead < RX_UART_FIFO_LENGTH(aUart) - aThreshold) ? 
+                    aUart.mRxUartFifoHead + aThreshold : 
+                    aThreshold - (RX_UART_FIFO_LENGTH(aUart) - aUart.mRxUartFifoHead);
     bool retval = true;
 
-    if (sRxUartFifoHead > sRxUartFifoTail)
+    if (aUart.mRxUartFifoHead > aUart.mRxUartFifoTail)
     {
-        if (newHead > sRxUartFifoHead || 
-            newHead < sRxUartFifoTail)
+        if (newHead > aUart.mRxUartFifoHead || 
+            newHead < aUart.mRxUartFifoTail)
         {
             retval = false;
         }
     }
     else
     {
-        if (newHead < sRxUartFifoTail && 
-            newHead > sRxUartFifoHead)
+        if (newHead < aUart.mRxUartFifoTail && 
+            newHead > aUart.mRxUartFifoHead)
         {
             retval = false;
         }
@@ -272,131 +421,257 @@ static bool IsRxFifoNearFull(size_t aThreshold)
     return retval;
 }
 
-static bool IsRxFifoEmpty(void)
+static bool IsRxFifoEmpty(const UartInstance &aUart)
+{
+    return (aUart.mRxUartFifoTail == aUart.mRxUartFifoHead);
+}
+
+#if THCI_CONFIG_FAULT_INJECTION
+static void DecodeFaultyChar(uint8_t aChar)
+{
+    const uint8_t verdict = thciFaultByte(kThciFaultStreamByteRx, &aChar);
+
+    if (!(verdict & THCI_FAULT_VERDICT_DROP))
+    {
+        sUart.mFrameDecoder->Decode(&aChar, sizeof(uint8_t));
+
+        if (verdict & THCI_FAULT_VERDICT_DUPLICATE)
+        {
+            sUart.mFrameDecoder->Decode(&aChar, sizeof(uint8_t));
+        }
+    }
+}
+
+static void PutFaultyChar(uint8_t aChar)
 {
-    return (sRxUartFifoTail == sRxUartFifoHead);
+    const uint8_t verdict = thciFaultByte(kThciFaultStreamByteTx, &aChar);
+
+    if (!(verdict & THCI_FAULT_VERDICT_DROP))
+    {
+        nl_console_putchar(sUart.mUartConsole, (char) aChar);
+
+        if ((verdict & THCI_FAULT_VERDICT_DUPLICATE) && nl_console_canput(sUart.mUartConsole))
+        {
+            nl_console_putchar(sUart.mUartConsole, (char) aChar);
+        }
+    }
 }
+#endif // THCI_CONFIG_FAULT_INJECTION
 
 /**
  * Process received bytes stored in the FIFO.
  */
-static void UartRxFifoProcess(void)
+static void UartRxFifoProcess(UartInstance &aUart)
 {
     uint8_t ch;
+
+    aUart.mRxPaused = false;
+
+    // Bytes put after this are signalled again.
+    aUart.mRxWakePending = false;
+    __sync_synchronize();
+
     // The loop must terminate if the desired response is received. The logic 
     // cannot be allowed to continue reading bytes from the fifo as it is possible 
     // to corrupt the response.
-    while (!sDecodeFailure && 
-           !sResponseReceived && 
-           !GetRxFifoChar(&ch))
+    while (!aUart.mDecodeFailure && 
+           !aUart.mRxPaused && 
+           !GetRxFifoChar(aUart, &ch))
     {
-        sFrameByteCount++;
-        sFrameDecoder->Decode(&ch, sizeof(uint8_t));
+        aUart.mFrameByteCount++;
+
+#if THCI_CONFIG_FAULT_INJECTION
+        if (THCI_FAULT_ACTIVE(kThciFaultStreamByteRx))
+        {
+            DecodeFaultyChar(ch);
+        }
+        else
+#endif
+        {
+            aUart.mFrameDecoder->Decode(&ch, sizeof(uint8_t));
+        }
 
         // If the RX ISR is disabled and the Fifo has been sufficiently drained, 
         // then re-enable the ISR.
-        if (sRxIsrDisabled && !IsRxFifoNearFull(2*RX_UART_FIFO_NEAR_FULL_THRESHOLD))
+        if (aUart.mRxIsrDisabled && !IsRxFifoNearFull(aUart, 2*RX_UART_FIFO_NEAR_FULL_THRESHOLD(aUart)))
         {
             const bool force = true;
-            RxISREnable(!force);
+            RxISREnable(aUart, !force);
         }
     }
+
+    // Stopped before the end of the fifo: what is left may hold whole frames.
+    if (aUart.mRxPaused && !IsRxFifoEmpty(aUart))
+    {
+        aUart.mRxWakePending = true;
+    }
 }
 
 /**
- * Sends bytes stored in aUartBuffer to UART.
+ * Returns the number of bytes of the TX fifo waiting to be sent.
  */
-static otError PutChars(UartTxBuffer *aUartBuffer)
+static uint16_t TxQueued(const UartInstance &aUart)
 {
-    uint16_t length;
-    otError retval = OT_ERROR_NONE;
+    return static_cast<uint16_t>(aUart.mTxHead - aUart.mTxTail);
+}
+
+static void TxQueueReset(UartInstance &aUart)
+{
+    aUart.mTxHead = 0;
+    aUart.mTxTail = 0;
+}
+
+/**
+ * Passes the TX fifo to the UART driver until it is full.
+ */
+static void UartTxPump(UartInstance &aUart)
+{
+
+    while (TxQueued(aUart) > 0 && nl_console_canput(aUart.mUartConsole))
+    {
+        const uint8_t byte = aUart.mTxUartFifo[aUart.mTxTail % TX_UART_FIFO_SIZE];
+
+#if THCI_CONFIG_FAULT_INJECTION
+        if (THCI_FAULT_ACTIVE(kThciFaultStreamByteTx))
+        {
+            PutFaultyChar(byte);
+        }
+        else
+#endif
+        {
+            nl_console_putchar(aUart.mUartConsole, (char) byte);
+        }
+
+        aUart.mTxTail++;
+    }
+}
 
-    length = aUartBuffer->GetLength();
+/**
+ * Waits until no more than aQueued bytes of the TX fifo are waiting to be
+ * sent.
+ */
+static otError UartTxWait(UartInstance &aUart, uint16_t aQueued)
+{
+    uint16_t tail = aUart.mTxTail;
+    nl_time_ms_t timeStamp = aUart.mGetMillisecondTimeFunc();
+    otError retval = OT_ERROR_NONE;
 
-    if (length)
+    while (TxQueued(aUart) > aQueued)
     {
-        const uint8_t *buffer = aUartBuffer->GetBuffer();
-        uint16_t put = 0;
-        nl_time_ms_t timeStamp = sGetMillisecondTimeFunc();
+        UartTxPump(aUart);
 
-        while (length > put)
+        if (aUart.mTxTail != tail)
         {
-            nlREQUIRE_ACTION(sGetMillisecondTimeFunc() - timeStamp < MAX_NCP_PUTCHAR_TIME, done, retval = OT_ERROR_BUSY);
+            tail = aUart.mTxTail;
+            timeStamp = aUart.mGetMillisecondTimeFunc();
+            continue;
+        }
 
-            if (nl_console_canput(sUartConsole))
-            {
-                nl_console_putchar(sUartConsole, (char) (buffer[put++]));
-                timeStamp = sGetMillisecondTimeFunc();
-            }
-            else if (sRxIsrDisabled)
-            {
-                // If nl_console_canput fails and sRxIsrDisabled is true then it suggests that the 
-                // NCP is blocked trying to send UART bytes to the host. To avoid a deadlock, drain
-                // the rx fifo by calling UartRxFifoProcess.
-                UartRxFifoProcess();
-            }
+        nlREQUIRE_ACTION(aUart.mGetMillisecondTimeFunc() - timeStamp < MAX_NCP_PUTCHAR_TIME, done, retval = OT_ERROR_BUSY);
+
+        if (aUart.mRxIsrDisabled)
+        {
+            aUart.mUartCounters.mTxBlocked++;
+
+            // If no byte goes out and mRxIsrDisabled is true then it suggests that the 
+            // NCP is blocked trying to send UART bytes to the host. To avoid a deadlock, drain
+            // the rx fifo by calling UartRxFifoProcess.
+            UartRxFifoProcess(aUart);
         }
     }
 
  done:
     if (retval != OT_ERROR_NONE)
     {
-        NL_LOG_CRIT(lrTHCI, "%s: Failed with err (%d) %d\n", __FUNCTION__, retval, sRxIsrDisabled);
+        NL_LOG_CRIT(lrTHCI, "%s: Failed with err (%d) %d\n", __FUNCTION__, retval, aUart.mRxIsrDisabled);
+    }
+
+    return retval;
+}
+
+/**
+ * Moves an encoded chunk to the TX fifo, waiting for room while it is full.
+ */
+static otError UartTxFifoPut(UartInstance &aUart, UartTxBuffer &aChunk)
+{
+    const uint8_t *bytes = aChunk.GetBuffer();
+    const uint16_t length = aChunk.GetLength();
+    uint16_t put = 0;
+    otError retval = OT_ERROR_NONE;
+
+    while (put < length)
+    {
+        // Room for one more byte.
+        retval = UartTxWait(aUart, TX_UART_FIFO_SIZE - 1);
+        nlREQUIRE(retval == OT_ERROR_NONE, done);
+
+        while (put < length && TxQueued(aUart) < TX_UART_FIFO_SIZE)
+        {
+            aUart.mTxUartFifo[aUart.mTxHead % TX_UART_FIFO_SIZE] = bytes[put++];
+            aUart.mTxHead++;
+        }
     }
 
-    aUartBuffer->Clear();
+ done:
+    aChunk.Clear();
 
     return retval;
 }
 
 /**
- * Encodes Frame using HDLC FrameEncoder and calls PutChars to send result out UART.
+ * Encodes Frame using HDLC FrameEncoder into the TX fifo.  The end of the
+ * frame is sent while the next one is packed and encoded.
  */
-static otError UartSendFrame(const uint8_t *aTxFrame, const uint16_t aTxFrameLen)
+static otError UartSendFrame(UartInstance &aUart, const uint8_t *aTxFrame, const uint16_t aTxFrameLen)
 {
-    uint8_t byte;
     ot::Hdlc::Encoder frameEncoder;
     otError retval;
-    UartTxBuffer uartTxBuffer;
-    uint16_t txFramePos = 0;
+    UartTxBuffer chunk;
+    UartTxBuffer *uartTxBuffer;
+    uint16_t txFramePos;
     const char *step = NULL;
 
-    uartTxBuffer.Clear();
-    
-    retval = frameEncoder.Init(uartTxBuffer);
+    // The frame is encoded in chunks, each moved to the TX fifo once full,
+    // which the UART driver is fed from.
+    uartTxBuffer = &chunk;
+
+    retval = frameEncoder.Init(*uartTxBuffer);
     nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Init");
 
-    byte = aTxFrame[txFramePos++];
+    txFramePos = 0;
 
-    while (aTxFrameLen >= txFramePos)
+    while (txFramePos < aTxFrameLen)
     {
-        retval = frameEncoder.Encode(byte, uartTxBuffer);
+        retval = frameEncoder.Encode(aTxFrame[txFramePos], *uartTxBuffer);
         nlREQUIRE_ACTION(retval == OT_ERROR_NONE || retval == OT_ERROR_NO_BUFS, exit, step = "Encode");
 
         if (retval == OT_ERROR_NO_BUFS)
         {
-            retval = PutChars(&uartTxBuffer);
-            nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "PutChars1");
+            retval = UartTxFifoPut(aUart, chunk);
+            nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Put1");
 
             continue;
         }
 
-        byte = aTxFrame[txFramePos++];
+        txFramePos++;
     }
 
-    retval = frameEncoder.Finalize(uartTxBuffer);
+    retval = frameEncoder.Finalize(*uartTxBuffer);
     nlREQUIRE_ACTION(retval == OT_ERROR_NONE || retval == OT_ERROR_NO_BUFS, exit, step = "Finalize1");
 
     if (retval == OT_ERROR_NO_BUFS)
     {
-        retval = PutChars(&uartTxBuffer);
-        nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "PutChars2");
+        retval = UartTxFifoPut(aUart, chunk);
+        nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Put2");
 
-        retval = frameEncoder.Finalize(uartTxBuffer);
+        retval = frameEncoder.Finalize(*uartTxBuffer);
         nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Finalize2");
     }
 
-    retval = PutChars(&uartTxBuffer);
+    retval = UartTxFifoPut(aUart, chunk);
+    nlREQUIRE_ACTION(retval == OT_ERROR_NONE, exit, step = "Put3");
+
+    UartTxPump(aUart);
 
  exit:
     if (retval != OT_ERROR_NONE)
@@ -406,166 +681,382 @@ static otError UartSendFrame(const uint8_t *aTxFrame, const uint16_t aTxFrameLen
 
     return retval;
 }
+#endif // UART_TRANSPORT
+
+#if THCI_CONFIG_FAULT_INJECTION
+/**
+ * Sends a frame through the frame_tx fault stream.  A dropped frame is
+ * reported as sent, as it would be if it were lost on the wire.
+ */
+static otError SendFaultyFrame(uint8_t *aTxFrame, uint16_t aTxFrameLen)
+{
+    uint16_t delay = 0;
+    otError retval = OT_ERROR_NONE;
+    const uint8_t verdict = thciFaultFrame(kThciFaultStreamFrameTx, aTxFrame, &aTxFrameLen, &delay);
+
+    nlREQUIRE(!(verdict & THCI_FAULT_VERDICT_DROP), done);
+
+    if (verdict & THCI_FAULT_VERDICT_DELAY)
+    {
+        DelayMs(delay);
+    }
+
+    retval = thciTransportSendFrame(aTxFrame, aTxFrameLen);
+
+    if ((retval == OT_ERROR_NONE) && (verdict & THCI_FAULT_VERDICT_DUPLICATE))
+    {
+        retval = thciTransportSendFrame(aTxFrame, aTxFrameLen);
+    }
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_FAULT_INJECTION
 
 /**
  * Tries to post an event to the sdk queue
  *
- * @param[in] aFromISR True if the caller is in ISR context, false otherwise.
+ * @param[in] aContext Where the caller runs.
  *
  */
-static void PostRxDoneEventToSdkQueue(bool aFromISR)
+static void PostRxDoneEventToSdkQueue(UartInstance &aUart, thci_transport_context_t aContext)
 {
+    nl_eventqueue_t sdkQueue = gTHCISDKContexts[InstanceIndex(aUart)].mInitParams.mSdkQueue;
+
     // Only post the event if the sdk queue is available.
-    if (gTHCISDKContext.mInitParams.mSdkQueue)
+    if (sdkQueue)
     {
         // Only post the event if the event is not already in the queue. Otherwise, 
         // these events could overflow the queue.
-        if (aFromISR)
+        if (aContext == kThciTransportContextIsr)
         {
-            if (!sRxEventPostedToSdkQueue)
+            if (!aUart.mRxEventPostedToSdkQueue)
+            {
+                aUart.mRxEventPostedToSdkQueue = 1;
+                THCI_EVENT_STATS_POSTED_FROM_ISR(kThciEventUartRxDone);
+                nl_eventqueue_post_event_from_isr(sdkQueue,  &sUartRxDoneEvent);
+            }
+            else
             {
-                sRxEventPostedToSdkQueue = 1;
-                nl_eventqueue_post_event_from_isr(gTHCISDKContext.mInitParams.mSdkQueue,  &sUartRxDoneEvent);
+                THCI_EVENT_STATS_SUPPRESSED(kThciEventUartRxDone);
             }
         }
         else
         {
-            if (!__sync_fetch_and_or(&sRxEventPostedToSdkQueue, 1))
+            if (!__sync_fetch_and_or(&aUart.mRxEventPostedToSdkQueue, 1))
+            {
+                THCI_EVENT_STATS_POSTED(kThciEventUartRxDone);
+                nl_eventqueue_post_event(sdkQueue,  &sUartRxDoneEvent);
+            }
+            else
             {
-                nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue,  &sUartRxDoneEvent);
+                THCI_EVENT_STATS_SUPPRESSED(kThciEventUartRxDone);
             }
         }
     }
 }
 
+/**
+ * Moves an event taken from the response queue to the sdk queue.  It was
+ * neither dispatched nor posted again, so only its pending count moves.
+ */
+static void MoveRxDoneEventToSdkQueue(UartInstance &aUart)
+{
+    nl_eventqueue_t sdkQueue = gTHCISDKContexts[InstanceIndex(aUart)].mInitParams.mSdkQueue;
+
+    if (sdkQueue && !__sync_fetch_and_or(&aUart.mRxEventPostedToSdkQueue, 1))
+    {
+        THCI_EVENT_STATS_MOVED(kThciEventUartRxResponse, kThciEventUartRxDone);
+        nl_eventqueue_post_event(sdkQueue,  &sUartRxDoneEvent);
+    }
+    else
+    {
+        // An event is in the sdk queue already.
+        THCI_EVENT_STATS_MOVED(kThciEventUartRxResponse, kThciEventCount);
+    }
+}
+
 /**
  * Tries to post an event to the local response queue
  *
- * @param[in] aFromISR True if the caller is in ISR context, false otherwise.
+ * @param[in] aContext Where the caller runs.
  *
  */
-static void PostRxDoneEventToResponseQueue(bool aFromISR)
+static void PostRxDoneEventToResponseQueue(UartInstance &aUart, thci_transport_context_t aContext)
 {
-    if (sProvideInternalResponse)
+    if (aUart.mProvideInternalResponse)
     {
         // Only post the event if the event has not already been posted.  Otherwise,
         // these events could overflow the queue.
-        if (sResponseQueueHandle)
+        if (aUart.mResponseQueueHandle)
         {
-            if (aFromISR)
+            if (aContext == kThciTransportContextIsr)
             {
-                if (!sRxEventPostedToResponseQueue)
+                if (!aUart.mRxEventPostedToResponseQueue)
                 {
-                    sRxEventPostedToResponseQueue = 1;
-                    nl_eventqueue_post_event_from_isr(sResponseQueueHandle,  &sUartRxDoneEvent);
+                    aUart.mRxEventPostedToResponseQueue = 1;
+                    THCI_EVENT_STATS_POSTED_FROM_ISR(kThciEventUartRxResponse);
+                    nl_eventqueue_post_event_from_isr(aUart.mResponseQueueHandle,  &sUartRxDoneEvent);
+                }
+                else
+                {
+                    THCI_EVENT_STATS_SUPPRESSED(kThciEventUartRxResponse);
+                }
+            }
+            else if (aContext == kThciTransportContextThread)
+            {
+                // A thread may run concurrently with the task clearing the flag.
+                if (!__sync_fetch_and_or(&aUart.mRxEventPostedToResponseQueue, 1))
+                {
+                    THCI_EVENT_STATS_POSTED(kThciEventUartRxResponse);
+                    nl_eventqueue_post_event(aUart.mResponseQueueHandle,  &sUartRxDoneEvent);
+                }
+                else
+                {
+                    THCI_EVENT_STATS_SUPPRESSED(kThciEventUartRxResponse);
                 }
             }
             else
             {
-                // posting to the response queue from outside ISR context is not supported and is likely a bug.
-                NL_LOG_CRIT(lrTHCI, "ERROR: Tried to post to response queue from outside ISR context.\n");
+                // The waiting task polls the transport itself; posting to its own queue is likely a bug.
+                NL_LOG_CRIT(lrTHCI, "ERROR: Tried to post to response queue from the THCI task.\n");
             } 
         }
     }
 }
 
 /**
- * Called in ISR context as a Rx callback by the UART module.
+ * Receives the signal of the transport of instance aInstanceIndex that
+ * data arrived, and posts the event that processes it.
  *
- * @param[in] aContext   A pointer to the new received byte.
+ * @param[in] aInstanceIndex  The instance whose transport received data.
+ * @param[in] aContext        Where the caller runs.
  *
+ * @return false if nobody will process the data.
  */
-static void UartRxReadyIsr(void *aContext)
+static bool HandleRxReady(uint8_t aInstanceIndex, thci_transport_context_t aContext)
 {
-    const bool fromISR = true;
+    UartInstance &uart = sUartInstances[aInstanceIndex];
+    const bool retval = (uart.mProvideInternalResponse || gTHCISDKContexts[aInstanceIndex].mInitParams.mSdkQueue);
 
-    nlREQUIRE(!sDecodeFailure, done);
-
-    if (sProvideInternalResponse || gTHCISDKContext.mInitParams.mSdkQueue)
+    if (uart.mProvideInternalResponse)
     {
-        if (sProvideInternalResponse)
-        {
-            PostRxDoneEventToResponseQueue(fromISR);
-        }
-        else
-        {
-            PostRxDoneEventToSdkQueue(fromISR);
-        }
-
-        // Add the character to the fifo even if the event wasn't posted.
-        // AUPD has no event queue but needs Internal response support.
-        PutRxFifoChar(*((uint8_t *)aContext));
-
-        if (IsRxFifoNearFull(RX_UART_FIFO_NEAR_FULL_THRESHOLD))
+        // On the THCI task this is the waiting task itself, which polls
+        // the transport.
+        if (aContext != kThciTransportContextTask)
         {
-            RxISRDisable();
+            PostRxDoneEventToResponseQueue(uart, aContext);
         }
     }
     else
     {
-        // let the character drop. This can happen in AUPD when the Task is no longer 
-        // waiting for an internal response but bytes continue to arrive from the NCP.
+        PostRxDoneEventToSdkQueue(uart, aContext);
     }
 
- done:
-    return;
+    return retval;
 }
 
+#if UART_TRANSPORT
 /**
- * Called to process UartRxReadyIsr interrupt.
+ * Wakes the THCI task for the bytes put in the fifo, in ISR context.
+ * Called at the end of a frame, or once the fifo passes its wake
+ * threshold, so that the task decodes whole frames.
  *
- * @param[in] aEvent    The event object that generated the call to this handler.
- * @param[in] aClosure  A application specific context object associated with the event.
+ * @param[in] aUart      The UART state of the instance that received the bytes.
+ * @param[in] aContext   Where the caller runs.
+ *
+ * @return false if nobody will process the bytes.
  */
-static int UartRxDoneEventHandler(nl_event_t *aEvent, void *aClosure)
+static bool RxWake(UartInstance &aUart, thci_transport_context_t aContext)
 {
-    (void)aEvent;
-    (void)aClosure;
-
-    sRxEventPostedToSdkQueue = 0;
-
-    UartRxFifoProcess();
-
-    if (!sDecodeFailure && 
-        !IsRxFifoEmpty())
+    if (!aUart.mRxWakePending)
     {
-        const bool fromISR = false;
-        // post an event to the sdk queue so that the task will return later to finish 
-        // emptying the fifo.
-        PostRxDoneEventToSdkQueue(fromISR);
+        aUart.mRxWakePending = true;
+        aUart.mUartCounters.mRxWakeups++;
     }
 
-    return 0;
+    return aUart.mTransport->mReady(InstanceIndex(aUart), aContext);
 }
 
-static bool CompareResponse(uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey)
+/**
+ * Called in ISR context as a Rx callback by the UART module.
+ *
+ * @param[in] aUart      The UART state of the instance that received the byte.
+ * @param[in] aContext   A pointer to the new received byte.
+ *
+ */
+static void UartRxReadyIsr(UartInstance &aUart, void *aContext)
 {
-    bool retval = false;
+    const uint8_t byte = *((uint8_t *)aContext);
 
-    if (sResponseTransactionId != kDontCareTransactionId) {
-        if (SPINEL_HEADER_GET_TID(aHeader) == sResponseTransactionId)
-        {
-            retval = true; // when the tid matches and is not the Don't care tid then it is matched.
+    nlREQUIRE(!aUart.mDecodeFailure, done);
 
-            // When the TID matches but the command and key do not it indicates operation failure.
-            // aKey is almost certainly SPINEL_PROP_LAST_STATUS in the unmatched case.
-            if (sResponseCommand == aCommand && sResponseKey == aKey)
+    if (aUart.mRxAccepting)
+    {
+        // Add the character to the fifo even if the event wasn't posted.
+        // AUPD has no event queue but needs Internal response support.
+        PutRxFifoChar(aUart, byte);
+
+        if ((byte == HDLC_FLAG_SEQUENCE) || IsRxFifoNearFull(aUart, RX_UART_FIFO_WAKE_THRESHOLD(aUart)))
+        {
+            aUart.mRxAccepting = RxWake(aUart, kThciTransportContextIsr);
+        }
+
+        if (IsRxFifoNearFull(aUart, RX_UART_FIFO_NEAR_FULL_THRESHOLD(aUart)))
+        {
+            RxISRDisable(aUart);
+        }
+    }
+    else
+    {
+        // let the character drop. This can happen in AUPD when the Task is no longer 
+        // waiting for an internal response but bytes continue to arrive from the NCP.
+        aUart.mUartCounters.mRxDroppedBytes++;
+
+        // The flag that ends this frame starts the next: check whether it
+        // has a receiver.
+        if (byte == HDLC_FLAG_SEQUENCE)
+        {
+            aUart.mRxAccepting = aUart.mTransport->mReady(InstanceIndex(aUart), kThciTransportContextIsr);
+        }
+    }
+
+ done:
+    return;
+}
+
+/**
+ * The Rx callback installed for instance kIndex: the UART module passes no
+ * user context, so each instance has its own.
+ */
+template <uint8_t kIndex>
+static void UartRxReadyIsrFor(void *aContext)
+{
+    UartRxReadyIsr(sUartInstances[kIndex], aContext);
+}
+
+static void (*const sUartRxReadyIsrs[THCI_CONFIG_MAX_INSTANCES])(void *aContext) =
+{
+    UartRxReadyIsrFor<0>,
+#if THCI_CONFIG_MAX_INSTANCES > 1
+    UartRxReadyIsrFor<1>,
+#endif
+#if THCI_CONFIG_MAX_INSTANCES > 2
+    UartRxReadyIsrFor<2>,
+#endif
+#if THCI_CONFIG_MAX_INSTANCES > 3
+    UartRxReadyIsrFor<3>,
+#endif
+};
+#endif // UART_TRANSPORT
+
+/**
+ * Called to process the data signalled by the transport.
+ *
+ * @param[in] aEvent    The event object that generated the call to this handler.
+ * @param[in] aClosure  A application specific context object associated with the event.
+ */
+static int UartRxDoneEventHandler(nl_event_t *aEvent, void *aClosure)
+{
+    UartInstance &uart = sUart;
+
+    (void)aEvent;
+    (void)aClosure;
+
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventUartRxDone);
+
+    uart.mRxEventPostedToSdkQueue = 0;
+
+    thciTransportProcess();
+
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventUartRxDone);
+
+    if (!uart.mDecodeFailure && 
+        thciTransportIsPending())
+    {
+        // post an event to the sdk queue so that the task will return later to finish 
+        // emptying the fifo.
+        PostRxDoneEventToSdkQueue(uart, kThciTransportContextTask);
+    }
+
+    return 0;
+}
+
+static bool CompareResponse(UartInstance &aUart, uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey)
+{
+    bool retval = false;
+
+    if (aUart.mResponseTransactionId != kDontCareTransactionId) {
+        if (SPINEL_HEADER_GET_TID(aHeader) == aUart.mResponseTransactionId)
+        {
+            retval = true; // when the tid matches and is not the Don't care tid then it is matched.
+
+            // When the TID matches but the command and key do not it indicates operation failure.
+            // aKey is almost certainly SPINEL_PROP_LAST_STATUS in the unmatched case.
+            if (aUart.mResponseCommand == aCommand && aUart.mResponseKey == aKey)
             {
-                sResponseSuccess = true;
+                aUart.mResponseSuccess = true;
             }
         }
     }
-    else if (sResponseCommand == aCommand && sResponseKey == aKey)
+    else if (aUart.mResponseCommand == aCommand && aUart.mResponseKey == aKey)
     {
         retval = true; // when the tid is the Don't care tid then the command and key must match.
-        sResponseSuccess = true;
+        aUart.mResponseSuccess = true;
     }
 
     return retval;
 }
 
-// upon receiving a complete frame from the UART this function will get called.
-static void HandleFrame(void *context, uint8_t *aBuf, uint16_t aBufLength)
+#if THCI_CONFIG_PIPELINED_RESPONSES
+static StashedResponse *FindStashedResponse(UartInstance &aUart, uint8_t aTransactionId)
+{
+    StashedResponse *retval = NULL;
+
+    for (size_t i = 0; i < THCI_CONFIG_PIPELINED_RESPONSES; i++)
+    {
+        if (aUart.mStashedResponses[i].mTransactionId == aTransactionId)
+        {
+            retval = &aUart.mStashedResponses[i];
+            break;
+        }
+    }
+
+    return retval;
+}
+
+// Copies the response to a pipelined request that arrived while no task
+// was waiting for it.  Returns false when the frame is not such a response.
+static bool StashResponse(UartInstance &aUart, uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen)
+{
+    StashedResponse *stash;
+    bool retval = false;
+
+    nlREQUIRE(SPINEL_HEADER_GET_TID(aHeader) != kDontCareTransactionId, done);
+
+    stash = FindStashedResponse(aUart, SPINEL_HEADER_GET_TID(aHeader));
+    nlREQUIRE(stash != NULL && !stash->mReceived, done);
+
+    // A longer response is dropped rather than truncated, and the wait for
+    // it fails; the last byte keeps string payloads terminated.
+    stash->mOverflowed = (aArgLen >= STASHED_RESPONSE_SIZE);
+    stash->mLength = (stash->mOverflowed) ? 0 : aArgLen;
+    memcpy(stash->mBuffer, aArgPtr, stash->mLength);
+    stash->mBuffer[stash->mLength] = '\0';
+
+    stash->mHeader      = aHeader;
+    stash->mCommand     = aCommand;
+    stash->mKey         = aKey;
+    stash->mReceived    = true;
+
+    retval = true;
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_PIPELINED_RESPONSES
+
+static void ProcessFrame(UartInstance &aUart, uint8_t *aBuf, uint16_t aBufLength)
 {
     uint8_t header = 0;
     unsigned int command = 0;
@@ -574,38 +1065,55 @@ static void HandleFrame(void *context, uint8_t *aBuf, uint16_t aBufLength)
     const uint8_t *argPtr = NULL;
     unsigned int argLen = 0;
 
-    sFrameByteCount = 0;
+    aUart.mUartCounters.mRxFrames++;
+
+    if (aBufLength > aUart.mUartCounters.mRxFrameHighWater)
+    {
+        aUart.mUartCounters.mRxFrameHighWater = aBufLength;
+    }
+
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+    thciNcpClockFrameReceived(aBuf, aBufLength);
+#endif
 
     parsedLength = spinel_datatype_unpack(aBuf, aBufLength, "CiiD", &header, &command, &key, &argPtr, &argLen);
-    nlREQUIRE_ACTION(parsedLength == aBufLength, done, NL_LOG_CRIT(lrTHCI, "Failed to parse incoming frame\n"));
+    nlREQUIRE_ACTION(parsedLength == aBufLength, done, NL_LOG_CRIT(lrTHCI, "Failed to parse incoming frame\n"); aUart.mUartCounters.mRxFrameErrors++);
 
-    if (sProvideInternalResponse && CompareResponse(header, command, key))
+    if (aUart.mProvideInternalResponse && CompareResponse(aUart, header, command, key))
     {        
-        sResponseReceived           = true;
-        sResponseBuffer             = argPtr;
-        sResponseLength             = argLen;
+        aUart.mResponseReceived           = true;
+        aUart.mResponseBuffer             = argPtr;
+        aUart.mResponseLength             = argLen;
+        aUart.mReceivedCommand            = command;
+        aUart.mReceivedKey                = key;
 
         // Often when the NCP fails a request it will return a last status frame with the same TID as the request.
         // The status value can provide insight as to why the previous request failed.
-        if (!sResponseSuccess && key == SPINEL_PROP_LAST_STATUS)
+        if (!aUart.mResponseSuccess && key == SPINEL_PROP_LAST_STATUS)
         {
             HandleLastStatusUpdate(argPtr, argLen);
         }
     }
+#if THCI_CONFIG_PIPELINED_RESPONSES
+    else if (StashResponse(aUart, header, command, key, argPtr, argLen))
+    {
+        // held for the pipelined request with the same tid.
+    }
+#endif
     else
     {
         if (key == SPINEL_PROP_STREAM_NET || key == SPINEL_PROP_STREAM_NET_INSECURE)
         {
-            if (sDataFrameCB)
+            if (aUart.mDataFrameCB)
             {
-                sDataFrameCB(command, key, argPtr, argLen);
+                aUart.mDataFrameCB(header, command, key, argPtr, argLen);
             }
         }
         else
         {
-            if (sControlFrameCB)
+            if (aUart.mControlFrameCB)
             {
-                sControlFrameCB(header, command, key, argPtr, argLen);
+                aUart.mControlFrameCB(header, command, key, argPtr, argLen);
             }
         }
     }
@@ -614,15 +1122,82 @@ static void HandleFrame(void *context, uint8_t *aBuf, uint16_t aBufLength)
     return;
 }
 
+// upon receiving a complete frame from the transport this function will get called.
+// Returns false once the response waited for is received, which the transport
+// must not overwrite.
+static bool HandleFrame(uint8_t aInstanceIndex, uint8_t *aBuf, uint16_t aBufLength)
+{
+    UartInstance &uart = sUartInstances[aInstanceIndex];
+
+#if THCI_CONFIG_FAULT_INJECTION
+    if (THCI_FAULT_ACTIVE(kThciFaultStreamFrameRx))
+    {
+        uint16_t delay = 0;
+        const uint8_t verdict = thciFaultFrame(kThciFaultStreamFrameRx, aBuf, &aBufLength, &delay);
+
+        if (verdict & THCI_FAULT_VERDICT_DROP)
+        {
+            return true;
+        }
+
+        if (verdict & THCI_FAULT_VERDICT_DELAY)
+        {
+            DelayMs(delay);
+        }
+
+        if (verdict & THCI_FAULT_VERDICT_DUPLICATE)
+        {
+            ProcessFrame(uart, aBuf, aBufLength);
+        }
+    }
+#endif
+
+    ProcessFrame(uart, aBuf, aBufLength);
+
+    return !uart.mResponseReceived;
+}
+
+// In the event of a transport error during receive this function will get called.
+static void HandleError(uint8_t aInstanceIndex, otError aError)
+{
+    UartInstance &uart = sUartInstances[aInstanceIndex];
+
+    uart.mResponseSuccess        = false;
+    uart.mResponseReceived       = true;
+    uart.mDecodeFailure          = true;
+
+    uart.mUartCounters.mRxDecodeErrors++;
+
+    NL_LOG_CRIT(lrTHCI, "ERROR: thci_module_ncp_uart.cpp::HandleError() %d.\n", aError);
+
+    thciInitiateNCPRecovery();
+}
+
+static const thci_transport_callbacks_t sTransportCallbacks =
+{
+    HandleFrame,
+    HandleError,
+    HandleRxReady
+};
+
+#if UART_TRANSPORT
+// upon receiving a complete frame from the UART this function will get called.
+static void HdlcHandleFrame(void *aContext, uint8_t *aBuf, uint16_t aBufLength)
+{
+    UartInstance &uart = *static_cast<UartInstance *>(aContext);
+
+    uart.mFrameByteCount = 0;
+    uart.mRxPaused = !uart.mTransport->mFrame(InstanceIndex(uart), aBuf, aBufLength);
+}
+
 // In the event of a frame decoder error during receive this function will get called.
-static void HandleError(void *aContext, otError aError, uint8_t *aFrame, uint16_t aFrameLength)
+static void HdlcHandleError(void *aContext, otError aError, uint8_t *aFrame, uint16_t aFrameLength)
 {
-    sResponseSuccess        = false;
-    sResponseReceived       = true;
-    sDecodeFailure          = true;
-    sFrameByteCount         = 0;
+    UartInstance &uart = *static_cast<UartInstance *>(aContext);
+
+    uart.mFrameByteCount = 0;
 
-    NL_LOG_CRIT(lrTHCI, "ERROR: thci_module_ncp_uart.cpp::HandleError() %d %d.\n", aError, aFrameLength);
+    NL_LOG_CRIT(lrTHCI, "%s: %d %d.\n", __FUNCTION__, aError, aFrameLength);
 #if 0 // useful frame debug code.
     if (aFrame)
     {
@@ -646,17 +1221,20 @@ static void HandleError(void *aContext, otError aError, uint8_t *aFrame, uint16_
             NL_LOG_CRIT(lrTHCI, "frame bytes: %02x\n", aFrame[i]);
         }
     }
+#else
+    (void)aFrame;
 #endif
 
-    thciInitiateNCPRecovery();
+    uart.mTransport->mError(InstanceIndex(uart), aError);
 }
 
 static void UartEnable(void)
 {
+    const uint8_t index = THCI_INSTANCE_INDEX();
     const uart_callback_config_t rxCBConfig =
     {
         UART_RX_CALLBACK,
-        UartRxReadyIsr,
+        sUartRxReadyIsrs[index],
         NULL
     };
     const nl_console_config_t uartCfg = {
@@ -665,16 +1243,16 @@ static void UartEnable(void)
     };
     const bool force = true;
 
-    sDecodeFailure = false;
-    sRxUartFifoHead = sRxUartFifoTail = 0;
-    sFrameByteCount = 0;
+    sUart.mDecodeFailure = false;
+    sUart.mRxUartFifoHead = sUart.mRxUartFifoTail = 0;
+    sUart.mFrameByteCount = 0;
 
-    sUartConsole = NL_PRODUCT_CONSOLE(6LOWPAN);
+    sUart.mUartConsole = THCI_INSTANCE_CONSOLE(index);
 
     // Install ISR callback
-    uart_install_callback(THCI_UART_ID, true, &rxCBConfig);    
+    uart_install_callback(THCI_INSTANCE_UART_ID(index), true, &rxCBConfig);    
     // Enable the UART
-    nl_console_enable(sUartConsole, true, &uartCfg);
+    nl_console_enable(sUart.mUartConsole, true, &uartCfg);
 }
 
 static void UartDisable(void)
@@ -686,52 +1264,156 @@ static void UartDisable(void)
         NULL
     };
 
-    if (sUartConsole)
+    if (sUart.mUartConsole)
     {
         // Disable the UART
-        nl_console_enable(sUartConsole, false, NULL);
+        nl_console_enable(sUart.mUartConsole, false, NULL);
     
         // Remove ISR callback
-        uart_install_callback(THCI_UART_ID, false, &rxCBConfig);
+        uart_install_callback(THCI_INSTANCE_UART_ID(THCI_INSTANCE_INDEX()), false, &rxCBConfig);
     }
 }
 
-otError thciUartEnable(thciUartDataFrameCallback_t aDataCB, thciUartControlFrameCallback_t aControlCB)
+otError thciTransportEnable(const thci_transport_callbacks_t *aCallbacks)
 {
+    const bool force = true;
     otError retval = OT_ERROR_NONE;
+#if THCI_CONFIG_ARENA
+    const thci_arena_buffers_t *buffers = thciArenaGetBuffers();
+    const thci_arena_profile_t *profile = thciArenaGetProfile();
+
+    nlREQUIRE_ACTION(buffers != NULL, done, retval = OT_ERROR_INVALID_STATE);
+
+    sUart.mRxUartFifo = buffers->mRxFifo;
+    sUart.mRxUartFifoSize = profile->mRxFifoSize;
+    sUart.mRxBuffer = buffers->mRxFrame;
+    sUart.mRxBufferSize = profile->mRxFrameSize;
+
+    sUart.mTxUartFifo = buffers->mTxFrames;
+#endif
+
+    sUart.mTransport = aCallbacks;
+    sUart.mFrameDecoder = new (&sUart.mFrameDecoderBuffer) ot::Hdlc::Decoder(sUart.mRxBuffer, RX_BUFFER_SIZE(sUart), HdlcHandleFrame, HdlcHandleError, &sUart);
+    sUart.mRxWakePending = false;
+    sUart.mRxAccepting = true;
+    TxQueueReset(sUart);
+
+    UartEnable();
+    RxISREnable(sUart, force);
+
+#if THCI_CONFIG_ARENA
+ done:
+#endif
+    return retval;
+}
+
+void thciTransportSleepEnable(void)
+{
     const bool force = true;
 
-    sFrameDecoder = new (&sFrameDecoderBuffer) ot::Hdlc::Decoder(sRxBuffer, sizeof(sRxBuffer), HandleFrame, HandleError, NULL),
+    sUart.mRxAccepting = true;
 
     UartEnable();
+    RxISREnable(sUart, force);
+}
+
+void thciTransportDisable(void)
+{
+    UartDisable();
+
+    sUart.mRxUartFifoHead = sUart.mRxUartFifoTail = 0;
+    sUart.mRxWakePending = false;
+    TxQueueReset(sUart);
+}
+
+bool thciTransportSleepDisable(void)
+{
+    bool retval = false;
+    const bool force = true;
+
+    RxISRDisable(sUart);
+
+    if (IsRxFifoEmpty(sUart) && sUart.mFrameByteCount == 0 && TxQueued(sUart) == 0)
+    {
+        UartDisable();
+        retval = true;
+    }
+    else
+    {
+        RxISREnable(sUart, !force);
+    }
+
+    return retval;
+}
+
+otError thciTransportSendFrame(const uint8_t *aFrame, uint16_t aLength)
+{
+    return UartSendFrame(sUart, aFrame, aLength);
+}
+
+void thciTransportProcess(void)
+{
+    UartInstance &uart = sUart;
+
+    UartTxPump(uart);
+    UartRxFifoProcess(uart);
+}
+
+bool thciTransportIsPending(void)
+{
+    // Bytes that do not end a frame wait for the rest of it.  The UART
+    // driver is refilled by the task.
+    const UartInstance &uart = sUart;
+
+    return uart.mRxWakePending || (TxQueued(uart) > 0);
+}
+
+uint16_t thciTransportGetMaxRxFrameSize(void)
+{
+    return RX_BUFFER_SIZE(sUart) - HDLC_FCS_SIZE;
+}
+#endif // UART_TRANSPORT
+
+otError thciUartEnable(thciUartDataFrameCallback_t aDataCB, thciUartControlFrameCallback_t aControlCB)
+{
+    otError retval = OT_ERROR_NONE;
+
+    sUart.mDecodeFailure = false;
+
+#if THCI_CONFIG_ARENA
+    nlREQUIRE_ACTION(thciArenaGetBuffers() != NULL, done, retval = OT_ERROR_INVALID_STATE);
+
+    sUart.mTxBuffer = thciArenaGetBuffers()->mTxFrame;
+    sUart.mTxBufferSize = thciArenaGetProfile()->mTxFrameSize;
+#endif
 
     // initialize the callbacks for data and control frames. 
     // For AUPD these should be NULL.
-    sDataFrameCB    = aDataCB;
-    sControlFrameCB = aControlCB;
+    sUart.mDataFrameCB    = aDataCB;
+    sUart.mControlFrameCB = aControlCB;
 
-    if (sDataFrameCB || sControlFrameCB)
+    if (sUart.mDataFrameCB || sUart.mControlFrameCB)
     {
         // A QueueHandle is created only if a data or control callback has been
         // provided.
-        if (sResponseQueueHandle == NULL)
+        if (sUart.mResponseQueueHandle == NULL)
         {
-            sResponseQueueHandle = nl_eventqueue_create(&sResponseQueue, sizeof(sResponseQueue));
-            nlREQUIRE_ACTION(sResponseQueueHandle != NULL, done, retval = OT_ERROR_FAILED);
+            sUart.mResponseQueueHandle = nl_eventqueue_create(&sUart.mResponseQueue, sizeof(sUart.mResponseQueue));
+            nlREQUIRE_ACTION(sUart.mResponseQueueHandle != NULL, done, retval = OT_ERROR_FAILED);
 
-            nl_eventqueue_disable_event_counting(sResponseQueueHandle);
+            nl_eventqueue_disable_event_counting(sUart.mResponseQueueHandle);
         }
 
         // Set up Time function
-        sGetMillisecondTimeFunc = GetMillisecondTime;
+        sUart.mGetMillisecondTimeFunc = GetMillisecondTime;
     }
     else
     {
         // Configure for AUPD operation and avoid calling GetMillisecondTime
-        sGetMillisecondTimeFunc = GetNoTime;
+        sUart.mGetMillisecondTimeFunc = GetNoTime;
     }
 
-    RxISREnable(force);
+    retval = thciTransportEnable(&sTransportCallbacks);
 
  done:
     return retval;
@@ -739,144 +1421,255 @@ otError thciUartEnable(thciUartDataFrameCallback_t aDataCB, thciUartControlFrame
 
 void thciUartSleepEnable(void)
 {
-    const bool force = true;
+    sUart.mDecodeFailure = false;
 
-    UartEnable();
-    RxISREnable(force);
+    thciTransportSleepEnable();
 }
 
-void thciUartDisable(void)
+uint16_t thciUartGetMaxRxFrameSize(void)
 {
-    UartDisable();
+    return thciTransportGetMaxRxFrameSize();
+}
 
-    sDecodeFailure = false;
+void thciUartDisable(void)
+{
+    thciTransportDisable();
 
-    sRxUartFifoHead = sRxUartFifoTail = 0;
+    sUart.mDecodeFailure = false;
 }
 
 bool thciUartSleepDisable(void)
 {
-    bool retval = false;
-    const bool force = true;
-
-    RxISRDisable();
-
-    if (IsRxFifoEmpty() && sFrameByteCount == 0)
-    {
-        UartDisable();
-        retval = true;
-    }
-    else
-    {
-        RxISREnable(!force);
-    }
-
-    return retval;
+    return thciTransportSleepDisable();
 }
 
-otError thciUartFrameSend(uint8_t aTransactionID, uint32_t aCommand, spinel_prop_key_t aKey, const char *aFormat, ...)
+static otError FrameSend(uint8_t aIid, uint8_t aTransactionID, uint32_t aCommand, spinel_prop_key_t aKey, const char *aFormat, va_list aArgs)
 {
+    UartInstance &uart = sUart;
     spinel_ssize_t packedLen;
-    va_list args;
     uint16_t txBufferLen;
     otError error = OT_ERROR_NONE;
 
     // the transaction ID resides at the bit 0 - 3 so the other two fields can simply be OR'd in to form the header.
-    aTransactionID |= SPINEL_HEADER_FLAG | SPINEL_HEADER_IID_0;
+    aTransactionID |= SPINEL_HEADER_FLAG | ((aIid << SPINEL_HEADER_IID_SHIFT) & SPINEL_HEADER_IID_MASK);
 
     // starting a new frame
     txBufferLen = 0;
 
     // pack the common frame header {header, command, key}
-    packedLen = spinel_datatype_pack(&sTxBuffer[txBufferLen], sizeof(sTxBuffer) - txBufferLen, "Cii", aTransactionID, aCommand, aKey);
+    packedLen = spinel_datatype_pack(&uart.mTxBuffer[txBufferLen], TX_BUFFER_SIZE(uart) - txBufferLen, "Cii", aTransactionID, aCommand, aKey);
     nlREQUIRE_ACTION(packedLen != -1, done, NL_LOG_CRIT(lrTHCI, "ERROR: %s failed spinel_datatype_pack\n", __FUNCTION__); error = OT_ERROR_PARSE);
 
     txBufferLen += packedLen;
     
     if (aFormat)
     {
-        va_start(args, aFormat);
-        packedLen = spinel_datatype_vpack(&sTxBuffer[txBufferLen], sizeof(sTxBuffer) - txBufferLen, aFormat, args);
-        va_end(args);
+        packedLen = spinel_datatype_vpack(&uart.mTxBuffer[txBufferLen], TX_BUFFER_SIZE(uart) - txBufferLen, aFormat, aArgs);
 
         nlREQUIRE_ACTION(packedLen != -1, done, NL_LOG_CRIT(lrTHCI, "ERROR: %s failed spinel_datatype_vpack\n", __FUNCTION__); error = OT_ERROR_PARSE);
 
         txBufferLen += packedLen;
     }
 
-    error = UartSendFrame(sTxBuffer, txBufferLen);
+    uart.mFrameSendTime = uart.mGetMillisecondTimeFunc();
+    uart.mFrameSendCommand = aCommand;
+
+#if THCI_CONFIG_FAULT_INJECTION
+    if (THCI_FAULT_ACTIVE(kThciFaultStreamFrameTx))
+    {
+        error = SendFaultyFrame(uart.mTxBuffer, txBufferLen);
+    }
+    else
+#endif
+    {
+        error = thciTransportSendFrame(uart.mTxBuffer, txBufferLen);
+    }
+
+    if (error == OT_ERROR_NONE)
+    {
+        uart.mUartCounters.mTxFrames++;
+        uart.mUartCounters.mTxBytes += txBufferLen;
+
+        if (txBufferLen > uart.mUartCounters.mTxFrameHighWater)
+        {
+            uart.mUartCounters.mTxFrameHighWater = txBufferLen;
+        }
+    }
+    else
+    {
+        uart.mUartCounters.mTxErrors++;
+    }
 
  done:
     return error;
 }
 
+otError thciUartFrameSend(uint8_t aTransactionID, uint32_t aCommand, spinel_prop_key_t aKey, const char *aFormat, ...)
+{
+    otError error;
+    va_list args;
+
+    va_start(args, aFormat);
+    error = FrameSend(0, aTransactionID, aCommand, aKey, aFormat, args);
+    va_end(args);
+
+    return error;
+}
+
+otError thciUartFrameSendOnIid(uint8_t aIid, uint8_t aTransactionID, uint32_t aCommand, spinel_prop_key_t aKey, const char *aFormat, ...)
+{
+    otError error;
+    va_list args;
+
+    va_start(args, aFormat);
+    error = FrameSend(aIid, aTransactionID, aCommand, aKey, aFormat, args);
+    va_end(args);
+
+    return error;
+}
+
+/**
+ * Accounts for a completed Spinel request/response exchange.  In AUPD no
+ * time is available and all latencies are recorded as 0.
+ */
+static void RecordTransaction(UartInstance &aUart, otError aResult, nl_time_ms_t aSendTime, uint32_t aCommand)
+{
+    const uint32_t latency = aUart.mGetMillisecondTimeFunc() - aSendTime;
+
+    aUart.mSpinelStats.mTransactions++;
+
+    if (aResult == OT_ERROR_NONE)
+    {
+        if (aCommand == SPINEL_CMD_PROP_VALUE_GET)
+        {
+            thciHistogramAdd(&aUart.mSpinelStats.mGetLatency, latency);
+        }
+        else
+        {
+            thciHistogramAdd(&aUart.mSpinelStats.mSetLatency, latency);
+        }
+    }
+    else
+    {
+        aUart.mSpinelStats.mFailures++;
+    }
+}
+
 static otError thciUartWaitForResponseInternal(bool aAvoidNCPRecovery, uint8_t aTransactionID, uint8_t aCommand, spinel_prop_key_t aKey, const uint8_t **aBuffer, size_t *aLength)
 {
+    UartInstance &uart = sUart;
     const uint32_t timeoutMsec = MAX_NCP_APP_RESPONSE_TIME_MSEC;
     nl_event_t *theEvent = NULL;
     otError retval = OT_ERROR_NO_FRAME_RECEIVED;
 
-    nlREQUIRE(!sDecodeFailure, done);
+    nlREQUIRE(!uart.mDecodeFailure, done);
+
+#if THCI_CONFIG_PIPELINED_RESPONSES
+    {
+        StashedResponse *stash = FindStashedResponse(uart, aTransactionID);
+
+        if (stash != NULL && stash->mReceived)
+        {
+            uart.mResponseTransactionId  = aTransactionID;
+            uart.mResponseCommand        = aCommand;
+            uart.mResponseKey            = aKey;
+            uart.mResponseSuccess        = false;
+
+            (void)CompareResponse(uart, stash->mHeader, stash->mCommand, stash->mKey);
+
+            if (!uart.mResponseSuccess && stash->mKey == SPINEL_PROP_LAST_STATUS)
+            {
+                HandleLastStatusUpdate(stash->mBuffer, stash->mLength);
+            }
+
+            *aBuffer    = stash->mBuffer;
+            *aLength    = stash->mLength;
+            retval      = (uart.mResponseSuccess) ? OT_ERROR_NONE : OT_ERROR_FAILED;
+
+            if (stash->mOverflowed)
+            {
+                retval = OT_ERROR_NO_BUFS;
+            }
+
+            uart.mReceivedCommand  = stash->mCommand;
+            uart.mReceivedKey      = stash->mKey;
+
+            RecordTransaction(uart, retval, stash->mSendTime, stash->mSendCommand);
+
+            // The slot is released but its buffer stays valid until the
+            // next request is expected.
+            stash->mTransactionId = 0;
+            goto done;
+        }
+    }
+#endif
 
     // register what is being looked for.
-    sResponseTransactionId  = aTransactionID;
-    sResponseCommand        = aCommand;
-    sResponseKey            = aKey;
-    sResponseSuccess        = false;
-    sResponseReceived       = false;
+    uart.mResponseTransactionId  = aTransactionID;
+    uart.mResponseCommand        = aCommand;
+    uart.mResponseKey            = aKey;
+    uart.mResponseSuccess        = false;
+    uart.mResponseReceived       = false;
 
     // Drive the rx pipe until the desired response is received or a timeout expires.
-    sProvideInternalResponse = true;
+    uart.mProvideInternalResponse = true;
 
-    if (sResponseQueueHandle)
+    if (uart.mResponseQueueHandle)
     {
         // Due to the way events can be posted
-        // to the SDKQueue or the sResponseQueueHandle, it is necessary to look at whether such an 
+        // to the SDKQueue or the mResponseQueueHandle, it is necessary to look at whether such an 
         // event has already been posted prior to blocking on the queue waiting for the next
         // event.  If the event was posted to the other SDKQueue while the task blocks on the 
-        // sResponseQueueHandle then the task will never unblock. To solve this the RxFifo
-        // is examined by the task and if it is not empty the task shall call UartRxFifoProcess
+        // mResponseQueueHandle then the task will never unblock. To solve this the transport
+        // is examined by the task and if it has data pending the task shall call thciTransportProcess
         // without getting the event. 
         // NOTE: This solution works provided that the SDKQueue and the 
-        //       sResponseQueueHandle are managed by the same task.
-        while (NULL != (theEvent = nl_eventqueue_get_event_with_timeout(sResponseQueueHandle, ((IsRxFifoEmpty()) ? timeoutMsec : 0))) || 
-               !IsRxFifoEmpty())
+        //       mResponseQueueHandle are managed by the same task.
+        while (NULL != (theEvent = nl_eventqueue_get_event_with_timeout(uart.mResponseQueueHandle, ((!thciTransportIsPending()) ? timeoutMsec : 0))) || 
+               thciTransportIsPending())
         {
             if (theEvent)
             {
-                sRxEventPostedToResponseQueue = 0;
+                THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventUartRxResponse);
+                uart.mRxEventPostedToResponseQueue = 0;
             }
 
-            UartRxFifoProcess();
+            thciTransportProcess();
+
+            if (theEvent)
+            {
+                THCI_EVENT_STATS_DISPATCH_END(kThciEventUartRxResponse);
+            }
 
-            if (sResponseReceived)
+            if (uart.mResponseReceived)
             {
-                *aBuffer    = sResponseBuffer;
-                *aLength    = sResponseLength;
-                retval      = (sResponseSuccess) ? OT_ERROR_NONE : OT_ERROR_FAILED;
+                *aBuffer    = uart.mResponseBuffer;
+                *aLength    = uart.mResponseLength;
+                retval      = (uart.mResponseSuccess) ? OT_ERROR_NONE : OT_ERROR_FAILED;
                 break;
             }
         }
 
         // Pull any event that might have made it into the internal Queue, after exiting the loop above,
         // and push it onto the sdkQueue.
-        if (NULL != (theEvent = nl_eventqueue_get_event_with_timeout(sResponseQueueHandle, 0)))
+        if (NULL != (theEvent = nl_eventqueue_get_event_with_timeout(uart.mResponseQueueHandle, 0)))
         {
-            const bool fromISR = false;
             // The order of operations is important as there is an ISR that read/writes these variables.
             // 1. Move the event to the SDK queue.
-            // 2. Clear sProvideInternalResponse so that the ISR will no longer try to post to the response queue.
-            // 3. Clear sRxEventPostedToResponseQueue to indicate that the response queue is empty.
-            PostRxDoneEventToSdkQueue(fromISR);
+            // 2. Clear mProvideInternalResponse so that the ISR will no longer try to post to the response queue.
+            // 3. Clear mRxEventPostedToResponseQueue to indicate that the response queue is empty.
+            MoveRxDoneEventToSdkQueue(uart);
 
-            sProvideInternalResponse = false;
-            sRxEventPostedToResponseQueue = 0;
+            uart.mProvideInternalResponse = false;
+            uart.mRxEventPostedToResponseQueue = 0;
         }
 
-        if (!sResponseReceived)
+        if (!uart.mResponseReceived)
         {
             NL_LOG_CRIT(lrTHCI, "Wait for NCP response timed out. %d\n", timeoutMsec);
 
+            uart.mSpinelStats.mTimeouts++;
+
             if (!aAvoidNCPRecovery)
             {
                 thciInitiateNCPRecovery();
@@ -885,34 +1678,67 @@ static otError thciUartWaitForResponseInternal(bool aAvoidNCPRecovery, uint8_t a
     }
     else
     {
-        // This logic is used in AUPD which lacks support for nler queues.
-        const uint32_t timeoutFraction = 300;
-        const uint32_t numFractions = timeoutMsec / timeoutFraction + 1;
-        uint32_t i;
+        // This logic is used in AUPD which lacks support for nler queues
+        // and for a clock: the delays are added up against the timeout.
+        const uint32_t timeoutUsec = 1000 * timeoutMsec;
+        uint32_t delayUsec = NCP_RESPONSE_POLL_MIN_USEC;
+        uint32_t waitedUsec = 0;
 
-        for (i = 0 ; i < numFractions ; i++)
+        while (true)
         {
-            if (!IsRxFifoEmpty())
+            // Set by the RX ISR at the end of a frame.
+            if (thciTransportIsPending())
             {
-                UartRxFifoProcess();
+                thciTransportProcess();
+                delayUsec = NCP_RESPONSE_POLL_MIN_USEC;
+                waitedUsec += NCP_RESPONSE_POLL_PROCESS_USEC;
+            }
+
+            if (uart.mResponseReceived)
+            {
+                *aBuffer    = uart.mResponseBuffer;
+                *aLength    = uart.mResponseLength;
+                retval      = (uart.mResponseSuccess) ? OT_ERROR_NONE : OT_ERROR_FAILED;
+                break;
             }
 
-            if (sResponseReceived)
+            if (waitedUsec >= timeoutUsec)
             {
-                *aBuffer    = sResponseBuffer;
-                *aLength    = sResponseLength;
-                retval      = (sResponseSuccess) ? OT_ERROR_NONE : OT_ERROR_FAILED;
                 break;
             }
 
-            DelayMs(timeoutFraction);
+            NL_CPU_spinWaitUs(delayUsec);
+            waitedUsec += delayUsec;
+
+            if (delayUsec < NCP_RESPONSE_POLL_MAX_USEC)
+            {
+                delayUsec = (2 * delayUsec < NCP_RESPONSE_POLL_MAX_USEC) ? 2 * delayUsec : NCP_RESPONSE_POLL_MAX_USEC;
+            }
         }
     }
 
+#if THCI_CONFIG_PIPELINED_RESPONSES
+    {
+        StashedResponse *stash = FindStashedResponse(uart, aTransactionID);
+
+        if (stash != NULL)
+        {
+            RecordTransaction(uart, retval, stash->mSendTime, stash->mSendCommand);
+            stash->mTransactionId = 0;
+        }
+        else
+        {
+            RecordTransaction(uart, retval, uart.mFrameSendTime, uart.mFrameSendCommand);
+        }
+    }
+#else
+    RecordTransaction(uart, retval, uart.mFrameSendTime, uart.mFrameSendCommand);
+#endif
+
  done:
     // clear relevant State before exit
-    sResponseReceived = false;
-    sProvideInternalResponse = false;
+    uart.mResponseReceived = false;
+    uart.mProvideInternalResponse = false;
 
     return retval;
 }
@@ -931,4 +1757,61 @@ otError thciUartWaitForResponseIgnoreTimeout(uint8_t aTransactionID, uint8_t aCo
     return thciUartWaitForResponseInternal(avoidNCPRecovery, aTransactionID, aCommand, aKey, aBuffer, aLength);
 }
 
+void thciUartGetResponseType(unsigned int *aCommand, spinel_prop_key_t *aKey)
+{
+    *aCommand = sUart.mReceivedCommand;
+    *aKey = sUart.mReceivedKey;
+}
+
+#if THCI_CONFIG_PIPELINED_RESPONSES
+otError thciUartExpectResponse(uint8_t aTransactionID)
+{
+    UartInstance &uart = sUart;
+    StashedResponse *stash;
+    otError retval = OT_ERROR_NONE;
+
+    nlREQUIRE_ACTION(aTransactionID != kDontCareTransactionId, done, retval = OT_ERROR_INVALID_ARGS);
+    nlREQUIRE_ACTION(FindStashedResponse(uart, aTransactionID) == NULL, done, retval = OT_ERROR_ALREADY);
+
+    stash = FindStashedResponse(uart, 0);
+    nlREQUIRE_ACTION(stash != NULL, done, retval = OT_ERROR_NO_BUFS);
+
+    stash->mTransactionId   = aTransactionID;
+    stash->mReceived        = false;
+    stash->mOverflowed      = false;
+    stash->mSendTime        = uart.mFrameSendTime;
+    stash->mSendCommand     = uart.mFrameSendCommand;
+
+ done:
+    return retval;
+}
+
+void thciUartCancelExpectedResponses(void)
+{
+    memset(sUart.mStashedResponses, 0, sizeof(sUart.mStashedResponses));
+}
+#endif // THCI_CONFIG_PIPELINED_RESPONSES
+
+void thciGetUartCounters(thci_uart_counters_t *aCounters)
+{
+    memcpy(aCounters, &sUart.mUartCounters, sizeof(*aCounters));
+#if THCI_CONFIG_POSIX_TTY
+    thciTtyGetCounters(aCounters);
+#endif
+}
+
+void thciGetSpinelStats(thci_spinel_stats_t *aStats)
+{
+    memcpy(aStats, &sUart.mSpinelStats, sizeof(*aStats));
+}
+
+void thciResetUartCounters(void)
+{
+    memset(&sUart.mUartCounters, 0, sizeof(sUart.mUartCounters));
+    memset(&sUart.mSpinelStats, 0, sizeof(sUart.mSpinelStats));
+#if THCI_CONFIG_POSIX_TTY
+    thciTtyResetCounters();
+#endif
+}
+
 #endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP
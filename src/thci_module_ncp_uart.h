@@ -37,16 +37,30 @@ extern "C"
 {
 #endif
 
-typedef void (*thciUartDataFrameCallback_t)(unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen);
+typedef void (*thciUartDataFrameCallback_t)(uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen);
 typedef void (*thciUartControlFrameCallback_t)(uint8_t aHeader, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aArgPtr, unsigned int aArgLen);
 
 otError thciUartEnable(thciUartDataFrameCallback_t aDataCB, thciUartControlFrameCallback_t aControlCB);
 void    thciUartDisable(void);
 void    thciUartSleepEnable(void);
+uint16_t thciUartGetMaxRxFrameSize(void);
 bool    thciUartSleepDisable(void);
 otError thciUartFrameSend(uint8_t aTransactionID, uint32_t aCommand, spinel_prop_key_t aKey, const char *aFormat, ...);
+// Same as thciUartFrameSend, on Spinel interface aIid instead of 0.
+otError thciUartFrameSendOnIid(uint8_t aIid, uint8_t aTransactionID, uint32_t aCommand, spinel_prop_key_t aKey, const char *aFormat, ...);
 otError thciUartWaitForResponse(uint8_t aTransactionID, uint8_t aCommand, spinel_prop_key_t aKey, const uint8_t **aBuffer, size_t *aLength);
 otError thciUartWaitForResponseIgnoreTimeout(uint8_t aTransactionID, uint8_t aCommand, spinel_prop_key_t aKey, const uint8_t **aBuffer, size_t *aLength);
+// The command and key of the last response returned by thciUartWaitForResponse,
+// which differ from those waited for when it returned OT_ERROR_FAILED.
+void    thciUartGetResponseType(unsigned int *aCommand, spinel_prop_key_t *aKey);
+
+#if THCI_CONFIG_PIPELINED_RESPONSES
+// Call right after thciUartFrameSend so that the response is held if it
+// arrives before thciUartWaitForResponse is called for aTransactionID.  A held
+// response too long to copy makes that wait return OT_ERROR_NO_BUFS.
+otError thciUartExpectResponse(uint8_t aTransactionID);
+void    thciUartCancelExpectedResponses(void);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,121 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/*
+ *    @file
+ *      This file declares the vendor Spinel properties used by THCI that
+ *      may not yet be present in the OpenThread spinel-vendor.h in use.
+ *      Definitions from spinel-vendor.h always take precedence.
+ *
+ */
+
+#ifndef __THCI_MODULE_NCP_VENDOR_H_INCLUDED__
+#define __THCI_MODULE_NCP_VENDOR_H_INCLUDED__
+
+#include <openthread/spinel.h>
+
+#if THCI_CONFIG_SPINEL_VENDOR_SUPPORT
+#include <openthread/spinel-vendor.h>
+#endif
+
+/**
+ * NCP free running millisecond clock.
+ *
+ * Get only.  Format: `L`, the NCP time in msec sampled while the NCP
+ * builds the response.
+ */
+#ifndef SPINEL_PROP_VENDOR_NEST_NCP_TIMESTAMP
+#define SPINEL_PROP_VENDOR_NEST_NCP_TIMESTAMP   (SPINEL_PROP_VENDOR__BEGIN + 0x80)
+#endif
+
+/**
+ * RF packet error rate test sequence.
+ *
+ * Set: `A(t(CCcSCSL))`, the steps to run, each {mode, channel, power,
+ * frame count, frame length, interval msec, rx duration msec}.  An empty
+ * array stops the running sequence.
+ *
+ * Inserted (unsolicited), once per completed step: `SCCcSLLLLdd`, {step
+ * index, mode, channel, power, frame count, frames sent, frames received,
+ * frame errors, duration msec, LQI histogram, RSSI histogram}, each
+ * histogram being an array of `S` bucket counts.
+ *
+ * Is (unsolicited), when the sequence ends: `S`, the number of steps run.
+ */
+#ifndef SPINEL_PROP_VENDOR_NEST_RF_TEST
+#define SPINEL_PROP_VENDOR_NEST_RF_TEST         (SPINEL_PROP_VENDOR__BEGIN + 0x81)
+#endif
+
+/**
+ * Limits of the NCP build, which THCI otherwise assumes.
+ *
+ * Get only.  Format: `SCCCCA(L)`, {largest Spinel frame the NCP takes,
+ * unicast address table size, multicast address table size, child table
+ * size, neighbor table size, UART baud rates the NCP supports}.
+ */
+#ifndef SPINEL_PROP_VENDOR_NEST_NCP_LIMITS
+#define SPINEL_PROP_VENDOR_NEST_NCP_LIMITS      (SPINEL_PROP_VENDOR__BEGIN + 0x82)
+#endif
+
+/**
+ * A page of a table property, for tables longer than a frame.
+ *
+ * Vendor get, with `iSS`: {table property, index of the first entry,
+ * most bytes of entries to return}.  Is: `iSSS` {table property, index
+ * of the first entry, entries in this page, entries in the table}
+ * followed by the whole entries of the page, encoded as in the table
+ * property.  For data properties, such as the network data, entries are
+ * bytes.
+ */
+#ifndef SPINEL_PROP_VENDOR_NEST_TABLE_PAGE
+#define SPINEL_PROP_VENDOR_NEST_TABLE_PAGE      (SPINEL_PROP_VENDOR__BEGIN + 0x83)
+#endif
+
+/**
+ * Listed in SPINEL_PROP_CAPS by an NCP that supports
+ * SPINEL_PROP_VENDOR_NEST_TABLE_PAGE.
+ */
+#ifndef SPINEL_CAP_VENDOR_NEST_TABLE_PAGE
+#define SPINEL_CAP_VENDOR_NEST_TABLE_PAGE       (SPINEL_CAP_VENDOR__BEGIN + 0x01)
+#endif
+
+/**
+ * Listed in SPINEL_PROP_CAPS by an NCP that supports
+ * SPINEL_PROP_VENDOR_NEST_NCP_TIMESTAMP.
+ */
+#ifndef SPINEL_CAP_VENDOR_NEST_NCP_TIMESTAMP
+#define SPINEL_CAP_VENDOR_NEST_NCP_TIMESTAMP    (SPINEL_CAP_VENDOR__BEGIN + 0x02)
+#endif
+
+/**
+ * Listed in SPINEL_PROP_CAPS by an NCP that supports
+ * SPINEL_PROP_VENDOR_NEST_RF_TEST.
+ */
+#ifndef SPINEL_CAP_VENDOR_NEST_RF_TEST
+#define SPINEL_CAP_VENDOR_NEST_RF_TEST          (SPINEL_CAP_VENDOR__BEGIN + 0x03)
+#endif
+
+/**
+ * Listed in SPINEL_PROP_CAPS by an NCP that carries the legacy netif on its
+ * own Spinel interface id, as THCI_CONFIG_SPINEL_IID_MUX expects.
+ */
+#ifndef SPINEL_CAP_VENDOR_NEST_IID_MUX
+#define SPINEL_CAP_VENDOR_NEST_IID_MUX          (SPINEL_CAP_VENDOR__BEGIN + 0x04)
+#endif
+
+#endif // __THCI_MODULE_NCP_VENDOR_H_INCLUDED__
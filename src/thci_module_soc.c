@@ -48,6 +48,9 @@
 #include <thci.h>
 #include <thci_module.h>
 #include <thci_module_soc.h>
+#include <thci_deferred_log.h>
+#include <thci_stats.h>
+#include <thci_fault.h>
 
 /* nlopenthread platform includes */
 #include <nlopenthread.h>
@@ -96,8 +99,6 @@ static const nl_event_t sOutgoingIPPacketEvent =
     NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), OutgoingIPPacketEventHandler, NULL)
 };
 
-extern thci_sdk_context_t gTHCISDKContext;
-
 /**
  * MODULE IMPLEMENTATION
  */
@@ -184,6 +185,26 @@ static int CreateOTMessageFromPbuf(struct pbuf *aPbuf, otMessage **aMessage)
 void thciSetLocalDeviceRole(void)
 {
     gTHCISDKContext.mDeviceRole = thciGetDeviceRole();
+
+#if THCI_CONFIG_ATTACH_STATS
+    THCI_ATTACH_STATS_ROLE_CHANGED(gTHCISDKContext.mDeviceRole);
+
+    const otIp6Address *locator = NULL;
+
+    // A locator gives the mesh-local prefix.
+    for (const otNetifAddress *addr = otIp6GetUnicastAddresses(thciGetOtInstance()); addr && !locator; addr = addr->mNext)
+    {
+        if (thciIsLocatorAddress(&addr->mAddress))
+        {
+            locator = &addr->mAddress;
+        }
+    }
+
+    for (const otNetifAddress *addr = otIp6GetUnicastAddresses(thciGetOtInstance()); addr; addr = addr->mNext)
+    {
+        THCI_ATTACH_STATS_ADDRESS(&addr->mAddress, locator);
+    }
+#endif
 }
 
 otDeviceRole thciGetLocalDeviceRole(void)
@@ -310,6 +331,8 @@ otError thciThreadStart(void)
 
     gTHCISDKContext.mSecurityFlags |= THCI_SECURITY_FLAG_THREAD_STARTED;
 
+    THCI_ATTACH_STATS_THREAD_STARTED(true);
+
  done:
     return error;
 }
@@ -320,6 +343,8 @@ otError thciThreadStop(void)
 
     gTHCISDKContext.mSecurityFlags &= ~THCI_SECURITY_FLAG_THREAD_STARTED;
 
+    THCI_ATTACH_STATS_THREAD_STARTED(false);
+
     return error;
 }
 
@@ -1115,20 +1140,24 @@ static void thciReceiveIp6DatagramCallback(otMessage *aMessage, void *aContext)
         NL_LOG_CRIT(lrTHCI, "%s: Failed to read message.\n", __FUNCTION__);
     }
 
-#ifdef BUILD_FEATURE_THCI_CERT
-    thci_cert_rx_corrupt(pbuf);
-#endif //BUILD_FEATURE_THCI_CERT
-
+#if THCI_CONFIG_DEFERRED_LOG
+    thciDeferredLogIp6(kThciLogIdIpRx, (struct ip6_hdr*)(pbuf->payload), len, otMessageIsLinkSecurityEnabled(aMessage), thciGetChecksum(pbuf));
+#else
     NL_LOG_DEBUG(lrTHCI, "IP RX len: %u, cksum: 0x%04x\n", len, thciGetChecksum(pbuf));
     NL_LOG_DEBUG(lrTHCI, "from: %s\n", ip6addr_ntoa((const ip6_addr_t*)&((struct ip6_hdr*)(pbuf->payload))->src));  // IPv6 Header Source
     NL_LOG_DEBUG(lrTHCI, "  to: %s\n", ip6addr_ntoa((const ip6_addr_t*)&((struct ip6_hdr*)(pbuf->payload))->dest)); // IPv6 Header Destination
+#endif
 
-    err = tcpip_input(pbuf, gTHCISDKContext.mNetif[THCI_NETIF_TAG_THREAD]);
+    err = THCI_FAULT_TCPIP_INPUT(pbuf, gTHCISDKContext.mNetif[THCI_NETIF_TAG_THREAD]);
 
     if (err != ERR_OK)
     {
         pbuf_free(pbuf);
     }
+    else
+    {
+        THCI_ATTACH_STATS_DATAGRAM_RECEIVED();
+    }
 
  done:
     otMessageFree(aMessage);
@@ -1150,21 +1179,28 @@ static err_t thciLwIPOutputIP6(struct netif *netif, struct pbuf *pbuf, const str
     err_t retval = ERR_OK;
     otMessage *message = NULL;
 
+#if THCI_CONFIG_FAULT_INJECTION
+    if (THCI_FAULT_ACTIVE(kThciFaultStreamIpTx) && thciFaultOutput(netif, pbuf, ipaddr, &retval))
+    {
+        return retval;
+    }
+#endif
+
     nlREQUIRE_ACTION(pbuf->len <= (NL_THCI_PAYLOAD_MTU), done, retval = ERR_VAL);
     nlREQUIRE_ACTION(netif == gTHCISDKContext.mNetif[THCI_NETIF_TAG_THREAD], done, retval = ERR_IF);
     // If security is enabled, check if the radio is connected before sending packet to OT.
     nlREQUIRE_ACTION(!(THCI_ENABLE_MESSAGE_SECURITY(gTHCISDKContext.mSecurityFlags) && !thciIsConnected()), done, retval = ERR_CONN);
 
-#ifdef BUILD_FEATURE_THCI_CERT
-    thci_cert_tx_corrupt(pbuf);
-#endif //BUILD_FEATURE_THCI_CERT
-
     nlREQUIRE_ACTION(0 == CreateOTMessageFromPbuf(pbuf, &message), done, retval = ERR_MEM);
-    nlREQUIRE_ACTION(0 == EnqueueMessage(message), done, retval = ERR_INPROGRESS);
+    nlREQUIRE_ACTION(0 == EnqueueMessage(&gTHCISDKContext, 0, message), done, retval = ERR_INPROGRESS);
 
+#if THCI_CONFIG_DEFERRED_LOG
+    thciDeferredLogIp6(kThciLogIdIpTx, (struct ip6_hdr*)(pbuf->payload), otMessageGetLength(message), otMessageIsLinkSecurityEnabled(message), thciGetChecksum(pbuf));
+#else
     NL_LOG_DEBUG(lrTHCI, "IP TX pbuf_len: %d, ot_len: %u, cksum: 0x%04x\n", pbuf->tot_len, otMessageGetLength(message), thciGetChecksum(pbuf));
     NL_LOG_DEBUG(lrTHCI, "from: %s\n", ip6addr_ntoa((const ip6_addr_t*)&((struct ip6_hdr*)(pbuf->payload))->src));  // IPv6 Header Source
     NL_LOG_DEBUG(lrTHCI, "  to: %s\n", ip6addr_ntoa((const ip6_addr_t*)&((struct ip6_hdr*)(pbuf->payload))->dest)); // IPv6 Header Destination
+#endif
 
     nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sOutgoingIPPacketEvent);
 
@@ -1236,9 +1272,9 @@ static int OutgoingIPPacketEventHandler(nl_event_t *aEvent, void *aClosure)
     // When the Stall is on don't post an event even if message queue is not empty.
     nlREQUIRE(!gTHCISDKContext.mStallOutgoingDataPackets, nopost_exit);
 
-    while(!IsMessageQueueEmpty())
+    while(!IsMessageQueueEmpty(&gTHCISDKContext, 0))
     {
-        message = DequeueMessage();
+        message = DequeueMessage(&gTHCISDKContext, 0);
 
         if (!THCI_ENABLE_MESSAGE_SECURITY(gTHCISDKContext.mSecurityFlags) &&
              THCI_TEST_INSECURE_PORTS(gTHCISDKContext.mSecurityFlags) &&
@@ -1392,7 +1428,7 @@ void thciStallOutgoingDataPackets(bool aEnable)
     {
         gTHCISDKContext.mStallOutgoingDataPackets = aEnable;
 
-        if (!gTHCISDKContext.mStallOutgoingDataPackets && !IsMessageQueueEmpty())
+        if (!gTHCISDKContext.mStallOutgoingDataPackets && !IsMessageQueueEmpty(&gTHCISDKContext, 0))
         {
             // post an event to restart the flow of outgoing packets.
             nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sOutgoingIPPacketEvent);
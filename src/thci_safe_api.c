@@ -42,6 +42,11 @@
 #include <thci_module.h>
 #include <thci_safe_api.h>
 #include <thci_update.h>
+#include <thci_ncp_log.h>
+#include <thci_clock.h>
+#include <thci_diag.h>
+#include <thci_rf_test.h>
+#include <thci_stats.h>
 
 
 /**
@@ -72,8 +77,15 @@ enum {
     kSafeCmdGetCombinedNeighborTable,
     kSafeCmdGetChildTable,
     kSafeCmdGetNeighborTable,
+    kSafeCmdVisitChildTable,
+    kSafeCmdVisitNeighborTable,
     kSafeCmdGetExtendedAddress,
-    kSafeCmdGetInstantRssi
+    kSafeCmdGetInstantRssi,
+    kSafeCmdSetNcpLogLevel,
+    kSafeCmdSyncNcpClock,
+    kSafeCmdRunDiagScript,
+    kSafeCmdRfTestStart,
+    kSafeCmdRfTestStop
 };
 
 struct versionStringContext
@@ -110,6 +122,35 @@ struct neighborTableContext
     uint32_t    *mOutSize;
 };
 
+struct childVisitContext
+{
+    thciChildVisitor mVisitor;
+    void            *mContext;
+};
+
+struct neighborVisitContext
+{
+    thciNeighborVisitor mVisitor;
+    void               *mContext;
+};
+
+struct diagScriptContext
+{
+    const char          *mScript;
+    uint8_t             mFlags;
+    thci_diag_record_t  *mRecords;
+    uint16_t            mMaxRecords;
+    uint16_t            *mNumRecords;
+};
+
+struct rfTestContext
+{
+    const thci_rf_test_step_t   *mSteps;
+    uint16_t                    mNumSteps;
+    thciRfTestCallback          mCallback;
+    void                        *mContext;
+};
+
 /**
  * PROTOTYPES
  */
@@ -133,15 +174,16 @@ typedef struct
  * GLOBALS
  */
 
-// THCI context that is common between the NCP and SOC solutions.
-extern thci_sdk_context_t gTHCISDKContext;
-
 static const nl_event_t sSafeAPIEvent =
 {
     NL_INIT_EVENT_STATIC(((nl_event_type_t)NL_EVENT_T_RUNTIME), SafeAPIEventHandler, NULL)
 };
 
-static thci_safe_context_t sThciSafeContext;
+// Each instance serializes its own safe API calls, so that a call to one NCP
+// never waits for a call to another.
+static thci_safe_context_t sThciSafeContexts[THCI_CONFIG_MAX_INSTANCES];
+
+#define sThciSafeContext (sThciSafeContexts[THCI_INSTANCE_INDEX()])
 
 /**
  * MULTI-TASK SAFE API IMPLEMENTATION
@@ -151,6 +193,8 @@ static int SafeAPIEventHandler(nl_event_t *aEvent, void *aClosure)
 {
     otError result = OT_ERROR_INVALID_STATE;
 
+    THCI_EVENT_STATS_DISPATCH_BEGIN(kThciEventSafeApi);
+
     nlREQUIRE(sThciSafeContext.mInitialized, done);
 
     switch (sThciSafeContext.mSafeCommand)
@@ -272,6 +316,18 @@ static int SafeAPIEventHandler(nl_event_t *aEvent, void *aClosure)
             ((struct neighborTableContext *)sThciSafeContext.mSafeContent)->mOutSize);
         break;
 
+    case kSafeCmdVisitChildTable:
+        result = thciVisitChildTable(
+            ((struct childVisitContext *)sThciSafeContext.mSafeContent)->mVisitor,
+            ((struct childVisitContext *)sThciSafeContext.mSafeContent)->mContext);
+        break;
+
+    case kSafeCmdVisitNeighborTable:
+        result = thciVisitNeighborTable(
+            ((struct neighborVisitContext *)sThciSafeContext.mSafeContent)->mVisitor,
+            ((struct neighborVisitContext *)sThciSafeContext.mSafeContent)->mContext);
+        break;
+
 #endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP
 
     case kSafeCmdGetExtendedAddress:
@@ -282,6 +338,43 @@ static int SafeAPIEventHandler(nl_event_t *aEvent, void *aClosure)
         result = thciGetInstantRssi((int8_t *)sThciSafeContext.mSafeContent);
         break;
 
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
+    case kSafeCmdSetNcpLogLevel:
+        result = thciSetNcpLogLevel(*(uint8_t *)sThciSafeContext.mSafeContent);
+        break;
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_CLOCK_SYNC
+    case kSafeCmdSyncNcpClock:
+        result = thciSyncNcpClock();
+        break;
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+    case kSafeCmdRunDiagScript:
+        result = thciDiagnosticsRunScript(
+            ((struct diagScriptContext *)sThciSafeContext.mSafeContent)->mScript,
+            ((struct diagScriptContext *)sThciSafeContext.mSafeContent)->mFlags,
+            ((struct diagScriptContext *)sThciSafeContext.mSafeContent)->mRecords,
+            ((struct diagScriptContext *)sThciSafeContext.mSafeContent)->mMaxRecords,
+            ((struct diagScriptContext *)sThciSafeContext.mSafeContent)->mNumRecords);
+        break;
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST
+    case kSafeCmdRfTestStart:
+        result = thciRfTestStart(
+            ((struct rfTestContext *)sThciSafeContext.mSafeContent)->mSteps,
+            ((struct rfTestContext *)sThciSafeContext.mSafeContent)->mNumSteps,
+            ((struct rfTestContext *)sThciSafeContext.mSafeContent)->mCallback,
+            ((struct rfTestContext *)sThciSafeContext.mSafeContent)->mContext);
+        break;
+
+    case kSafeCmdRfTestStop:
+        result = thciRfTestStop();
+        break;
+#endif
+
     default:
         result = OT_ERROR_INVALID_ARGS;
         break;
@@ -294,6 +387,8 @@ static int SafeAPIEventHandler(nl_event_t *aEvent, void *aClosure)
     // It doesn't matter what gets posted to this queue as it behaves like a semaphore.
     nl_eventqueue_post_event(sThciSafeContext.mSafeQueue, &sSafeAPIEvent);
 
+    THCI_EVENT_STATS_DISPATCH_END(kThciEventSafeApi);
+
     return NLER_SUCCESS;
 }
 
@@ -311,6 +406,8 @@ static otError IssueSafeCommand(uint16_t aCmd, void *aContext)
     sThciSafeContext.mSafeCommand = aCmd;
     sThciSafeContext.mSafeContent = aContext;
 
+    THCI_EVENT_STATS_POSTED(kThciEventSafeApi);
+
     status = nl_eventqueue_post_event(gTHCISDKContext.mInitParams.mSdkQueue, &sSafeAPIEvent);
     nlREQUIRE(!status, unlock);
 
@@ -511,6 +608,24 @@ otError thciSafeGetNeighborTable(otNeighborInfo *aNeighborTableHead, uint32_t aI
     return IssueSafeCommand(kSafeCmdGetNeighborTable, (void*)&context);
 }
 
+otError thciSafeVisitChildTable(thciChildVisitor aVisitor, void *aContext)
+{
+    struct childVisitContext context;
+    context.mVisitor = aVisitor;
+    context.mContext = aContext;
+
+    return IssueSafeCommand(kSafeCmdVisitChildTable, (void*)&context);
+}
+
+otError thciSafeVisitNeighborTable(thciNeighborVisitor aVisitor, void *aContext)
+{
+    struct neighborVisitContext context;
+    context.mVisitor = aVisitor;
+    context.mContext = aContext;
+
+    return IssueSafeCommand(kSafeCmdVisitNeighborTable, (void*)&context);
+}
+
 bool thciSafeIsNcpPosting(void)
 {
     //TODO: Implement this function to test the Interrupt line from the NCP.
@@ -528,3 +643,50 @@ otError thciSafeGetInstantRssi(int8_t *aRssi)
 {
     return IssueSafeCommand(kSafeCmdGetInstantRssi, (void*)aRssi);
 }
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
+otError thciSafeSetNcpLogLevel(uint8_t aLevel)
+{
+    return IssueSafeCommand(kSafeCmdSetNcpLogLevel, (void*)&aLevel);
+}
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_CLOCK_SYNC
+otError thciSafeSyncNcpClock(void)
+{
+    return IssueSafeCommand(kSafeCmdSyncNcpClock, NULL);
+}
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+otError thciSafeRunDiagScript(const char *aScript, uint8_t aFlags, thci_diag_record_t *aRecords,
+                              uint16_t aMaxRecords, uint16_t *aNumRecords)
+{
+    struct diagScriptContext context;
+    context.mScript      = aScript;
+    context.mFlags       = aFlags;
+    context.mRecords     = aRecords;
+    context.mMaxRecords  = aMaxRecords;
+    context.mNumRecords  = aNumRecords;
+
+    return IssueSafeCommand(kSafeCmdRunDiagScript, (void*)&context);
+}
+#endif
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST
+otError thciSafeRfTestStart(const thci_rf_test_step_t *aSteps, uint16_t aNumSteps, thciRfTestCallback aCallback, void *aContext)
+{
+    struct rfTestContext context;
+    context.mSteps       = aSteps;
+    context.mNumSteps    = aNumSteps;
+    context.mCallback    = aCallback;
+    context.mContext     = aContext;
+
+    return IssueSafeCommand(kSafeCmdRfTestStart, (void*)&context);
+}
+
+otError thciSafeRfTestStop(void)
+{
+    return IssueSafeCommand(kSafeCmdRfTestStop, NULL);
+}
+#endif
@@ -27,9 +27,12 @@
 #include <getopt.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <nlertime.h>
+#include <nlertask.h>
+#include <nlplatform/nltime.h>
 #include <nlerlog.h>
 #include <nlutilities.h>
 #include <nlassert.h>
@@ -39,6 +42,17 @@
 #include <thci_update.h>
 #include <thci_safe_api.h>
 #include <thci_cert.h>
+#include <thci_ncp_log.h>
+#include <thci_clock.h>
+#include <thci_stats.h>
+#include <thci_deferred_log.h>
+#include <thci_bench.h>
+#include <thci_diag.h>
+#include <thci_rf_test.h>
+#include <thci_fault.h>
+#include <thci_health.h>
+#include <thci_daemon.h>
+#include <thci_arena.h>
 
 #include <lwip/ip6_addr.h>
 
@@ -226,8 +240,510 @@ static int handle_ncp_reset(int argc, const char *argv[])
     return 0;
 }
 
+#if THCI_CONFIG_LOG_NCP_LOGS
+static void handle_ncp_log_help(void)
+{
+    NL_LOG_CRIT(lrAPP, "\n"
+                "ncp_log              - write the captured NCP debug stream to the log.\n"
+                "ncp_log stats        - display the NCP debug stream capture counters.  \n"
+                "ncp_log level <n>    - set the NCP log level.                          \n");
+}
+
+static int handle_ncp_log(int argc, const char *argv[])
+{
+    int retval = 0;
+    otError error = OT_ERROR_NONE;
+
+    argc--;
+    argv++;
+
+    if (argc == 0)
+    {
+        NL_LOG_CRIT(lrAPP, "%u lines\n", (unsigned int)thciNcpLogFlush(0));
+    }
+    else if (argc == 1 && !strcmp(argv[0], "stats"))
+    {
+        thci_ncp_log_stats_t stats;
+
+        thciNcpLogGetStats(&stats);
+
+        NL_LOG_CRIT(lrAPP, "chunks=%u bytes=%u rate_dropped=%u overflow_dropped=%u high_water=%u\n",
+                    stats.mCapturedChunks, stats.mCapturedBytes, stats.mRateLimitedBytes,
+                    stats.mOverflowBytes, stats.mHighWater);
+    }
+    else if (argc == 2 && !strcmp(argv[0], "level"))
+    {
+        error = thciSafeSetNcpLogLevel((uint8_t)strtoul(argv[1], NULL, 0));
+        nlREQUIRE_ACTION(error == OT_ERROR_NONE, done, retval = -EIO);
+    }
+    else
+    {
+        retval = -EINVAL;
+    }
+
+ done:
+    if (retval == -EIO)
+    {
+        LogError(__FUNCTION__, (uint32_t)error);
+    }
+
+    return retval;
+}
+#endif /* THCI_CONFIG_LOG_NCP_LOGS */
+
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+static int handle_ncp_clock(int argc, const char *argv[])
+{
+    int retval = 0;
+    otError error = OT_ERROR_NONE;
+    thci_ncp_clock_t clock;
+
+    argc--;
+    argv++;
+
+    if (argc == 1 && !strcmp(argv[0], "sync"))
+    {
+        error = thciSafeSyncNcpClock();
+        nlREQUIRE_ACTION(error == OT_ERROR_NONE, done, retval = -EIO);
+    }
+    else
+    {
+        nlREQUIRE_ACTION(argc == 0, done, retval = -EINVAL);
+    }
+
+    if (thciNcpClockGet(&clock))
+    {
+        NL_LOG_CRIT(lrAPP, "host=%u offset=%d error=%u drift_ppm=%d drift_error_ppm=%u samples=%u\n",
+                    clock.mHostTime, clock.mOffset, clock.mError,
+                    clock.mDriftPpm, clock.mDriftErrorPpm, clock.mSamples);
+    }
+    else
+    {
+        NL_LOG_CRIT(lrAPP, "no samples\n");
+    }
+
+ done:
+    if (retval == -EIO)
+    {
+        LogError(__FUNCTION__, (uint32_t)error);
+    }
+
+    return retval;
+}
+#endif /* THCI_CONFIG_NCP_CLOCK_SYNC */
+
 #endif /* THCI_CONFIG_USE_OPENTHREAD_ON_NCP */
 
+enum
+{
+    kPerfGroupUart      = 0x01,
+    kPerfGroupSpinel    = 0x02,
+    kPerfGroupQueue     = 0x04,
+    kPerfGroupEvents    = 0x08,
+    kPerfGroupMem       = 0x10,
+    kPerfGroupAll       = 0x1f
+};
+
+static const struct
+{
+    const char  *name;
+    uint8_t     group;
+} kPerfGroups[] =
+{
+    { "uart",   kPerfGroupUart },
+    { "spinel", kPerfGroupSpinel },
+    { "queue",  kPerfGroupQueue },
+    { "events", kPerfGroupEvents },
+    { "mem",    kPerfGroupMem },
+};
+
+static void handle_perf_help(void)
+{
+    NL_LOG_CRIT(lrAPP, "\n"
+                "perf [group]               - display performance counters as key=value.    \n"
+                "perf [group] reset         - reset the counters.                           \n"
+                "perf [group] watch <secs>  - display the counters every second for <secs>.\n"
+                "groups: uart spinel queue events mem (default: all)                        \n");
+}
+
+static void perf_print_histogram(const char *inName, const thci_histogram_t *inHistogram)
+{
+    NL_LOG_CRIT(lrAPP, "%s n=%u avg=%u p50=%u p90=%u p99=%u max=%u\n",
+                inName,
+                inHistogram->mCount,
+                inHistogram->mCount ? inHistogram->mSum / inHistogram->mCount : 0,
+                thciHistogramPercentile(inHistogram, 50),
+                thciHistogramPercentile(inHistogram, 90),
+                thciHistogramPercentile(inHistogram, 99),
+                inHistogram->mMax);
+}
+
+static void perf_print(uint8_t inGroups)
+{
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+    thci_datapath_counters_t datapath;
+
+    thciGetDatapathCounters(&datapath);
+
+    if (inGroups & kPerfGroupUart)
+    {
+        thci_uart_counters_t uart;
+
+        thciGetUartCounters(&uart);
+
+        NL_LOG_CRIT(lrAPP, "uart rx_bytes=%u rx_dropped=%u rx_flow_off=%u rx_fifo_hw=%u rx_wakeups=%u rx_frames=%u rx_frame_err=%u rx_decode_err=%u\n",
+                    uart.mRxBytes, uart.mRxDroppedBytes, uart.mRxFlowOff, uart.mRxFifoHighWater, uart.mRxWakeups,
+                    uart.mRxFrames, uart.mRxFrameErrors, uart.mRxDecodeErrors);
+        NL_LOG_CRIT(lrAPP, "uart tx_frames=%u tx_bytes=%u tx_err=%u tx_blocked=%u\n",
+                    uart.mTxFrames, uart.mTxBytes, uart.mTxErrors, uart.mTxBlocked);
+        NL_LOG_CRIT(lrAPP, "uart rx_frame_hw=%u tx_frame_hw=%u\n",
+                    uart.mRxFrameHighWater, uart.mTxFrameHighWater);
+    }
+
+    if (inGroups & kPerfGroupSpinel)
+    {
+        thci_spinel_stats_t spinel;
+
+        thciGetSpinelStats(&spinel);
+
+        NL_LOG_CRIT(lrAPP, "spinel transactions=%u failures=%u timeouts=%u\n",
+                    spinel.mTransactions, spinel.mFailures, spinel.mTimeouts);
+        perf_print_histogram("spinel.get_ms", &spinel.mGetLatency);
+        perf_print_histogram("spinel.set_ms", &spinel.mSetLatency);
+    }
+
+    if (inGroups & kPerfGroupQueue)
+    {
+        NL_LOG_CRIT(lrAPP, "queue tx_pkts=%u tx_bytes=%u tx_drop_nobufs=%u tx_drop_other=%u tx_rejected=%u\n",
+                    datapath.mTxPackets, datapath.mTxBytes, datapath.mTxDropNoBufs,
+                    datapath.mTxDropOther, datapath.mTxRejected);
+        NL_LOG_CRIT(lrAPP, "queue rx_pkts=%u rx_bytes=%u rx_dropped=%u\n",
+                    datapath.mRxPackets, datapath.mRxBytes, datapath.mRxDropped);
+    }
+#endif /* THCI_CONFIG_USE_OPENTHREAD_ON_NCP */
+
+#if THCI_CONFIG_EVENT_STATS
+    if (inGroups & kPerfGroupEvents)
+    {
+        uint32_t pending;
+        uint32_t maxPending;
+
+        pending = thciGetPendingEventCount(&maxPending);
+
+        NL_LOG_CRIT(lrAPP, "events pending=%u pending_hw=%u\n", pending, maxPending);
+
+        for (int i = 0; i < kThciEventCount; i++)
+        {
+            thci_event_stats_t stats;
+            char name[32];
+
+            thciGetEventStats((thci_event_id_t)i, &stats);
+
+            NL_LOG_CRIT(lrAPP, "events.%s posted=%u suppressed=%u dispatched=%u pending=%u pending_hw=%u\n",
+                        thciEventName((thci_event_id_t)i), stats.mPosted, stats.mSuppressed,
+                        stats.mDispatched, stats.mPending, stats.mMaxPending);
+
+            snprintf(name, sizeof(name), "events.%s.latency_ms", thciEventName((thci_event_id_t)i));
+            perf_print_histogram(name, &stats.mLatency);
+
+            snprintf(name, sizeof(name), "events.%s.run_ms", thciEventName((thci_event_id_t)i));
+            perf_print_histogram(name, &stats.mRunTime);
+        }
+    }
+#endif /* THCI_CONFIG_EVENT_STATS */
+
+    if (inGroups & kPerfGroupMem)
+    {
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+        NL_LOG_CRIT(lrAPP, "mem tx_ring_used=%u tx_ring_size=%u tx_ring_hw=%u cb_used=%u cb_size=%u\n",
+                    datapath.mTxRingUsed, datapath.mTxRingSize, datapath.mTxRingHighWater,
+                    datapath.mCallbackBuffersUsed, datapath.mCallbackBuffersSize);
+#endif
+#if THCI_CONFIG_ARENA
+        {
+            thci_arena_usage_t usage;
+
+            thciGetArenaUsage(&usage);
+            NL_LOG_CRIT(lrAPP, "mem arena_used=%u arena_size=%u queue_hw=%u queue_size=%u\n",
+                        usage.mUsed, usage.mSize, usage.mMessageQueueHighWater, usage.mProfile.mMessageQueueSize);
+            NL_LOG_CRIT(lrAPP, "mem tx_frame_hw=%u tx_frame_size=%u rx_frame_hw=%u rx_frame_size=%u rx_fifo_hw=%u rx_fifo_size=%u\n",
+                        usage.mTxFrameHighWater, usage.mProfile.mTxFrameSize,
+                        usage.mRxFrameHighWater, usage.mProfile.mRxFrameSize,
+                        usage.mRxFifoHighWater, usage.mProfile.mRxFifoSize);
+        }
+#endif
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_LOG_NCP_LOGS
+        {
+            thci_ncp_log_stats_t stats;
+
+            thciNcpLogGetStats(&stats);
+            NL_LOG_CRIT(lrAPP, "mem ncp_log_hw=%u ncp_log_size=%u\n", stats.mHighWater, THCI_CONFIG_NCP_LOG_RING_SIZE);
+        }
+#endif
+#if THCI_CONFIG_DEFERRED_LOG
+        {
+            thci_log_stats_t stats;
+
+            thciDeferredLogGetStats(&stats);
+            NL_LOG_CRIT(lrAPP, "mem deferred_log_hw=%u deferred_log_size=%u\n", stats.mHighWater, THCI_CONFIG_DEFERRED_LOG_RING_SIZE);
+        }
+#endif
+    }
+}
+
+static void perf_reset(uint8_t inGroups)
+{
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP
+    if (inGroups & (kPerfGroupUart | kPerfGroupSpinel))
+    {
+        thciResetUartCounters();
+    }
+
+    if (inGroups & (kPerfGroupQueue | kPerfGroupMem))
+    {
+        thciResetDatapathCounters();
+    }
+#endif
+
+#if THCI_CONFIG_EVENT_STATS
+    if (inGroups & kPerfGroupEvents)
+    {
+        thciResetEventStats();
+    }
+#endif
+}
+
+static int handle_perf(int argc, const char *argv[])
+{
+    int retval = 0;
+    uint8_t groups = kPerfGroupAll;
+
+    argc--;
+    argv++;
+
+    if (argc > 0)
+    {
+        for (size_t i = 0; i < sizeof(kPerfGroups) / sizeof(kPerfGroups[0]); i++)
+        {
+            if (!strcmp(argv[0], kPerfGroups[i].name))
+            {
+                groups = kPerfGroups[i].group;
+                argc--;
+                argv++;
+                break;
+            }
+        }
+    }
+
+    if (argc == 0)
+    {
+        perf_print(groups);
+    }
+    else if (argc == 1 && !strcmp(argv[0], "reset"))
+    {
+        perf_reset(groups);
+    }
+    else if (argc == 2 && !strcmp(argv[0], "watch"))
+    {
+        unsigned long seconds = strtoul(argv[1], NULL, 0);
+
+        nlREQUIRE_ACTION(seconds > 0, done, retval = -EINVAL);
+
+        while (seconds--)
+        {
+            NL_LOG_CRIT(lrAPP, "time ms=%u\n", (uint32_t)nltime_get_system_ms());
+            perf_print(groups);
+            nl_task_sleep_ms(1000);
+        }
+    }
+    else
+    {
+        retval = -EINVAL;
+    }
+
+ done:
+    return retval;
+}
+
+#if THCI_CONFIG_BENCH
+static void handle_bench_help(void)
+{
+    NL_LOG_CRIT(lrAPP, "\n"
+                "bench udp <addr> [size] [pps] [secs] [port] - UDP to an echo service.     \n"
+                "bench icmp <addr> [size] [pps] [secs]       - ICMPv6 echo requests.       \n"
+                "defaults: size 64, 10 pps, 10 secs, port 7.                                \n");
+}
+
+static int handle_bench(int argc, const char *argv[])
+{
+    int retval = 0;
+    thci_bench_config_t config;
+    thci_bench_result_t result;
+
+    nlREQUIRE_ACTION(argc >= 3 && argc <= 7, done, retval = -EINVAL);
+
+    memset(&config, 0, sizeof(config));
+    config.mPort = THCI_BENCH_DEFAULT_PORT;
+    config.mSize = 64;
+    config.mRate = 10;
+    config.mDuration = 10000;
+    config.mLinger = 1000;
+
+    if (!strcmp(argv[1], "udp"))
+    {
+        config.mProto = kThciBenchProtoUdp;
+    }
+    else if (!strcmp(argv[1], "icmp"))
+    {
+        config.mProto = kThciBenchProtoIcmp;
+        nlREQUIRE_ACTION(argc <= 6, done, retval = -EINVAL);
+    }
+    else
+    {
+        retval = -EINVAL;
+        goto done;
+    }
+
+    nlREQUIRE_ACTION(ip6addr_aton(argv[2], &config.mPeer), done, retval = -EINVAL);
+
+    if (argc > 3)
+    {
+        config.mSize = (uint16_t)strtoul(argv[3], NULL, 0);
+    }
+
+    if (argc > 4)
+    {
+        config.mRate = (uint16_t)strtoul(argv[4], NULL, 0);
+    }
+
+    if (argc > 5)
+    {
+        config.mDuration = strtoul(argv[5], NULL, 0) * 1000;
+    }
+
+    if (argc > 6)
+    {
+        config.mPort = (uint16_t)strtoul(argv[6], NULL, 0);
+    }
+
+    retval = thciBenchRun(&config, &result);
+    nlREQUIRE(retval == 0, done);
+
+    NL_LOG_CRIT(lrAPP, "bench sent=%u send_err=%u received=%u duplicates=%u invalid=%u lost=%u elapsed_ms=%u\n",
+                result.mSent, result.mSendErrors, result.mReceived, result.mDuplicates, result.mInvalid,
+                (result.mSent > result.mReceived) ? result.mSent - result.mReceived : 0,
+                result.mElapsed);
+    NL_LOG_CRIT(lrAPP, "bench tx_bps=%u rx_bps=%u\n", result.mTxBitsPerSec, result.mRxBitsPerSec);
+    perf_print_histogram("bench.rtt_ms", &result.mRtt);
+
+ done:
+    return retval;
+}
+#endif /* THCI_CONFIG_BENCH */
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_HEALTH
+static void handle_health_help(void)
+{
+    NL_LOG_CRIT(lrAPP, "\n"
+                "health                     - show the NCP health status.                 \n"
+                "health start [norecover]   - start the monitor with the default SLOs.    \n"
+                "health stop                - stop the monitor.                           \n"
+                "The monitor probes on NCP traffic and on thciHealthTick() calls.       \n");
+}
+
+static int handle_health(int argc, const char *argv[])
+{
+    int retval = 0;
+    thci_health_status_t status;
+
+    if (argc >= 2 && !strcmp(argv[1], "start"))
+    {
+        thci_health_config_t config;
+
+        config.mMinInterval = THCI_HEALTH_DEFAULT_MIN_INTERVAL_MSEC;
+        config.mMaxInterval = THCI_HEALTH_DEFAULT_MAX_INTERVAL_MSEC;
+        config.mRttSlo = THCI_HEALTH_DEFAULT_RTT_SLO_MSEC;
+        config.mFailureSlo = THCI_HEALTH_DEFAULT_FAILURE_SLO_PERCENT;
+        config.mFailureThreshold = THCI_HEALTH_DEFAULT_FAILURE_THRESHOLD;
+        config.mAutoRecover = !(argc == 3 && !strcmp(argv[2], "norecover"));
+
+        nlREQUIRE_ACTION(thciHealthStart(&config, NULL, NULL) == OT_ERROR_NONE, done, retval = -EINVAL);
+    }
+    else if (argc == 2 && !strcmp(argv[1], "stop"))
+    {
+        thciHealthStop();
+    }
+    else
+    {
+        nlREQUIRE_ACTION(argc == 1, done, retval = -EINVAL);
+    }
+
+    thciGetHealthStatus(&status);
+
+    NL_LOG_CRIT(lrAPP, "health state=%s interval_ms=%u probes=%u failures=%u consecutive=%u\n",
+                thciHealthStateName(status.mState), status.mInterval, status.mProbes, status.mFailures,
+                status.mConsecutiveFailures);
+    NL_LOG_CRIT(lrAPP, "health window=%u p99_ms=%u failed_pct=%u degradations=%u recoveries=%u\n",
+                status.mWindowProbes, status.mWindowRttP99, status.mWindowFailures, status.mDegradations,
+                status.mRecoveries);
+    perf_print_histogram("health.rtt_ms", &status.mRtt);
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_HEALTH
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DAEMON
+static int handle_daemon(int argc, const char *argv[])
+{
+    int retval = 0;
+    thci_daemon_stats_t stats;
+
+    if (argc == 2 && !strcmp(argv[1], "stop"))
+    {
+        thciDaemonStop();
+    }
+    else
+    {
+        nlREQUIRE_ACTION(argc == 1, done, retval = -EINVAL);
+    }
+
+    thciDaemonGetStats(&stats);
+
+    NL_LOG_CRIT(lrAPP, "daemon clients=%u accepted=%u rejected=%u requests=%u invalid=%u notifications=%u send_deferred=%u send_drops=%u\n",
+                stats.mClients, stats.mAccepted, stats.mRejected, stats.mRequests, stats.mInvalid,
+                stats.mNotifications, stats.mSendDeferred, stats.mSendDrops);
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DAEMON
+
+#if THCI_CONFIG_MAX_INSTANCES > 1
+static int handle_instance(int argc, const char *argv[])
+{
+    int retval = 0;
+
+    if (argc == 2)
+    {
+        thci_instance_t *instance = thciGetInstance((uint8_t)strtoul(argv[1], NULL, 0));
+
+        nlREQUIRE_ACTION(instance != NULL, done, retval = -EINVAL);
+
+        thciSetCurrentInstance(instance);
+    }
+    else
+    {
+        nlREQUIRE_ACTION(argc == 1, done, retval = -EINVAL);
+    }
+
+    NL_LOG_CRIT(lrAPP, "instance %u of %u\n", thciGetInstanceIndex(thciGetCurrentInstance()), THCI_CONFIG_MAX_INSTANCES);
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_MAX_INSTANCES > 1
+
 static int handle_mac_params(int argc, const char *argv[])
 {
     otMacCounters counters;
@@ -333,6 +849,234 @@ static int handle_diags_cmd(int argc, const char *argv[])
     return retval;
 }
 
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+#define kDiagScriptMaxSteps     16
+#define kDiagScriptMaxLength    512
+
+static thci_diag_record_t sDiagRecords[kDiagScriptMaxSteps];
+
+static const char *diag_result_name(thci_diag_result_t inResult)
+{
+    static const char * const kNames[] = { "not_run", "pass", "fail", "error" };
+
+    return (inResult < sizeof(kNames) / sizeof(kNames[0])) ? kNames[inResult] : "unknown";
+}
+
+static int run_diag_script(const char *inScript, bool inAbortOnFailure)
+{
+    otError status;
+    uint16_t count = 0;
+    int retval = 0;
+
+    status = thciSafeRunDiagScript(inScript, inAbortOnFailure ? THCI_DIAG_FLAG_ABORT_ON_FAILURE : 0,
+                                   sDiagRecords, kDiagScriptMaxSteps, &count);
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const thci_diag_record_t *record = &sDiagRecords[i];
+        char output[sizeof(record->mOutput)];
+
+        // keep one record per line.
+        snprintf(output, sizeof(output), "%s", record->mOutput);
+        for (char *c = output; *c != '\0'; c++)
+        {
+            if (*c == '\r' || *c == '\n')
+            {
+                *c = ' ';
+            }
+        }
+
+        NL_LOG_CRIT(lrAPP, "diag step=%u result=%s error=%u status=%u has_value=%u value=%d latency_ms=%u output=\"%s\"\n",
+                    record->mStep, diag_result_name(record->mResult), record->mError, record->mStatus,
+                    record->mHasValue, record->mValue, record->mLatency, output);
+    }
+
+    NL_LOG_CRIT(lrAPP, "diag steps=%u result=%u\n", count, status);
+
+    nlREQUIRE_ACTION(status == OT_ERROR_NONE, done, retval = -EIO);
+
+ done:
+    return retval;
+}
+
+static void handle_diag_script_help(void)
+{
+    NL_LOG_CRIT(lrAPP, "\n"
+                "diag_script [-a] <step>; <step>; ...                               \n"
+                "  each step is a diag command, e.g. 'channel 11' or 'gpio get 3 = 1'\n"
+                "  '= <n>' fails the step unless the command outputs <n>.            \n"
+                "  -a stops at the first failed step.                                \n");
+}
+
+static int handle_diag_script(int argc, const char *argv[])
+{
+    char script[kDiagScriptMaxLength];
+    size_t index = 0;
+    bool abortOnFailure = false;
+    int retval = 0;
+    int i;
+
+    argc--;
+    argv++;
+
+    if (argc > 0 && !strcmp(argv[0], "-a"))
+    {
+        abortOnFailure = true;
+        argc--;
+        argv++;
+    }
+
+    nlREQUIRE_ACTION(argc > 0, done, retval = -EINVAL);
+
+    for (i = 0 ; i < argc ; i++)
+    {
+        const size_t len = strlen(argv[i]);
+
+        nlREQUIRE_ACTION(index + len + 1 < sizeof(script), done, retval = -EINVAL);
+
+        memcpy(&script[index], argv[i], len);
+        index += len;
+        script[index++] = ' ';
+    }
+
+    script[index] = '\0';
+
+    retval = run_diag_script(script, abortOnFailure);
+
+ done:
+    return retval;
+}
+#endif /* THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER */
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST
+static void rf_test_print_histogram(const char *inName, const uint16_t *inHistogram)
+{
+    NL_LOG_CRIT(lrAPP, "rf_test.%s=%u,%u,%u,%u,%u,%u,%u,%u\n", inName,
+                inHistogram[0], inHistogram[1], inHistogram[2], inHistogram[3],
+                inHistogram[4], inHistogram[5], inHistogram[6], inHistogram[7]);
+}
+
+static void rf_test_callback(const thci_rf_test_result_t *inResult, void *inContext)
+{
+    (void)inContext;
+
+    if (inResult == NULL)
+    {
+        NL_LOG_CRIT(lrAPP, "rf_test done\n");
+    }
+    else
+    {
+        uint32_t perPpm = 0;
+
+        if (inResult->mMode == kThciRfTestModeRx && inResult->mFrameCount > 0 &&
+            inResult->mFramesReceived < inResult->mFrameCount)
+        {
+            perPpm = (uint32_t)(((uint64_t)(inResult->mFrameCount - inResult->mFramesReceived) * 1000000) / inResult->mFrameCount);
+        }
+
+        NL_LOG_CRIT(lrAPP, "rf_test step=%u mode=%s ch=%u power=%d expected=%u sent=%u received=%u errors=%u per_ppm=%u duration_ms=%u\n",
+                    inResult->mStep, (inResult->mMode == kThciRfTestModeTx) ? "tx" : "rx",
+                    inResult->mChannel, inResult->mPower, inResult->mFrameCount,
+                    inResult->mFramesSent, inResult->mFramesReceived, inResult->mFrameErrors,
+                    perPpm, inResult->mDuration);
+        rf_test_print_histogram("lqi", inResult->mLqiHistogram);
+        rf_test_print_histogram("rssi", inResult->mRssiHistogram);
+    }
+}
+
+static void handle_rf_test_help(void)
+{
+    NL_LOG_CRIT(lrAPP, "\n"
+                "rf_test tx <ch>[-<ch>] <power> <count> [len] [interval_ms] - transmit on each channel.\n"
+                "rf_test rx <ch>[-<ch>] <msecs> [count]                     - receive on each channel; \n"
+                "                                                             PER is computed against count.\n"
+                "rf_test stop                                               - stop the running test.    \n"
+                "Requires 'diag start'.  Defaults: len 127, interval 10 ms, count 1000.                 \n");
+}
+
+static int handle_rf_test(int argc, const char *argv[])
+{
+    static thci_rf_test_step_t steps[THCI_CONFIG_RF_TEST_MAX_STEPS];
+    thci_rf_test_step_t step;
+    unsigned long first;
+    unsigned long last;
+    char *end;
+    otError status;
+    uint16_t count = 0;
+    int retval = 0;
+
+    nlREQUIRE_ACTION(argc >= 2, done, retval = -EINVAL);
+
+    if (!strcmp(argv[1], "stop"))
+    {
+        status = thciSafeRfTestStop();
+        nlREQUIRE_ACTION(status == OT_ERROR_NONE, done, retval = -EIO);
+        goto done;
+    }
+
+    nlREQUIRE_ACTION(argc >= 4, done, retval = -EINVAL);
+
+    memset(&step, 0, sizeof(step));
+    step.mFrameCount = 1000;
+    step.mFrameLength = 127;
+    step.mInterval = 10;
+
+    first = strtoul(argv[2], &end, 0);
+    last = (*end == '-') ? strtoul(end + 1, NULL, 0) : first;
+    nlREQUIRE_ACTION(first <= last && last <= UINT8_MAX, done, retval = -EINVAL);
+    nlREQUIRE_ACTION(last - first < THCI_CONFIG_RF_TEST_MAX_STEPS, done, retval = -EINVAL);
+
+    if (!strcmp(argv[1], "tx"))
+    {
+        nlREQUIRE_ACTION(argc >= 5 && argc <= 7, done, retval = -EINVAL);
+
+        step.mMode = kThciRfTestModeTx;
+        step.mPower = (int8_t)strtol(argv[3], NULL, 0);
+        step.mFrameCount = (uint16_t)strtoul(argv[4], NULL, 0);
+
+        if (argc > 5)
+        {
+            step.mFrameLength = (uint8_t)strtoul(argv[5], NULL, 0);
+        }
+
+        if (argc > 6)
+        {
+            step.mInterval = (uint16_t)strtoul(argv[6], NULL, 0);
+        }
+    }
+    else if (!strcmp(argv[1], "rx"))
+    {
+        nlREQUIRE_ACTION(argc <= 5, done, retval = -EINVAL);
+
+        step.mMode = kThciRfTestModeRx;
+        step.mDuration = strtoul(argv[3], NULL, 0);
+
+        if (argc > 4)
+        {
+            step.mFrameCount = (uint16_t)strtoul(argv[4], NULL, 0);
+        }
+    }
+    else
+    {
+        retval = -EINVAL;
+        goto done;
+    }
+
+    for (unsigned long channel = first; channel <= last; channel++)
+    {
+        steps[count] = step;
+        steps[count].mChannel = (uint8_t)channel;
+        count++;
+    }
+
+    status = thciSafeRfTestStart(steps, count, rf_test_callback, NULL);
+    nlREQUIRE_ACTION(status == OT_ERROR_NONE, done, retval = -EIO);
+
+ done:
+    return retval;
+}
+#endif /* THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST */
+
 static int handle_version(int argc, const char *argv[])
 {
     char version[128];
@@ -656,6 +1400,147 @@ done:
 }
 #endif // BUILD_FEATURE_THCI_CERT
 
+#if THCI_CONFIG_FAULT_INJECTION
+static void handle_fault_help(void)
+{
+    NL_LOG_CRIT(lrAPP, "\n"
+                "fault                          - show the stream settings and counters.   \n"
+                "fault seed <n>                 - reseed the generators, reset counters.   \n"
+                "fault reset                    - reset the counters.                      \n"
+                "fault off                      - disable all streams.                     \n"
+                "fault <stream> off             - disable a stream.                        \n"
+                "fault <stream> <action>=<ppm> ... [delay=<ms>] [skip=<n>] [bits=<n>]     \n"
+                "streams: ip_tx ip_rx frame_tx frame_rx byte_tx byte_rx                   \n"
+                "actions: drop duplicate delay reorder truncate bitflip                   \n"
+                "e.g. fault ip_rx drop=10000 reorder=5000 skip=40                         \n");
+}
+
+static void fault_print_stream(thci_fault_stream_t aStream)
+{
+    thci_fault_config_t config;
+    thci_fault_stats_t stats;
+
+    thciFaultGetConfig(aStream, &config);
+    thciFaultGetStats(aStream, &stats);
+
+    NL_LOG_CRIT(lrAPP, "%-8s %s units=%u delay=%u skip=%u bits=%u\n", thciFaultStreamName(aStream),
+                THCI_FAULT_ACTIVE(aStream) ? "on " : "off", stats.mUnits, config.mDelay, config.mSkipBytes, config.mBitFlips);
+
+    for (int i = 0; i < kThciFaultActionCount; i++)
+    {
+        if (config.mProbability[i] != 0 || stats.mInjected[i] != 0)
+        {
+            NL_LOG_CRIT(lrAPP, "    %-10s ppm=%u injected=%u\n", thciFaultActionName((thci_fault_action_t)i),
+                        config.mProbability[i], stats.mInjected[i]);
+        }
+    }
+}
+
+static int fault_parse_setting(const char *aArg, thci_fault_config_t *aConfig)
+{
+    int retval = -EINVAL;
+    const char *value = strchr(aArg, '=');
+    size_t nameLength;
+    unsigned long number;
+
+    nlREQUIRE(value != NULL, done);
+
+    nameLength = value - aArg;
+    number = strtoul(value + 1, NULL, 0);
+
+    for (int i = 0; i < kThciFaultActionCount; i++)
+    {
+        const char *name = thciFaultActionName((thci_fault_action_t)i);
+
+        if (strlen(name) == nameLength && !strncmp(aArg, name, nameLength))
+        {
+            aConfig->mProbability[i] = number;
+            retval = 0;
+            goto done;
+        }
+    }
+
+    if (!strncmp(aArg, "delay=", nameLength + 1))
+    {
+        aConfig->mDelay = (uint16_t)number;
+        retval = 0;
+    }
+    else if (!strncmp(aArg, "skip=", nameLength + 1))
+    {
+        aConfig->mSkipBytes = (uint16_t)number;
+        retval = 0;
+    }
+    else if (!strncmp(aArg, "bits=", nameLength + 1))
+    {
+        aConfig->mBitFlips = (uint8_t)number;
+        retval = 0;
+    }
+
+ done:
+    return retval;
+}
+
+static int handle_fault(int argc, const char *argv[])
+{
+    int retval = 0;
+    int stream;
+    thci_fault_config_t config;
+
+    if (argc == 1)
+    {
+        for (stream = 0; stream < kThciFaultStreamCount; stream++)
+        {
+            fault_print_stream((thci_fault_stream_t)stream);
+        }
+    }
+    else if (!strcmp(argv[1], "seed"))
+    {
+        nlREQUIRE_ACTION(argc == 3, done, retval = -EINVAL);
+        thciFaultSeed(strtoul(argv[2], NULL, 0));
+    }
+    else if (!strcmp(argv[1], "reset"))
+    {
+        thciFaultResetStats();
+    }
+    else if (!strcmp(argv[1], "off"))
+    {
+        thciFaultDisableAll();
+    }
+    else
+    {
+        for (stream = 0; stream < kThciFaultStreamCount; stream++)
+        {
+            if (!strcmp(argv[1], thciFaultStreamName((thci_fault_stream_t)stream)))
+            {
+                break;
+            }
+        }
+
+        nlREQUIRE_ACTION(stream < kThciFaultStreamCount, done, retval = -EINVAL);
+        nlREQUIRE_ACTION(argc > 2, done, retval = -EINVAL);
+
+        memset(&config, 0, sizeof(config));
+
+        if (strcmp(argv[2], "off"))
+        {
+            for (int i = 2; i < argc; i++)
+            {
+                retval = fault_parse_setting(argv[i], &config);
+                nlREQUIRE_ACTION(retval == 0, done, NL_LOG_CRIT(lrAPP, "ERROR: Invalid setting %s\n", argv[i]));
+            }
+        }
+
+        retval = thciFaultConfigure((thci_fault_stream_t)stream, &config);
+        nlREQUIRE_ACTION(retval == 0, done, NL_LOG_CRIT(lrAPP, "ERROR: Action not supported on %s\n", argv[1]));
+
+        fault_print_stream((thci_fault_stream_t)stream);
+    }
+
+ done:
+    return retval;
+}
+#endif // THCI_CONFIG_FAULT_INJECTION
+
 static void handle_cmd(const struct command_entry_t *cmd_set, int argc, const char *argv[])
 {
     int i;
@@ -700,11 +1585,45 @@ static const struct command_entry_t cmd_list[] = {
         "Update the NCP firmware" },
     { handle_ncp_reset, NULL, "ncp_reset", "",
         "Perform a hard reset on the NCP." },
+#if THCI_CONFIG_LOG_NCP_LOGS
+    { handle_ncp_log, handle_ncp_log_help, "ncp_log", "[stats | level <n>]",
+        "Display captured NCP logs or set the NCP log level." },
+#endif
+#if THCI_CONFIG_NCP_CLOCK_SYNC
+    { handle_ncp_clock, NULL, "ncp_clock", "[sync]",
+        "Display the NCP clock estimate, optionally taking a new sample." },
+#endif
 #endif
     { handle_mac_params, NULL, "mac_counters", "",
         "Query and display MAC counters." },
+    { handle_perf, handle_perf_help, "perf", "[group] [reset | watch <secs>]",
+        "Display performance counters." },
+#if THCI_CONFIG_BENCH
+    { handle_bench, handle_bench_help, "bench", "<udp|icmp> <addr> [size] [pps] [secs] [port]",
+        "Measure throughput, loss and round trip to an echo peer." },
+#endif
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_HEALTH
+    { handle_health, handle_health_help, "health", "[start [norecover] | stop]",
+        "Show or control the NCP health monitor." },
+#endif
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DAEMON
+    { handle_daemon, NULL, "daemon", "[stop]",
+        "Show the daemon statistics, or stop the daemon." },
+#endif
+#if THCI_CONFIG_MAX_INSTANCES > 1
+    { handle_instance, NULL, "instance", "[index]",
+        "Show or select the THCI instance the shell commands act on." },
+#endif
     { handle_diags_cmd, NULL, "diag", "",
         "Pass various diagnostic command strings to Openthread." },
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+    { handle_diag_script, handle_diag_script_help, "diag_script", "[-a] <step>; <step>; ...",
+        "Run a sequence of diag commands and report a record per step." },
+#endif
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_RF_TEST
+    { handle_rf_test, handle_rf_test_help, "rf_test", "<tx|rx|stop> ...",
+        "Run an RF packet error rate test and report binary statistics per step." },
+#endif
     { handle_version, NULL, "version", "",
         "Display the OpenThread version string." },
     { handle_ext_route, NULL, "ext_route", "",
@@ -713,6 +1632,10 @@ static const struct command_entry_t cmd_list[] = {
     { handle_corrupt, handle_corrupt_help, "corrupt", "<enable/disable> <rx/tx/all> <num>",
         "Toggle random bits on rx/tx." },
 #endif // BUILD_FEATURE_THCI_CERT
+#if THCI_CONFIG_FAULT_INJECTION
+    { handle_fault, handle_fault_help, "fault", "[seed <n> | reset | off | <stream> <action>=<ppm> ...]",
+        "Inject seeded faults on the IP, frame and UART byte streams." },
+#endif // THCI_CONFIG_FAULT_INJECTION
     { NULL, NULL, NULL, NULL, NULL }
 };
 
@@ -826,3 +1749,16 @@ int thciShellMfgGetGpio(uint16_t inPin)
     return retval;
 }
 
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_DIAG_SEQUENCER
+int thciShellMfgRunScript(const char *inScript, bool inAbortOnFailure)
+{
+    int retval = 0;
+
+    nlREQUIRE_ACTION(inScript != NULL, done, retval = -EINVAL);
+
+    retval = run_diag_script(inScript, inAbortOnFailure);
+
+ done:
+    return retval;
+}
+#endif
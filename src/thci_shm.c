@@ -0,0 +1,169 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the shared memory rings of thci_shm.h, used by
+ *      both the host and the NCP.
+ *
+ *      The producer publishes a frame with a full barrier between writing
+ *      its buffer and descriptor and advancing the head; the consumer has
+ *      one between reading the head and reading the descriptor, and one
+ *      between reading the frame and advancing the tail.  The consumer
+ *      copies the descriptor before checking it, as the other core may
+ *      rewrite it.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <nlassert.h>
+
+#include <thci_shm.h>
+
+#define SHM_RING_MASK                   (THCI_CONFIG_SHM_RING_SIZE - 1)
+
+static uint32_t ShmFrameOffset(thci_shm_direction_t aDirection, uint32_t aIndex)
+{
+    return (uint32_t)(offsetof(thci_shm_region_t, mFrames) +
+                      ((aDirection * THCI_CONFIG_SHM_RING_SIZE) + (aIndex & SHM_RING_MASK)) * THCI_CONFIG_SHM_FRAME_SIZE);
+}
+
+void thciShmRegionInit(thci_shm_region_t *aRegion)
+{
+    memset(aRegion, 0, offsetof(thci_shm_region_t, mFrames));
+
+    aRegion->mVersion = THCI_SHM_VERSION;
+    aRegion->mRingSize = THCI_CONFIG_SHM_RING_SIZE;
+    aRegion->mFrameSize = THCI_CONFIG_SHM_FRAME_SIZE;
+
+    __sync_synchronize();
+
+    aRegion->mMagic = THCI_SHM_MAGIC;
+
+    __sync_synchronize();
+}
+
+bool thciShmRegionIsValid(const thci_shm_region_t *aRegion)
+{
+    const uint32_t magic = *(volatile const uint32_t *)&aRegion->mMagic;
+
+    __sync_synchronize();
+
+    return ((magic == THCI_SHM_MAGIC) &&
+            (aRegion->mVersion == THCI_SHM_VERSION) &&
+            (aRegion->mRingSize == THCI_CONFIG_SHM_RING_SIZE) &&
+            (aRegion->mFrameSize == THCI_CONFIG_SHM_FRAME_SIZE));
+}
+
+uint8_t *thciShmRingReserve(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection)
+{
+    const thci_shm_ring_t *ring = &aRegion->mRings[aDirection];
+    const uint32_t head = ring->mHead.mValue;
+    uint8_t *retval = NULL;
+
+    nlREQUIRE(head - ring->mTail.mValue < THCI_CONFIG_SHM_RING_SIZE, done);
+
+    retval = aRegion->mFrames[aDirection][head & SHM_RING_MASK];
+
+ done:
+    return retval;
+}
+
+void thciShmRingCommit(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection, uint16_t aLength)
+{
+    thci_shm_ring_t *ring = &aRegion->mRings[aDirection];
+    const uint32_t head = ring->mHead.mValue;
+    thci_shm_descriptor_t *descriptor = &ring->mDescriptors[head & SHM_RING_MASK];
+
+    descriptor->mOffset = ShmFrameOffset(aDirection, head);
+    descriptor->mLength = aLength;
+    descriptor->mReserved = 0;
+
+    // The frame and its descriptor before the head.
+    __sync_synchronize();
+
+    ring->mHead.mValue = head + 1;
+}
+
+int thciShmRingPut(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection, const uint8_t *aFrame, uint16_t aLength)
+{
+    int retval = 0;
+    uint8_t *buffer;
+
+    nlREQUIRE_ACTION(aLength <= THCI_CONFIG_SHM_FRAME_SIZE, done, retval = -EMSGSIZE);
+
+    buffer = thciShmRingReserve(aRegion, aDirection);
+    nlREQUIRE_ACTION(buffer != NULL, done, retval = -ENOBUFS);
+
+    memcpy(buffer, aFrame, aLength);
+    thciShmRingCommit(aRegion, aDirection, aLength);
+
+ done:
+    return retval;
+}
+
+int thciShmRingPeek(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection, uint8_t **aFrame, uint16_t *aLength)
+{
+    const thci_shm_ring_t *ring = &aRegion->mRings[aDirection];
+    const uint32_t tail = ring->mTail.mValue;
+    const uint32_t count = ring->mHead.mValue - tail;
+    thci_shm_descriptor_t descriptor;
+    int retval = 0;
+
+    nlREQUIRE_ACTION(count != 0, done, retval = -ENODATA);
+    nlREQUIRE_ACTION(count <= THCI_CONFIG_SHM_RING_SIZE, done, retval = -EBADMSG);
+
+    // The head before the descriptor it publishes.
+    __sync_synchronize();
+
+    descriptor = ring->mDescriptors[tail & SHM_RING_MASK];
+
+    nlREQUIRE_ACTION(descriptor.mOffset == ShmFrameOffset(aDirection, tail), done, retval = -EBADMSG);
+    nlREQUIRE_ACTION(descriptor.mLength <= THCI_CONFIG_SHM_FRAME_SIZE, done, retval = -EBADMSG);
+
+    *aFrame = (uint8_t *)aRegion + descriptor.mOffset;
+    *aLength = descriptor.mLength;
+
+ done:
+    return retval;
+}
+
+void thciShmRingRelease(thci_shm_region_t *aRegion, thci_shm_direction_t aDirection)
+{
+    thci_shm_ring_t *ring = &aRegion->mRings[aDirection];
+
+    // Done with the frame before the producer may reuse its buffer.
+    __sync_synchronize();
+
+    ring->mTail.mValue = ring->mTail.mValue + 1;
+}
+
+uint32_t thciShmRingCount(const thci_shm_region_t *aRegion, thci_shm_direction_t aDirection)
+{
+    const thci_shm_ring_t *ring = &aRegion->mRings[aDirection];
+
+    return ring->mHead.mValue - ring->mTail.mValue;
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM
@@ -0,0 +1,323 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements the Linux platform of the shared memory
+ *      transport.
+ *
+ *      The region of each instance is a POSIX shared memory object, mapped
+ *      by the host and by the NCP, in threads of one process or in two
+ *      processes.  The side that creates the object sizes and initializes
+ *      it, then publishes it; the other side waits for that.  The
+ *      doorbells are futexes on the doorbell words of the region; a thread
+ *      per instance waits on the host's and calls the doorbell handler.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM && THCI_CONFIG_SHM_POSIX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+
+#include <thci_shm.h>
+
+// How long thciShmPosixMap() waits for the creator of an existing object
+// to size and publish it.
+#define SHM_POSIX_PUBLISH_RETRY_USEC    1000
+#define SHM_POSIX_PUBLISH_TIMEOUT_MSEC  1000
+
+typedef struct
+{
+    thci_shm_region_t          *mRegion;
+    thciShmDoorbellHandler      mHandler;
+    bool                        mThreadRunning;
+    volatile bool               mStop;
+    uint32_t                    mSeen;          // the host's doorbell when the thread started.
+    pthread_t                   mThread;
+} thci_shm_posix_context_t;
+
+static thci_shm_posix_context_t sShmPosixContexts[THCI_CONFIG_MAX_INSTANCES];
+
+/**
+ * Create the object aName, size and initialize it, then publish it by
+ * writing mOwner.
+ *
+ * @retval 0 on success, -EEXIST if the object exists or another negative
+ *         errno.
+ */
+static int ShmPosixCreate(const char *aName, thci_shm_region_t **aRegion)
+{
+    int retval = 0;
+    void *map = MAP_FAILED;
+    int fd;
+
+    fd = shm_open(aName, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    nlREQUIRE_ACTION(fd >= 0, done, retval = -errno);
+
+    nlREQUIRE_ACTION(ftruncate(fd, sizeof(thci_shm_region_t)) == 0, done, retval = -errno);
+
+    map = mmap(NULL, sizeof(thci_shm_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    nlREQUIRE_ACTION(map != MAP_FAILED, done, retval = -errno);
+
+    *aRegion = (thci_shm_region_t *)map;
+
+    // thciShmRegionInit() writes mMagic last; mOwner follows it, so that an
+    // opener of the region sees all of it once mOwner is set.
+    thciShmRegionInit(*aRegion);
+    (*aRegion)->mOwner = (uint32_t)getpid();
+    __sync_synchronize();
+
+ done:
+    if (fd >= 0)
+    {
+        (void)close(fd);
+
+        // Do not leave an object behind that will never be published.
+        if (retval != 0)
+        {
+            (void)shm_unlink(aName);
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * Map the existing object aName, once its creator published it.
+ *
+ * @retval 0 on success, -ENOENT if the object is gone, -ESTALE if it is
+ *         not published in time, has another layout or its creator is gone,
+ *         or another negative errno.
+ */
+static int ShmPosixOpen(const char *aName, thci_shm_region_t **aRegion)
+{
+    thci_shm_region_t *region = NULL;
+    uint32_t waitedUsec = 0;
+    struct stat status;
+    void *map;
+    int retval = 0;
+    int fd;
+
+    fd = shm_open(aName, O_RDWR, 0);
+    nlREQUIRE_ACTION(fd >= 0, done, retval = -errno);
+
+    // Mapping the object before the creator sized it would fault on access.
+    while (true)
+    {
+        nlREQUIRE_ACTION(fstat(fd, &status) == 0, done, retval = -errno);
+
+        if (status.st_size != 0 || waitedUsec >= SHM_POSIX_PUBLISH_TIMEOUT_MSEC * 1000)
+        {
+            break;
+        }
+
+        usleep(SHM_POSIX_PUBLISH_RETRY_USEC);
+        waitedUsec += SHM_POSIX_PUBLISH_RETRY_USEC;
+    }
+
+    nlREQUIRE_ACTION(status.st_size == sizeof(thci_shm_region_t), done, retval = -ESTALE);
+
+    map = mmap(NULL, sizeof(thci_shm_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    nlREQUIRE_ACTION(map != MAP_FAILED, done, retval = -errno);
+
+    region = (thci_shm_region_t *)map;
+
+    // The creator writes mOwner last.
+    while ((*(volatile uint32_t *)&region->mOwner == 0) && (waitedUsec < SHM_POSIX_PUBLISH_TIMEOUT_MSEC * 1000))
+    {
+        usleep(SHM_POSIX_PUBLISH_RETRY_USEC);
+        waitedUsec += SHM_POSIX_PUBLISH_RETRY_USEC;
+    }
+
+    nlREQUIRE_ACTION(*(volatile uint32_t *)&region->mOwner != 0, done, retval = -ESTALE);
+    nlREQUIRE_ACTION(thciShmRegionIsValid(region), done, retval = -ESTALE);
+
+    // Left behind by a process that exited.
+    nlREQUIRE_ACTION(kill((pid_t)region->mOwner, 0) == 0 || errno != ESRCH, done, retval = -ESTALE);
+
+    *aRegion = region;
+
+ done:
+    if (retval != 0 && region != NULL)
+    {
+        (void)munmap(region, sizeof(thci_shm_region_t));
+    }
+
+    if (fd >= 0)
+    {
+        (void)close(fd);
+    }
+
+    return retval;
+}
+
+thci_shm_region_t *thciShmPosixMap(const char *aName)
+{
+    thci_shm_region_t *retval = NULL;
+    unsigned int attempt;
+    int err = -ENOENT;
+
+    // The object may be unlinked by its creator or by us between the
+    // attempts, hence the second one.
+    for (attempt = 0; attempt < 2 && retval == NULL; attempt++)
+    {
+        err = ShmPosixCreate(aName, &retval);
+
+        if (err == -EEXIST)
+        {
+            err = ShmPosixOpen(aName, &retval);
+
+            if (err == -ESTALE)
+            {
+                NL_LOG_CRIT(lrTHCI, "%s: unlinking stale %s\n", __FUNCTION__, aName);
+                (void)shm_unlink(aName);
+            }
+        }
+    }
+
+    if (retval == NULL)
+    {
+        errno = -err;
+    }
+
+    return retval;
+}
+
+void thciShmPosixRing(thci_shm_word_t *aDoorbell)
+{
+    (void)__sync_fetch_and_add(&aDoorbell->mValue, 1);
+    (void)syscall(SYS_futex, &aDoorbell->mValue, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+uint32_t thciShmPosixWait(thci_shm_word_t *aDoorbell, uint32_t aSeen, int aTimeoutMsec)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = aTimeoutMsec / 1000;
+    timeout.tv_nsec = (aTimeoutMsec % 1000) * 1000000L;
+
+    // Returns at once if the doorbell already moved on.
+    (void)syscall(SYS_futex, &aDoorbell->mValue, FUTEX_WAIT, aSeen, (aTimeoutMsec < 0) ? NULL : &timeout, NULL, 0);
+
+    return aDoorbell->mValue;
+}
+
+static void *ShmPosixDoorbellThread(void *aContext)
+{
+    thci_shm_posix_context_t *context = (thci_shm_posix_context_t *)aContext;
+    const uint8_t index = (uint8_t)(context - sShmPosixContexts);
+    thci_shm_word_t *doorbell = &context->mRegion->mHostDoorbell;
+    uint32_t seen = context->mSeen;
+    uint32_t current;
+
+    while (!context->mStop)
+    {
+        current = thciShmPosixWait(doorbell, seen, -1);
+
+        if (current != seen && !context->mStop)
+        {
+            seen = current;
+            context->mHandler(index);
+        }
+    }
+
+    return NULL;
+}
+
+thci_shm_region_t *thciShmPlatformGetRegion(uint8_t aInstanceIndex)
+{
+    thci_shm_posix_context_t *context = &sShmPosixContexts[aInstanceIndex];
+    char name[NAME_MAX];
+
+    if (context->mRegion == NULL)
+    {
+        if (aInstanceIndex == 0)
+        {
+            snprintf(name, sizeof(name), "%s", THCI_CONFIG_SHM_POSIX_NAME);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "%s%d", THCI_CONFIG_SHM_POSIX_NAME, aInstanceIndex);
+        }
+
+        context->mRegion = thciShmPosixMap(name);
+
+        if (context->mRegion == NULL)
+        {
+            NL_LOG_CRIT(lrTHCI, "%s: cannot map %s (%d)\n", __FUNCTION__, name, errno);
+        }
+    }
+
+    return context->mRegion;
+}
+
+void thciShmPlatformEnable(uint8_t aInstanceIndex, thciShmDoorbellHandler aHandler)
+{
+    thci_shm_posix_context_t *context = &sShmPosixContexts[aInstanceIndex];
+    int err;
+
+    if (context->mThreadRunning)
+    {
+        context->mStop = true;
+        thciShmPosixRing(&context->mRegion->mHostDoorbell);
+        (void)pthread_join(context->mThread, NULL);
+        context->mThreadRunning = false;
+    }
+
+    nlREQUIRE(aHandler != NULL && context->mRegion != NULL, done);
+
+    context->mHandler = aHandler;
+    context->mStop = false;
+    // Read here, so that no ring after thciShmPlatformEnable() returns is missed.
+    context->mSeen = context->mRegion->mHostDoorbell.mValue;
+
+    err = pthread_create(&context->mThread, NULL, ShmPosixDoorbellThread, context);
+    nlREQUIRE_ACTION(err == 0, done, NL_LOG_CRIT(lrTHCI, "%s: pthread_create failed (%d)\n", __FUNCTION__, err));
+
+    context->mThreadRunning = true;
+
+ done:
+    return;
+}
+
+void thciShmPlatformRingDoorbell(uint8_t aInstanceIndex)
+{
+    thci_shm_posix_context_t *context = &sShmPosixContexts[aInstanceIndex];
+
+    if (context->mRegion != NULL)
+    {
+        thciShmPosixRing(&context->mRegion->mNcpDoorbell);
+    }
+}
+
+#endif // THCI_CONFIG_USE_OPENTHREAD_ON_NCP && THCI_CONFIG_NCP_SHM && THCI_CONFIG_SHM_POSIX
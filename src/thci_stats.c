@@ -0,0 +1,465 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      This file implements THCI runtime statistics.
+ *
+ *      Events may be posted from ISR context or from other tasks while the
+ *      THCI task dispatches them, so the post side counters are updated
+ *      with atomic operations.  The dispatch side is only touched by the
+ *      THCI task.  The clock is not read in ISR context: an event posted
+ *      from an ISR has no post time, and its latency is not sampled.
+ */
+
+#include <string.h>
+
+#include <nlassert.h>
+#include <nlerlog.h>
+#include <nlplatform/nltime.h>
+
+#include <thci.h>
+#include <thci_config.h>
+#include <thci_stats.h>
+
+#if THCI_CONFIG_EVENT_STATS || THCI_CONFIG_ATTACH_STATS
+static uint32_t Now(void)
+{
+    return (uint32_t)nltime_get_system_ms();
+}
+#endif
+
+static uint8_t HistogramBucket(uint32_t aValue)
+{
+    uint8_t bucket = 0;
+
+    while (aValue && bucket < THCI_HISTOGRAM_BUCKETS - 1)
+    {
+        aValue >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void thciHistogramAdd(thci_histogram_t *aHistogram, uint32_t aValue)
+{
+    aHistogram->mBuckets[HistogramBucket(aValue)]++;
+    aHistogram->mCount++;
+    aHistogram->mSum += aValue;
+
+    if (aValue > aHistogram->mMax)
+    {
+        aHistogram->mMax = aValue;
+    }
+}
+
+uint32_t thciHistogramPercentile(const thci_histogram_t *aHistogram, uint8_t aPercent)
+{
+    uint32_t retval = 0;
+    uint32_t target;
+    uint32_t cumulative = 0;
+    uint8_t i;
+
+    if (aHistogram->mCount == 0)
+    {
+        goto done;
+    }
+
+    target = (uint32_t)(((uint64_t)aHistogram->mCount * aPercent + 99) / 100);
+
+    for (i = 0; i < THCI_HISTOGRAM_BUCKETS; i++)
+    {
+        cumulative += aHistogram->mBuckets[i];
+
+        if (cumulative >= target)
+        {
+            retval = (i == 0) ? 0 : ((1UL << i) - 1);
+            break;
+        }
+    }
+
+    if (i == THCI_HISTOGRAM_BUCKETS - 1 || retval > aHistogram->mMax)
+    {
+        retval = aHistogram->mMax;
+    }
+
+ done:
+    return retval;
+}
+
+#if THCI_CONFIG_EVENT_STATS
+
+typedef struct
+{
+    thci_event_stats_t  mStats[kThciEventCount];
+    uint32_t            mPostTime[kThciEventCount];
+    bool                mPostTimeValid[kThciEventCount];    // false when the oldest pending post was from an ISR.
+    uint32_t            mDispatchStart[kThciEventCount];
+    uint32_t            mTotalPending;
+    uint32_t            mMaxTotalPending;
+} thci_event_stats_context_t;
+
+static thci_event_stats_context_t sEventStats;
+
+static const char *const kEventNames[kThciEventCount] =
+{
+    [kThciEventUartRxDone]          = "uart_rx",
+    [kThciEventUartRxResponse]      = "uart_rsp",
+    [kThciEventOutgoingIPPacket]    = "ip_tx",
+    [kThciEventStateChange]         = "state",
+    [kThciEventLegacyUla]           = "legacy_ula",
+    [kThciEventScanResult]          = "scan_result",
+    [kThciEventScanComplete]        = "scan_done",
+    [kThciEventNCPRecovery]         = "recovery",
+    [kThciEventSafeApi]             = "safe_api",
+    [kThciEventRfTest]              = "rf_test",
+    [kThciEventHealth]              = "health",
+    [kThciEventDaemon]              = "daemon",
+    [kThciEventAsync]               = "async",
+    [kThciEventLogFlush]            = "log_flush",
+    [kThciEventClockSync]           = "clock_sync",
+};
+
+void thciEventStatsPosted(thci_event_id_t aId)
+{
+    thci_event_stats_t *stats = &sEventStats.mStats[aId];
+    uint32_t pending;
+    uint32_t total;
+
+    __sync_fetch_and_add(&stats->mPosted, 1);
+
+    pending = __sync_fetch_and_add(&stats->mPending, 1);
+
+    if (pending == 0)
+    {
+        sEventStats.mPostTime[aId] = Now();
+        sEventStats.mPostTimeValid[aId] = true;
+    }
+
+    if (pending + 1 > stats->mMaxPending)
+    {
+        stats->mMaxPending = pending + 1;
+    }
+
+    total = __sync_add_and_fetch(&sEventStats.mTotalPending, 1);
+
+    if (total > sEventStats.mMaxTotalPending)
+    {
+        sEventStats.mMaxTotalPending = total;
+    }
+}
+
+void thciEventStatsPostedFromIsr(thci_event_id_t aId)
+{
+    thci_event_stats_t *stats = &sEventStats.mStats[aId];
+    uint32_t pending;
+    uint32_t total;
+
+    __sync_fetch_and_add(&stats->mPosted, 1);
+
+    pending = __sync_fetch_and_add(&stats->mPending, 1);
+
+    if (pending == 0)
+    {
+        sEventStats.mPostTimeValid[aId] = false;
+    }
+
+    if (pending + 1 > stats->mMaxPending)
+    {
+        stats->mMaxPending = pending + 1;
+    }
+
+    total = __sync_add_and_fetch(&sEventStats.mTotalPending, 1);
+
+    if (total > sEventStats.mMaxTotalPending)
+    {
+        sEventStats.mMaxTotalPending = total;
+    }
+}
+
+void thciEventStatsSuppressed(thci_event_id_t aId)
+{
+    __sync_fetch_and_add(&sEventStats.mStats[aId].mSuppressed, 1);
+}
+
+void thciEventStatsDispatchBegin(thci_event_id_t aId)
+{
+    thci_event_stats_t *stats = &sEventStats.mStats[aId];
+    const uint32_t now = Now();
+
+    sEventStats.mDispatchStart[aId] = now;
+    stats->mDispatched++;
+
+    if (stats->mPending)
+    {
+        if (sEventStats.mPostTimeValid[aId])
+        {
+            thciHistogramAdd(&stats->mLatency, now - sEventStats.mPostTime[aId]);
+        }
+
+        __sync_fetch_and_sub(&sEventStats.mTotalPending, 1);
+
+        if (__sync_sub_and_fetch(&stats->mPending, 1))
+        {
+            // Further posts are outstanding; their post times are not kept,
+            // so measure the next dispatch from now.
+            sEventStats.mPostTime[aId] = now;
+            sEventStats.mPostTimeValid[aId] = true;
+        }
+    }
+}
+
+void thciEventStatsDispatchEnd(thci_event_id_t aId)
+{
+    thciHistogramAdd(&sEventStats.mStats[aId].mRunTime, Now() - sEventStats.mDispatchStart[aId]);
+}
+
+void thciEventStatsMoved(thci_event_id_t aFrom, thci_event_id_t aTo)
+{
+    thci_event_stats_t *from = &sEventStats.mStats[aFrom];
+    const uint32_t postTime = sEventStats.mPostTime[aFrom];
+    const bool postTimeValid = sEventStats.mPostTimeValid[aFrom];
+    uint32_t pending;
+
+    nlREQUIRE(from->mPending, done);
+
+    if (__sync_sub_and_fetch(&from->mPending, 1))
+    {
+        sEventStats.mPostTime[aFrom] = Now();
+        sEventStats.mPostTimeValid[aFrom] = true;
+    }
+
+    if (aTo < kThciEventCount)
+    {
+        thci_event_stats_t *to = &sEventStats.mStats[aTo];
+
+        pending = __sync_fetch_and_add(&to->mPending, 1);
+
+        if (pending == 0)
+        {
+            sEventStats.mPostTime[aTo] = postTime;
+            sEventStats.mPostTimeValid[aTo] = postTimeValid;
+        }
+
+        if (pending + 1 > to->mMaxPending)
+        {
+            to->mMaxPending = pending + 1;
+        }
+    }
+    else
+    {
+        __sync_fetch_and_sub(&sEventStats.mTotalPending, 1);
+    }
+
+ done:
+    return;
+}
+
+void thciGetEventStats(thci_event_id_t aId, thci_event_stats_t *aStats)
+{
+    memcpy(aStats, &sEventStats.mStats[aId], sizeof(*aStats));
+}
+
+void thciResetEventStats(void)
+{
+    for (size_t i = 0; i < kThciEventCount; i++)
+    {
+        thci_event_stats_t *stats = &sEventStats.mStats[i];
+
+        stats->mPosted = 0;
+        stats->mSuppressed = 0;
+        stats->mDispatched = 0;
+        stats->mMaxPending = stats->mPending;
+        memset(&stats->mLatency, 0, sizeof(stats->mLatency));
+        memset(&stats->mRunTime, 0, sizeof(stats->mRunTime));
+    }
+
+    sEventStats.mMaxTotalPending = sEventStats.mTotalPending;
+}
+
+uint32_t thciGetPendingEventCount(uint32_t *aMaxPending)
+{
+    if (aMaxPending)
+    {
+        *aMaxPending = sEventStats.mMaxTotalPending;
+    }
+
+    return sEventStats.mTotalPending;
+}
+
+const char *thciEventName(thci_event_id_t aId)
+{
+    return (aId < kThciEventCount) ? kEventNames[aId] : "unknown";
+}
+
+#endif // THCI_CONFIG_EVENT_STATS
+
+#if THCI_CONFIG_ATTACH_STATS
+
+static thci_attach_stats_t sAttachStats;
+
+static bool IsAttachedRole(otDeviceRole aRole)
+{
+    return (aRole == OT_DEVICE_ROLE_CHILD ||
+            aRole == OT_DEVICE_ROLE_ROUTER ||
+            aRole == OT_DEVICE_ROLE_LEADER);
+}
+
+static void AddAttachSample(thci_histogram_t *aHistogram, uint32_t aStart, uint32_t aEnd)
+{
+    thciHistogramAdd(aHistogram, (aEnd - aStart) / THCI_ATTACH_STATS_UNIT_MSEC);
+}
+
+void thciAttachStatsThreadStarted(bool aStarted)
+{
+    sAttachStats.mStarted = aStarted;
+
+    if (aStarted)
+    {
+        sAttachStats.mThreadStartTime = Now();
+        sAttachStats.mHaveRoutableAddress = false;
+        sAttachStats.mHaveDatagram = false;
+        // The next attach is timed from this start, not from a detach
+        // before it.
+        sAttachStats.mHaveDetach = false;
+        sAttachStats.mDetachTime = 0;
+    }
+}
+
+void thciAttachStatsRoleChanged(otDeviceRole aRole)
+{
+    const uint32_t now = Now();
+    const otDeviceRole previous = sAttachStats.mRole;
+
+    nlREQUIRE(aRole != previous, done);
+
+    if (sAttachStats.mRoleChanges && (now - sAttachStats.mRoleChangeTime) < THCI_CONFIG_ROLE_FLAP_WINDOW_MSEC)
+    {
+        sAttachStats.mFlaps++;
+    }
+
+    if (sAttachStats.mRoleChanges)
+    {
+        AddAttachSample(&sAttachStats.mRoleDwell, sAttachStats.mRoleChangeTime, now);
+    }
+
+    if (!IsAttachedRole(previous) && IsAttachedRole(aRole))
+    {
+        sAttachStats.mAttaches++;
+
+        if (previous == OT_DEVICE_ROLE_DETACHED && sAttachStats.mHaveDetach)
+        {
+            AddAttachSample(&sAttachStats.mDetachDuration, sAttachStats.mDetachTime, now);
+            AddAttachSample(&sAttachStats.mTimeToAttach, sAttachStats.mDetachTime, now);
+        }
+        else if (sAttachStats.mStarted)
+        {
+            AddAttachSample(&sAttachStats.mTimeToAttach, sAttachStats.mThreadStartTime, now);
+        }
+    }
+    else if (IsAttachedRole(previous) && aRole == OT_DEVICE_ROLE_DETACHED)
+    {
+        sAttachStats.mDetaches++;
+        sAttachStats.mHaveDetach = true;
+        sAttachStats.mDetachTime = now;
+    }
+
+    NL_LOG_DEBUG(lrTHCI, "role %d -> %d after %u ms\n", previous, aRole,
+                 sAttachStats.mRoleChanges ? (now - sAttachStats.mRoleChangeTime) : 0);
+
+    sAttachStats.mRole = aRole;
+    sAttachStats.mRoleChangeTime = now;
+    sAttachStats.mRoleChanges++;
+
+ done:
+    return;
+}
+
+bool thciIsLocatorAddress(const otIp6Address *aAddress)
+{
+    const uint8_t *a = aAddress->mFields.m8;
+
+    // Thread RLOC and ALOC have the IID 0000:00ff:fe00:xxxx.
+    return (a[8] == 0x00 && a[9] == 0x00 && a[10] == 0x00 && a[11] == 0xff &&
+            a[12] == 0xfe && a[13] == 0x00);
+}
+
+bool thciIsRoutableAddress(const otIp6Address *aAddress, const otIp6Address *aLocator)
+{
+    const uint8_t *a = aAddress->mFields.m8;
+    bool retval = false;
+
+    nlREQUIRE(aLocator != NULL, done);
+
+    // fe80::/10 link-local
+    nlREQUIRE(!(a[0] == 0xfe && (a[1] & 0xc0) == 0x80), done);
+
+    // The mesh-local /64 of the locators and the ML-EID.
+    nlREQUIRE(memcmp(a, aLocator->mFields.m8, 8) != 0, done);
+
+    retval = true;
+
+ done:
+    return retval;
+}
+
+void thciAttachStatsAddress(const otIp6Address *aAddress, const otIp6Address *aLocator)
+{
+    nlREQUIRE(sAttachStats.mStarted && !sAttachStats.mHaveRoutableAddress, done);
+    nlREQUIRE(thciIsRoutableAddress(aAddress, aLocator), done);
+
+    sAttachStats.mHaveRoutableAddress = true;
+    sAttachStats.mRoutableAddressTime = Now();
+    AddAttachSample(&sAttachStats.mTimeToRoutableAddress, sAttachStats.mThreadStartTime, sAttachStats.mRoutableAddressTime);
+
+ done:
+    return;
+}
+
+void thciAttachStatsDatagramReceived(void)
+{
+    nlREQUIRE(sAttachStats.mStarted && !sAttachStats.mHaveDatagram, done);
+
+    sAttachStats.mHaveDatagram = true;
+    sAttachStats.mDatagramTime = Now();
+    AddAttachSample(&sAttachStats.mTimeToDatagram, sAttachStats.mThreadStartTime, sAttachStats.mDatagramTime);
+
+ done:
+    return;
+}
+
+void thciGetAttachStats(thci_attach_stats_t *aStats)
+{
+    memcpy(aStats, &sAttachStats, sizeof(*aStats));
+}
+
+void thciResetAttachStats(void)
+{
+    sAttachStats.mRoleChanges = 0;
+    sAttachStats.mAttaches = 0;
+    sAttachStats.mDetaches = 0;
+    sAttachStats.mFlaps = 0;
+    memset(&sAttachStats.mTimeToAttach, 0, sizeof(sAttachStats.mTimeToAttach));
+    memset(&sAttachStats.mTimeToRoutableAddress, 0, sizeof(sAttachStats.mTimeToRoutableAddress));
+    memset(&sAttachStats.mTimeToDatagram, 0, sizeof(sAttachStats.mTimeToDatagram));
+    memset(&sAttachStats.mDetachDuration, 0, sizeof(sAttachStats.mDetachDuration));
+    memset(&sAttachStats.mRoleDwell, 0, sizeof(sAttachStats.mRoleDwell));
+}
+
+#endif // THCI_CONFIG_ATTACH_STATS
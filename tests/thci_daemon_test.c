@@ -0,0 +1,328 @@
+/*
+ *
+ *    Copyright (c) 2016-2018 Nest Labs, Inc.
+ *    All rights reserved.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ *    @file
+ *      Manual check of the THCI daemon: socket clients send requests
+ *      through the daemon to the simulated SPI NCP, and receive its
+ *      responses and notifications.
+ *
+ *      thci.mak does not build this program.  Build it on a POSIX host as
+ *      a program of its own, linked with THCI built with
+ *      THCI_CONFIG_DAEMON, THCI_CONFIG_NCP_SPI and
+ *      THCI_CONFIG_SPI_SIMULATED_PEER, and run it by hand.  The main task
+ *      is the THCI task, a second task polls the daemon and a third one
+ *      runs the clients.  The socket is named after the process id, so
+ *      that several runs do not collide.  The program exits with 0 when
+ *      every check passed.
+ */
+
+#include <thci_config.h>
+
+#if THCI_CONFIG_DAEMON && THCI_CONFIG_NCP_SPI && THCI_CONFIG_SPI_SIMULATED_PEER
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <nlassert.h>
+#include <nlerevent.h>
+
+#include <openthread/spinel.h>
+
+#include <thci.h>
+#include <thci_daemon.h>
+#include <thci_spi.h>
+
+#define kTestSocketPathFormat   "/tmp/thci_daemon_test.%ld.sock"
+#define kTestReceiveMsec        2000
+#define kTestSilenceMsec        200
+#define kTestPollMsec           100
+
+static nl_event_t *sSdkQueueMem[16];
+static char sSocketPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static volatile bool sClientsDone;
+static int sPollResult;
+static int sFailures;
+
+static void Fail(const char *aCheck)
+{
+    printf("FAIL: %s\n", aCheck);
+    sFailures++;
+}
+
+static int Connect(void)
+{
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+
+    nlREQUIRE(fd >= 0, done);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, sSocketPath);
+
+    if (connect(fd, (const struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+
+ done:
+    return fd;
+}
+
+static bool SendRequest(int aFd, uint8_t aTid, unsigned int aCommand, spinel_prop_key_t aKey, const uint8_t *aValue, uint16_t aLength)
+{
+    uint8_t message[THCI_CONFIG_DAEMON_MAX_MESSAGE];
+    spinel_ssize_t length;
+
+    message[0] = kThciDaemonMsgRequest;
+    length = spinel_datatype_pack(message + 1, sizeof(message) - 1, "Cii", SPINEL_HEADER_FLAG | aTid, aCommand, aKey);
+
+    if (aLength > 0)
+    {
+        memcpy(message + 1 + length, aValue, aLength);
+    }
+
+    return (send(aFd, message, 1 + length + aLength, 0) == (ssize_t)(1 + length + aLength));
+}
+
+static bool SendSubscribe(int aFd, spinel_prop_key_t aKey)
+{
+    uint8_t message[8];
+    spinel_ssize_t length;
+
+    message[0] = kThciDaemonMsgSubscribe;
+    length = spinel_datatype_pack(message + 1, sizeof(message) - 1, SPINEL_DATATYPE_UINT_PACKED_S, aKey);
+
+    return (send(aFd, message, 1 + length, 0) == (ssize_t)(1 + length));
+}
+
+/**
+ * Receives a message of aType, and checks its frame against the expected
+ * one.  A NULL aValue expects an empty value.
+ */
+static bool ReceiveFrame(int aFd, uint8_t aType, uint8_t aTid, unsigned int aCommand, spinel_prop_key_t aKey,
+                         const uint8_t *aValue, uint16_t aLength)
+{
+    uint8_t message[THCI_CONFIG_DAEMON_MAX_MESSAGE];
+    struct pollfd pfd;
+    ssize_t length;
+    uint8_t header;
+    unsigned int command;
+    spinel_prop_key_t key;
+    const uint8_t *value;
+    unsigned int valueLength;
+    bool retval = false;
+
+    pfd.fd = aFd;
+    pfd.events = POLLIN;
+
+    nlREQUIRE(poll(&pfd, 1, kTestReceiveMsec) == 1, done);
+
+    length = recv(aFd, message, sizeof(message), 0);
+    nlREQUIRE(length > 1 && message[0] == aType, done);
+
+    nlREQUIRE(spinel_datatype_unpack(message + 1, length - 1, "CiiD", &header, &command, &key, &value, &valueLength) > 0, done);
+
+    nlREQUIRE(SPINEL_HEADER_GET_TID(header) == aTid && command == aCommand && key == aKey, done);
+    nlREQUIRE(valueLength == aLength && (aLength == 0 || memcmp(value, aValue, aLength) == 0), done);
+
+    retval = true;
+
+ done:
+    return retval;
+}
+
+static bool IsSilent(int aFd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = aFd;
+    pfd.events = POLLIN;
+
+    return (poll(&pfd, 1, kTestSilenceMsec) == 0);
+}
+
+static void *PollTask(void *aContext)
+{
+    int result;
+
+    (void)aContext;
+
+    do
+    {
+        result = thciDaemonPoll(kTestPollMsec);
+    }
+    while (result == 0);
+
+    sPollResult = result;
+
+    return NULL;
+}
+
+static void *ClientTask(void *aContext)
+{
+    const uint8_t channel = 11;
+    const uint8_t notified = 15;
+    uint8_t status[4];
+    uint8_t frame[16];
+    spinel_ssize_t length;
+    int a = -1;
+    int b = -1;
+
+    (void)aContext;
+
+    a = Connect();
+    b = Connect();
+    nlREQUIRE_ACTION(a >= 0 && b >= 0, done, Fail("connect"));
+
+    // A set is answered with the value the simulated NCP echoes.
+    if (!SendRequest(a, 5, SPINEL_CMD_PROP_VALUE_SET, SPINEL_PROP_PHY_CHAN, &channel, sizeof(channel)) ||
+        !ReceiveFrame(a, kThciDaemonMsgResponse, 5, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_CHAN, &channel, sizeof(channel)))
+    {
+        Fail("set through the daemon");
+    }
+
+    // Both clients use the same TID; each gets its own answer.
+    if (!SendRequest(a, 7, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_PHY_CHAN, NULL, 0) ||
+        !SendRequest(b, 7, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_PHY_CHAN, NULL, 0) ||
+        !ReceiveFrame(a, kThciDaemonMsgResponse, 7, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_CHAN, NULL, 0) ||
+        !ReceiveFrame(b, kThciDaemonMsgResponse, 7, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_CHAN, NULL, 0))
+    {
+        Fail("same TID from two clients");
+    }
+
+    // A command the daemon does not forward is answered with a LAST_STATUS.
+    length = spinel_datatype_pack(status, sizeof(status), SPINEL_DATATYPE_UINT_PACKED_S, SPINEL_STATUS_INVALID_COMMAND);
+
+    if (!SendRequest(b, 9, SPINEL_CMD_NOOP, SPINEL_PROP_LAST_STATUS, NULL, 0) ||
+        !ReceiveFrame(b, kThciDaemonMsgResponse, 9, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_LAST_STATUS, status, (uint16_t)length))
+    {
+        Fail("refused command");
+    }
+
+    // An unsolicited frame reaches the subscribed client only.
+    length = spinel_datatype_pack(frame, sizeof(frame), "CiiC", SPINEL_HEADER_FLAG, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_CHAN, notified);
+
+    if (!SendSubscribe(a, SPINEL_PROP_PHY_CHAN) ||
+        !SendRequest(a, 10, SPINEL_CMD_PROP_VALUE_GET, SPINEL_PROP_PHY_CHAN, NULL, 0) ||
+        !ReceiveFrame(a, kThciDaemonMsgResponse, 10, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_CHAN, NULL, 0) ||
+        thciSpiSimSend(0, frame, (uint16_t)length) != 0 ||
+        !ReceiveFrame(a, kThciDaemonMsgNotify, 0, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_PHY_CHAN, &notified, sizeof(notified)) ||
+        !IsSilent(b))
+    {
+        Fail("notification");
+    }
+
+ done:
+    if (a >= 0)
+    {
+        close(a);
+    }
+
+    if (b >= 0)
+    {
+        close(b);
+    }
+
+    sClientsDone = true;
+
+    return NULL;
+}
+
+// Runs the THCI task until aDone is set.
+static void DispatchUntil(nl_eventqueue_t aQueue, volatile bool *aDone)
+{
+    while (!*aDone)
+    {
+        nl_event_t *event = nl_eventqueue_get_event_with_timeout(aQueue, kTestPollMsec);
+
+        if (event != NULL)
+        {
+            nl_dispatch_event(event, NULL);
+        }
+    }
+}
+
+int main(void)
+{
+    thci_init_params_t params;
+    thci_callbacks_t callbacks;
+    pthread_t pollTask;
+    pthread_t clientTask;
+    uint8_t reset[8];
+    spinel_ssize_t length;
+
+    memset(&params, 0, sizeof(params));
+    memset(&callbacks, 0, sizeof(callbacks));
+
+    params.mSdkQueue = nl_eventqueue_create(sSdkQueueMem, sizeof(sSdkQueueMem));
+    nlREQUIRE_ACTION(params.mSdkQueue != NULL, done, Fail("queue"));
+
+    (void)thciSetCurrentInstance(thciGetInstance(0));
+    nlREQUIRE_ACTION(thciSDKInit(&params) == 0, done, Fail("thciSDKInit"));
+
+    // The simulated NCP reports its reset once THCI enables the transport.
+    length = spinel_datatype_pack(reset, sizeof(reset), "Cii" SPINEL_DATATYPE_UINT_PACKED_S,
+                                  SPINEL_HEADER_FLAG, SPINEL_CMD_PROP_VALUE_IS, SPINEL_PROP_LAST_STATUS, SPINEL_STATUS_RESET_POWER_ON);
+    nlREQUIRE_ACTION(thciSpiSimSend(0, reset, (uint16_t)length) == 0, done, Fail("reset status"));
+
+    nlREQUIRE_ACTION(thciInitialize(&callbacks) == OT_ERROR_NONE, done, Fail("thciInitialize"));
+    snprintf(sSocketPath, sizeof(sSocketPath), kTestSocketPathFormat, (long)getpid());
+    nlREQUIRE_ACTION(thciDaemonStart(sSocketPath) == 0, done, Fail("thciDaemonStart"));
+
+    nlREQUIRE_ACTION(pthread_create(&pollTask, NULL, PollTask, NULL) == 0, done, Fail("poll task"));
+    nlREQUIRE_ACTION(pthread_create(&clientTask, NULL, ClientTask, NULL) == 0, done, Fail("client task"));
+
+    DispatchUntil(params.mSdkQueue, &sClientsDone);
+    pthread_join(clientTask, NULL);
+
+    // Stopping the daemon while it polls ends the poll loop.
+    thciDaemonStop();
+    pthread_join(pollTask, NULL);
+
+    if (sPollResult != -ENOTCONN)
+    {
+        Fail("stop during poll");
+    }
+
+ done:
+    printf("%s\n", (sFailures == 0) ? "PASS" : "FAIL");
+
+    return (sFailures == 0) ? 0 : 1;
+}
+
+#else
+
+#include <stdio.h>
+
+int main(void)
+{
+    printf("SKIP: requires THCI_CONFIG_DAEMON, THCI_CONFIG_NCP_SPI and THCI_CONFIG_SPI_SIMULATED_PEER\n");
+
+    return 0;
+}
+
+#endif // THCI_CONFIG_DAEMON && THCI_CONFIG_NCP_SPI && THCI_CONFIG_SPI_SIMULATED_PEER
@@ -22,12 +22,27 @@
 THCI_INCLUDES =                                  \
     thci.h                                       \
     thci_safe_api.h                              \
+    thci_arena.h                                 \
+    thci_async.h                                 \
+    thci_bench.h                                 \
+    thci_clock.h                                 \
     thci_config.h                                \
+    thci_coroutine.h                             \
+    thci_daemon.h                                \
     thci_default_config.h                        \
+    thci_deferred_log.h                          \
+    thci_diag.h                                  \
+    thci_fault.h                                 \
+    thci_health.h                                \
     thci_logregions.h                            \
     thci_module.h                                \
+    thci_ncp_log.h                               \
     thci_notification.h                          \
+    thci_rf_test.h                               \
     thci_shell.h                                 \
+    thci_shm.h                                   \
+    thci_spi.h                                   \
+    thci_stats.h                                 \
 
 ifeq ($(BUILD_FEATURE_THCI_CERT),1)
 
@@ -44,9 +59,24 @@ THCI_SOURCES =                                   \
     thci_module_ncp.c                            \
     thci_module_soc.c                            \
     thci_module_ncp_uart.cpp                     \
+    thci_module_ncp_tty.cpp                      \
     thci_module_ncp_update.c                     \
+    thci_module_ncp_log.c                        \
     thci_shell.c                                 \
     thci_safe_api.c                              \
+    thci_deferred_log.c                          \
+    thci_stats.c                                 \
+    thci_clock.c                                 \
+    thci_bench.c                                 \
+    thci_fault.c                                 \
+    thci_health.c                                \
+    thci_daemon.c                                \
+    thci_module_ncp_spi.c                        \
+    thci_module_ncp_spi_sim.c                    \
+    thci_module_ncp_shm.c                        \
+    thci_shm.c                                   \
+    thci_shm_posix.c                             \
+    thci_arena.c                                 \
 
 ifeq ($(BUILD_FEATURE_THCI_CERT),1)
 
@@ -56,4 +86,3 @@ THCI_SOURCES +=                                  \
 endif
 
 THCI_SOURCES += $(NULL)
-